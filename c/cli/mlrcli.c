@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "lib/mlr_arch.h"
 #include "lib/mlrutil.h"
@@ -10,10 +11,13 @@
 #include "containers/lhmss.h"
 #include "containers/lhmsll.h"
 #include "input/lrec_readers.h"
+#include "input/file_reader_mmap.h"
+#include "input/file_decompressor.h"
 #include "dsl/function_manager.h"
 #include "dsl/mlr_dsl_cst.h"
 #include "mapping/mappers.h"
 #include "output/lrec_writers.h"
+#include "output/output_handle_pool.h"
 #include "cli/mlrcli.h"
 #include "cli/quoting.h"
 #include "cli/argparse.h"
@@ -33,7 +37,9 @@
 #define DEFAULT_JSON_FLATTEN_SEPARATOR   ":"
 #define DEFAULT_OOSVAR_FLATTEN_SEPARATOR ":"
 #define DEFAULT_COMMENT_STRING           "#"
-#define DEFAULT_MAX_FILE_SIZE_FOR_MMAP (4LL*1024LL*1024LL*1024LL)
+// Files are mapped whole but released a window at a time (see
+// input/file_reader_mmap.h), so size matters only for 32-bit address spaces.
+#define DEFAULT_MAX_FILE_SIZE_FOR_MMAP (sizeof(void*) >= 8 ? LLONG_MAX : 4LL*1024LL*1024LL*1024LL)
 
 // ----------------------------------------------------------------
 static mapper_setup_t* mapper_lookup_table[] = {
@@ -74,6 +80,7 @@ static mapper_setup_t* mapper_lookup_table[] = {
 	&mapper_seqgen_setup,
 	&mapper_shuffle_setup,
 	&mapper_sort_setup,
+	&mapper_split_setup,
 	&mapper_stats1_setup,
 	&mapper_stats2_setup,
 	&mapper_step_setup,
@@ -96,6 +103,7 @@ static lhmss_t* get_default_pses();
 static lhmss_t* get_default_rses();
 static void free_opt_singletons();
 static char* rebackslash(char* sep);
+static hss_t* get_used_field_names(sllv_t* pmapper_list, sllv_t* psetup_list);
 
 static void main_usage_long(FILE* o, char* argv0);
 static void main_usage_short(FILE* o, char* argv0);
@@ -190,6 +198,39 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 			}
 			argi += 2;
 
+		} else if (streq(argv[argi], "--read-threads") || streq(argv[argi], "--read-threads-unordered")) {
+			check_arg_count(argv, argi, argc, 2);
+			if (sscanf(argv[argi+1], "%d", &popts->read_threads) != 1 || popts->read_threads <= 0) {
+				fprintf(stderr,
+					"%s: %s argument must be a positive integer; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi], argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			popts->read_threads_ordered = streq(argv[argi], "--read-threads");
+			argi += 2;
+
+		} else if (streq(argv[argi], "--read-all-fields")) {
+			popts->read_all_fields = TRUE;
+			argi += 1;
+
+		} else if (streq(argv[argi], "--max-open-files")) {
+			check_arg_count(argv, argi, argc, 2);
+			int max_open_files = 0;
+			if (sscanf(argv[argi+1], "%d", &max_open_files) != 1 || max_open_files <= 0) {
+				fprintf(stderr,
+					"%s: --max-open-files argument must be a positive integer; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			output_handle_pool_set_max_open_files(max_open_files);
+			argi += 2;
+
+		} else if (streq(argv[argi], "--redirect-stats")) {
+			output_handle_pool_set_print_stats(TRUE);
+			argi += 1;
+
 		} else if (streq(argv[argi], "--seed")) {
 			check_arg_count(argv, argi, argc, 2);
 			if (sscanf(argv[argi+1], "0x%x", &rand_seed) == 1) {
@@ -261,9 +302,10 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 	if (no_input) {
 		slls_free(popts->filenames);
 		popts->filenames = NULL;
-	} else if (popts->filenames->length == 0) {
-		// No filenames means read from standard input, and standard input cannot be mmapped.
-		popts->reader_opts.use_mmap_for_read = FALSE;
+	} else if (popts->filenames->length == 0 || popts->reader_opts.prepipe != NULL) {
+		// No filenames means read from standard input.
+		if (!lrec_reader_mmap_reads_streams(&popts->reader_opts))
+			popts->reader_opts.use_mmap_for_read = FALSE;
 	} else if (popts->reader_opts.use_mmap_for_read == TRUE) {
 		// https://github.com/johnkerl/miller/issues/160: don't use mmap for large files.
 		//
@@ -282,6 +324,15 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 		if (!all_exist_and_are_small_enough) {
 			popts->reader_opts.use_mmap_for_read = FALSE;
 		}
+		// Gzipped files are read from a pipe, as is standard input.
+		if (!lrec_reader_mmap_reads_streams(&popts->reader_opts)) {
+			for (sllse_t* pe = popts->filenames->phead; pe != NULL; pe = pe->pnext) {
+				if (file_decompressor_is_gzipped(pe->value)) {
+					popts->reader_opts.use_mmap_for_read = FALSE;
+					break;
+				}
+			}
+		}
 	}
 
 	if (popts->do_in_place && (popts->filenames == NULL || popts->filenames->length == 0)) {
@@ -303,6 +354,7 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 // point to remaining post-mapper-setup args, i.e. filenames.
 sllv_t* cli_parse_mappers(char** argv, int* pargi, int argc, cli_opts_t* popts, int* pno_input) {
 	sllv_t* pmapper_list = sllv_alloc();
+	sllv_t* psetup_list = sllv_alloc();
 	int argi = *pargi;
 
 	// Allow then-chains to start with an initial 'then': 'mlr verb1 then verb2 then verb3' or
@@ -349,22 +401,55 @@ sllv_t* cli_parse_mappers(char** argv, int* pargi, int argc, cli_opts_t* popts,
 		}
 
 		sllv_append(pmapper_list, pmapper);
+		sllv_append(psetup_list, pmapper_setup);
 
 		if (argi >= argc || !streq(argv[argi], "then"))
 			break;
 		argi++;
 	}
 
+	// In-place mode reconstructs the mappers for each file, but they use the
+	// same fields each time.
+	if (!popts->read_all_fields && popts->reader_opts.pused_field_names == NULL)
+		popts->reader_opts.pused_field_names = get_used_field_names(pmapper_list, psetup_list);
+	sllv_free(psetup_list);
+
 	*pargi = argi;
 	return pmapper_list;
 }
 
+// ----------------------------------------------------------------
+// Goes down the chain as long as the mappers pass through the fields they
+// don't look at. If it reaches one whose output depends only on the fields it
+// names, then no verb (nor the writer) sees any fields but those named so far.
+// Returns them in that case, else null. The set points to the mappers' field
+// names, so it's for use while they're allocated.
+static hss_t* get_used_field_names(sllv_t* pmapper_list, sllv_t* psetup_list) {
+	hss_t* pfield_names = hss_alloc();
+	sllve_t* pe = pmapper_list->phead;
+	sllve_t* pf = psetup_list->phead;
+	for ( ; pe != NULL && pf != NULL; pe = pe->pnext, pf = pf->pnext) {
+		mapper_t* pmapper = pe->pvvalue;
+		mapper_setup_t* pmapper_setup = pf->pvvalue;
+		mapper_field_usage_t usage = (pmapper_setup->pfield_usage_func == NULL)
+			? MAPPER_USES_ALL_FIELDS
+			: pmapper_setup->pfield_usage_func(pmapper, pfield_names);
+		if (usage == MAPPER_USES_NAMED_FIELDS_ONLY)
+			return pfield_names;
+		if (usage != MAPPER_PASSES_OTHER_FIELDS)
+			break;
+	}
+	hss_free(pfield_names);
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 void cli_opts_free(cli_opts_t* popts) {
 	if (popts == NULL)
 		return;
 
 	slls_free(popts->filenames);
+	hss_free(popts->reader_opts.pused_field_names);
 	free(popts);
 	free_opt_singletons();
 }
@@ -422,6 +507,7 @@ static lhmss_t* get_default_rses() {
 		lhmss_put(singleton_default_rses, "markdown", "auto",  NO_FREE);
 		lhmss_put(singleton_default_rses, "pprint",   "auto",  NO_FREE);
 		lhmss_put(singleton_default_rses, "xtab",     "(N/A)", NO_FREE);
+		lhmss_put(singleton_default_rses, "bin",      "(N/A)", NO_FREE);
 	}
 	return singleton_default_rses;
 }
@@ -438,6 +524,7 @@ static lhmss_t* get_default_fses() {
 		lhmss_put(singleton_default_fses, "markdown", "(N/A)",  NO_FREE);
 		lhmss_put(singleton_default_fses, "pprint",   " ",      NO_FREE);
 		lhmss_put(singleton_default_fses, "xtab",     "auto",   NO_FREE);
+		lhmss_put(singleton_default_fses, "bin",      "(N/A)",  NO_FREE);
 	}
 	return singleton_default_fses;
 }
@@ -454,6 +541,7 @@ static lhmss_t* get_default_pses() {
 		lhmss_put(singleton_default_pses, "markdown", "(N/A)", NO_FREE);
 		lhmss_put(singleton_default_pses, "pprint",   "(N/A)", NO_FREE);
 		lhmss_put(singleton_default_pses, "xtab",     " ",     NO_FREE);
+		lhmss_put(singleton_default_pses, "bin",      "(N/A)", NO_FREE);
 	}
 	return singleton_default_pses;
 }
@@ -470,6 +558,7 @@ static lhmsll_t* get_default_repeat_ifses() {
 		lhmsll_put(singleton_default_repeat_ifses, "nidx",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "xtab",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ifses, "pprint",   TRUE,  NO_FREE);
+		lhmsll_put(singleton_default_repeat_ifses, "bin",      FALSE, NO_FREE);
 	}
 	return singleton_default_repeat_ifses;
 }
@@ -486,6 +575,7 @@ static lhmsll_t* get_default_repeat_ipses() {
 		lhmsll_put(singleton_default_repeat_ipses, "nidx",     FALSE, NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "xtab",     TRUE,  NO_FREE);
 		lhmsll_put(singleton_default_repeat_ipses, "pprint",   FALSE, NO_FREE);
+		lhmsll_put(singleton_default_repeat_ipses, "bin",      FALSE, NO_FREE);
 	}
 	return singleton_default_repeat_ipses;
 }
@@ -765,10 +855,19 @@ static void main_usage_data_format_options(FILE* o, char* argv0) {
 	fprintf(o, "  -t                              Synonymous with --tsvlite.\n");
 	fprintf(o, "\n");
 	fprintf(o, "  --ipprint --opprint --pprint    Pretty-printed tabular (produces no\n");
-	fprintf(o, "                                  output until all input is in).\n");
+	fprintf(o, "                                  output until all input is in, unless\n");
+	fprintf(o, "                                  --pprint-lookahead is used).\n");
 	fprintf(o, "                      --right     Right-justifies all fields for PPRINT output.\n");
 	fprintf(o, "                      --barred    Prints a border around PPRINT output\n");
 	fprintf(o, "                                  (only available for output).\n");
+	fprintf(o, "    --pprint-lookahead {n}        Streaming PPRINT output: column widths are\n");
+	fprintf(o, "                                  computed from the first n records of each\n");
+	fprintf(o, "                                  block, after which records are printed as they\n");
+	fprintf(o, "                                  arrive. A later value too wide for its column\n");
+	fprintf(o, "                                  starts a new block with its own header.\n");
+	fprintf(o, "                                  0 (the default) means no limit.\n");
+	fprintf(o, "    --pprint-truncate             With --pprint-lookahead, truncate too-wide\n");
+	fprintf(o, "                                  values rather than starting a new block.\n");
 	fprintf(o, "\n");
 	fprintf(o, "            --omd                 Markdown-tabular (only available for output).\n");
 	fprintf(o, "\n");
@@ -793,15 +892,28 @@ static void main_usage_data_format_options(FILE* o, char* argv0) {
 	fprintf(o, "                                  non-JSON formats. Defaults to %s.\n",
 		DEFAULT_JSON_FLATTEN_SEPARATOR);
 	fprintf(o, "\n");
+	fprintf(o, "  --ibin    --obin    --bin       Miller's own binary format, for piping records from\n");
+	fprintf(o, "                                  one %s process to another without formatting\n", argv0);
+	fprintf(o, "                                  and re-parsing them as text, e.g.\n");
+	fprintf(o, "                                  %s --icsv --obin sort -f a x.csv | %s --ibin --ojson head\n",
+		argv0, argv0);
+	fprintf(o, "                                  Records are written in batches, so output comes a batch\n");
+	fprintf(o, "                                  at a time. This is not a storage format: it may change\n");
+	fprintf(o, "                                  between Miller versions.\n");
+	fprintf(o, "\n");
 	fprintf(o, "  -p is a keystroke-saver for --nidx --fs space --repifs\n");
 	fprintf(o, "\n");
 	fprintf(o, "  --mmap --no-mmap --mmap-below {n} Use mmap for files whenever possible, never, or\n");
-	fprintf(o, "                                  for files less than n bytes in size. Default is for\n");
-	fprintf(o, "                                  files less than %lld bytes in size.\n", DEFAULT_MAX_FILE_SIZE_FOR_MMAP);
-	fprintf(o, "                                  'Whenever possible' means always except for when reading\n");
-	fprintf(o, "                                  standard input which is not mmappable. If you don't know\n");
+	fprintf(o, "                                  for files less than n bytes in size. Default is\n");
+	fprintf(o, "                                  whenever possible on 64-bit systems.\n");
+	fprintf(o, "                                  Standard input and --prepipe output are not mmappable;\n");
+	fprintf(o, "                                  for DKVP and NIDX they are instead read in large blocks\n");
+	fprintf(o, "                                  which the same parsers run over. If you don't know\n");
 	fprintf(o, "                                  what this means, don't worry about it -- it's a minor\n");
 	fprintf(o, "                                  performance optimization.\n");
+	fprintf(o, "  --mmap-window {n}               Memory for mmapped files is released n bytes at\n");
+	fprintf(o, "                                  a time, as records are done with. Default %lld.\n",
+		FILE_READER_MMAP_DEFAULT_WINDOW_SIZE);
 	fprintf(o, "\n");
 	fprintf(o, "  Examples: --csv for CSV-formatted input and output; --idkvp --opprint for\n");
 	fprintf(o, "  DKVP-formatted input and pretty-printed output.\n");
@@ -843,6 +955,9 @@ static void main_usage_format_conversion_keystroke_saver_options(FILE* o, char*
 }
 
 static void main_usage_compressed_data_options(FILE* o, char* argv0) {
+	fprintf(o, "  Gzip-compressed input files, including concatenated ones, are decompressed\n");
+	fprintf(o, "  natively without --prepipe. They are recognized by their contents rather than\n");
+	fprintf(o, "  their names, and decompressed in a separate thread.\n");
 	fprintf(o, "  --prepipe {command} This allows Miller to handle compressed inputs. You can do\n");
 	fprintf(o, "  without this for single input files, e.g. \"gunzip < myfile.csv.gz | %s ...\".\n",
 		argv0);
@@ -897,6 +1012,7 @@ static void main_usage_separator_options(FILE* o, char* argv0) {
 	fprintf(o, "    disabled.\n");
 	fprintf(o, "  * TSV is simply CSV using tab as field separator (\"--fs tab\").\n");
 	fprintf(o, "  * FS/PS are ignored for markdown format; RS is used.\n");
+	fprintf(o, "  * All separator options are ignored for binary format.\n");
 	fprintf(o, "  * All FS and PS options are ignored for JSON format, since they are not relevant\n");
 	fprintf(o, "    to the JSON format.\n");
 	fprintf(o, "  * You can specify separators in any of the following ways, shown by example:\n");
@@ -959,6 +1075,29 @@ static void main_usage_other_options(FILE* o, char* argv0) {
 	fprintf(o, "                     urand()/urandint()/urand32().\n");
 	fprintf(o, "  --nr-progress-mod {m}, with m a positive integer: print filename and record\n");
 	fprintf(o, "                     count to stderr every m input records.\n");
+	fprintf(o, "  --read-threads {n} Read and parse up to n input files at once, on separate\n");
+	fprintf(o, "                     threads, while the main thread runs the verbs. Records are\n");
+	fprintf(o, "                     still processed in file order, with the same FILENAME,\n");
+	fprintf(o, "                     FNR, and FILENUM, so output is as without this flag. Not\n");
+	fprintf(o, "                     used for standard input, in-place mode, or --pass-comments.\n");
+	fprintf(o, "                     Files are read with stdio rather than mmap in this mode.\n");
+	fprintf(o, "  --read-threads-unordered {n} As --read-threads, but records of different\n");
+	fprintf(o, "                     files are processed as they are parsed, interleaved. Each\n");
+	fprintf(o, "                     still has its own FILENAME, FNR, and FILENUM. Only for\n");
+	fprintf(o, "                     verbs where input order doesn't matter, such as stats1\n");
+	fprintf(o, "                     without mode/antimode, count-distinct, or uniq -n.\n");
+	fprintf(o, "  --read-all-fields  Make records of all input fields. By default, when the\n");
+	fprintf(o, "                     verbs are known to use only some fields -- e.g. mlr cut -f\n");
+	fprintf(o, "                     or stats1 -f/-g, perhaps after sort -f, head, or a put or\n");
+	fprintf(o, "                     filter not using $*, NF, or $[...] -- the DKVP and CSV\n");
+	fprintf(o, "                     readers skip the others, since no output depends on them.\n");
+	fprintf(o, "  --max-open-files {n} For put/filter tee/emit/print/dump redirects to files:\n");
+	fprintf(o, "                     keep at most n of them open at a time. When more are\n");
+	fprintf(o, "                     needed, the least recently written-to is closed, and\n");
+	fprintf(o, "                     reopened in append mode when next written to. Default is\n");
+	fprintf(o, "                     half the open-file limit (ulimit -n).\n");
+	fprintf(o, "  --redirect-stats   At exit, print to stderr counts of redirect-file opens,\n");
+	fprintf(o, "                     reopens, evictions, and flushes.\n");
 	fprintf(o, "  --from {filename}  Use this to specify an input file before the verb(s),\n");
 	fprintf(o, "                     rather than after. May be used more than once. Example:\n");
 	fprintf(o, "                     \"%s --from a.dat --from b.dat cat\" is the same as\n", argv0);
@@ -1069,6 +1208,10 @@ void cli_opts_init(cli_opts_t* popts) {
 	popts->nr_progress_mod = 0LL;
 
 	popts->do_in_place     = FALSE;
+
+	popts->read_threads         = 1;
+	popts->read_threads_ordered = TRUE;
+	popts->read_all_fields      = FALSE;
 }
 
 void cli_reader_opts_init(cli_reader_opts_t* preader_opts) {
@@ -1095,6 +1238,8 @@ void cli_reader_opts_init(cli_reader_opts_t* preader_opts) {
 	preader_opts->generator_opts.start          = 0LL;
 	preader_opts->generator_opts.stop           = 100LL;
 	preader_opts->generator_opts.step           = 1LL;
+
+	preader_opts->pused_field_names              = NULL;
 }
 
 void cli_writer_opts_init(cli_writer_opts_t* pwriter_opts) {
@@ -1107,6 +1252,8 @@ void cli_writer_opts_init(cli_writer_opts_t* pwriter_opts) {
 	pwriter_opts->right_justify_xtab_value       = NEITHER_TRUE_NOR_FALSE;
 	pwriter_opts->right_align_pprint             = NEITHER_TRUE_NOR_FALSE;
 	pwriter_opts->pprint_barred                  = NEITHER_TRUE_NOR_FALSE;
+	pwriter_opts->pprint_lookahead               = -1LL;
+	pwriter_opts->pprint_truncate                = NEITHER_TRUE_NOR_FALSE;
 	pwriter_opts->stack_json_output_vertically   = NEITHER_TRUE_NOR_FALSE;
 	pwriter_opts->wrap_json_output_in_outer_list = NEITHER_TRUE_NOR_FALSE;
 	pwriter_opts->json_quote_int_keys            = NEITHER_TRUE_NOR_FALSE;
@@ -1165,6 +1312,12 @@ void cli_apply_writer_defaults(cli_writer_opts_t* pwriter_opts) {
 	if (pwriter_opts->pprint_barred == NEITHER_TRUE_NOR_FALSE)
 		pwriter_opts->pprint_barred = FALSE;
 
+	if (pwriter_opts->pprint_lookahead < 0LL)
+		pwriter_opts->pprint_lookahead = 0LL;
+
+	if (pwriter_opts->pprint_truncate == NEITHER_TRUE_NOR_FALSE)
+		pwriter_opts->pprint_truncate = FALSE;
+
 	if (pwriter_opts->stack_json_output_vertically == NEITHER_TRUE_NOR_FALSE)
 		pwriter_opts->stack_json_output_vertically = FALSE;
 
@@ -1291,6 +1444,12 @@ void cli_merge_writer_opts(cli_writer_opts_t* pfunc_opts, cli_writer_opts_t* pma
 	if (pfunc_opts->pprint_barred == NEITHER_TRUE_NOR_FALSE)
 		pfunc_opts->pprint_barred = pmain_opts->pprint_barred;
 
+	if (pfunc_opts->pprint_lookahead < 0LL)
+		pfunc_opts->pprint_lookahead = pmain_opts->pprint_lookahead;
+
+	if (pfunc_opts->pprint_truncate == NEITHER_TRUE_NOR_FALSE)
+		pfunc_opts->pprint_truncate = pmain_opts->pprint_truncate;
+
 	if (pfunc_opts->stack_json_output_vertically == NEITHER_TRUE_NOR_FALSE)
 		pfunc_opts->stack_json_output_vertically = pmain_opts->stack_json_output_vertically;
 
@@ -1535,6 +1694,10 @@ int cli_handle_reader_options(char** argv, int argc, int *pargi, cli_reader_opts
 		preader_opts->ifile_fmt = "xtab";
 		argi += 1;
 
+	} else if (streq(argv[argi], "--ibin")) {
+		preader_opts->ifile_fmt = "bin";
+		argi += 1;
+
 	} else if (streq(argv[argi], "--ipprint")) {
 		preader_opts->ifile_fmt        = "csvlite";
 		preader_opts->ifs              = " ";
@@ -1560,10 +1723,20 @@ int cli_handle_reader_options(char** argv, int argc, int *pargi, cli_reader_opts
 		preader_opts->max_file_size_for_mmap = llmax;
 		argi += 2;
 
+	} else if (streq(argv[argi], "--mmap-window")) {
+		check_arg_count(argv, argi, argc, 2);
+		long long window_size;
+		if (sscanf(argv[argi+1], "%lld", &window_size) != 1 || window_size <= 0) {
+			fprintf(stderr, "%s: --mmap-window argument must be a positive integer; got \"%s\".\n",
+				MLR_GLOBALS.bargv0, argv[argi+1]);
+			exit(1);
+		}
+		file_reader_mmap_set_window_size(window_size);
+		argi += 2;
+
 	} else if (streq(argv[argi], "--prepipe")) {
 		check_arg_count(argv, argi, argc, 2);
 		preader_opts->prepipe = argv[argi+1];
-		preader_opts->use_mmap_for_read = FALSE;
 		argi += 2;
 
 	} else if (streq(argv[argi], "--skip-comments")) {
@@ -1692,6 +1865,10 @@ int cli_handle_writer_options(char** argv, int argc, int *pargi, cli_writer_opts
 		pwriter_opts->ofile_fmt = "xtab";
 		argi += 1;
 
+	} else if (streq(argv[argi], "--obin")) {
+		pwriter_opts->ofile_fmt = "bin";
+		argi += 1;
+
 	} else if (streq(argv[argi], "--opprint")) {
 		pwriter_opts->ofile_fmt = "pprint";
 		argi += 1;
@@ -1704,6 +1881,21 @@ int cli_handle_writer_options(char** argv, int argc, int *pargi, cli_writer_opts
 		pwriter_opts->pprint_barred = TRUE;
 		argi += 1;
 
+	} else if (streq(argv[argi], "--pprint-lookahead")) {
+		check_arg_count(argv, argi, argc, 2);
+		if (sscanf(argv[argi+1], "%lld", &pwriter_opts->pprint_lookahead) != 1
+			|| pwriter_opts->pprint_lookahead < 0LL)
+		{
+			fprintf(stderr, "%s: --pprint-lookahead argument must be a non-negative integer; got \"%s\".\n",
+				MLR_GLOBALS.bargv0, argv[argi+1]);
+			exit(1);
+		}
+		argi += 2;
+
+	} else if (streq(argv[argi], "--pprint-truncate")) {
+		pwriter_opts->pprint_truncate = TRUE;
+		argi += 1;
+
 	} else if (streq(argv[argi], "--quote-all")) {
 		pwriter_opts->oquoting = QUOTE_ALL;
 		argi += 1;
@@ -1828,6 +2020,11 @@ int cli_handle_reader_writer_options(char** argv, int argc, int *pargi,
 		pwriter_opts->ofile_fmt = "xtab";
 		argi += 1;
 
+	} else if (streq(argv[argi], "--bin")) {
+		preader_opts->ifile_fmt = "bin";
+		pwriter_opts->ofile_fmt = "bin";
+		argi += 1;
+
 	} else if (streq(argv[argi], "--pprint")) {
 		preader_opts->ifile_fmt        = "csvlite";
 		preader_opts->ifs              = " ";
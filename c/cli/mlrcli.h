@@ -13,6 +13,7 @@
 #include "cli/json_array_ingest.h"
 #include "containers/lhmsll.h"
 #include "containers/lhmss.h"
+#include "containers/hss.h"
 #include <unistd.h>
 
 // ----------------------------------------------------------------
@@ -51,6 +52,11 @@ typedef struct _cli_reader_opts_t {
 	// Fake internal-data-generator 'reader'
 	generator_opts_t generator_opts;
 
+	// Set from the verb chain when it's known to look at only these fields.
+	// Readers may then leave the others out of the records they return. Null
+	// means all fields are needed.
+	hss_t* pused_field_names;
+
 } cli_reader_opts_t;
 
 // ----------------------------------------------------------------
@@ -65,6 +71,8 @@ typedef struct _cli_writer_opts_t {
 	int   right_justify_xtab_value;
 	int   right_align_pprint;
 	int   pprint_barred;
+	long long pprint_lookahead;
+	int   pprint_truncate;
 	int   stack_json_output_vertically;
 	int   wrap_json_output_in_outer_list;
 	int   json_quote_int_keys;
@@ -94,6 +102,13 @@ typedef struct _cli_opts_t {
 
 	int do_in_place;
 
+	// Number of threads reading input files; 1 for reading them in turn.
+	int read_threads;
+	int read_threads_ordered;
+
+	// Don't let readers skip fields which the verb chain won't look at.
+	int read_all_fields;
+
 } cli_opts_t;
 
 // ----------------------------------------------------------------
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/fingerprint_table.h"
+
+// ----------------------------------------------------------------
+// Allow compile-time override, e.g using gcc -D.
+#ifndef FINGERPRINT_TABLE_INITIAL_SLOTS
+#define FINGERPRINT_TABLE_INITIAL_SLOTS 16
+#endif
+
+static void fingerprint_table_rehash(fingerprint_table_t* ptable, unsigned int num_slots);
+
+// ----------------------------------------------------------------
+fingerprint_table_t* fingerprint_table_alloc() {
+	fingerprint_table_t* ptable = mlr_malloc_or_die(sizeof(fingerprint_table_t));
+	ptable->entries          = NULL;
+	ptable->num_entries      = 0;
+	ptable->entries_capacity = 0;
+	ptable->slots            = NULL;
+	ptable->slots_mask       = 0;
+	fingerprint_table_rehash(ptable, FINGERPRINT_TABLE_INITIAL_SLOTS);
+	return ptable;
+}
+
+void fingerprint_table_free(fingerprint_table_t* ptable) {
+	if (ptable == NULL)
+		return;
+	free(ptable->entries);
+	free(ptable->slots);
+	free(ptable);
+}
+
+// ----------------------------------------------------------------
+// The slot index is from the first hash and the tag from the second, so that a
+// tag match is nearly always a full match.
+static inline fingerprint_table_slot_t* fingerprint_table_find_slot(fingerprint_table_t* ptable,
+	fingerprint_t fingerprint)
+{
+	unsigned int hash_tag = (unsigned int)(fingerprint.lo >> 32);
+	unsigned int index = (unsigned int)fingerprint.hi & ptable->slots_mask;
+	while (TRUE) {
+		fingerprint_table_slot_t* pslot = &ptable->slots[index];
+		if (pslot->entry_index == 0)
+			return pslot;
+		if (pslot->hash_tag == hash_tag) {
+			fingerprint_table_entry_t* pe = &ptable->entries[pslot->entry_index - 1];
+			if (pe->fingerprint.hi == fingerprint.hi && pe->fingerprint.lo == fingerprint.lo)
+				return pslot;
+		}
+		index = (index + 1) & ptable->slots_mask;
+	}
+}
+
+fingerprint_table_entry_t* fingerprint_table_get(fingerprint_table_t* ptable, fingerprint_t fingerprint) {
+	fingerprint_table_slot_t* pslot = fingerprint_table_find_slot(ptable, fingerprint);
+	return pslot->entry_index == 0 ? NULL : &ptable->entries[pslot->entry_index - 1];
+}
+
+fingerprint_table_entry_t* fingerprint_table_get_or_add(fingerprint_table_t* ptable, fingerprint_t fingerprint) {
+	fingerprint_table_slot_t* pslot = fingerprint_table_find_slot(ptable, fingerprint);
+	if (pslot->entry_index != 0)
+		return &ptable->entries[pslot->entry_index - 1];
+
+	if (ptable->num_entries >= ptable->entries_capacity) {
+		ptable->entries_capacity = ptable->entries_capacity == 0 ? FINGERPRINT_TABLE_INITIAL_SLOTS
+			: 2 * ptable->entries_capacity;
+		ptable->entries = mlr_realloc_or_die(ptable->entries,
+			ptable->entries_capacity * sizeof(fingerprint_table_entry_t));
+	}
+	int entry_index = ptable->num_entries++;
+	fingerprint_table_entry_t* pe = &ptable->entries[entry_index];
+	pe->fingerprint = fingerprint;
+	pe->count       = 0LL;
+	pe->pvvalue     = NULL;
+	pslot->hash_tag    = (unsigned int)(fingerprint.lo >> 32);
+	pslot->entry_index = ptable->num_entries;
+
+	// Keep the load factor at most 3/4.
+	if (4ULL * ptable->num_entries >= 3ULL * (ptable->slots_mask + 1ULL))
+		fingerprint_table_rehash(ptable, 2 * (ptable->slots_mask + 1));
+	return &ptable->entries[entry_index];
+}
+
+// ----------------------------------------------------------------
+static void fingerprint_table_rehash(fingerprint_table_t* ptable, unsigned int num_slots) {
+	free(ptable->slots);
+	ptable->slots = mlr_malloc_or_die(num_slots * sizeof(fingerprint_table_slot_t));
+	memset(ptable->slots, 0, num_slots * sizeof(fingerprint_table_slot_t));
+	ptable->slots_mask = num_slots - 1;
+	for (int i = 0; i < ptable->num_entries; i++) {
+		fingerprint_t fingerprint = ptable->entries[i].fingerprint;
+		unsigned int index = (unsigned int)fingerprint.hi & ptable->slots_mask;
+		while (ptable->slots[index].entry_index != 0)
+			index = (index + 1) & ptable->slots_mask;
+		ptable->slots[index].hash_tag    = (unsigned int)(fingerprint.lo >> 32);
+		ptable->slots[index].entry_index = i + 1;
+	}
+}
+
+// ----------------------------------------------------------------
+int fingerprint_table_check(fingerprint_table_t* ptable) {
+	int num_occupied = 0;
+	for (unsigned int index = 0; index <= ptable->slots_mask; index++) {
+		fingerprint_table_slot_t* pslot = &ptable->slots[index];
+		if (pslot->entry_index == 0)
+			continue;
+		num_occupied++;
+		if (pslot->entry_index > ptable->num_entries)
+			return FALSE;
+		fingerprint_table_entry_t* pe = &ptable->entries[pslot->entry_index - 1];
+		if (pslot->hash_tag != (unsigned int)(pe->fingerprint.lo >> 32))
+			return FALSE;
+		if (fingerprint_table_get(ptable, pe->fingerprint) != pe)
+			return FALSE;
+	}
+	return num_occupied == ptable->num_entries;
+}
@@ -0,0 +1,76 @@
+// ================================================================
+// Table keyed by 128-bit fingerprints of group keys, for mlr uniq and
+// count-distinct with --fingerprint: a set of distinct keys (or records) which
+// doesn't store the keys themselves, only their hashes, with a count and an
+// optional void-star per entry, in insertion order.
+//
+// Two distinct keys are taken as the same only if both of their independent
+// 64-bit hashes collide, which for n distinct keys happens with probability
+// about n^2/2^129: negligible for any data set which fits on disk.
+//
+// As with group_table, the index is open-addressing with linear probing over
+// slots holding the entry number and part of the fingerprint; entries are in a
+// separate array in insertion order, which is the iteration order:
+//
+//   for (int i = 0; i < ptable->num_entries; i++) {
+//     fingerprint_table_entry_t* pe = &ptable->entries[i];
+//     ... pe->count, pe->pvvalue ...
+//   }
+//
+// There is no removal.
+// ================================================================
+
+#ifndef FINGERPRINT_TABLE_H
+#define FINGERPRINT_TABLE_H
+
+#include "containers/group_table.h"
+
+typedef struct _fingerprint_t {
+	unsigned long long hi; // The group key's hash
+	unsigned long long lo; // Its second hash
+} fingerprint_t;
+
+static inline fingerprint_t fingerprint_from_group_key(group_key_t* pkey) {
+	fingerprint_t fingerprint = { pkey->hash, group_key_second_hash(pkey) };
+	return fingerprint;
+}
+
+// ----------------------------------------------------------------
+typedef struct _fingerprint_table_entry_t {
+	fingerprint_t      fingerprint;
+	unsigned long long count;
+	void*              pvvalue;
+} fingerprint_table_entry_t;
+
+typedef struct _fingerprint_table_slot_t {
+	unsigned int hash_tag;    // High 32 bits of the fingerprint's second hash
+	unsigned int entry_index; // One more than the index into entries; zero for empty slots.
+} fingerprint_table_slot_t;
+
+typedef struct _fingerprint_table_t {
+	fingerprint_table_entry_t* entries;
+	int                        num_entries;
+	int                        entries_capacity;
+
+	fingerprint_table_slot_t*  slots;
+	unsigned int               slots_mask;
+} fingerprint_table_t;
+
+fingerprint_table_t* fingerprint_table_alloc();
+// Void-star payloads should first be freed by the caller.
+void fingerprint_table_free(fingerprint_table_t* ptable);
+
+// Returns NULL if the fingerprint isn't present.
+fingerprint_table_entry_t* fingerprint_table_get(fingerprint_table_t* ptable, fingerprint_t fingerprint);
+// Returns the fingerprint's entry, first adding it with a count of zero and a
+// NULL value if it isn't present. The pointer is valid only until the next add.
+fingerprint_table_entry_t* fingerprint_table_get_or_add(fingerprint_table_t* ptable, fingerprint_t fingerprint);
+
+static inline int fingerprint_table_size(fingerprint_table_t* ptable) {
+	return ptable->num_entries;
+}
+
+// Unit-test hook
+int fingerprint_table_check(fingerprint_table_t* ptable);
+
+#endif // FINGERPRINT_TABLE_H
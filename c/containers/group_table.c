@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/group_table.h"
+
+// ----------------------------------------------------------------
+// Allow compile-time override, e.g using gcc -D.
+#ifndef GROUP_TABLE_INITIAL_SLOTS
+#define GROUP_TABLE_INITIAL_SLOTS 16
+#endif
+
+#ifndef GROUP_TABLE_BLOCK_SIZE
+#define GROUP_TABLE_BLOCK_SIZE (64 * 1024)
+#endif
+
+#define GROUP_KEY_INITIAL_CAPACITY 4
+
+// Multipliers from MurmurHash3's 64-bit finalizer and the golden ratio.
+#define HASH_SEED 0x9e3779b97f4a7c15ULL
+#define HASH_MUL1 0xff51afd7ed558ccdULL
+#define HASH_MUL2 0xc4ceb9fe1a85ec53ULL
+// For the second hash: from xxHash64.
+#define HASH2_SEED 0x27d4eb2f165667c5ULL
+#define HASH2_MUL1 0x9e3779b185ebca87ULL
+#define HASH2_MUL2 0xc2b2ae3d27d4eb4fULL
+
+typedef struct _group_table_block_t {
+	struct _group_table_block_t* pnext;
+	size_t size;
+	size_t used;
+	char   data[];
+} group_table_block_t;
+
+static void group_table_rehash(group_table_t* ptable, unsigned int num_slots);
+static char** group_table_copy_key(group_table_t* ptable, group_key_t* pkey);
+
+// ================================================================
+// Hashing: eight bytes at a time, with a multiply-rotate step per word and
+// the value's length folded in after each value, so that ("ab","c") and
+// ("a","bc") differ. A final avalanche spreads the entropy into both the low
+// bits (used for the slot index) and the high bits (kept as the slot's tag).
+
+static inline unsigned long long rotl64(unsigned long long x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline unsigned long long hash_bytes(unsigned long long h, char* p, int n) {
+	unsigned long long w;
+	for ( ; n >= 8; p += 8, n -= 8) {
+		memcpy(&w, p, 8);
+		h = rotl64(h ^ (w * HASH_MUL1), 31) * HASH_SEED;
+	}
+	if (n > 0) {
+		w = 0ULL;
+		memcpy(&w, p, n);
+		h = rotl64(h ^ (w * HASH_MUL1), 31) * HASH_SEED;
+	}
+	return h;
+}
+
+static inline unsigned long long hash_finish(unsigned long long h) {
+	h ^= h >> 33;
+	h *= HASH_MUL1;
+	h ^= h >> 33;
+	h *= HASH_MUL2;
+	h ^= h >> 33;
+	return h;
+}
+
+// ================================================================
+group_key_t* group_key_alloc() {
+	group_key_t* pkey = mlr_malloc_or_die(sizeof(group_key_t));
+	pkey->num_values = 0;
+	pkey->capacity   = GROUP_KEY_INITIAL_CAPACITY;
+	pkey->values     = mlr_malloc_or_die(pkey->capacity * sizeof(char*));
+	pkey->lengths    = mlr_malloc_or_die(pkey->capacity * sizeof(int));
+	pkey->hash       = 0ULL;
+	return pkey;
+}
+
+void group_key_free(group_key_t* pkey) {
+	if (pkey == NULL)
+		return;
+	free(pkey->values);
+	free(pkey->lengths);
+	free(pkey);
+}
+
+static void group_key_ensure_capacity(group_key_t* pkey, int num_values) {
+	if (num_values > pkey->capacity) {
+		pkey->capacity = num_values;
+		pkey->values   = mlr_realloc_or_die(pkey->values, pkey->capacity * sizeof(char*));
+		pkey->lengths  = mlr_realloc_or_die(pkey->lengths, pkey->capacity * sizeof(int));
+	}
+}
+
+// Hashes the values already placed in the key.
+static void group_key_finish(group_key_t* pkey) {
+	unsigned long long h = HASH_SEED;
+	for (int i = 0; i < pkey->num_values; i++) {
+		int length = strlen(pkey->values[i]);
+		pkey->lengths[i] = length;
+		h = hash_bytes(h, pkey->values[i], length);
+		h = (h ^ length) * HASH_MUL2;
+	}
+	pkey->hash = hash_finish(h);
+}
+
+// As hash_bytes but with other constants and rotation, for the second hash.
+static inline unsigned long long hash2_bytes(unsigned long long h, char* p, int n) {
+	unsigned long long w;
+	for ( ; n >= 8; p += 8, n -= 8) {
+		memcpy(&w, p, 8);
+		h = rotl64(h ^ (w * HASH2_MUL2), 27) * HASH2_MUL1;
+	}
+	if (n > 0) {
+		w = 0ULL;
+		memcpy(&w, p, n);
+		h = rotl64(h ^ (w * HASH2_MUL2), 27) * HASH2_MUL1;
+	}
+	return h;
+}
+
+unsigned long long group_key_second_hash(group_key_t* pkey) {
+	unsigned long long h = HASH2_SEED;
+	for (int i = 0; i < pkey->num_values; i++) {
+		h = hash2_bytes(h, pkey->values[i], pkey->lengths[i]);
+		h = (h ^ pkey->lengths[i]) * HASH2_MUL2;
+	}
+	return hash_finish(h ^ pkey->num_values);
+}
+
+int group_key_from_record(group_key_t* pkey, lrec_t* prec, slls_t* pfield_names) {
+	group_key_ensure_capacity(pkey, pfield_names->length);
+	int i = 0;
+	for (sllse_t* pe = pfield_names->phead; pe != NULL; pe = pe->pnext, i++) {
+		char* value = lrec_get(prec, pe->value);
+		if (value == NULL)
+			return FALSE;
+		pkey->values[i] = value;
+	}
+	pkey->num_values = i;
+	group_key_finish(pkey);
+	return TRUE;
+}
+
+void group_key_from_list(group_key_t* pkey, slls_t* pvalues) {
+	group_key_ensure_capacity(pkey, pvalues->length);
+	int i = 0;
+	for (sllse_t* pe = pvalues->phead; pe != NULL; pe = pe->pnext, i++)
+		pkey->values[i] = pe->value;
+	pkey->num_values = i;
+	group_key_finish(pkey);
+}
+
+void group_key_from_array(group_key_t* pkey, char** values, int num_values) {
+	group_key_ensure_capacity(pkey, num_values);
+	for (int i = 0; i < num_values; i++)
+		pkey->values[i] = values[i];
+	pkey->num_values = num_values;
+	group_key_finish(pkey);
+}
+
+// ================================================================
+group_table_t* group_table_alloc(int num_key_fields) {
+	group_table_t* ptable = mlr_malloc_or_die(sizeof(group_table_t));
+	ptable->num_key_fields   = num_key_fields;
+	ptable->entries          = NULL;
+	ptable->num_entries      = 0;
+	ptable->entries_capacity = 0;
+	ptable->slots            = NULL;
+	ptable->slots_mask       = 0;
+	ptable->pblocks          = NULL;
+	group_table_rehash(ptable, GROUP_TABLE_INITIAL_SLOTS);
+	return ptable;
+}
+
+void group_table_free(group_table_t* ptable) {
+	if (ptable == NULL)
+		return;
+	group_table_block_t* pnext = NULL;
+	for (group_table_block_t* pblock = ptable->pblocks; pblock != NULL; pblock = pnext) {
+		pnext = pblock->pnext;
+		free(pblock);
+	}
+	free(ptable->entries);
+	free(ptable->slots);
+	free(ptable);
+}
+
+// ----------------------------------------------------------------
+// Returns the slot where the key is, or the empty slot where it should go.
+static inline group_table_slot_t* group_table_find_slot(group_table_t* ptable, group_key_t* pkey) {
+	MLR_INTERNAL_CODING_ERROR_IF(pkey->num_values != ptable->num_key_fields);
+	unsigned int hash_tag = (unsigned int)(pkey->hash >> 32);
+	unsigned int index = (unsigned int)pkey->hash & ptable->slots_mask;
+	while (TRUE) {
+		group_table_slot_t* pslot = &ptable->slots[index];
+		if (pslot->entry_index == 0)
+			return pslot;
+		if (pslot->hash_tag == hash_tag) {
+			group_table_entry_t* pe = &ptable->entries[pslot->entry_index - 1];
+			if (pe->hash == pkey->hash) {
+				int i = 0;
+				for ( ; i < pkey->num_values; i++) {
+					// Includes the null terminator, so prefixes don't match.
+					if (memcmp(pe->key_values[i], pkey->values[i], pkey->lengths[i] + 1) != 0)
+						break;
+				}
+				if (i == pkey->num_values)
+					return pslot;
+			}
+		}
+		index = (index + 1) & ptable->slots_mask;
+	}
+}
+
+void* group_table_get(group_table_t* ptable, group_key_t* pkey) {
+	group_table_slot_t* pslot = group_table_find_slot(ptable, pkey);
+	return pslot->entry_index == 0 ? NULL : ptable->entries[pslot->entry_index - 1].pvvalue;
+}
+
+void** group_table_get_or_add(group_table_t* ptable, group_key_t* pkey) {
+	group_table_slot_t* pslot = group_table_find_slot(ptable, pkey);
+	if (pslot->entry_index != 0)
+		return &ptable->entries[pslot->entry_index - 1].pvvalue;
+
+	if (ptable->num_entries >= ptable->entries_capacity) {
+		ptable->entries_capacity = ptable->entries_capacity == 0 ? GROUP_TABLE_INITIAL_SLOTS
+			: 2 * ptable->entries_capacity;
+		ptable->entries = mlr_realloc_or_die(ptable->entries,
+			ptable->entries_capacity * sizeof(group_table_entry_t));
+	}
+	group_table_entry_t* pe = &ptable->entries[ptable->num_entries++];
+	pe->hash       = pkey->hash;
+	pe->key_values = group_table_copy_key(ptable, pkey);
+	pe->pvvalue    = NULL;
+	pslot->hash_tag    = (unsigned int)(pkey->hash >> 32);
+	pslot->entry_index = ptable->num_entries;
+
+	// Keep the load factor at most 3/4.
+	if (4ULL * ptable->num_entries >= 3ULL * (ptable->slots_mask + 1ULL))
+		group_table_rehash(ptable, 2 * (ptable->slots_mask + 1));
+	return &pe->pvvalue;
+}
+
+void group_table_put(group_table_t* ptable, group_key_t* pkey, void* pvvalue) {
+	*group_table_get_or_add(ptable, pkey) = pvvalue;
+}
+
+// ----------------------------------------------------------------
+// The entries keep their full hashes, so keys needn't be rehashed.
+static void group_table_rehash(group_table_t* ptable, unsigned int num_slots) {
+	free(ptable->slots);
+	ptable->slots = mlr_malloc_or_die(num_slots * sizeof(group_table_slot_t));
+	memset(ptable->slots, 0, num_slots * sizeof(group_table_slot_t));
+	ptable->slots_mask = num_slots - 1;
+	for (int i = 0; i < ptable->num_entries; i++) {
+		unsigned long long hash = ptable->entries[i].hash;
+		unsigned int index = (unsigned int)hash & ptable->slots_mask;
+		while (ptable->slots[index].entry_index != 0)
+			index = (index + 1) & ptable->slots_mask;
+		ptable->slots[index].hash_tag    = (unsigned int)(hash >> 32);
+		ptable->slots[index].entry_index = i + 1;
+	}
+}
+
+// ----------------------------------------------------------------
+// Lays the key out in the arena as an array of value pointers followed by the
+// null-terminated values themselves.
+static char** group_table_copy_key(group_table_t* ptable, group_key_t* pkey) {
+	size_t pointers_size = pkey->num_values * sizeof(char*);
+	size_t size = pointers_size;
+	for (int i = 0; i < pkey->num_values; i++)
+		size += pkey->lengths[i] + 1;
+	size = (size + sizeof(char*) - 1) & ~(sizeof(char*) - 1);
+
+	group_table_block_t* pblock = ptable->pblocks;
+	if (pblock == NULL || pblock->used + size > pblock->size) {
+		size_t block_size = size > GROUP_TABLE_BLOCK_SIZE ? size : GROUP_TABLE_BLOCK_SIZE;
+		pblock = mlr_malloc_or_die(sizeof(group_table_block_t) + block_size);
+		pblock->size = block_size;
+		pblock->used = 0;
+		pblock->pnext = ptable->pblocks;
+		ptable->pblocks = pblock;
+	}
+	char** key_values = (char**)&pblock->data[pblock->used];
+	char* p = &pblock->data[pblock->used + pointers_size];
+	for (int i = 0; i < pkey->num_values; i++) {
+		key_values[i] = p;
+		memcpy(p, pkey->values[i], pkey->lengths[i] + 1);
+		p += pkey->lengths[i] + 1;
+	}
+	pblock->used += size;
+	return key_values;
+}
+
+// ----------------------------------------------------------------
+int group_table_check(group_table_t* ptable) {
+	int num_occupied = 0;
+	for (unsigned int index = 0; index <= ptable->slots_mask; index++) {
+		group_table_slot_t* pslot = &ptable->slots[index];
+		if (pslot->entry_index == 0)
+			continue;
+		num_occupied++;
+		if (pslot->entry_index > ptable->num_entries)
+			return FALSE;
+		group_table_entry_t* pe = &ptable->entries[pslot->entry_index - 1];
+		if (pslot->hash_tag != (unsigned int)(pe->hash >> 32))
+			return FALSE;
+	}
+	return num_occupied == ptable->num_entries;
+}
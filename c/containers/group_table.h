@@ -0,0 +1,98 @@
+// ================================================================
+// Group-by table for the grouping verbs (stats1 -g, count-distinct, head -g,
+// etc.): maps tuples of field values to void-star, in insertion order.
+//
+// Lookups are done with a group_key_t, which points at the selected values in
+// the record and hashes them in place, so a per-record lookup does no
+// allocation and no list-building. Only when a new group is added are its
+// values copied, into the table's arena: contiguous blocks which are never
+// reallocated, so that copied keys stay put for the life of the table.
+//
+// The index is open-addressing with linear probing over a power-of-two array
+// of 8-byte slots, each holding the entry number and part of the key's hash,
+// so that most mismatches are rejected without touching the key itself.
+// Entries are kept in a separate array in insertion order, which is the
+// iteration order:
+//
+//   for (int i = 0; i < ptable->num_entries; i++) {
+//     group_table_entry_t* pe = &ptable->entries[i];
+//     ... pe->key_values[0 .. ptable->num_key_fields-1], pe->pvvalue ...
+//   }
+//
+// There is no removal.
+// ================================================================
+
+#ifndef GROUP_TABLE_H
+#define GROUP_TABLE_H
+
+#include "containers/lrec.h"
+#include "containers/slls.h"
+
+// ----------------------------------------------------------------
+// A probe key. Its values point into the record (or list) it was filled from,
+// and are valid only as long as that is.
+typedef struct _group_key_t {
+	int                num_values;
+	int                capacity;
+	char**             values;
+	int*               lengths;
+	unsigned long long hash;
+} group_key_t;
+
+group_key_t* group_key_alloc();
+void group_key_free(group_key_t* pkey);
+
+// Returns FALSE if the record lacks any of the fields.
+int  group_key_from_record(group_key_t* pkey, lrec_t* prec, slls_t* pfield_names);
+void group_key_from_list(group_key_t* pkey, slls_t* pvalues);
+void group_key_from_array(group_key_t* pkey, char** values, int num_values);
+// A second 64-bit hash of the key's values, independent of pkey->hash: with
+// it, a 128-bit fingerprint (see fingerprint_table.h). The key must be filled.
+unsigned long long group_key_second_hash(group_key_t* pkey);
+
+// ----------------------------------------------------------------
+typedef struct _group_table_entry_t {
+	unsigned long long hash;
+	char**             key_values; // In the arena; valid until the table is freed.
+	void*              pvvalue;
+} group_table_entry_t;
+
+typedef struct _group_table_slot_t {
+	unsigned int hash_tag;    // High 32 bits of the key's hash
+	unsigned int entry_index; // One more than the index into entries; zero for empty slots.
+} group_table_slot_t;
+
+struct _group_table_block_t;
+
+typedef struct _group_table_t {
+	int                  num_key_fields;
+
+	group_table_entry_t* entries;
+	int                  num_entries;
+	int                  entries_capacity;
+
+	group_table_slot_t*  slots;
+	unsigned int         slots_mask;
+
+	struct _group_table_block_t* pblocks;
+} group_table_t;
+
+group_table_t* group_table_alloc(int num_key_fields);
+// Void-star payloads should first be freed by the caller.
+void group_table_free(group_table_t* ptable);
+
+// Returns NULL if the key isn't present.
+void*  group_table_get(group_table_t* ptable, group_key_t* pkey);
+// Returns the address of the key's value, first adding the key with a NULL
+// value if it isn't present. The address is valid only until the next add.
+void** group_table_get_or_add(group_table_t* ptable, group_key_t* pkey);
+void   group_table_put(group_table_t* ptable, group_key_t* pkey, void* pvvalue);
+
+static inline int group_table_size(group_table_t* ptable) {
+	return ptable->num_entries;
+}
+
+// Unit-test hook
+int group_table_check(group_table_t* ptable);
+
+#endif // GROUP_TABLE_H
@@ -0,0 +1,234 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/heavy_hitters.h"
+
+static char** copy_key(group_key_t* pkey);
+
+// ----------------------------------------------------------------
+heavy_hitters_t* heavy_hitters_alloc(int num_key_fields, int capacity) {
+	MLR_INTERNAL_CODING_ERROR_IF(capacity < 1);
+	heavy_hitters_t* phh = mlr_malloc_or_die(sizeof(heavy_hitters_t));
+	phh->num_key_fields = num_key_fields;
+	phh->capacity       = capacity;
+	phh->counters       = mlr_malloc_or_die(capacity * sizeof(heavy_hitter_t));
+	phh->num_counters   = 0;
+	phh->heap           = mlr_malloc_or_die(capacity * sizeof(int));
+
+	// At least twice as many slots as counters, so probe runs stay short.
+	unsigned int num_slots = 16;
+	while (num_slots < 2U * capacity)
+		num_slots *= 2;
+	phh->slots      = mlr_malloc_or_die(num_slots * sizeof(int));
+	memset(phh->slots, 0, num_slots * sizeof(int));
+	phh->slots_mask = num_slots - 1;
+
+	phh->num_ingested  = 0LL;
+	phh->next_sequence = 0LL;
+	return phh;
+}
+
+void heavy_hitters_free(heavy_hitters_t* phh) {
+	if (phh == NULL)
+		return;
+	for (int i = 0; i < phh->num_counters; i++)
+		free(phh->counters[i].key_values);
+	free(phh->counters);
+	free(phh->heap);
+	free(phh->slots);
+	free(phh);
+}
+
+// ----------------------------------------------------------------
+// Min-heap on count, older counters first among equal counts.
+static inline int counter_less(heavy_hitters_t* phh, int i, int j) {
+	heavy_hitter_t* pa = &phh->counters[i];
+	heavy_hitter_t* pb = &phh->counters[j];
+	return pa->count < pb->count || (pa->count == pb->count && pa->sequence < pb->sequence);
+}
+
+static inline void heap_set(heavy_hitters_t* phh, int heap_index, int counter_index) {
+	phh->heap[heap_index] = counter_index;
+	phh->counters[counter_index].heap_index = heap_index;
+}
+
+static void heap_sift_up(heavy_hitters_t* phh, int heap_index) {
+	int counter_index = phh->heap[heap_index];
+	while (heap_index > 0) {
+		int parent = (heap_index - 1) / 2;
+		if (!counter_less(phh, counter_index, phh->heap[parent]))
+			break;
+		heap_set(phh, heap_index, phh->heap[parent]);
+		heap_index = parent;
+	}
+	heap_set(phh, heap_index, counter_index);
+}
+
+static void heap_sift_down(heavy_hitters_t* phh, int heap_index) {
+	int counter_index = phh->heap[heap_index];
+	int n = phh->num_counters;
+	while (TRUE) {
+		int child = 2 * heap_index + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && counter_less(phh, phh->heap[child + 1], phh->heap[child]))
+			child++;
+		if (!counter_less(phh, phh->heap[child], counter_index))
+			break;
+		heap_set(phh, heap_index, phh->heap[child]);
+		heap_index = child;
+	}
+	heap_set(phh, heap_index, counter_index);
+}
+
+// ----------------------------------------------------------------
+// Returns the slot where the key is, or the empty slot where it should go.
+static int find_slot(heavy_hitters_t* phh, group_key_t* pkey) {
+	MLR_INTERNAL_CODING_ERROR_IF(pkey->num_values != phh->num_key_fields);
+	unsigned int index = (unsigned int)pkey->hash & phh->slots_mask;
+	while (TRUE) {
+		int slot = phh->slots[index];
+		if (slot == 0)
+			return index;
+		heavy_hitter_t* pc = &phh->counters[slot - 1];
+		if (pc->hash == pkey->hash) {
+			int i = 0;
+			for ( ; i < pkey->num_values; i++) {
+				// Includes the null terminator, so prefixes don't match.
+				if (memcmp(pc->key_values[i], pkey->values[i], pkey->lengths[i] + 1) != 0)
+					break;
+			}
+			if (i == pkey->num_values)
+				return index;
+		}
+		index = (index + 1) & phh->slots_mask;
+	}
+}
+
+// Backward-shift deletion: entries after the removed one in its probe run are
+// moved up unless that would put them before their home slot.
+static void remove_slot(heavy_hitters_t* phh, int counter_index) {
+	unsigned int mask = phh->slots_mask;
+	unsigned int i = (unsigned int)phh->counters[counter_index].hash & mask;
+	while (phh->slots[i] != counter_index + 1)
+		i = (i + 1) & mask;
+	unsigned int j = i;
+	while (TRUE) {
+		j = (j + 1) & mask;
+		if (phh->slots[j] == 0)
+			break;
+		unsigned int home = (unsigned int)phh->counters[phh->slots[j] - 1].hash & mask;
+		// Leave it if its home is cyclically in (i, j].
+		if (i <= j ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+		phh->slots[i] = phh->slots[j];
+		i = j;
+	}
+	phh->slots[i] = 0;
+}
+
+// ----------------------------------------------------------------
+void heavy_hitters_ingest(heavy_hitters_t* phh, group_key_t* pkey) {
+	phh->num_ingested++;
+	int slot_index = find_slot(phh, pkey);
+	int counter_index = phh->slots[slot_index] - 1;
+
+	if (counter_index >= 0) {
+		phh->counters[counter_index].count++;
+		heap_sift_down(phh, phh->counters[counter_index].heap_index);
+
+	} else if (phh->num_counters < phh->capacity) {
+		counter_index = phh->num_counters++;
+		heavy_hitter_t* pc = &phh->counters[counter_index];
+		pc->hash       = pkey->hash;
+		pc->key_values = copy_key(pkey);
+		pc->count      = 1LL;
+		pc->error      = 0LL;
+		pc->sequence   = phh->next_sequence++;
+		phh->slots[slot_index] = counter_index + 1;
+		heap_set(phh, phh->num_counters - 1, counter_index);
+		heap_sift_up(phh, phh->num_counters - 1);
+
+	} else {
+		// Take over the least counter. Removing its key from the index can move
+		// the empty slot found above, so look again.
+		counter_index = phh->heap[0];
+		heavy_hitter_t* pc = &phh->counters[counter_index];
+		remove_slot(phh, counter_index);
+		free(pc->key_values);
+		pc->hash       = pkey->hash;
+		pc->key_values = copy_key(pkey);
+		pc->error      = pc->count;
+		pc->count++;
+		pc->sequence   = phh->next_sequence++;
+		phh->slots[find_slot(phh, pkey)] = counter_index + 1;
+		heap_sift_down(phh, 0);
+	}
+}
+
+// ----------------------------------------------------------------
+static int descending_count_comparator(const void* pva, const void* pvb) {
+	const heavy_hitter_t* pa = *(heavy_hitter_t* const*)pva;
+	const heavy_hitter_t* pb = *(heavy_hitter_t* const*)pvb;
+	if (pa->count != pb->count)
+		return pa->count > pb->count ? -1 : 1;
+	return pa->sequence < pb->sequence ? -1 : pa->sequence > pb->sequence ? 1 : 0;
+}
+
+heavy_hitter_t** heavy_hitters_sorted(heavy_hitters_t* phh) {
+	heavy_hitter_t** sorted = mlr_malloc_or_die((phh->num_counters + 1) * sizeof(heavy_hitter_t*));
+	for (int i = 0; i < phh->num_counters; i++)
+		sorted[i] = &phh->counters[i];
+	qsort(sorted, phh->num_counters, sizeof(heavy_hitter_t*), descending_count_comparator);
+	return sorted;
+}
+
+// ----------------------------------------------------------------
+static char** copy_key(group_key_t* pkey) {
+	size_t pointers_size = pkey->num_values * sizeof(char*);
+	size_t size = pointers_size;
+	for (int i = 0; i < pkey->num_values; i++)
+		size += pkey->lengths[i] + 1;
+	char** key_values = mlr_malloc_or_die(size > 0 ? size : 1);
+	char* p = (char*)key_values + pointers_size;
+	for (int i = 0; i < pkey->num_values; i++) {
+		key_values[i] = p;
+		memcpy(p, pkey->values[i], pkey->lengths[i] + 1);
+		p += pkey->lengths[i] + 1;
+	}
+	return key_values;
+}
+
+// ----------------------------------------------------------------
+int heavy_hitters_check(heavy_hitters_t* phh) {
+	int num_occupied = 0;
+	for (unsigned int index = 0; index <= phh->slots_mask; index++) {
+		int slot = phh->slots[index];
+		if (slot == 0)
+			continue;
+		num_occupied++;
+		if (slot > phh->num_counters)
+			return FALSE;
+		// Every slot from the entry's home up to it must be occupied.
+		for (unsigned int j = (unsigned int)phh->counters[slot - 1].hash & phh->slots_mask; j != index;
+			j = (j + 1) & phh->slots_mask)
+		{
+			if (phh->slots[j] == 0)
+				return FALSE;
+		}
+	}
+	if (num_occupied != phh->num_counters)
+		return FALSE;
+
+	unsigned long long total = 0LL;
+	for (int i = 0; i < phh->num_counters; i++) {
+		int counter_index = phh->heap[i];
+		if (phh->counters[counter_index].heap_index != i)
+			return FALSE;
+		if (i > 0 && counter_less(phh, counter_index, phh->heap[(i - 1) / 2]))
+			return FALSE;
+		total += phh->counters[i].count;
+	}
+	// Each key ingested adds one to exactly one count.
+	return total == phh->num_ingested;
+}
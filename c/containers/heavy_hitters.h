@@ -0,0 +1,62 @@
+// ================================================================
+// Bounded-memory heavy hitters, for mlr most-frequent with --approx.
+//
+// This is the Space-Saving algorithm (Metwally, Agrawal, and El Abbadi,
+// "Efficient Computation of Frequent and Top-k Elements in Data Streams",
+// 2005). At most m group keys are counted. A key already counted has its count
+// incremented; a new key, once all m counters are in use, takes over the
+// counter with the least count c and gets count c+1, with c recorded as its
+// maximum overcount.
+//
+// So each reported count is at least the key's true count and at most its
+// error more; errors are at most n/m for n keys ingested; and any key occurring
+// more than n/m times is sure to be counted. With m at least the number of
+// distinct keys, counts are exact.
+//
+// Counters are found by key through an open-addressing index like group_table's
+// (with deletion, for evicted keys), and the least is found through a min-heap.
+// Both are O(1) or O(log m) per key ingested, with no allocation once all the
+// counters are in use, except to copy the key of a newly counted one.
+// ================================================================
+
+#ifndef HEAVY_HITTERS_H
+#define HEAVY_HITTERS_H
+
+#include "containers/group_table.h"
+
+#define HEAVY_HITTERS_DEFAULT_CAPACITY 1000
+
+typedef struct _heavy_hitter_t {
+	unsigned long long hash;
+	char**             key_values; // Pointers then values, in one allocation
+	unsigned long long count;
+	unsigned long long error;      // Most by which count may exceed the true count
+	unsigned long long sequence;   // When this key started being counted, for tie-breaking
+	int                heap_index;
+} heavy_hitter_t;
+
+typedef struct _heavy_hitters_t {
+	int                num_key_fields;
+	int                capacity;
+	heavy_hitter_t*    counters;
+	int                num_counters;
+	int*               heap;       // Counter indices, least count first
+	int*               slots;      // One more than the counter index; zero for empty slots.
+	unsigned int       slots_mask;
+	unsigned long long num_ingested;
+	unsigned long long next_sequence;
+} heavy_hitters_t;
+
+heavy_hitters_t* heavy_hitters_alloc(int num_key_fields, int capacity);
+void heavy_hitters_free(heavy_hitters_t* phh);
+void heavy_hitters_ingest(heavy_hitters_t* phh, group_key_t* pkey);
+
+// Returns the counters from most to least frequent, ties in the order they
+// started being counted. The array is for the caller to free; the counters
+// stay owned by the heavy-hitters object.
+heavy_hitter_t** heavy_hitters_sorted(heavy_hitters_t* phh);
+
+// Unit-test hook
+int heavy_hitters_check(heavy_hitters_t* phh);
+
+#endif // HEAVY_HITTERS_H
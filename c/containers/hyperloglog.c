@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lib/mlrutil.h"
+#include "containers/hyperloglog.h"
+
+#define INITIAL_SPARSE_CAPACITY 16
+
+// ----------------------------------------------------------------
+hyperloglog_t* hyperloglog_alloc(int precision) {
+	MLR_INTERNAL_CODING_ERROR_IF(precision < HYPERLOGLOG_MIN_PRECISION || precision > HYPERLOGLOG_MAX_PRECISION);
+	hyperloglog_t* phll = mlr_malloc_or_die(sizeof(hyperloglog_t));
+	phll->precision       = precision;
+	phll->num_registers   = 1 << precision;
+	phll->registers       = NULL;
+	phll->sparse_capacity = INITIAL_SPARSE_CAPACITY;
+	phll->sparse          = mlr_malloc_or_die(phll->sparse_capacity * sizeof(unsigned int));
+	phll->num_sparse      = 0;
+	return phll;
+}
+
+void hyperloglog_free(hyperloglog_t* phll) {
+	if (phll == NULL)
+		return;
+	free(phll->registers);
+	free(phll->sparse);
+	free(phll);
+}
+
+// ----------------------------------------------------------------
+static void hyperloglog_densify(hyperloglog_t* phll) {
+	phll->registers = mlr_malloc_or_die(phll->num_registers);
+	memset(phll->registers, 0, phll->num_registers);
+	for (int i = 0; i < phll->num_sparse; i++)
+		phll->registers[phll->sparse[i] >> 8] = phll->sparse[i] & 0xff;
+	free(phll->sparse);
+	phll->sparse = NULL;
+	phll->num_sparse = 0;
+	phll->sparse_capacity = 0;
+}
+
+// Returns the position of the register's entry, or of where it should go.
+static int sparse_search(hyperloglog_t* phll, int index) {
+	int lo = 0;
+	int hi = phll->num_sparse;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if ((int)(phll->sparse[mid] >> 8) < index)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int hyperloglog_get_register(hyperloglog_t* phll, int index) {
+	if (phll->registers != NULL)
+		return phll->registers[index];
+	int pos = sparse_search(phll, index);
+	if (pos < phll->num_sparse && (int)(phll->sparse[pos] >> 8) == index)
+		return phll->sparse[pos] & 0xff;
+	return 0;
+}
+
+void hyperloglog_update_register(hyperloglog_t* phll, int index, int value) {
+	if (phll->registers != NULL) {
+		if (value > phll->registers[index])
+			phll->registers[index] = value;
+		return;
+	}
+
+	int pos = sparse_search(phll, index);
+	if (pos < phll->num_sparse && (int)(phll->sparse[pos] >> 8) == index) {
+		if (value > (int)(phll->sparse[pos] & 0xff))
+			phll->sparse[pos] = ((unsigned int)index << 8) | value;
+		return;
+	}
+	// Four bytes per sparse entry versus one per dense register.
+	if (4 * (phll->num_sparse + 1) > phll->num_registers) {
+		hyperloglog_densify(phll);
+		phll->registers[index] = value;
+		return;
+	}
+	if (phll->num_sparse >= phll->sparse_capacity) {
+		phll->sparse_capacity *= 2;
+		phll->sparse = mlr_realloc_or_die(phll->sparse, phll->sparse_capacity * sizeof(unsigned int));
+	}
+	memmove(&phll->sparse[pos + 1], &phll->sparse[pos], (phll->num_sparse - pos) * sizeof(unsigned int));
+	phll->sparse[pos] = ((unsigned int)index << 8) | value;
+	phll->num_sparse++;
+}
+
+// ----------------------------------------------------------------
+void hyperloglog_add_hash(hyperloglog_t* phll, unsigned long long hash) {
+	int index = (int)(hash >> (64 - phll->precision));
+	unsigned long long rest = hash << phll->precision;
+	int value = 1;
+	int max_value = hyperloglog_max_register_value(phll);
+	while (value < max_value && (rest & 0x8000000000000000ULL) == 0) {
+		rest <<= 1;
+		value++;
+	}
+	hyperloglog_update_register(phll, index, value);
+}
+
+void hyperloglog_merge(hyperloglog_t* phll, hyperloglog_t* pother) {
+	MLR_INTERNAL_CODING_ERROR_IF(phll->precision != pother->precision);
+	if (pother->registers != NULL) {
+		if (phll->registers == NULL)
+			hyperloglog_densify(phll);
+		for (int i = 0; i < phll->num_registers; i++)
+			if (pother->registers[i] > phll->registers[i])
+				phll->registers[i] = pother->registers[i];
+	} else {
+		for (int i = 0; i < pother->num_sparse; i++)
+			hyperloglog_update_register(phll, pother->sparse[i] >> 8, pother->sparse[i] & 0xff);
+	}
+}
+
+// ----------------------------------------------------------------
+// Ertl's sigma and tau functions, by their series.
+static double ertl_sigma(double x) {
+	if (x == 1.0)
+		return INFINITY;
+	double y = 1.0;
+	double z = x;
+	while (TRUE) {
+		x *= x;
+		double z_prev = z;
+		z += x * y;
+		y += y;
+		if (z == z_prev)
+			return z;
+	}
+}
+
+static double ertl_tau(double x) {
+	if (x == 0.0 || x == 1.0)
+		return 0.0;
+	double y = 1.0;
+	double z = 1.0 - x;
+	while (TRUE) {
+		x = sqrt(x);
+		double z_prev = z;
+		y *= 0.5;
+		z -= (1.0 - x) * (1.0 - x) * y;
+		if (z == z_prev)
+			return z / 3.0;
+	}
+}
+
+double hyperloglog_estimate(hyperloglog_t* phll) {
+	int q = 64 - phll->precision;
+	double m = phll->num_registers;
+	int histogram[64 + 2];
+	memset(histogram, 0, sizeof(histogram));
+	if (phll->registers != NULL) {
+		for (int i = 0; i < phll->num_registers; i++)
+			histogram[phll->registers[i]]++;
+	} else {
+		histogram[0] = phll->num_registers - phll->num_sparse;
+		for (int i = 0; i < phll->num_sparse; i++)
+			histogram[phll->sparse[i] & 0xff]++;
+	}
+	if (histogram[0] == phll->num_registers)
+		return 0.0;
+
+	double z = m * ertl_tau(1.0 - histogram[q + 1] / m);
+	for (int k = q; k >= 1; k--)
+		z = 0.5 * (z + histogram[k]);
+	z += m * ertl_sigma(histogram[0] / m);
+	return m * m / (2.0 * log(2.0) * z);
+}
@@ -0,0 +1,59 @@
+// ================================================================
+// HyperLogLog cardinality estimator, for mlr count-distinct and uniq with
+// --approx: estimates the number of distinct values added, in memory which
+// doesn't grow with the number of values.
+//
+// Values are added by 64-bit hash (e.g. a group_key_t's). The top p bits of a
+// hash pick one of m = 2^p registers, which keeps the maximum over its hashes
+// of the number of leading zeros in the remaining bits, plus one. The estimate
+// is computed from the histogram of register values using Ertl's improved
+// estimator ("New cardinality estimation algorithms for HyperLogLog sketches",
+// 2017), which is unbiased across the whole range without HyperLogLog++'s
+// empirical bias-correction tables or the switch to linear counting.
+//
+// The relative standard error is about 1.04/sqrt(m): 0.81% for the default
+// p=14, using 16KB. As in HyperLogLog++, hashes are 64-bit so there is no
+// large-cardinality correction, and a sketch starts out sparse -- a sorted
+// list of the nonzero registers -- becoming dense only once that would be
+// smaller, so that sketches for many small groups stay small.
+//
+// Sketches of the same precision merge losslessly (register-wise max): the
+// merged sketch is the one which would have seen all of both inputs' values.
+// ================================================================
+
+#ifndef HYPERLOGLOG_H
+#define HYPERLOGLOG_H
+
+#define HYPERLOGLOG_MIN_PRECISION     4
+#define HYPERLOGLOG_MAX_PRECISION     18
+#define HYPERLOGLOG_DEFAULT_PRECISION 14
+
+typedef struct _hyperloglog_t {
+	int            precision;
+	int            num_registers;
+	unsigned char* registers; // NULL while sparse
+
+	// Sparse: (index << 8) | value for nonzero registers, sorted by index.
+	unsigned int*  sparse;
+	int            num_sparse;
+	int            sparse_capacity;
+} hyperloglog_t;
+
+hyperloglog_t* hyperloglog_alloc(int precision);
+void hyperloglog_free(hyperloglog_t* phll);
+
+void hyperloglog_add_hash(hyperloglog_t* phll, unsigned long long hash);
+// Both must have the same precision. The other is left unchanged.
+void hyperloglog_merge(hyperloglog_t* phll, hyperloglog_t* pother);
+double hyperloglog_estimate(hyperloglog_t* phll);
+
+// For dumping and restoring states.
+int  hyperloglog_get_register(hyperloglog_t* phll, int index);
+// Raises the register to the value if it's less.
+void hyperloglog_update_register(hyperloglog_t* phll, int index, int value);
+// The largest possible register value.
+static inline int hyperloglog_max_register_value(hyperloglog_t* phll) {
+	return 64 - phll->precision + 1;
+}
+
+#endif // HYPERLOGLOG_H
@@ -106,9 +106,18 @@ lrec_t* lrec_copy(lrec_t* pinrec) {
 	return poutrec;
 }
 
+// ----------------------------------------------------------------
+void lrec_set_original_line(lrec_t* prec, char* line, int length, char ifs, char ips) {
+	prec->poriginal_line       = line;
+	prec->original_line_length = length;
+	prec->original_ifs         = ifs;
+	prec->original_ips         = ips;
+}
+
 // ----------------------------------------------------------------
 void lrec_put(lrec_t* prec, char* key, char* value, char free_flags) {
 	lrece_t* pe = lrec_find_entry(prec, key);
+	prec->poriginal_line = NULL;
 
 	if (pe != NULL) {
 		if (pe->free_flags & FREE_ENTRY_VALUE) {
@@ -145,6 +154,7 @@ void lrec_put(lrec_t* prec, char* key, char* value, char free_flags) {
 
 void lrec_put_ext(lrec_t* prec, char* key, char* value, char free_flags, char quote_flags) {
 	lrece_t* pe = lrec_find_entry(prec, key);
+	prec->poriginal_line = NULL;
 
 	if (pe != NULL) {
 		if (pe->free_flags & FREE_ENTRY_VALUE) {
@@ -179,8 +189,19 @@ void lrec_put_ext(lrec_t* prec, char* key, char* value, char free_flags, char qu
 	}
 }
 
+// ----------------------------------------------------------------
+void lrec_append_unique(lrec_t* prec, char* key, char* value, char free_flags, char quote_flags) {
+	lrece_t* pe = mlr_malloc_or_die(sizeof(lrece_t));
+	pe->key         = key;
+	pe->value       = value;
+	pe->free_flags  = free_flags;
+	pe->quote_flags = quote_flags;
+	lrec_link_at_tail(prec, pe);
+}
+
 void lrec_prepend(lrec_t* prec, char* key, char* value, char free_flags) {
 	lrece_t* pe = lrec_find_entry(prec, key);
+	prec->poriginal_line = NULL;
 
 	if (pe != NULL) {
 		if (pe->free_flags & FREE_ENTRY_VALUE) {
@@ -214,6 +235,7 @@ void lrec_prepend(lrec_t* prec, char* key, char* value, char free_flags) {
 
 lrece_t* lrec_put_after(lrec_t* prec, lrece_t* pd, char* key, char* value, char free_flags) {
 	lrece_t* pe = lrec_find_entry(prec, key);
+	prec->poriginal_line = NULL;
 
 	if (pe != NULL) { // Overwrite
 		if (pe->free_flags & FREE_ENTRY_VALUE) {
@@ -262,6 +284,7 @@ char* lrec_get(lrec_t* prec, char* key) {
 char* lrec_get_pff(lrec_t* prec, char* key, char** ppfree_flags) {
 	lrece_t* pe = lrec_find_entry(prec, key);
 	if (pe != NULL) {
+		prec->poriginal_line = NULL;
 		*ppfree_flags = &pe->free_flags;
 		return pe->value;
 	} else {
@@ -273,6 +296,7 @@ char* lrec_get_pff(lrec_t* prec, char* key, char** ppfree_flags) {
 char* lrec_get_ext(lrec_t* prec, char* key, lrece_t** ppentry) {
 	lrece_t* pe = lrec_find_entry(prec, key);
 	if (pe != NULL) {
+		prec->poriginal_line = NULL;
 		*ppentry = pe;
 		return pe->value;
 	} else {
@@ -344,6 +368,7 @@ void lrec_rename(lrec_t* prec, char* old_key, char* new_key, int new_needs_freei
 			lrec_unlink(prec, pnew);
 			free(pnew);
 		}
+		prec->poriginal_line = NULL;
 	}
 }
 
@@ -385,6 +410,7 @@ void lrec_unlink(lrec_t* prec, lrece_t* pe) {
 		}
 	}
 	prec->field_count--;
+	prec->poriginal_line = NULL;
 }
 
 void lrec_unlink_and_free(lrec_t* prec, lrece_t* pe) {
@@ -398,6 +424,7 @@ void lrec_unlink_and_free(lrec_t* prec, lrece_t* pe) {
 
 // ----------------------------------------------------------------
 static void lrec_link_at_head(lrec_t* prec, lrece_t* pe) {
+	prec->poriginal_line = NULL;
 
 	if (prec->phead == NULL) {
 		pe->pprev   = NULL;
@@ -415,6 +442,7 @@ static void lrec_link_at_head(lrec_t* prec, lrece_t* pe) {
 }
 
 static void lrec_link_at_tail(lrec_t* prec, lrece_t* pe) {
+	prec->poriginal_line = NULL;
 
 	if (prec->phead == NULL) {
 		pe->pprev   = NULL;
@@ -87,9 +87,22 @@ struct _lrec_t {
 	// For XTAB format.
 	slls_t* pxtab_lines;
 
+	// For records holding exactly the fields of a DKVP line, in order, and not
+	// modified since: the line, whose separators the reader replaced with null
+	// terminators. A DKVP writer with the same separators puts them back and
+	// writes out the line as it was read. Any change to the record through the
+	// lrec functions sets this back to NULL.
+	char* poriginal_line;
+	int   original_line_length;
+	char  original_ifs;
+	char  original_ips;
+
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	// Format-dependent virtual-function pointer:
 	lrec_free_func_t* pfree_backing_func;
+	// Data for it, e.g. which windows of a memory-mapped file the record
+	// points into.
+	void* pvbacking;
 };
 
 // ----------------------------------------------------------------
@@ -104,6 +117,11 @@ void lrec_clear(lrec_t* prec);
 void  lrec_free(lrec_t* prec);
 lrec_t* lrec_copy(lrec_t* pinrec);
 
+// For the DKVP readers; see poriginal_line above. The line's fields must have
+// single-character separators, and must all be in the record, each with its
+// key as read.
+void lrec_set_original_line(lrec_t* prec, char* line, int length, char ifs, char ips);
+
 // The only difference between lrec_put and lrec_prepend is that the latter
 // adds to the end of the record, while the former adds to the beginning.
 //
@@ -123,6 +141,9 @@ lrec_t* lrec_copy(lrec_t* pinrec);
 //     free the memory (else, there will be a memory leak).
 void  lrec_put(lrec_t* prec, char* key, char* value, char free_flags);
 void  lrec_put_ext(lrec_t* prec, char* key, char* value, char free_flags, char quote_flags);
+// Like lrec_put_ext, for readers which know the key isn't already in the record:
+// adds the field at the end without looking for the key first.
+void  lrec_append_unique(lrec_t* prec, char* key, char* value, char free_flags, char quote_flags);
 // Like lrec_put: if key is present, modify value. But if not, add new field at start of record, not at end.
 void  lrec_prepend(lrec_t* prec, char* key, char* value, char free_flags);
 // Like lrec_put: if key is present, modify value. But if not, add new field after specified entry, not at end.
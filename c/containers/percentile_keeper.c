@@ -9,12 +9,14 @@
 
 // ----------------------------------------------------------------
 percentile_keeper_t* percentile_keeper_alloc() {
-	unsigned long long capacity = INITIAL_CAPACITY;
 	percentile_keeper_t* ppercentile_keeper = mlr_malloc_or_die(sizeof(percentile_keeper_t));
-	ppercentile_keeper->data     = mlr_malloc_or_die(capacity*sizeof(mv_t));
+	ppercentile_keeper->type     = PERCENTILE_KEEPER_EMPTY;
+	ppercentile_keeper->u.mvs    = NULL;
 	ppercentile_keeper->size     = 0LL;
-	ppercentile_keeper->capacity = capacity;
-	ppercentile_keeper->sorted   = FALSE;
+	ppercentile_keeper->capacity = 0LL;
+	ppercentile_keeper->selected_ranks          = NULL;
+	ppercentile_keeper->num_selected_ranks      = 0;
+	ppercentile_keeper->selected_ranks_capacity = 0;
 	return ppercentile_keeper;
 }
 
@@ -22,25 +24,113 @@ percentile_keeper_t* percentile_keeper_alloc() {
 void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper) {
 	if (ppercentile_keeper == NULL)
 		return;
-	for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
-		mv_free(&ppercentile_keeper->data[i]);
+	if (ppercentile_keeper->type == PERCENTILE_KEEPER_MIXED) {
+		for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
+			mv_free(&ppercentile_keeper->u.mvs[i]);
+		}
 	}
-	free(ppercentile_keeper->data);
-	ppercentile_keeper->data = NULL;
+	free(ppercentile_keeper->u.mvs);
+	free(ppercentile_keeper->selected_ranks);
+	ppercentile_keeper->u.mvs = NULL;
 	ppercentile_keeper->size = 0LL;
 	ppercentile_keeper->capacity = 0LL;
 	free(ppercentile_keeper);
 }
 
 // ----------------------------------------------------------------
-void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t value) {
-	if (ppercentile_keeper->size >= ppercentile_keeper->capacity) {
+// All three array types have the same element size except for mixed.
+static size_t element_size(int type) {
+	return type == PERCENTILE_KEEPER_MIXED ? sizeof(mv_t) : sizeof(long long);
+}
+
+static void percentile_keeper_ensure_capacity(percentile_keeper_t* ppercentile_keeper, unsigned long long size) {
+	if (size <= ppercentile_keeper->capacity)
+		return;
+	if (ppercentile_keeper->capacity == 0LL)
+		ppercentile_keeper->capacity = INITIAL_CAPACITY;
+	while (ppercentile_keeper->capacity < size)
 		ppercentile_keeper->capacity = (unsigned long long)(ppercentile_keeper->capacity * GROWTH_FACTOR);
-		ppercentile_keeper->data = (mv_t*)mlr_realloc_or_die(ppercentile_keeper->data,
-			ppercentile_keeper->capacity*sizeof(mv_t));
+	ppercentile_keeper->u.mvs = mlr_realloc_or_die(ppercentile_keeper->u.mvs,
+		ppercentile_keeper->capacity * element_size(ppercentile_keeper->type));
+}
+
+// Converts int-only or float-only storage to mlrvals, in place.
+static void percentile_keeper_convert_to_mixed(percentile_keeper_t* ppercentile_keeper) {
+	if (ppercentile_keeper->type == PERCENTILE_KEEPER_MIXED)
+		return;
+	int old_type = ppercentile_keeper->type;
+	ppercentile_keeper->type = PERCENTILE_KEEPER_MIXED;
+	if (ppercentile_keeper->capacity == 0LL)
+		return;
+	ppercentile_keeper->u.mvs = mlr_realloc_or_die(ppercentile_keeper->u.mvs,
+		ppercentile_keeper->capacity * sizeof(mv_t));
+	// Back to front since the elements are growing in place.
+	for (unsigned long long i = ppercentile_keeper->size; i-- > 0; ) {
+		if (old_type == PERCENTILE_KEEPER_INTS) {
+			long long intv = ((long long*)ppercentile_keeper->u.mvs)[i];
+			ppercentile_keeper->u.mvs[i] = mv_from_int(intv);
+		} else {
+			double fltv = ((double*)ppercentile_keeper->u.mvs)[i];
+			ppercentile_keeper->u.mvs[i] = mv_from_float(fltv);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t value) {
+	int value_type = value.type == MT_INT ? PERCENTILE_KEEPER_INTS
+		: value.type == MT_FLOAT ? PERCENTILE_KEEPER_FLOATS
+		: PERCENTILE_KEEPER_MIXED;
+	if (ppercentile_keeper->type == PERCENTILE_KEEPER_EMPTY)
+		ppercentile_keeper->type = value_type;
+	else if (value_type != ppercentile_keeper->type)
+		percentile_keeper_convert_to_mixed(ppercentile_keeper);
+
+	percentile_keeper_ensure_capacity(ppercentile_keeper, ppercentile_keeper->size + 1);
+	switch (ppercentile_keeper->type) {
+	case PERCENTILE_KEEPER_INTS:
+		ppercentile_keeper->u.ints[ppercentile_keeper->size++] = value.u.intv;
+		break;
+	case PERCENTILE_KEEPER_FLOATS:
+		ppercentile_keeper->u.floats[ppercentile_keeper->size++] = value.u.fltv;
+		break;
+	default:
+		ppercentile_keeper->u.mvs[ppercentile_keeper->size++] = value;
+		break;
+	}
+	ppercentile_keeper->num_selected_ranks = 0;
+}
+
+// ----------------------------------------------------------------
+void percentile_keeper_merge(percentile_keeper_t* ppercentile_keeper, percentile_keeper_t* pother) {
+	if (pother->size == 0LL)
+		return;
+	if (ppercentile_keeper->type == PERCENTILE_KEEPER_EMPTY)
+		ppercentile_keeper->type = pother->type;
+	if (pother->type != ppercentile_keeper->type) {
+		percentile_keeper_convert_to_mixed(ppercentile_keeper);
+		percentile_keeper_convert_to_mixed(pother);
+	}
+	unsigned long long new_size = ppercentile_keeper->size + pother->size;
+	percentile_keeper_ensure_capacity(ppercentile_keeper, new_size);
+	size_t size = element_size(ppercentile_keeper->type);
+	memcpy((char*)ppercentile_keeper->u.mvs + ppercentile_keeper->size * size, pother->u.mvs, pother->size * size);
+	ppercentile_keeper->size = new_size;
+	ppercentile_keeper->num_selected_ranks = 0;
+	pother->size = 0LL;
+	pother->num_selected_ranks = 0;
+}
+
+// ----------------------------------------------------------------
+mv_t percentile_keeper_get(percentile_keeper_t* ppercentile_keeper, unsigned long long index) {
+	switch (ppercentile_keeper->type) {
+	case PERCENTILE_KEEPER_INTS:
+		return mv_from_int(ppercentile_keeper->u.ints[index]);
+	case PERCENTILE_KEEPER_FLOATS:
+		return mv_from_float(ppercentile_keeper->u.floats[index]);
+	default:
+		return ppercentile_keeper->u.mvs[index];
 	}
-	ppercentile_keeper->data[ppercentile_keeper->size++] = value;
-	ppercentile_keeper->sorted = FALSE;
 }
 
 // ================================================================
@@ -213,6 +303,120 @@ void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t valu
 // * (Note that Miller's interpolated percentiles match match R's quantile with type=7)
 // ----------------------------------------------------------------
 
+// ================================================================
+// Selection. Rather than sorting all the data, each requested rank is found by
+// quickselect, which leaves the value of that rank in place with no greater
+// values before it and no lesser ones after. The ranks so fixed are
+// remembered, so that later selections need only look between the two
+// nearest: e.g. selecting p10, p50, and p90 from n values takes about 2n + n
+// + n/2 comparisons, against n log n for a sort.
+//
+// This is introselect in that a subrange which isn't shrinking fast enough --
+// say, from repeated bad pivots -- is finished by sorting it instead.
+
+static int ll_comparator(const void* pva, const void* pvb) {
+	long long a = *(const long long*)pva;
+	long long b = *(const long long*)pvb;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static int double_comparator(const void* pva, const void* pvb) {
+	double a = *(const double*)pva;
+	double b = *(const double*)pvb;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+#define INT_LT(a, b)   ((a) < (b))
+#define FLOAT_LT(a, b) ((a) < (b))
+#define MV_LT(a, b)    (mv_xx_comparator(&(a), &(b)) < 0)
+
+// Moves the rank-k value (zero-up) of a[lo..hi] into position k.
+#define DEFINE_SELECT(NAME, TYPE, LT, COMPARATOR) \
+static void NAME(TYPE* a, long long lo, long long hi, long long k) { \
+	int depth_limit = 0; \
+	for (long long m = hi - lo + 1; m > 1; m >>= 1) \
+		depth_limit += 2; \
+	while (hi > lo) { \
+		if (depth_limit-- <= 0) { \
+			qsort(&a[lo], hi - lo + 1, sizeof(TYPE), COMPARATOR); \
+			return; \
+		} \
+		long long mid = lo + (hi - lo) / 2; \
+		TYPE t; \
+		if (LT(a[mid], a[lo])) { t = a[mid]; a[mid] = a[lo]; a[lo] = t; } \
+		if (LT(a[hi], a[lo]))  { t = a[hi];  a[hi]  = a[lo]; a[lo] = t; } \
+		if (LT(a[hi], a[mid])) { t = a[hi];  a[hi]  = a[mid]; a[mid] = t; } \
+		TYPE pivot = a[mid]; \
+		long long i = lo; \
+		long long j = hi; \
+		while (i <= j) { \
+			while (LT(a[i], pivot)) \
+				i++; \
+			while (LT(pivot, a[j])) \
+				j--; \
+			if (i <= j) { \
+				t = a[i]; a[i] = a[j]; a[j] = t; \
+				i++; \
+				j--; \
+			} \
+		} \
+		if (k <= j) \
+			hi = j; \
+		else if (k >= i) \
+			lo = i; \
+		else \
+			return; \
+	} \
+}
+
+DEFINE_SELECT(select_ints,   long long, INT_LT,   ll_comparator)
+DEFINE_SELECT(select_floats, double,    FLOAT_LT, double_comparator)
+DEFINE_SELECT(select_mvs,    mv_t,      MV_LT,    mv_xx_comparator)
+
+// Returns the value of the given rank, selecting it first if need be.
+static mv_t percentile_keeper_select(percentile_keeper_t* ppercentile_keeper, unsigned long long rank) {
+	// Find the nearest already-fixed ranks on either side.
+	long long lo = 0;
+	long long hi = ppercentile_keeper->size - 1;
+	int insert_at = 0;
+	for ( ; insert_at < ppercentile_keeper->num_selected_ranks; insert_at++) {
+		unsigned long long selected_rank = ppercentile_keeper->selected_ranks[insert_at];
+		if (selected_rank == rank)
+			return percentile_keeper_get(ppercentile_keeper, rank);
+		if (selected_rank > rank) {
+			hi = selected_rank - 1;
+			break;
+		}
+		lo = selected_rank + 1;
+	}
+
+	switch (ppercentile_keeper->type) {
+	case PERCENTILE_KEEPER_INTS:
+		select_ints(ppercentile_keeper->u.ints, lo, hi, rank);
+		break;
+	case PERCENTILE_KEEPER_FLOATS:
+		select_floats(ppercentile_keeper->u.floats, lo, hi, rank);
+		break;
+	default:
+		select_mvs(ppercentile_keeper->u.mvs, lo, hi, rank);
+		break;
+	}
+
+	if (ppercentile_keeper->num_selected_ranks >= ppercentile_keeper->selected_ranks_capacity) {
+		ppercentile_keeper->selected_ranks_capacity = ppercentile_keeper->selected_ranks_capacity == 0
+			? 8 : 2 * ppercentile_keeper->selected_ranks_capacity;
+		ppercentile_keeper->selected_ranks = mlr_realloc_or_die(ppercentile_keeper->selected_ranks,
+			ppercentile_keeper->selected_ranks_capacity * sizeof(unsigned long long));
+	}
+	memmove(&ppercentile_keeper->selected_ranks[insert_at + 1], &ppercentile_keeper->selected_ranks[insert_at],
+		(ppercentile_keeper->num_selected_ranks - insert_at) * sizeof(unsigned long long));
+	ppercentile_keeper->selected_ranks[insert_at] = rank;
+	ppercentile_keeper->num_selected_ranks++;
+
+	return percentile_keeper_get(ppercentile_keeper, rank);
+}
+
+// ----------------------------------------------------------------
 static unsigned long long compute_index_non_interpolated(unsigned long long n, double p) {
 	long long index = p*n/100.0;
 	//unsigned long long index = p*(n-1)/100.0;
@@ -225,21 +429,22 @@ static unsigned long long compute_index_non_interpolated(unsigned long long n, d
 	return (unsigned long long)index;
 }
 
-static mv_t get_percentile_linearly_interpolated(mv_t* array, unsigned long long n, double p) {
+static mv_t get_percentile_linearly_interpolated(percentile_keeper_t* ppercentile_keeper, double p) {
+	unsigned long long n = ppercentile_keeper->size;
 	double findex = (p/100.0)*(n-1);
 	if (findex < 0)
 		findex = 0;
 	unsigned long long iindex = (unsigned long long)floor(findex);
 	if (iindex >= n-1) {
-		return array[iindex];
+		return percentile_keeper_select(ppercentile_keeper, iindex);
 	} else {
 		// array[iindex] + frac * (array[iindex+1] - array[iindex]);
 		mv_t frac = mv_from_float(findex - iindex);
-		mv_t* pa = &array[iindex];
-		mv_t* pb = &array[iindex+1];
-		mv_t diff = x_xx_minus_func(pb, pa);
+		mv_t a = percentile_keeper_select(ppercentile_keeper, iindex);
+		mv_t b = percentile_keeper_select(ppercentile_keeper, iindex+1);
+		mv_t diff = x_xx_minus_func(&b, &a);
 		mv_t prod = x_xx_times_func(&frac, &diff);
-		mv_t rv = x_xx_plus_func(pa, &prod);
+		mv_t rv = x_xx_plus_func(&a, &prod);
 		return rv;
 	}
 }
@@ -249,32 +454,25 @@ mv_t percentile_keeper_emit_non_interpolated(percentile_keeper_t* ppercentile_ke
 	if (ppercentile_keeper->size == 0) {
 		return mv_absent();
 	}
-	if (!ppercentile_keeper->sorted) {
-		qsort(ppercentile_keeper->data, ppercentile_keeper->size, sizeof(mv_t), mv_xx_comparator);
-		ppercentile_keeper->sorted = TRUE;
-	}
-	return ppercentile_keeper->data[compute_index_non_interpolated(ppercentile_keeper->size, percentile)];
+	return percentile_keeper_select(ppercentile_keeper,
+		compute_index_non_interpolated(ppercentile_keeper->size, percentile));
 }
 
 mv_t percentile_keeper_emit_linearly_interpolated(percentile_keeper_t* ppercentile_keeper, double percentile) {
 	if (ppercentile_keeper->size == 0) {
 		return mv_absent();
 	}
-	if (!ppercentile_keeper->sorted) {
-		qsort(ppercentile_keeper->data, ppercentile_keeper->size, sizeof(mv_t), mv_xx_comparator);
-		ppercentile_keeper->sorted = TRUE;
-	}
-	return get_percentile_linearly_interpolated(ppercentile_keeper->data, ppercentile_keeper->size, percentile);
+	return get_percentile_linearly_interpolated(ppercentile_keeper, percentile);
 }
 
 // ----------------------------------------------------------------
 void percentile_keeper_print(percentile_keeper_t* ppercentile_keeper) {
 	printf("percentile_keeper dump:\n");
 	for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
-		mv_t* pa = &ppercentile_keeper->data[i];
-		if (pa->type == MT_FLOAT)
-			printf("[%02llu] %.8lf\n", i, ppercentile_keeper->data[i].u.fltv);
+		mv_t a = percentile_keeper_get(ppercentile_keeper, i);
+		if (a.type == MT_FLOAT)
+			printf("[%02llu] %.8lf\n", i, a.u.fltv);
 		else
-			printf("[%02llu] %8lld\n", i, ppercentile_keeper->data[i].u.intv);
+			printf("[%02llu] %8lld\n", i, a.u.intv);
 	}
 }
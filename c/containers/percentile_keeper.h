@@ -6,16 +6,37 @@
 #define PERCENTILE_KEEPER_H
 #include "lib/mlrval.h"
 
+// Values are kept as plain 8-byte ints while all ingested values are ints, or
+// as doubles while all are floats; only once there is a mix of types, or any
+// strings, are they kept as mlrvals.
+#define PERCENTILE_KEEPER_EMPTY  0
+#define PERCENTILE_KEEPER_INTS   1
+#define PERCENTILE_KEEPER_FLOATS 2
+#define PERCENTILE_KEEPER_MIXED  3
+
 typedef struct _percentile_keeper_t {
-	mv_t* data;
+	int type;
+	union {
+		long long* ints;
+		double*    floats;
+		mv_t*      mvs;
+	} u;
 	unsigned long long size;
 	unsigned long long capacity;
-	int   sorted;
+
+	// Ranks already selected, in increasing order: see percentile_keeper.c.
+	unsigned long long* selected_ranks;
+	int num_selected_ranks;
+	int selected_ranks_capacity;
 } percentile_keeper_t;
 
 percentile_keeper_t* percentile_keeper_alloc();
 void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper);
 void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t value);
+// Moves the other keeper's values onto the end of this one's, leaving the other empty.
+void percentile_keeper_merge(percentile_keeper_t* ppercentile_keeper, percentile_keeper_t* pother);
+// The value at the given position in the keeper, in no particular order.
+mv_t percentile_keeper_get(percentile_keeper_t* ppercentile_keeper, unsigned long long index);
 
 typedef mv_t percentile_keeper_emitter_t(percentile_keeper_t* ppercentile_keeper, double percentile);
 mv_t percentile_keeper_emit_non_interpolated(percentile_keeper_t* ppercentile_keeper, double percentile);
@@ -0,0 +1,279 @@
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "lib/mlrutil.h"
+#include "containers/percentile_sketch.h"
+
+#define INITIAL_LEVELS_CAPACITY 8
+#define RNG_SEED 0x9e3779b97f4a7c15ULL
+
+static void percentile_sketch_add_level(percentile_sketch_t* psketch);
+static void percentile_sketch_compress(percentile_sketch_t* psketch);
+
+// ----------------------------------------------------------------
+percentile_sketch_t* percentile_sketch_alloc(int k) {
+	MLR_INTERNAL_CODING_ERROR_IF(k < PERCENTILE_SKETCH_MIN_K);
+	percentile_sketch_t* psketch = mlr_malloc_or_die(sizeof(percentile_sketch_t));
+	psketch->k                  = k;
+	psketch->levels_capacity    = INITIAL_LEVELS_CAPACITY;
+	psketch->levels             = mlr_malloc_or_die(psketch->levels_capacity * sizeof(percentile_sketch_level_t));
+	psketch->num_levels         = 0;
+	psketch->total_size         = 0;
+	psketch->total_threshold    = 0;
+	psketch->n                  = 0LL;
+	psketch->min                = 0.0;
+	psketch->max                = 0.0;
+	psketch->all_ints           = TRUE;
+	psketch->rng_state          = RNG_SEED;
+	psketch->sorted_values      = NULL;
+	psketch->cumulative_weights = NULL;
+	psketch->num_sorted         = 0;
+	psketch->sorted_capacity    = 0;
+	psketch->sorted_valid       = FALSE;
+	percentile_sketch_add_level(psketch);
+	return psketch;
+}
+
+void percentile_sketch_free(percentile_sketch_t* psketch) {
+	if (psketch == NULL)
+		return;
+	for (int h = 0; h < psketch->num_levels; h++)
+		free(psketch->levels[h].values);
+	free(psketch->levels);
+	free(psketch->sorted_values);
+	free(psketch->cumulative_weights);
+	free(psketch);
+}
+
+// ----------------------------------------------------------------
+// Compaction threshold for a level: k for the top level, and 2/3 of the one
+// above for each level below that, but at least 2.
+static int level_threshold(percentile_sketch_t* psketch, int h) {
+	int threshold = (int)ceil(psketch->k * pow(2.0/3.0, psketch->num_levels - 1 - h));
+	return threshold < 2 ? 2 : threshold;
+}
+
+static void percentile_sketch_add_level(percentile_sketch_t* psketch) {
+	if (psketch->num_levels >= psketch->levels_capacity) {
+		psketch->levels_capacity *= 2;
+		psketch->levels = mlr_realloc_or_die(psketch->levels,
+			psketch->levels_capacity * sizeof(percentile_sketch_level_t));
+	}
+	percentile_sketch_level_t* plevel = &psketch->levels[psketch->num_levels++];
+	plevel->capacity = 16;
+	plevel->values   = mlr_malloc_or_die(plevel->capacity * sizeof(double));
+	plevel->size     = 0;
+
+	psketch->total_threshold = 0;
+	for (int h = 0; h < psketch->num_levels; h++)
+		psketch->total_threshold += level_threshold(psketch, h);
+}
+
+static inline void level_append(percentile_sketch_level_t* plevel, double value) {
+	if (plevel->size >= plevel->capacity) {
+		plevel->capacity *= 2;
+		plevel->values = mlr_realloc_or_die(plevel->values, plevel->capacity * sizeof(double));
+	}
+	plevel->values[plevel->size++] = value;
+}
+
+// xorshift64: only one bit per compaction is needed.
+static int next_random_bit(percentile_sketch_t* psketch) {
+	unsigned long long x = psketch->rng_state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	psketch->rng_state = x;
+	return (int)(x >> 63);
+}
+
+static int double_comparator(const void* pva, const void* pvb) {
+	double a = *(const double*)pva;
+	double b = *(const double*)pvb;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+// ----------------------------------------------------------------
+void percentile_sketch_ingest(percentile_sketch_t* psketch, double value, int is_int) {
+	if (psketch->n == 0LL) {
+		psketch->min = value;
+		psketch->max = value;
+	} else if (value < psketch->min) {
+		psketch->min = value;
+	} else if (value > psketch->max) {
+		psketch->max = value;
+	}
+	if (!is_int)
+		psketch->all_ints = FALSE;
+	psketch->n++;
+	level_append(&psketch->levels[0], value);
+	psketch->total_size++;
+	psketch->sorted_valid = FALSE;
+	if (psketch->total_size > psketch->total_threshold)
+		percentile_sketch_compress(psketch);
+}
+
+// ----------------------------------------------------------------
+// Compacts the lowest level at or over its threshold, repeating until the
+// sketch as a whole is within its total threshold. An odd value out stays behind
+// so that an even number are compacted and the total weight is unchanged.
+static void percentile_sketch_compress(percentile_sketch_t* psketch) {
+	while (psketch->total_size > psketch->total_threshold) {
+		int h = 0;
+		while (h < psketch->num_levels && psketch->levels[h].size < level_threshold(psketch, h))
+			h++;
+		MLR_INTERNAL_CODING_ERROR_IF(h >= psketch->num_levels);
+		if (h + 1 >= psketch->num_levels)
+			percentile_sketch_add_level(psketch);
+
+		percentile_sketch_level_t* plevel = &psketch->levels[h];
+		percentile_sketch_level_t* pabove = &psketch->levels[h + 1];
+		qsort(plevel->values, plevel->size, sizeof(double), double_comparator);
+		int num_to_compact = plevel->size & ~1;
+		int num_promoted = num_to_compact / 2;
+		for (int i = next_random_bit(psketch); i < num_to_compact; i += 2)
+			level_append(pabove, plevel->values[i]);
+		if (plevel->size & 1) {
+			plevel->values[0] = plevel->values[plevel->size - 1];
+			plevel->size = 1;
+		} else {
+			plevel->size = 0;
+		}
+		psketch->total_size -= num_promoted;
+	}
+}
+
+// ----------------------------------------------------------------
+void percentile_sketch_merge(percentile_sketch_t* psketch, percentile_sketch_t* pother) {
+	if (pother->n == 0LL)
+		return;
+	if (psketch->n == 0LL) {
+		psketch->min = pother->min;
+		psketch->max = pother->max;
+	} else {
+		if (pother->min < psketch->min)
+			psketch->min = pother->min;
+		if (pother->max > psketch->max)
+			psketch->max = pother->max;
+	}
+	if (!pother->all_ints)
+		psketch->all_ints = FALSE;
+	psketch->n += pother->n;
+
+	while (psketch->num_levels < pother->num_levels)
+		percentile_sketch_add_level(psketch);
+	for (int h = 0; h < pother->num_levels; h++) {
+		percentile_sketch_level_t* pfrom = &pother->levels[h];
+		for (int i = 0; i < pfrom->size; i++)
+			level_append(&psketch->levels[h], pfrom->values[i]);
+		psketch->total_size += pfrom->size;
+	}
+	psketch->sorted_valid = FALSE;
+	percentile_sketch_compress(psketch);
+}
+
+void percentile_sketch_restore(percentile_sketch_t* psketch, int level, double value) {
+	while (psketch->num_levels <= level)
+		percentile_sketch_add_level(psketch);
+	level_append(&psketch->levels[level], value);
+	psketch->total_size++;
+	psketch->n += 1ULL << level;
+	psketch->sorted_valid = FALSE;
+}
+
+// ----------------------------------------------------------------
+// Sorts all retained values, with cumulative weights, for queries.
+typedef struct _weighted_value_t {
+	double             value;
+	unsigned long long weight;
+} weighted_value_t;
+
+static int weighted_value_comparator(const void* pva, const void* pvb) {
+	const weighted_value_t* pa = pva;
+	const weighted_value_t* pb = pvb;
+	return pa->value < pb->value ? -1 : pa->value > pb->value ? 1 : 0;
+}
+
+static void percentile_sketch_sort(percentile_sketch_t* psketch) {
+	if (psketch->sorted_valid)
+		return;
+	int n = psketch->total_size;
+	weighted_value_t* pairs = mlr_malloc_or_die((n > 0 ? n : 1) * sizeof(weighted_value_t));
+	int j = 0;
+	for (int h = 0; h < psketch->num_levels; h++) {
+		percentile_sketch_level_t* plevel = &psketch->levels[h];
+		for (int i = 0; i < plevel->size; i++, j++) {
+			pairs[j].value  = plevel->values[i];
+			pairs[j].weight = 1ULL << h;
+		}
+	}
+	qsort(pairs, n, sizeof(weighted_value_t), weighted_value_comparator);
+
+	if (n > psketch->sorted_capacity) {
+		psketch->sorted_capacity    = n;
+		psketch->sorted_values      = mlr_realloc_or_die(psketch->sorted_values, n * sizeof(double));
+		psketch->cumulative_weights = mlr_realloc_or_die(psketch->cumulative_weights,
+			n * sizeof(unsigned long long));
+	}
+	unsigned long long cumulative_weight = 0LL;
+	for (int i = 0; i < n; i++) {
+		cumulative_weight += pairs[i].weight;
+		psketch->sorted_values[i]      = pairs[i].value;
+		psketch->cumulative_weights[i] = cumulative_weight;
+	}
+	psketch->num_sorted   = n;
+	psketch->sorted_valid = TRUE;
+	free(pairs);
+}
+
+// The value standing in for the one at the given zero-up rank in the
+// original data: the first whose cumulative weight exceeds the rank.
+static double value_at_rank(percentile_sketch_t* psketch, unsigned long long rank) {
+	if (rank == 0LL)
+		return psketch->min;
+	if (rank >= psketch->n - 1)
+		return psketch->max;
+	int lo = 0;
+	int hi = psketch->num_sorted - 1;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (psketch->cumulative_weights[mid] > rank)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return psketch->sorted_values[lo];
+}
+
+static mv_t mv_from_sketch_value(percentile_sketch_t* psketch, double value) {
+	return psketch->all_ints ? mv_from_int((long long)value) : mv_from_float(value);
+}
+
+// ----------------------------------------------------------------
+// Ranks are computed as in percentile_keeper.
+mv_t percentile_sketch_emit_non_interpolated(percentile_sketch_t* psketch, double percentile) {
+	if (psketch->n == 0LL)
+		return mv_absent();
+	percentile_sketch_sort(psketch);
+	long long index = percentile*psketch->n/100.0;
+	if (index >= (long long)psketch->n)
+		index = psketch->n-1;
+	if (index < 0)
+		index = 0;
+	return mv_from_sketch_value(psketch, value_at_rank(psketch, index));
+}
+
+mv_t percentile_sketch_emit_linearly_interpolated(percentile_sketch_t* psketch, double percentile) {
+	if (psketch->n == 0LL)
+		return mv_absent();
+	percentile_sketch_sort(psketch);
+	double findex = (percentile/100.0)*(psketch->n-1);
+	if (findex < 0)
+		findex = 0;
+	unsigned long long iindex = (unsigned long long)floor(findex);
+	if (iindex >= psketch->n-1)
+		return mv_from_sketch_value(psketch, psketch->max);
+	double a = value_at_rank(psketch, iindex);
+	double b = value_at_rank(psketch, iindex+1);
+	return mv_from_float(a + (findex - iindex) * (b - a));
+}
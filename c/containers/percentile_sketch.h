@@ -0,0 +1,78 @@
+// ================================================================
+// Bounded-memory, mergeable approximation to percentile_keeper, for mlr stats1
+// and merge-fields with --approx.
+//
+// This is a KLL sketch (Karnin, Lang, and Liberty, "Optimal Quantile
+// Approximation in Streams", 2016). Values are kept in a stack of compactors:
+// level h holds values each standing for 2^h of the originals. When the sketch
+// is over capacity, the lowest full level is sorted and every other value, from
+// a random start, is promoted to the level above. Capacities shrink
+// geometrically (by 2/3) going down from the top level, with k at the top, so
+// memory is O(k) plus a few values per level, i.e. O(k + log(n/k)).
+//
+// Until the first compaction -- up to k values -- results are exact and the
+// same as percentile_keeper's. After that each result is the value at a rank
+// which is off from the requested one by at most about 1.65% of n for k=200,
+// with 99% confidence, the error shrinking roughly as 1/k for larger k. Error
+// depends only on k, not on n or on the distribution of the values. p0 and p100
+// are always exact since the min and max are tracked separately.
+//
+// Values are kept as doubles; if all ingested values were ints, results are
+// ints. The pseudorandom compaction offsets are from a fixed seed, so results
+// are reproducible run to run.
+// ================================================================
+
+#ifndef PERCENTILE_SKETCH_H
+#define PERCENTILE_SKETCH_H
+#include "lib/mlrval.h"
+
+#define PERCENTILE_SKETCH_DEFAULT_K 200
+#define PERCENTILE_SKETCH_MIN_K     8
+
+typedef struct _percentile_sketch_level_t {
+	double* values;
+	int     size;
+	int     capacity; // Allocated length, not the compaction threshold
+} percentile_sketch_level_t;
+
+typedef struct _percentile_sketch_t {
+	int                        k;
+	percentile_sketch_level_t* levels;
+	int                        num_levels;
+	int                        levels_capacity;
+	int                        total_size;
+	int                        total_threshold;
+	unsigned long long         n;
+	double                     min;
+	double                     max;
+	int                        all_ints;
+	unsigned long long         rng_state;
+
+	// Weighted values sorted for queries, rebuilt after any ingest or merge.
+	double*                    sorted_values;
+	unsigned long long*        cumulative_weights;
+	int                        num_sorted;
+	int                        sorted_capacity;
+	int                        sorted_valid;
+} percentile_sketch_t;
+
+percentile_sketch_t* percentile_sketch_alloc(int k);
+void percentile_sketch_free(percentile_sketch_t* psketch);
+void percentile_sketch_ingest(percentile_sketch_t* psketch, double value, int is_int);
+// Folds the other sketch into this one. The other is left unchanged.
+void percentile_sketch_merge(percentile_sketch_t* psketch, percentile_sketch_t* pother);
+
+// For restoring a dumped sketch: appends a value, of weight 2^level, without
+// compacting. The min, max, and all-ints flag are for the caller to set.
+void percentile_sketch_restore(percentile_sketch_t* psketch, int level, double value);
+
+typedef mv_t percentile_sketch_emitter_t(percentile_sketch_t* psketch, double percentile);
+mv_t percentile_sketch_emit_non_interpolated(percentile_sketch_t* psketch, double percentile);
+mv_t percentile_sketch_emit_linearly_interpolated(percentile_sketch_t* psketch, double percentile);
+
+// Number of values held, for test and benchmark.
+static inline int percentile_sketch_retained(percentile_sketch_t* psketch) {
+	return psketch->total_size;
+}
+
+#endif // PERCENTILE_SKETCH_H
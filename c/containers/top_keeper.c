@@ -11,6 +11,13 @@ top_keeper_t* top_keeper_alloc(int capacity) {
 	ptop_keeper->top_precords = mlr_malloc_or_die(capacity*sizeof(lrec_t*));
 	ptop_keeper->size         = 0;
 	ptop_keeper->capacity     = capacity;
+	ptop_keeper->sequences    = NULL;
+	ptop_keeper->next_sequence = 0LL;
+	ptop_keeper->is_heap      = FALSE;
+	if (capacity > TOP_KEEPER_HEAP_THRESHOLD) {
+		ptop_keeper->sequences = mlr_malloc_or_die(capacity*sizeof(unsigned long long));
+		ptop_keeper->is_heap   = TRUE;
+	}
 	return ptop_keeper;
 }
 
@@ -20,6 +27,7 @@ void top_keeper_free(top_keeper_t* ptop_keeper) {
 		return;
 	free(ptop_keeper->top_values);
 	free(ptop_keeper->top_precords);
+	free(ptop_keeper->sequences);
 	ptop_keeper->top_values = NULL;
 	ptop_keeper->top_precords = NULL;
 	ptop_keeper->size = 0;
@@ -56,8 +64,14 @@ void top_keeper_free(top_keeper_t* ptop_keeper) {
 // [8  ]   [8  ]                            [8 #]   [8 #]
 // [9  ]   [9  ]                            [9 #]   [9 #]
 
+static void top_keeper_heap_add(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec);
+
 // Our caller, mapper_top, feeds us records. We keep them or free them.
 void top_keeper_add(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec) {
+	if (ptop_keeper->sequences != NULL) {
+		top_keeper_heap_add(ptop_keeper, value, prec);
+		return;
+	}
 	int destidx = mlr_bsearch_mv_n_for_insert(ptop_keeper->top_values, ptop_keeper->size, &value);
 	if (ptop_keeper->size < ptop_keeper->capacity) {
 		for (int i = ptop_keeper->size-1; i >= destidx; i--) {
@@ -82,6 +96,89 @@ void top_keeper_add(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec) {
 	}
 }
 
+// ----------------------------------------------------------------
+// Heap mode. The root is the least value kept: the first to go.
+
+// Whether entry i goes after entry j: a smaller value, or an equal one added earlier.
+static inline int heap_less(top_keeper_t* ptop_keeper, int i, int j) {
+	mv_t* pa = &ptop_keeper->top_values[i];
+	mv_t* pb = &ptop_keeper->top_values[j];
+	if (mv_i_nn_lt(pa, pb))
+		return TRUE;
+	if (mv_i_nn_gt(pa, pb))
+		return FALSE;
+	return ptop_keeper->sequences[i] < ptop_keeper->sequences[j];
+}
+
+static inline void heap_swap(top_keeper_t* ptop_keeper, int i, int j) {
+	mv_t value = ptop_keeper->top_values[i];
+	ptop_keeper->top_values[i] = ptop_keeper->top_values[j];
+	ptop_keeper->top_values[j] = value;
+	lrec_t* prec = ptop_keeper->top_precords[i];
+	ptop_keeper->top_precords[i] = ptop_keeper->top_precords[j];
+	ptop_keeper->top_precords[j] = prec;
+	unsigned long long sequence = ptop_keeper->sequences[i];
+	ptop_keeper->sequences[i] = ptop_keeper->sequences[j];
+	ptop_keeper->sequences[j] = sequence;
+}
+
+static void heap_sift_down(top_keeper_t* ptop_keeper, int i, int size) {
+	while (TRUE) {
+		int child = 2*i + 1;
+		if (child >= size)
+			break;
+		if (child + 1 < size && heap_less(ptop_keeper, child + 1, child))
+			child++;
+		if (!heap_less(ptop_keeper, child, i))
+			break;
+		heap_swap(ptop_keeper, i, child);
+		i = child;
+	}
+}
+
+static void top_keeper_heap_add(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec) {
+	// Sorted descending, the array is reversed into an ascending one, which is a min-heap.
+	if (!ptop_keeper->is_heap) {
+		for (int i = 0, j = ptop_keeper->size - 1; i < j; i++, j--)
+			heap_swap(ptop_keeper, i, j);
+		ptop_keeper->is_heap = TRUE;
+	}
+
+	unsigned long long sequence = ptop_keeper->next_sequence++;
+	if (ptop_keeper->size < ptop_keeper->capacity) {
+		int i = ptop_keeper->size++;
+		ptop_keeper->top_values[i]   = value;
+		ptop_keeper->top_precords[i] = prec;
+		ptop_keeper->sequences[i]    = sequence;
+		while (i > 0 && heap_less(ptop_keeper, i, (i-1)/2)) {
+			heap_swap(ptop_keeper, i, (i-1)/2);
+			i = (i-1)/2;
+		}
+	} else {
+		// Being added last, the new value goes after only those less than it.
+		if (mv_i_nn_lt(&value, &ptop_keeper->top_values[0])) {
+			lrec_free(prec);
+			return;
+		}
+		lrec_free(ptop_keeper->top_precords[0]);
+		ptop_keeper->top_values[0]   = value;
+		ptop_keeper->top_precords[0] = prec;
+		ptop_keeper->sequences[0]    = sequence;
+		heap_sift_down(ptop_keeper, 0, ptop_keeper->size);
+	}
+}
+
+// Heapsort: moving the least remaining to the end each time leaves the array descending.
+void top_keeper_sort(top_keeper_t* ptop_keeper) {
+	if (!ptop_keeper->is_heap)
+		return;
+	for (int n = ptop_keeper->size - 1; n > 0; n--) {
+		heap_swap(ptop_keeper, 0, n);
+		heap_sift_down(ptop_keeper, 0, n);
+	}
+	ptop_keeper->is_heap = FALSE;
+}
+
 // ----------------------------------------------------------------
 void top_keeper_print(top_keeper_t* ptop_keeper) {
 	printf("top_keeper dump:\n");
@@ -1,5 +1,12 @@
 // ================================================================
-// Data structure for mlr top: just a decorated array.
+// Data structure for mlr top: keeps the largest values seen, with their records.
+//
+// For small capacities this is just a decorated array, kept sorted descending
+// by insertion. Past TOP_KEEPER_HEAP_THRESHOLD, where shifting the array on
+// each insert would be O(capacity), it's a binary min-heap instead -- O(log
+// capacity) per insert, and O(1) to reject a value smaller than all those kept
+// -- which top_keeper_sort turns into the same descending array for output.
+// Among equal values, the later-added come first and are kept in preference.
 // ================================================================
 
 #ifndef TOP_KEEPER_H
@@ -7,16 +14,30 @@
 #include "lib/mlrval.h"
 #include "containers/lrec.h"
 
+// Allow compile-time override, e.g using gcc -D.
+#ifndef TOP_KEEPER_HEAP_THRESHOLD
+#define TOP_KEEPER_HEAP_THRESHOLD 32
+#endif
+
 typedef struct _top_keeper_t {
 	mv_t*    top_values;
 	lrec_t** top_precords;
 	int      size;
 	int      capacity;
+
+	// Heap mode only: when each value was added, for ordering ties.
+	unsigned long long* sequences;
+	unsigned long long  next_sequence;
+	int      is_heap; // FALSE once sorted
 } top_keeper_t;
 
 top_keeper_t* top_keeper_alloc(int capacity);
 void top_keeper_free(top_keeper_t* ptop_keeper);
+// Takes ownership of the record, if non-null: it's freed once not among the top.
 void top_keeper_add(top_keeper_t* ptop_keeper, mv_t value, lrec_t* prec);
+// Puts top_values and top_precords in descending order. Must be called after
+// adding and before reading them.
+void top_keeper_sort(top_keeper_t* ptop_keeper);
 
 // For debug/test
 void top_keeper_print(top_keeper_t* ptop_keeper);
@@ -0,0 +1,489 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/mvfuncs.h"
+#include "containers/lhmsi.h"
+#include "dsl/type_inference.h"
+#include "dsl/columnar_filter.h"
+
+// ----------------------------------------------------------------
+// Per-record classification within a column. Int and float values have their
+// numeric values in the int/float vectors; everything else (absent, empty,
+// string) goes through the mlrval disposition matrices one record at a time.
+#define CF_KIND_INT   0
+#define CF_KIND_FLOAT 1
+#define CF_KIND_OTHER 2
+
+// Per-record comparison outcomes, before packing into bitmaps.
+#define CF_FALSE  0
+#define CF_TRUE   1
+#define CF_ABSENT 2
+#define CF_ERROR  3
+
+typedef struct _cf_column_t {
+	mv_t*          pvals;  // Typed values, pointing into the records' strings
+	long long*     pints;
+	double*        pflts;  // Ints are also here, as doubles, for int-vs-float comparisons
+	unsigned char* pkinds;
+} cf_column_t;
+
+typedef enum _cf_node_type_t {
+	CF_NODE_AND,
+	CF_NODE_OR,
+	CF_NODE_NOT,
+	CF_NODE_COMPARE,
+} cf_node_type_t;
+
+typedef void cf_numeric_kernel_t(cf_column_t* pa, cf_column_t* pb, int n, unsigned char* pout);
+
+typedef struct _cf_node_t {
+	cf_node_type_t       type;
+	struct _cf_node_t*   pleft;
+	struct _cf_node_t*   pright;
+
+	// For comparisons: column indices of the operands, the numeric fast-path
+	// kernel, and the row engine's comparator for everything else.
+	int                  left_column_index;
+	int                  right_column_index;
+	cf_numeric_kernel_t* pkernel;
+	mv_binary_func_t*    pcomparator;
+
+	// Node results: one bit per record.
+	uint64_t*            ptrue_bits;
+	uint64_t*            pabsent_bits;
+	uint64_t*            perror_bits;
+} cf_node_t;
+
+struct _columnar_filter_t {
+	cf_node_t*     proot;
+	int            negate_final_filter;
+	int            batch_size;
+	int            num_words;
+	mv_t         (*ptype_infer_func)(char* string);
+
+	// Field columns are refilled for each batch; literal columns are filled
+	// once at construction time.
+	lhmsi_t*       pfield_names_to_column_indices;
+	char**         field_names;
+	cf_column_t*   pcolumns;
+	int            num_columns;
+	int            columns_capacity;
+
+	unsigned char* pcompare_outputs;
+};
+
+static int        cf_node_is_eligible(mlr_dsl_ast_node_t* pnode);
+static cf_node_t* cf_node_alloc(columnar_filter_t* pfilter, mlr_dsl_ast_node_t* pnode);
+static void       cf_node_free(cf_node_t* pnode);
+static void       cf_node_evaluate(columnar_filter_t* pfilter, cf_node_t* pnode, int n);
+static int        cf_column_index_from_ast(columnar_filter_t* pfilter, mlr_dsl_ast_node_t* pnode);
+static int        cf_column_alloc(columnar_filter_t* pfilter);
+static void       cf_column_set(cf_column_t* pcolumn, int i, mv_t val);
+
+// ----------------------------------------------------------------
+columnar_filter_t* columnar_filter_alloc(mlr_dsl_cst_t* pcst, int type_inferencing, int negate_final_filter,
+	int batch_size)
+{
+	blocked_ast_t* paast = pcst->paast;
+	if (paast->pfunc_defs->length != 0 || paast->psubr_defs->length != 0)
+		return NULL;
+	if (paast->pbegin_blocks->length != 0 || paast->pend_blocks->length != 0)
+		return NULL;
+	// Only a single bare-boolean statement: anything before it would be an
+	// assignment or other side-effecting statement.
+	sllv_t* pstatements = paast->pmain_block->pchildren;
+	if (pstatements->length != 1)
+		return NULL;
+	mlr_dsl_ast_node_t* pexpression = pstatements->phead->pvvalue;
+	if (!cf_node_is_eligible(pexpression))
+		return NULL;
+
+	columnar_filter_t* pfilter = mlr_malloc_or_die(sizeof(columnar_filter_t));
+	pfilter->negate_final_filter = negate_final_filter;
+	pfilter->batch_size          = batch_size;
+	pfilter->num_words           = (batch_size + 63) / 64;
+	switch (type_inferencing) {
+	case TYPE_INFER_STRING_ONLY:
+		pfilter->ptype_infer_func = mv_ref_type_infer_string;
+		break;
+	case TYPE_INFER_STRING_FLOAT:
+		pfilter->ptype_infer_func = mv_ref_type_infer_string_or_float;
+		break;
+	case TYPE_INFER_STRING_FLOAT_INT:
+		pfilter->ptype_infer_func = mv_ref_type_infer_string_or_float_or_int;
+		break;
+	default:
+		MLR_INTERNAL_CODING_ERROR();
+		break;
+	}
+
+	pfilter->pfield_names_to_column_indices = lhmsi_alloc();
+	pfilter->field_names       = NULL;
+	pfilter->pcolumns          = NULL;
+	pfilter->num_columns       = 0;
+	pfilter->columns_capacity  = 0;
+	pfilter->pcompare_outputs  = mlr_malloc_or_die(batch_size * sizeof(unsigned char));
+
+	pfilter->proot = cf_node_alloc(pfilter, pexpression);
+
+	return pfilter;
+}
+
+// ----------------------------------------------------------------
+void columnar_filter_free(columnar_filter_t* pfilter) {
+	if (pfilter == NULL)
+		return;
+	cf_node_free(pfilter->proot);
+	for (int j = 0; j < pfilter->num_columns; j++) {
+		cf_column_t* pcolumn = &pfilter->pcolumns[j];
+		free(pcolumn->pvals);
+		free(pcolumn->pints);
+		free(pcolumn->pflts);
+		free(pcolumn->pkinds);
+	}
+	free(pfilter->pcolumns);
+	free(pfilter->field_names);
+	lhmsi_free(pfilter->pfield_names_to_column_indices);
+	free(pfilter->pcompare_outputs);
+	free(pfilter);
+}
+
+int columnar_filter_get_batch_size(columnar_filter_t* pfilter) {
+	return pfilter->batch_size;
+}
+
+// ----------------------------------------------------------------
+void columnar_filter_evaluate(columnar_filter_t* pfilter, lrec_t** records, int n,
+	uint64_t* pselected_bits, uint64_t* perror_bits)
+{
+	MLR_INTERNAL_CODING_ERROR_IF(n > pfilter->batch_size);
+
+	// Extract and type-infer each referenced field exactly once per record.
+	for (int j = 0; j < pfilter->num_columns; j++) {
+		char* field_name = pfilter->field_names[j];
+		if (field_name == NULL) // literal
+			continue;
+		cf_column_t* pcolumn = &pfilter->pcolumns[j];
+		for (int i = 0; i < n; i++)
+			cf_column_set(pcolumn, i, pfilter->ptype_infer_func(lrec_get(records[i], field_name)));
+	}
+
+	cf_node_t* proot = pfilter->proot;
+	cf_node_evaluate(pfilter, proot, n);
+
+	// As in the row engine's final-filter statement: absent means don't emit,
+	// else true (or false with -x) means emit.
+	int num_words = (n + 63) / 64;
+	for (int w = 0; w < num_words; w++) {
+		uint64_t t = proot->ptrue_bits[w];
+		uint64_t a = proot->pabsent_bits[w];
+		uint64_t e = proot->perror_bits[w];
+		pselected_bits[w] = pfilter->negate_final_filter ? ~(t | a | e) : t;
+		perror_bits[w] = e;
+	}
+	int tail = n % 64;
+	if (tail != 0) {
+		uint64_t mask = (((uint64_t)1) << tail) - 1;
+		pselected_bits[num_words-1] &= mask;
+		perror_bits[num_words-1] &= mask;
+	}
+}
+
+// ================================================================
+static int cf_operand_is_eligible(mlr_dsl_ast_node_t* pnode) {
+	if (pnode->pchildren != NULL)
+		return FALSE;
+	switch (pnode->type) {
+	case MD_AST_NODE_TYPE_FIELD_NAME:
+	case MD_AST_NODE_TYPE_NUMERIC_LITERAL:
+	case MD_AST_NODE_TYPE_STRING_LITERAL:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static int cf_is_comparator(char* op) {
+	return streq(op, "==") || streq(op, "!=")
+		|| streq(op, "<")  || streq(op, "<=")
+		|| streq(op, ">")  || streq(op, ">=");
+}
+
+static int cf_node_is_eligible(mlr_dsl_ast_node_t* pnode) {
+	if (pnode->type != MD_AST_NODE_TYPE_OPERATOR || pnode->pchildren == NULL)
+		return FALSE;
+	sllv_t* pchildren = pnode->pchildren;
+	char* op = pnode->text;
+
+	if (streq(op, "&&") || streq(op, "||")) {
+		return pchildren->length == 2
+			&& cf_node_is_eligible(pchildren->phead->pvvalue)
+			&& cf_node_is_eligible(pchildren->phead->pnext->pvvalue);
+	} else if (streq(op, "!")) {
+		return pchildren->length == 1
+			&& cf_node_is_eligible(pchildren->phead->pvvalue);
+	} else if (cf_is_comparator(op)) {
+		return pchildren->length == 2
+			&& cf_operand_is_eligible(pchildren->phead->pvvalue)
+			&& cf_operand_is_eligible(pchildren->phead->pnext->pvvalue);
+	} else {
+		return FALSE;
+	}
+}
+
+// ================================================================
+// Numeric fast paths. Both loops are branch-free over contiguous arrays so
+// that the compiler can auto-vectorize them. Int-vs-int comparisons are done
+// on the ints, not their double images, to match the row engine for values
+// past 2^53.
+
+#define CF_DEFINE_NUMERIC_KERNEL(name, OP) \
+static void name(cf_column_t* pa, cf_column_t* pb, int n, unsigned char* pout) { \
+	double*        af = pa->pflts;  double*        bf = pb->pflts; \
+	long long*     ai = pa->pints;  long long*     bi = pb->pints; \
+	unsigned char* ak = pa->pkinds; unsigned char* bk = pb->pkinds; \
+	for (int i = 0; i < n; i++) \
+		pout[i] = af[i] OP bf[i]; \
+	for (int i = 0; i < n; i++) { \
+		unsigned char both_int = (ak[i] == CF_KIND_INT) & (bk[i] == CF_KIND_INT); \
+		unsigned char int_result = ai[i] OP bi[i]; \
+		pout[i] = both_int ? int_result : pout[i]; \
+	} \
+}
+
+CF_DEFINE_NUMERIC_KERNEL(cf_eq_kernel, ==)
+CF_DEFINE_NUMERIC_KERNEL(cf_ne_kernel, !=)
+CF_DEFINE_NUMERIC_KERNEL(cf_lt_kernel, <)
+CF_DEFINE_NUMERIC_KERNEL(cf_le_kernel, <=)
+CF_DEFINE_NUMERIC_KERNEL(cf_gt_kernel, >)
+CF_DEFINE_NUMERIC_KERNEL(cf_ge_kernel, >=)
+
+// ----------------------------------------------------------------
+static cf_node_t* cf_node_alloc(columnar_filter_t* pfilter, mlr_dsl_ast_node_t* pastnode) {
+	cf_node_t* pnode = mlr_malloc_or_die(sizeof(cf_node_t));
+	pnode->pleft              = NULL;
+	pnode->pright             = NULL;
+	pnode->left_column_index  = -1;
+	pnode->right_column_index = -1;
+	pnode->pkernel            = NULL;
+	pnode->pcomparator        = NULL;
+	pnode->ptrue_bits         = mlr_malloc_or_die(pfilter->num_words * sizeof(uint64_t));
+	pnode->pabsent_bits       = mlr_malloc_or_die(pfilter->num_words * sizeof(uint64_t));
+	pnode->perror_bits        = mlr_malloc_or_die(pfilter->num_words * sizeof(uint64_t));
+
+	char* op = pastnode->text;
+	mlr_dsl_ast_node_t* pfirst = pastnode->pchildren->phead->pvvalue;
+
+	if (streq(op, "&&")) {
+		pnode->type   = CF_NODE_AND;
+		pnode->pleft  = cf_node_alloc(pfilter, pfirst);
+		pnode->pright = cf_node_alloc(pfilter, pastnode->pchildren->phead->pnext->pvvalue);
+	} else if (streq(op, "||")) {
+		pnode->type   = CF_NODE_OR;
+		pnode->pleft  = cf_node_alloc(pfilter, pfirst);
+		pnode->pright = cf_node_alloc(pfilter, pastnode->pchildren->phead->pnext->pvvalue);
+	} else if (streq(op, "!")) {
+		pnode->type   = CF_NODE_NOT;
+		pnode->pleft  = cf_node_alloc(pfilter, pfirst);
+	} else {
+		pnode->type = CF_NODE_COMPARE;
+		pnode->left_column_index  = cf_column_index_from_ast(pfilter, pfirst);
+		pnode->right_column_index = cf_column_index_from_ast(pfilter, pastnode->pchildren->phead->pnext->pvvalue);
+		if        (streq(op, "==")) { pnode->pkernel = cf_eq_kernel; pnode->pcomparator = eq_op_func;
+		} else if (streq(op, "!=")) { pnode->pkernel = cf_ne_kernel; pnode->pcomparator = ne_op_func;
+		} else if (streq(op, "<"))  { pnode->pkernel = cf_lt_kernel; pnode->pcomparator = lt_op_func;
+		} else if (streq(op, "<=")) { pnode->pkernel = cf_le_kernel; pnode->pcomparator = le_op_func;
+		} else if (streq(op, ">"))  { pnode->pkernel = cf_gt_kernel; pnode->pcomparator = gt_op_func;
+		} else if (streq(op, ">=")) { pnode->pkernel = cf_ge_kernel; pnode->pcomparator = ge_op_func;
+		} else {
+			MLR_INTERNAL_CODING_ERROR();
+		}
+	}
+	return pnode;
+}
+
+static void cf_node_free(cf_node_t* pnode) {
+	if (pnode == NULL)
+		return;
+	cf_node_free(pnode->pleft);
+	cf_node_free(pnode->pright);
+	free(pnode->ptrue_bits);
+	free(pnode->pabsent_bits);
+	free(pnode->perror_bits);
+	free(pnode);
+}
+
+// ----------------------------------------------------------------
+// Field names map to one shared column apiece, so '$x > 1 && $x < 5' extracts
+// $x once. Literals get their own columns, filled with copies of the literal
+// value, so that the kernels only ever see column-vs-column comparisons. Typed
+// literals are set up as in rval_evaluator_alloc_from_numeric_literal and
+// rval_evaluator_alloc_from_string_literal.
+
+static int cf_column_index_from_ast(columnar_filter_t* pfilter, mlr_dsl_ast_node_t* pnode) {
+	if (pnode->type == MD_AST_NODE_TYPE_FIELD_NAME) {
+		int index = 0;
+		if (lhmsi_test_and_get(pfilter->pfield_names_to_column_indices, pnode->text, &index))
+			return index;
+		index = cf_column_alloc(pfilter);
+		pfilter->field_names[index] = pnode->text;
+		lhmsi_put(pfilter->pfield_names_to_column_indices, pnode->text, index, NO_FREE);
+		return index;
+	}
+
+	mv_t literal;
+	long long intv;
+	double fltv;
+	if (pnode->type == MD_AST_NODE_TYPE_NUMERIC_LITERAL && mlr_try_int_from_string(pnode->text, &intv)) {
+		literal = mv_from_int(intv);
+	} else if (pnode->type == MD_AST_NODE_TYPE_NUMERIC_LITERAL && mlr_try_float_from_string(pnode->text, &fltv)) {
+		literal = mv_from_float(fltv);
+	} else {
+		literal = mv_from_string_no_free(pnode->text);
+	}
+
+	int index = cf_column_alloc(pfilter);
+	pfilter->field_names[index] = NULL;
+	cf_column_t* pcolumn = &pfilter->pcolumns[index];
+	for (int i = 0; i < pfilter->batch_size; i++)
+		cf_column_set(pcolumn, i, literal);
+	return index;
+}
+
+static int cf_column_alloc(columnar_filter_t* pfilter) {
+	if (pfilter->num_columns >= pfilter->columns_capacity) {
+		pfilter->columns_capacity = 2 * pfilter->columns_capacity + 4;
+		pfilter->pcolumns = mlr_realloc_or_die(pfilter->pcolumns,
+			pfilter->columns_capacity * sizeof(cf_column_t));
+		pfilter->field_names = mlr_realloc_or_die(pfilter->field_names,
+			pfilter->columns_capacity * sizeof(char*));
+	}
+	int index = pfilter->num_columns++;
+	cf_column_t* pcolumn = &pfilter->pcolumns[index];
+	int n = pfilter->batch_size;
+	pcolumn->pvals  = mlr_malloc_or_die(n * sizeof(mv_t));
+	pcolumn->pints  = mlr_malloc_or_die(n * sizeof(long long));
+	pcolumn->pflts  = mlr_malloc_or_die(n * sizeof(double));
+	pcolumn->pkinds = mlr_malloc_or_die(n * sizeof(unsigned char));
+	return index;
+}
+
+static void cf_column_set(cf_column_t* pcolumn, int i, mv_t val) {
+	pcolumn->pvals[i] = val;
+	if (val.type == MT_INT) {
+		pcolumn->pints[i]  = val.u.intv;
+		pcolumn->pflts[i]  = (double)val.u.intv;
+		pcolumn->pkinds[i] = CF_KIND_INT;
+	} else if (val.type == MT_FLOAT) {
+		pcolumn->pints[i]  = 0LL;
+		pcolumn->pflts[i]  = val.u.fltv;
+		pcolumn->pkinds[i] = CF_KIND_FLOAT;
+	} else {
+		pcolumn->pints[i]  = 0LL;
+		pcolumn->pflts[i]  = 0.0;
+		pcolumn->pkinds[i] = CF_KIND_OTHER;
+	}
+}
+
+// ================================================================
+// Truth tables, with F/T/A/E for false/true/absent/error, follow
+// rval_evaluator_b_bb_and_func, rval_evaluator_b_bb_or_func, and
+// rval_evaluator_b_b_func:
+// * and: E if the left is E; F if the left is F; else the right unless it's A, in which case the left.
+// * or:  E if the left is E; T if the left is T; else the right unless it's A, in which case the left.
+// * not: swaps T and F; A and E pass through.
+// Short-circuiting doesn't matter here since comparisons have no side effects.
+
+static void cf_node_evaluate(columnar_filter_t* pfilter, cf_node_t* pnode, int n) {
+	int num_words = (n + 63) / 64;
+
+	switch (pnode->type) {
+
+	case CF_NODE_AND: {
+		cf_node_evaluate(pfilter, pnode->pleft, n);
+		cf_node_evaluate(pfilter, pnode->pright, n);
+		uint64_t *t1 = pnode->pleft->ptrue_bits,  *a1 = pnode->pleft->pabsent_bits,  *e1 = pnode->pleft->perror_bits;
+		uint64_t *t2 = pnode->pright->ptrue_bits, *a2 = pnode->pright->pabsent_bits, *e2 = pnode->pright->perror_bits;
+		for (int w = 0; w < num_words; w++) {
+			uint64_t go_right = t1[w] | a1[w];
+			pnode->ptrue_bits[w]   = go_right & (t2[w] | (a2[w] & t1[w]));
+			pnode->pabsent_bits[w] = a1[w] & a2[w];
+			pnode->perror_bits[w]  = e1[w] | (go_right & e2[w]);
+		}
+		break;
+	}
+
+	case CF_NODE_OR: {
+		cf_node_evaluate(pfilter, pnode->pleft, n);
+		cf_node_evaluate(pfilter, pnode->pright, n);
+		uint64_t *t1 = pnode->pleft->ptrue_bits,  *a1 = pnode->pleft->pabsent_bits,  *e1 = pnode->pleft->perror_bits;
+		uint64_t *t2 = pnode->pright->ptrue_bits, *a2 = pnode->pright->pabsent_bits, *e2 = pnode->pright->perror_bits;
+		for (int w = 0; w < num_words; w++) {
+			uint64_t go_right = ~(t1[w] | e1[w]);
+			pnode->ptrue_bits[w]   = t1[w] | (go_right & t2[w]);
+			pnode->pabsent_bits[w] = a1[w] & a2[w];
+			pnode->perror_bits[w]  = e1[w] | (go_right & e2[w]);
+		}
+		break;
+	}
+
+	case CF_NODE_NOT: {
+		cf_node_evaluate(pfilter, pnode->pleft, n);
+		uint64_t *t1 = pnode->pleft->ptrue_bits, *a1 = pnode->pleft->pabsent_bits, *e1 = pnode->pleft->perror_bits;
+		for (int w = 0; w < num_words; w++) {
+			pnode->ptrue_bits[w]   = ~(t1[w] | a1[w] | e1[w]);
+			pnode->pabsent_bits[w] = a1[w];
+			pnode->perror_bits[w]  = e1[w];
+		}
+		break;
+	}
+
+	case CF_NODE_COMPARE: {
+		cf_column_t* pa = &pfilter->pcolumns[pnode->left_column_index];
+		cf_column_t* pb = &pfilter->pcolumns[pnode->right_column_index];
+		unsigned char* pout = pfilter->pcompare_outputs;
+
+		pnode->pkernel(pa, pb, n, pout);
+
+		// Records with a non-numeric operand use the same disposition matrices
+		// as the row engine: string compares, absent-handling, etc. The column
+		// values are non-owning references so the comparators' mv_frees are
+		// no-ops on them.
+		for (int i = 0; i < n; i++) {
+			if (pa->pkinds[i] != CF_KIND_OTHER && pb->pkinds[i] != CF_KIND_OTHER)
+				continue;
+			mv_t aval = pa->pvals[i];
+			mv_t bval = pb->pvals[i];
+			mv_t result = pnode->pcomparator(&aval, &bval);
+			if (result.type == MT_BOOLEAN)
+				pout[i] = result.u.boolv ? CF_TRUE : CF_FALSE;
+			else if (result.type == MT_ABSENT)
+				pout[i] = CF_ABSENT;
+			else
+				pout[i] = CF_ERROR;
+		}
+
+		for (int w = 0; w < num_words; w++) {
+			uint64_t t = 0LL, a = 0LL, e = 0LL;
+			int lo = w * 64;
+			int hi = (lo + 64 < n) ? lo + 64 : n;
+			for (int i = lo; i < hi; i++) {
+				uint64_t bit = ((uint64_t)1) << (i - lo);
+				unsigned char c = pout[i];
+				t |= (c == CF_TRUE)   ? bit : 0;
+				a |= (c == CF_ABSENT) ? bit : 0;
+				e |= (c == CF_ERROR)  ? bit : 0;
+			}
+			pnode->ptrue_bits[w]   = t;
+			pnode->pabsent_bits[w] = a;
+			pnode->perror_bits[w]  = e;
+		}
+		break;
+	}
+
+	default:
+		MLR_INTERNAL_CODING_ERROR();
+		break;
+	}
+}
@@ -0,0 +1,52 @@
+// ================================================================
+// Column-at-a-time evaluator for mlr filter --columnar.
+//
+// The row engine walks the rval-evaluator tree once per record. For filter
+// expressions which are only comparisons of field values against literals (or
+// against other fields), combined with &&, ||, and !, that tree-walk costs far
+// more than the comparisons themselves. Here, records are instead gathered
+// into batches; each referenced field is extracted once per batch into typed
+// column vectors (int, float, and the original mlrval); each comparison is run
+// over the whole batch in straight-line loops the compiler can vectorize; and
+// the boolean connectives are applied 64 records at a time on bitmaps.
+//
+// Results are identical to the row engine's, including absent-field semantics:
+// each node's result is a pair of bitmaps (true, absent) plus an error bitmap
+// which the caller resolves by re-running the affected records through the row
+// engine. Records whose values aren't both numeric are compared using the same
+// mlrval disposition matrices the row engine uses.
+//
+// Expressions with anything else -- assignments, oosvars, locals, function
+// calls, regex matches (which set captures), context variables, begin/end
+// blocks, emit/tee/print/dump, etc. -- are not handled here: the allocator
+// returns NULL and the caller falls back to the row engine.
+// ================================================================
+
+#ifndef COLUMNAR_FILTER_H
+#define COLUMNAR_FILTER_H
+
+#include <stdint.h>
+#include "containers/lrec.h"
+#include "dsl/mlr_dsl_cst.h"
+
+#define COLUMNAR_FILTER_DEFAULT_BATCH_SIZE 1024
+
+struct _columnar_filter_t; // Opaque
+typedef struct _columnar_filter_t columnar_filter_t;
+
+// Returns NULL if the CST's statements aren't eligible for columnar evaluation.
+columnar_filter_t* columnar_filter_alloc(mlr_dsl_cst_t* pcst, int type_inferencing, int negate_final_filter,
+	int batch_size);
+void columnar_filter_free(columnar_filter_t* pfilter);
+
+int columnar_filter_get_batch_size(columnar_filter_t* pfilter);
+
+// Evaluates the filter expression over records[0..n-1], with n at most the
+// batch size. On return, bit i of pselected_bits is set if record i passes the
+// filter, and bit i of perror_bits is set if the expression evaluated to error
+// for record i -- in which case the caller should use the row engine for that
+// record. Both bitmaps must have room for (batch_size+63)/64 words.
+void columnar_filter_evaluate(columnar_filter_t* pfilter, lrec_t** records, int n,
+	uint64_t* pselected_bits, uint64_t* perror_bits);
+
+#endif // COLUMNAR_FILTER_H
@@ -129,7 +129,7 @@ static void handle_print(
 		FILE* outfp = multi_out_get(pstate->pmulti_out, filename, pstate->file_output_mode);
 		fprintf(outfp, "%s%s", sval, pstate->print_terminator);
 		if (pstate->flush_every_record)
-			fflush(outfp);
+			multi_out_flush_record(pstate->pmulti_out, filename);
 
 		if (fn_free_flags)
 			free(filename);
@@ -1434,11 +1434,11 @@ static void handle_dump_to_file(
 	char fn_free_flags;
 	char* filename = mv_format_val(&filename_mv, &fn_free_flags);
 
-	FILE* outfp = multi_out_get(pstate->pmulti_out, filename, pstate->file_output_mode);
-
 	rxval_evaluator_t* ptarget_xevaluator = pstate->ptarget_xevaluator;
 	boxed_xval_t boxed_xval = ptarget_xevaluator->pprocess_func(ptarget_xevaluator->pvstate, pvars);
 
+	FILE* outfp = multi_out_get(pstate->pmulti_out, filename, pstate->file_output_mode);
+
 	if (boxed_xval.xval.is_terminal) {
 		mlhmmv_print_terminal(&boxed_xval.xval.terminal_mlrval,
 			pvars->json_quote_int_keys, pvars->json_quote_non_string_values, outfp);
@@ -1451,7 +1451,7 @@ static void handle_dump_to_file(
 	}
 
 	if (pstate->flush_every_record)
-		fflush(outfp);
+		multi_out_flush_record(pstate->pmulti_out, filename);
 
 	if (fn_free_flags)
 		free(filename);
@@ -0,0 +1,186 @@
+// ================================================================
+// Delimiter-scan benchmark for the DKVP and NIDX readers' inner loops:
+// byte-at-a-time comparison against each separator, versus skipping to the
+// next candidate byte with byte_scan_4, versus going through all the candidate
+// bytes of each block with byte_scan_block_4 as the readers now do.
+//
+// Each pass splits a buffer of DKVP lines into keys and values, poking null
+// terminators as the readers do, and counts the fields found; the counts must
+// agree. Lines are refreshed from a pristine copy before each pass.
+//
+// Usage: delimiter_scan_bench [num lines [num fields per line [value length [num reps]]]]
+// Defaults are 1M lines of 8 fields, with values averaging 8 characters.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/mlrdatetime.h"
+#include "lib/byte_scan.h"
+
+// ----------------------------------------------------------------
+static char* make_lines(int num_lines, int num_fields, int value_length, size_t* plength) {
+	size_t line_length = num_fields * (4 + 2 * value_length + 1);
+	size_t length = num_lines * line_length;
+	char* buf = mlr_malloc_or_die(length + 1);
+	char* p = buf;
+	unsigned int r = 1;
+	for (int i = 0; i < num_lines; i++) {
+		for (int j = 0; j < num_fields; j++) {
+			p += sprintf(p, "k%02d=", j % 100);
+			// Lengths vary from 1 to twice the average, as in real data.
+			r = r * 1103515245 + 12345;
+			int n = value_length < 1 ? 0 : 1 + (r >> 16) % (2 * value_length);
+			for (int k = 0; k < n; k++) {
+				r = r * 1103515245 + 12345;
+				*p++ = '0' + (r >> 16) % 10;
+			}
+			*p++ = j < num_fields - 1 ? ',' : '\n';
+		}
+	}
+	*p = 0;
+	*plength = p - buf;
+	return buf;
+}
+
+// ----------------------------------------------------------------
+// As in the readers before byte_scan: one comparison per separator per byte.
+static long long split_scalar(char* buf, char* eof, char irs, char ifs, char ips) {
+	long long num_fields = 0LL;
+	long long checksum = 0LL;
+	char* p = buf;
+	char* key = p;
+	char* value = p;
+	int saw_ps = FALSE;
+	for ( ; p < eof && *p; ) {
+		if (*p == irs || *p == ifs) {
+			*p = 0;
+			num_fields++;
+			checksum += value - key;
+			p++;
+			key = p;
+			value = p;
+			saw_ps = FALSE;
+		} else if (*p == ips && !saw_ps) {
+			*p = 0;
+			p++;
+			value = p;
+			saw_ps = TRUE;
+		} else {
+			p++;
+		}
+	}
+	return num_fields + checksum;
+}
+
+// Skipping to the next byte which is any of the separators.
+static long long split_byte_scan(char* buf, char* eof, char irs, char ifs, char ips) {
+	long long num_fields = 0LL;
+	long long checksum = 0LL;
+	char* p = buf;
+	char* key = p;
+	char* value = p;
+	int saw_ps = FALSE;
+	while (TRUE) {
+		p = byte_scan_4(p, eof, irs, ifs, ips, 0);
+		if (p >= eof || *p == 0)
+			break;
+		if (*p == irs || *p == ifs) {
+			*p = 0;
+			num_fields++;
+			checksum += value - key;
+			p++;
+			key = p;
+			value = p;
+			saw_ps = FALSE;
+		} else if (*p == ips && !saw_ps) {
+			*p = 0;
+			p++;
+			value = p;
+			saw_ps = TRUE;
+		} else {
+			p++;
+		}
+	}
+	return num_fields + checksum;
+}
+
+// Finding all the separators in a block at once, then going through them.
+static long long split_block_mask(char* buf, char* eof, char irs, char ifs, char ips) {
+	long long num_fields = 0LL;
+	long long checksum = 0LL;
+	char* key = buf;
+	char* value = buf;
+	int saw_ps = FALSE;
+	for (char* block = buf; block < eof; block += BYTE_SCAN_BLOCK_SIZE) {
+		unsigned int mask = byte_scan_block_4(block, eof, irs, ifs, ips, 0);
+		for ( ; mask != 0; mask &= mask - 1) {
+			char* p = block + __builtin_ctz(mask);
+			if (*p == irs || *p == ifs) {
+				*p = 0;
+				num_fields++;
+				checksum += value - key;
+				key = p + 1;
+				value = p + 1;
+				saw_ps = FALSE;
+			} else if (*p == ips) {
+				if (!saw_ps) {
+					*p = 0;
+					value = p + 1;
+					saw_ps = TRUE;
+				}
+			} else {
+				return num_fields + checksum;
+			}
+		}
+	}
+	return num_fields + checksum;
+}
+
+// ----------------------------------------------------------------
+typedef long long splitter_t(char* buf, char* eof, char irs, char ifs, char ips);
+
+static void run(char* name, splitter_t* psplitter, char* pristine, char* buf, size_t length) {
+	memcpy(buf, pristine, length + 1);
+	double s = get_systime();
+	long long result = psplitter(buf, buf + length, '\n', ',', '=');
+	double e = get_systime();
+	printf("type=%s,t=%.6lf,mb_per_s=%.1lf,result=%lld\n", name, e - s, length / (e - s) / 1e6, result);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+	mlr_global_init(argv[0], NULL);
+	int num_lines    = 1000000;
+	int num_fields   = 8;
+	int value_length = 8;
+	int nreps        = 1;
+	if (argc >= 2)
+		(void)sscanf(argv[1], "%d", &num_lines);
+	if (argc >= 3)
+		(void)sscanf(argv[2], "%d", &num_fields);
+	if (argc >= 4)
+		(void)sscanf(argv[3], "%d", &value_length);
+	if (argc >= 5)
+		(void)sscanf(argv[4], "%d", &nreps);
+	if (num_lines < 1 || num_fields < 1 || value_length < 0) {
+		fprintf(stderr, "Usage: %s [num lines [num fields per line [value length [num reps]]]]\n", argv[0]);
+		exit(1);
+	}
+
+	size_t length = 0;
+	char* pristine = make_lines(num_lines, num_fields, value_length, &length);
+	char* buf = mlr_malloc_or_die(length + 1);
+
+	for (int rep = 0; rep < nreps; rep++) {
+		run("scalar",    split_scalar,    pristine, buf, length);
+		run("byte_scan", split_byte_scan, pristine, buf, length);
+		run("block_mask", split_block_mask, pristine, buf, length);
+	}
+
+	free(buf);
+	free(pristine);
+	return 0;
+}
@@ -0,0 +1,124 @@
+// ================================================================
+// Group-by lookup benchmark: lhmslv keyed on selected-value lists, as the
+// grouping verbs used to do it, versus group_table.
+//
+// Usage: group_table_bench [num groups [num records [num reps]]]
+// Defaults are 1M groups and 5M records, with two group-by fields.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/mlrdatetime.h"
+#include "containers/lrec.h"
+#include "containers/slls.h"
+#include "containers/lhmslv.h"
+#include "containers/group_table.h"
+#include "containers/mixutil.h"
+
+// ----------------------------------------------------------------
+static lrec_t** make_records(int num_groups, int num_records) {
+	lrec_t** precs = mlr_malloc_or_die(num_records * sizeof(lrec_t*));
+	for (int i = 0; i < num_records; i++) {
+		// Scatter the groups over the stream rather than having them in runs.
+		long long g = (long long)i * 7919LL % num_groups;
+		precs[i] = lrec_unbacked_alloc();
+		lrec_put(precs[i], "a", mlr_alloc_string_from_ll(g % 1000), FREE_ENTRY_VALUE);
+		lrec_put(precs[i], "b", mlr_alloc_string_from_ll(g / 1000), FREE_ENTRY_VALUE);
+		lrec_put(precs[i], "x", mlr_alloc_string_from_int(i), FREE_ENTRY_VALUE);
+	}
+	return precs;
+}
+
+// ----------------------------------------------------------------
+static long long count_with_lhmslv(lrec_t** precs, int num_records, slls_t* pgroup_by_field_names, int* pnum_groups) {
+	lhmslv_t* pcounts_by_group = lhmslv_alloc();
+	long long total = 0LL;
+	for (int i = 0; i < num_records; i++) {
+		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(precs[i], pgroup_by_field_names);
+		unsigned long long* pcount = lhmslv_get(pcounts_by_group, pgroup_by_field_values);
+		if (pcount == NULL) {
+			pcount = mlr_malloc_or_die(sizeof(unsigned long long));
+			*pcount = 0LL;
+			lhmslv_put(pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+		}
+		total += ++(*pcount);
+		slls_free(pgroup_by_field_values);
+	}
+	*pnum_groups = lhmslv_size(pcounts_by_group);
+	for (lhmslve_t* pe = pcounts_by_group->phead; pe != NULL; pe = pe->pnext)
+		free(pe->pvvalue);
+	lhmslv_free(pcounts_by_group);
+	return total;
+}
+
+static long long count_with_group_table(lrec_t** precs, int num_records, slls_t* pgroup_by_field_names,
+	int* pnum_groups)
+{
+	group_table_t* pcounts_by_group = group_table_alloc(pgroup_by_field_names->length);
+	group_key_t* pkey = group_key_alloc();
+	long long total = 0LL;
+	for (int i = 0; i < num_records; i++) {
+		group_key_from_record(pkey, precs[i], pgroup_by_field_names);
+		unsigned long long** ppcount = (unsigned long long**)group_table_get_or_add(pcounts_by_group, pkey);
+		if (*ppcount == NULL) {
+			*ppcount = mlr_malloc_or_die(sizeof(unsigned long long));
+			**ppcount = 0LL;
+		}
+		total += ++(**ppcount);
+	}
+	*pnum_groups = group_table_size(pcounts_by_group);
+	for (int i = 0; i < pcounts_by_group->num_entries; i++)
+		free(pcounts_by_group->entries[i].pvvalue);
+	group_table_free(pcounts_by_group);
+	group_key_free(pkey);
+	return total;
+}
+
+// ----------------------------------------------------------------
+int main(int argc, char** argv) {
+	mlr_global_init(argv[0], NULL);
+	int num_groups  = 1000000;
+	int num_records = 5000000;
+	int nreps       = 1;
+	if (argc >= 2)
+		(void)sscanf(argv[1], "%d", &num_groups);
+	if (argc >= 3)
+		(void)sscanf(argv[2], "%d", &num_records);
+	if (argc >= 4)
+		(void)sscanf(argv[3], "%d", &nreps);
+	if (num_groups < 1 || num_records < 1) {
+		fprintf(stderr, "Usage: %s [num groups [num records [num reps]]]\n", argv[0]);
+		exit(1);
+	}
+
+	lrec_t** precs = make_records(num_groups, num_records);
+	slls_t* pgroup_by_field_names = slls_alloc();
+	slls_append_no_free(pgroup_by_field_names, "a");
+	slls_append_no_free(pgroup_by_field_names, "b");
+
+	for (int rep = 0; rep < nreps; rep++) {
+		double s, e;
+		int ngroups;
+		long long total;
+
+		s = get_systime();
+		total = count_with_lhmslv(precs, num_records, pgroup_by_field_names, &ngroups);
+		e = get_systime();
+		printf("type=lhmslv,t=%.6lf,nrec=%d,ngroups=%d,total=%lld\n", e - s, num_records, ngroups, total);
+		fflush(stdout);
+
+		s = get_systime();
+		total = count_with_group_table(precs, num_records, pgroup_by_field_names, &ngroups);
+		e = get_systime();
+		printf("type=group_table,t=%.6lf,nrec=%d,ngroups=%d,total=%lld\n", e - s, num_records, ngroups, total);
+		fflush(stdout);
+	}
+
+	for (int i = 0; i < num_records; i++)
+		lrec_free(precs[i]);
+	free(precs);
+	slls_free(pgroup_by_field_names);
+	return 0;
+}
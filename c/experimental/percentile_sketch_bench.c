@@ -0,0 +1,112 @@
+// ================================================================
+// Percentile benchmark: percentile_keeper, which keeps and sorts all values,
+// versus percentile_sketch with various k. Reports time, values retained, and
+// for each sketch the worst rank error over p1 through p99 as a fraction of n.
+//
+// Usage: percentile_sketch_bench [num values [k ...]]
+// Defaults are 10M uniformly distributed values, and k of 200 and 1600.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/mlrdatetime.h"
+#include "lib/mtrand.h"
+#include "containers/percentile_keeper.h"
+#include "containers/percentile_sketch.h"
+
+#define NUM_PERCENTILES 99
+
+// ----------------------------------------------------------------
+static int double_comparator(const void* pva, const void* pvb) {
+	double a = *(const double*)pva;
+	double b = *(const double*)pvb;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+// Number of values less than the given one, in the sorted array.
+static long long rank_of(double* sorted, long long n, double value) {
+	long long lo = 0, hi = n;
+	while (lo < hi) {
+		long long mid = lo + (hi - lo) / 2;
+		if (sorted[mid] < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// ----------------------------------------------------------------
+int main(int argc, char** argv) {
+	mlr_global_init(argv[0], NULL);
+	mtrand_init(1);
+	long long num_values = 10000000LL;
+	int default_ks[] = { 200, 1600 };
+	int* ks = default_ks;
+	int num_ks = 2;
+	if (argc >= 2)
+		(void)sscanf(argv[1], "%lld", &num_values);
+	if (argc >= 3) {
+		num_ks = argc - 2;
+		ks = mlr_malloc_or_die(num_ks * sizeof(int));
+		for (int i = 0; i < num_ks; i++)
+			if (sscanf(argv[i+2], "%d", &ks[i]) != 1 || ks[i] < PERCENTILE_SKETCH_MIN_K)
+				num_values = 0;
+	}
+	if (num_values < 1) {
+		fprintf(stderr, "Usage: %s [num values [k ...]]\n", argv[0]);
+		exit(1);
+	}
+
+	double* values = mlr_malloc_or_die(num_values * sizeof(double));
+	for (long long i = 0; i < num_values; i++)
+		values[i] = get_mtrand_double();
+
+	double s, e;
+
+	s = get_systime();
+	percentile_keeper_t* pkeeper = percentile_keeper_alloc();
+	for (long long i = 0; i < num_values; i++)
+		percentile_keeper_ingest(pkeeper, mv_from_float(values[i]));
+	for (int p = 1; p <= NUM_PERCENTILES; p++)
+		(void)percentile_keeper_emit_non_interpolated(pkeeper, p);
+	e = get_systime();
+	printf("type=keeper,k=-,t=%.6lf,n=%lld,retained=%lld,max_rank_error=0\n", e - s, num_values, num_values);
+	fflush(stdout);
+	percentile_keeper_free(pkeeper);
+
+	double* sorted = mlr_malloc_or_die(num_values * sizeof(double));
+	memcpy(sorted, values, num_values * sizeof(double));
+	qsort(sorted, num_values, sizeof(double), double_comparator);
+
+	for (int i = 0; i < num_ks; i++) {
+		s = get_systime();
+		percentile_sketch_t* psketch = percentile_sketch_alloc(ks[i]);
+		for (long long j = 0; j < num_values; j++)
+			percentile_sketch_ingest(psketch, values[j], FALSE);
+		mv_t results[NUM_PERCENTILES];
+		for (int p = 1; p <= NUM_PERCENTILES; p++)
+			results[p-1] = percentile_sketch_emit_non_interpolated(psketch, p);
+		e = get_systime();
+
+		double max_rank_error = 0.0;
+		for (int p = 1; p <= NUM_PERCENTILES; p++) {
+			long long wanted = (long long)(p * num_values / 100.0);
+			long long got = rank_of(sorted, num_values, results[p-1].u.fltv);
+			double rank_error = (double)llabs(got - wanted) / num_values;
+			if (rank_error > max_rank_error)
+				max_rank_error = rank_error;
+		}
+		printf("type=sketch,k=%d,t=%.6lf,n=%lld,retained=%d,max_rank_error=%.6lf\n",
+			ks[i], e - s, num_values, percentile_sketch_retained(psketch), max_rank_error);
+		fflush(stdout);
+		percentile_sketch_free(psketch);
+	}
+
+	free(sorted);
+	free(values);
+	return 0;
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "lib/mlr_arch.h"
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "input/file_decompressor.h"
+
+#if MLR_ARCH_DECOMPRESSION_ENABLED
+#include <signal.h>
+#include <pthread.h>
+#include <zlib.h>
+#endif
+
+// Allow compile-time override, e.g using gcc -D.
+#ifndef FILE_DECOMPRESSOR_BUFFER_SIZE
+#define FILE_DECOMPRESSOR_BUFFER_SIZE (256*1024)
+#endif
+
+#if MLR_ARCH_DECOMPRESSION_ENABLED
+typedef struct _gunzip_state_t {
+	char* file_name;
+	int   in_fd;
+	int   out_fd;
+} gunzip_state_t;
+
+static int   start_gunzip(char* file_name, int in_fd);
+static void* gunzip_thread(void* pvstate);
+static int   write_fully(int fd, char* buf, size_t length);
+static void  gunzip_error(gunzip_state_t* pstate, char* message);
+#endif
+static int is_gzip_magic(unsigned char* magic, ssize_t num_read);
+
+// ----------------------------------------------------------------
+int file_decompressor_open(char* file_name) {
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0)
+		return fd;
+
+	// Fails harmlessly for FIFOs and the like, which are then read as they are.
+	unsigned char magic[4];
+	ssize_t num_read = pread(fd, magic, sizeof(magic), 0);
+
+	if (is_gzip_magic(magic, num_read)) {
+#if MLR_ARCH_DECOMPRESSION_ENABLED
+		return start_gunzip(file_name, fd);
+#else
+		fprintf(stderr, "%s: \"%s\" is gzip-compressed; please use --prepipe gunzip.\n",
+			MLR_GLOBALS.bargv0, file_name);
+		exit(1);
+#endif
+	}
+
+	if (num_read >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+		fprintf(stderr, "%s: \"%s\" is zstd-compressed; please use --prepipe 'zstd -dc'.\n",
+			MLR_GLOBALS.bargv0, file_name);
+		exit(1);
+	}
+
+	return fd;
+}
+
+FILE* file_decompressor_fopen(char* file_name) {
+	int fd = file_decompressor_open(file_name);
+	if (fd < 0)
+		return NULL;
+	FILE* fp = fdopen(fd, "r");
+	if (fp == NULL)
+		close(fd);
+	return fp;
+}
+
+int file_decompressor_is_gzipped(char* file_name) {
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0)
+		return FALSE;
+	unsigned char magic[3];
+	ssize_t num_read = pread(fd, magic, sizeof(magic), 0);
+	close(fd);
+	return is_gzip_magic(magic, num_read);
+}
+
+static int is_gzip_magic(unsigned char* magic, ssize_t num_read) {
+	return num_read >= 3 && magic[0] == 0x1f && magic[1] == 0x8b && magic[2] == 0x08;
+}
+
+#if MLR_ARCH_DECOMPRESSION_ENABLED
+// ----------------------------------------------------------------
+// The thread is detached: it exits once the input is all decompressed, or
+// once the reader closes its end of the pipe.
+static int start_gunzip(char* file_name, int in_fd) {
+	int pipe_fds[2];
+	if (pipe(pipe_fds) < 0) {
+		perror("pipe");
+		exit(1);
+	}
+
+	gunzip_state_t* pstate = mlr_malloc_or_die(sizeof(gunzip_state_t));
+	pstate->file_name = mlr_strdup_or_die(file_name);
+	pstate->in_fd     = in_fd;
+	pstate->out_fd    = pipe_fds[1];
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_t thread;
+	int rc = pthread_create(&thread, &attr, gunzip_thread, pstate);
+	pthread_attr_destroy(&attr);
+	if (rc != 0) {
+		fprintf(stderr, "%s: could not start decompression of \"%s\": %s.\n",
+			MLR_GLOBALS.bargv0, file_name, strerror(rc));
+		exit(1);
+	}
+	return pipe_fds[0];
+}
+
+static void* gunzip_thread(void* pvstate) {
+	gunzip_state_t* pstate = pvstate;
+
+	// If the reader stops early, as with head, writes should fail with EPIPE
+	// here rather than killing the process.
+	sigset_t sigset;
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+	unsigned char* inbuf  = mlr_malloc_or_die(FILE_DECOMPRESSOR_BUFFER_SIZE);
+	unsigned char* outbuf = mlr_malloc_or_die(FILE_DECOMPRESSOR_BUFFER_SIZE);
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	// 16 for the gzip wrapper
+	if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK)
+		gunzip_error(pstate, "could not initialize zlib");
+
+	int at_member_end = FALSE; // Between gzip members, or after the last
+	while (TRUE) {
+		if (zs.avail_in == 0) {
+			ssize_t num_read = read(pstate->in_fd, inbuf, FILE_DECOMPRESSOR_BUFFER_SIZE);
+			if (num_read < 0) {
+				if (errno == EINTR)
+					continue;
+				gunzip_error(pstate, strerror(errno));
+			}
+			if (num_read == 0) {
+				if (!at_member_end)
+					gunzip_error(pstate, "unexpected end of compressed data");
+				break;
+			}
+			zs.next_in  = inbuf;
+			zs.avail_in = num_read;
+		}
+
+		zs.next_out  = outbuf;
+		zs.avail_out = FILE_DECOMPRESSOR_BUFFER_SIZE;
+		int rc = inflate(&zs, Z_NO_FLUSH);
+		if (rc == Z_DATA_ERROR && at_member_end)
+			break; // Trailing non-gzip data, such as tar padding: ignored, as by gunzip.
+		if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR)
+			gunzip_error(pstate, zs.msg != NULL ? zs.msg : "corrupt compressed data");
+
+		if (!write_fully(pstate->out_fd, (char*)outbuf, FILE_DECOMPRESSOR_BUFFER_SIZE - zs.avail_out))
+			break; // The reader is done
+
+		if (rc == Z_STREAM_END) {
+			inflateReset(&zs);
+			at_member_end = TRUE;
+		} else if (rc == Z_OK) {
+			at_member_end = FALSE;
+		}
+	}
+
+	inflateEnd(&zs);
+	free(inbuf);
+	free(outbuf);
+	close(pstate->in_fd);
+	close(pstate->out_fd);
+	free(pstate->file_name);
+	free(pstate);
+	return NULL;
+}
+
+// Returns FALSE if the reader has closed the pipe.
+static int write_fully(int fd, char* buf, size_t length) {
+	while (length > 0) {
+		ssize_t num_written = write(fd, buf, length);
+		if (num_written < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EPIPE)
+				return FALSE;
+			perror("write");
+			exit(1);
+		}
+		buf += num_written;
+		length -= num_written;
+	}
+	return TRUE;
+}
+
+static void gunzip_error(gunzip_state_t* pstate, char* message) {
+	fprintf(stderr, "%s: could not decompress \"%s\": %s.\n", MLR_GLOBALS.bargv0, pstate->file_name, message);
+	exit(1);
+}
+#endif
@@ -0,0 +1,34 @@
+// ================================================================
+// Native decompression of input files, so that compressed files can be read
+// without --prepipe.
+//
+// Files are recognized by their magic numbers, not their names. A gzip file is
+// decompressed with zlib in a background thread, which writes to a pipe; the
+// opener gets the read end of the pipe. So the lrec readers need no changes:
+// the mmap readers read it in blocks as they do any other unmappable input,
+// and the stdio readers read it as a stream. Decompression then runs alongside
+// parsing, with no shell or gunzip process. Concatenated gzip members, as
+// from "cat a.gz b.gz" or from parallel compressors, are decompressed in turn.
+//
+// There is no zstd support in this build; zstd files are rejected with a
+// pointer to --prepipe rather than parsed as text.
+// ================================================================
+
+#ifndef FILE_DECOMPRESSOR_H
+#define FILE_DECOMPRESSOR_H
+
+#include <stdio.h>
+
+// As open(2) with O_RDONLY, returning -1 with errno set if the file can't be
+// opened. For compressed files the descriptor is for the decompressed data.
+int file_decompressor_open(char* file_name);
+
+// As fopen(3) with "r", likewise.
+FILE* file_decompressor_fopen(char* file_name);
+
+// TRUE if the file is gzip-compressed, so that it'd be read from a pipe. The
+// mmap readers for formats other than DKVP and NIDX would then read the whole
+// decompressed input into memory, so the caller uses the stdio readers instead.
+int file_decompressor_is_gzipped(char* file_name);
+
+#endif // FILE_DECOMPRESSOR_H
@@ -8,6 +8,7 @@
 #include "lib/mlrescape.h"
 #include "lib/mlr_globals.h"
 #include "file_ingestor_stdio.h"
+#include "file_decompressor.h"
 
 // ----------------------------------------------------------------
 void* file_ingestor_stdio_vopen(void* pvstate, char* prepipe, char* filename) {
@@ -22,7 +23,11 @@ void* file_ingestor_stdio_vopen(void* pvstate, char* prepipe, char* filename) {
 				exit(1);
 			}
 		} else {
-			file_contents_buffer = read_file_into_memory(filename, &file_size);
+			FILE* input_stream = file_decompressor_fopen(filename);
+			if (input_stream != NULL) {
+				file_contents_buffer = read_fp_into_memory(input_stream, &file_size);
+				fclose(input_stream);
+			}
 			if (file_contents_buffer == NULL) {
 				fprintf(stderr, "%s: Couldn't open \"%s\" for read.\n", MLR_GLOBALS.bargv0, filename);
 				exit(1);
@@ -1,30 +1,131 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include "lib/mlr_arch.h"
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
 #include "file_reader_mmap.h"
+#include "file_reader_stdio.h"
+#include "file_decompressor.h"
 
 #if MLR_ARCH_MMAP_ENABLED
 static char empty_buf[1] = { 0 };
 #endif
 
 // ----------------------------------------------------------------
-file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name) {
+typedef struct _file_reader_mmap_window_t {
+	file_reader_mmap_windows_t* pwindows;
+	int index;
+	int hold_count; // How many records point into the window
+} file_reader_mmap_window_t;
+
+// Records may be freed on other threads than the reader's, e.g. by stats1 -j
+// workers, so the hold counts and the windows' state are kept under the mutex.
+struct _file_reader_mmap_windows_t {
+	pthread_mutex_t mutex;
+	char*  base;
+	size_t length;        // Of the file, and of the mapping
+	size_t window_size;   // A multiple of the page size
+	int    num_windows;
+	file_reader_mmap_window_t* windows;
+	int    num_passed;    // The reader has moved past the windows before this one
+	int    num_released;
+	int    is_closed;
+};
+
+// For the occasional record straddling windows: which ones it points into.
+// Records within one window point to just that window.
+typedef struct _file_reader_mmap_hold_t {
+	file_reader_mmap_window_t* pfirst;
+	file_reader_mmap_window_t* plast;
+} file_reader_mmap_hold_t;
+
+// ----------------------------------------------------------------
+typedef struct _file_reader_mmap_block_t {
+	file_reader_mmap_blocks_t* pblocks;
+	char*  data;
+	size_t capacity;   // Not counting room for a null terminator
+	size_t length;     // How much has been read into it
+	int    hold_count; // How many records point into the block
+} file_reader_mmap_block_t;
+
+// As for the windows, the blocks' hold counts and state are kept under the mutex.
+struct _file_reader_mmap_blocks_t {
+	pthread_mutex_t mutex;
+	FILE*  input_stream; // From file_reader_stdio_vopen, or NULL if the fd was opened here
+	char*  prepipe;
+	int    fd;
+	char*  irs;          // NULL to read the whole input into one block
+	int    irslen;
+	int    skip_quoted;  // For CSV: line ends within double quotes don't count
+	int    at_eof;
+	int    is_closed;
+	int    num_blocks;   // Allocated and not yet freed
+	file_reader_mmap_block_t* pcurrent; // Being read into
+	file_reader_mmap_block_t* pspare;   // Let go, and kept for reuse
+};
+
+static long long window_size = FILE_READER_MMAP_DEFAULT_WINDOW_SIZE;
+
 #if MLR_ARCH_MMAP_ENABLED
-	// popen is a stdio construct, not an mmap construct, and it can't be supported here.
-	if (prepipe != NULL) {
-		fprintf(stderr, "%s: coding error detected in file %s at line %d.\n",
-			MLR_GLOBALS.bargv0, __FILE__, __LINE__);
-		exit(1);
-	}
+static file_reader_mmap_windows_t* windows_alloc(char* base, size_t length);
+static void windows_pass(file_reader_mmap_windows_t* pwindows, int num_passed);
+static inline size_t window_offset(file_reader_mmap_windows_t* pwindows, int i);
+static inline size_t window_length(file_reader_mmap_windows_t* pwindows, int i);
+static void windows_release(file_reader_mmap_windows_t* pwindows, int i);
+static int  windows_are_done(file_reader_mmap_windows_t* pwindows);
+static void windows_free(file_reader_mmap_windows_t* pwindows);
+#endif
+static void file_reader_mmap_free_window_hold(lrec_t* prec);
+static void file_reader_mmap_free_multi_window_hold(lrec_t* prec);
+
+static file_reader_mmap_state_t* file_reader_mmap_open_blocked(char* prepipe, char* file_name, char* irs,
+	int skip_quoted);
+static void blocks_open(file_reader_mmap_state_t* pstate, FILE* input_stream, char* prepipe, char* irs,
+	int skip_quoted);
+static void blocks_close(file_reader_mmap_blocks_t* pblocks);
+static file_reader_mmap_block_t* blocks_get_block(file_reader_mmap_blocks_t* pblocks, size_t capacity);
+static int  blocks_retire(file_reader_mmap_blocks_t* pblocks, file_reader_mmap_block_t* pblock);
+static void blocks_free(file_reader_mmap_blocks_t* pblocks);
+static char* blocks_find_last_line_end(file_reader_mmap_blocks_t* pblocks, char* p, char* e);
+static char* blocks_find_last_unquoted_line_end(file_reader_mmap_blocks_t* pblocks, char** pquote_scanned,
+	int* pin_quotes, char* unsearched, char* e);
+static void file_reader_mmap_free_block_hold(lrec_t* prec);
+
+// ----------------------------------------------------------------
+file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name) {
+	return file_reader_mmap_open_blocked(prepipe, file_name, NULL, FALSE);
+}
 
+file_reader_mmap_state_t* file_reader_mmap_open_lines(char* prepipe, char* file_name, char* irs) {
+	return file_reader_mmap_open_blocked(prepipe, file_name, irs, FALSE);
+}
+
+file_reader_mmap_state_t* file_reader_mmap_open_csv_lines(char* prepipe, char* file_name, char* irs) {
+	return file_reader_mmap_open_blocked(prepipe, file_name, irs, TRUE);
+}
+
+static file_reader_mmap_state_t* file_reader_mmap_open_blocked(char* prepipe, char* file_name, char* irs,
+	int skip_quoted)
+{
 	file_reader_mmap_state_t* pstate = mlr_malloc_or_die(sizeof(file_reader_mmap_state_t));
-	pstate->fd = open(file_name, O_RDONLY);
+	pstate->pwindows = NULL;
+	pstate->pblocks  = NULL;
+
+	// popen is a stdio construct, not an mmap construct: read its output in blocks.
+	if (prepipe != NULL || streq(file_name, "-")) {
+		FILE* input_stream = file_reader_stdio_vopen(NULL, prepipe, file_name);
+		pstate->fd = fileno(input_stream);
+		blocks_open(pstate, input_stream, prepipe, irs, skip_quoted);
+		return pstate;
+	}
+
+	pstate->fd = file_decompressor_open(file_name);
 	if (pstate->fd < 0) {
 		perror("open");
 		fprintf(stderr, "%s: could not open \"%s\"\n", MLR_GLOBALS.bargv0, file_name);
@@ -36,6 +137,13 @@ file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name)
 		fprintf(stderr, "%s: could not fstat \"%s\"\n", MLR_GLOBALS.bargv0, file_name);
 		exit(1);
 	}
+	// E.g. FIFOs, /dev/stdin, or decompressed data; see file_decompressor.h.
+	if (!S_ISREG(stat.st_mode)) {
+		blocks_open(pstate, NULL, NULL, irs, skip_quoted);
+		return pstate;
+	}
+
+#if MLR_ARCH_MMAP_ENABLED
 	if (stat.st_size == 0) {
 		// mmap doesn't allow us to map zero-length files but zero-length files do exist.
 		pstate->sol = &empty_buf[0];
@@ -48,6 +156,8 @@ file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name)
 		}
 	}
 	pstate->eof = pstate->sol + stat.st_size;
+	if (stat.st_size != 0)
+		pstate->pwindows = windows_alloc(pstate->sol, (size_t)stat.st_size);
 	// POSIX semantics: the mmap itself increments a reference count to the file, in addition to the
 	// open.  We close the file but keep the mmap reference until a subsequent munmap.
 	if (close(pstate->fd) < 0) {
@@ -56,20 +166,34 @@ file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name)
 	}
 	return pstate;
 #else
-	fprintf(stderr, "%s: mmap is unsupported on this architecture.\n", MLR_GLOBALS.bargv0);
-	exit(1);
-	return NULL;
+	blocks_open(pstate, NULL, NULL, irs, skip_quoted);
+	return pstate;
 #endif
 }
 
 // ----------------------------------------------------------------
-// Here we intentionally do not munmap.
+// Here we do not munmap outright.
 //
 // This method is used by various lrec readers, where lrecs are instantiated with keys/values
 // pointing into mmapped file-contents buffers.  This is done for the sake of performance, to reduce
 // data-copies. But it also means we can't unmap files after ingesting lrecs, since the lrecs in
 // question might be retained after the input-file closes.  Example: mlr sort on multiple files.
+// So only the windows no records hold are unmapped now; the rest go as their records are freed.
 void file_reader_mmap_close(file_reader_mmap_state_t* pstate, char* prepipe) {
+	if (pstate->pblocks != NULL)
+		blocks_close(pstate->pblocks);
+#if MLR_ARCH_MMAP_ENABLED
+	file_reader_mmap_windows_t* pwindows = pstate->pwindows;
+	if (pwindows != NULL) {
+		pthread_mutex_lock(&pwindows->mutex);
+		windows_pass(pwindows, pwindows->num_windows);
+		pwindows->is_closed = TRUE;
+		int done = windows_are_done(pwindows);
+		pthread_mutex_unlock(&pwindows->mutex);
+		if (done)
+			windows_free(pwindows);
+	}
+#endif
 	free(pstate);
 }
 
@@ -82,3 +206,404 @@ void* file_reader_mmap_vopen(void* pvstate, char* prepipe, char* file_name) {
 void file_reader_mmap_vclose(void* pvstate, void* pvhandle, char* prepipe) {
 	file_reader_mmap_close(pvhandle, prepipe);
 }
+
+// ----------------------------------------------------------------
+void file_reader_mmap_set_window_size(long long new_window_size) {
+	window_size = new_window_size;
+}
+
+// ----------------------------------------------------------------
+lrec_t* file_reader_mmap_hold(file_reader_mmap_state_t* pstate, char* start, lrec_t* prec) {
+	if (prec == NULL)
+		return prec;
+
+	// Records are never split across blocks, so they're all in the current one.
+	if (pstate->pblocks != NULL) {
+		file_reader_mmap_block_t* pblock = pstate->pblocks->pcurrent;
+		pthread_mutex_lock(&pstate->pblocks->mutex);
+		pblock->hold_count++;
+		pthread_mutex_unlock(&pstate->pblocks->mutex);
+		prec->pvbacking = pblock;
+		prec->pfree_backing_func = file_reader_mmap_free_block_hold;
+		return prec;
+	}
+
+#if MLR_ARCH_MMAP_ENABLED
+	file_reader_mmap_windows_t* pwindows = pstate->pwindows;
+	if (pwindows == NULL)
+		return prec;
+
+	int first = (start - pwindows->base) / pwindows->window_size;
+	int last = (pstate->sol - 1 - pwindows->base) / pwindows->window_size;
+	if (last >= pwindows->num_windows)
+		last = pwindows->num_windows - 1;
+	if (last < first)
+		last = first;
+	pthread_mutex_lock(&pwindows->mutex);
+	for (int i = first; i <= last; i++)
+		pwindows->windows[i].hold_count++;
+	// The next record starts in the reader's current window, so only the ones
+	// before that are done with.
+	windows_pass(pwindows, (pstate->sol - pwindows->base) / pwindows->window_size);
+	pthread_mutex_unlock(&pwindows->mutex);
+
+	if (first == last) {
+		prec->pvbacking = &pwindows->windows[first];
+		prec->pfree_backing_func = file_reader_mmap_free_window_hold;
+	} else {
+		file_reader_mmap_hold_t* phold = mlr_malloc_or_die(sizeof(file_reader_mmap_hold_t));
+		phold->pfirst = &pwindows->windows[first];
+		phold->plast  = &pwindows->windows[last];
+		prec->pvbacking = phold;
+		prec->pfree_backing_func = file_reader_mmap_free_multi_window_hold;
+	}
+#endif
+	return prec;
+}
+
+void file_reader_mmap_hold_all(file_reader_mmap_state_t* pstate) {
+	if (pstate->pblocks != NULL) {
+		pthread_mutex_lock(&pstate->pblocks->mutex);
+		pstate->pblocks->pcurrent->hold_count++;
+		pthread_mutex_unlock(&pstate->pblocks->mutex);
+		return;
+	}
+	file_reader_mmap_windows_t* pwindows = pstate->pwindows;
+	if (pwindows == NULL)
+		return;
+	pthread_mutex_lock(&pwindows->mutex);
+	for (int i = 0; i < pwindows->num_windows; i++)
+		pwindows->windows[i].hold_count++;
+	pthread_mutex_unlock(&pwindows->mutex);
+}
+
+#if MLR_ARCH_MMAP_ENABLED
+// Lets go of the windows from pfirst through plast; frees the windows if that
+// was the last hold on them after the reader closed.
+static void windows_let_go(file_reader_mmap_window_t* pfirst, file_reader_mmap_window_t* plast) {
+	file_reader_mmap_windows_t* pwindows = pfirst->pwindows;
+	int done = FALSE;
+	pthread_mutex_lock(&pwindows->mutex);
+	for (file_reader_mmap_window_t* pwindow = pfirst; pwindow <= plast; pwindow++) {
+		if (--pwindow->hold_count == 0 && pwindow->index < pwindows->num_passed) {
+			windows_release(pwindows, pwindow->index);
+			done = windows_are_done(pwindows);
+		}
+	}
+	pthread_mutex_unlock(&pwindows->mutex);
+	if (done)
+		windows_free(pwindows);
+}
+#endif
+
+static void file_reader_mmap_free_window_hold(lrec_t* prec) {
+#if MLR_ARCH_MMAP_ENABLED
+	windows_let_go(prec->pvbacking, prec->pvbacking);
+#endif
+}
+
+static void file_reader_mmap_free_multi_window_hold(lrec_t* prec) {
+#if MLR_ARCH_MMAP_ENABLED
+	file_reader_mmap_hold_t* phold = prec->pvbacking;
+	windows_let_go(phold->pfirst, phold->plast);
+	free(phold);
+#endif
+}
+
+#if MLR_ARCH_MMAP_ENABLED
+// ----------------------------------------------------------------
+static file_reader_mmap_windows_t* windows_alloc(char* base, size_t length) {
+	file_reader_mmap_windows_t* pwindows = mlr_malloc_or_die(sizeof(file_reader_mmap_windows_t));
+	pwindows->base         = base;
+	pwindows->length       = length;
+	// Unmapping is by whole pages.
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t size = window_size < (long long)page_size ? page_size : (size_t)window_size;
+	pwindows->window_size  = ((size + page_size - 1) / page_size) * page_size;
+	pwindows->num_windows  = (length + pwindows->window_size - 1) / pwindows->window_size;
+	pwindows->windows      = mlr_malloc_or_die(pwindows->num_windows * sizeof(file_reader_mmap_window_t));
+	for (int i = 0; i < pwindows->num_windows; i++) {
+		pwindows->windows[i].pwindows   = pwindows;
+		pwindows->windows[i].index      = i;
+		pwindows->windows[i].hold_count = 0;
+	}
+	pwindows->num_passed   = 0;
+	pwindows->num_released = 0;
+	pwindows->is_closed    = FALSE;
+	pthread_mutex_init(&pwindows->mutex, NULL);
+#ifdef MADV_SEQUENTIAL
+	madvise(base, length, MADV_SEQUENTIAL);
+#endif
+	return pwindows;
+}
+
+// Marks the windows before the given one as passed by the reader, unmapping
+// those which no records hold, and reads ahead the next window. The caller
+// holds the mutex.
+static void windows_pass(file_reader_mmap_windows_t* pwindows, int num_passed) {
+	if (num_passed > pwindows->num_windows)
+		num_passed = pwindows->num_windows;
+	if (num_passed <= pwindows->num_passed)
+		return;
+	for (int i = pwindows->num_passed; i < num_passed; i++) {
+		if (pwindows->windows[i].hold_count == 0)
+			windows_release(pwindows, i);
+	}
+	pwindows->num_passed = num_passed;
+#ifdef MADV_WILLNEED
+	if (num_passed + 1 < pwindows->num_windows)
+		madvise(pwindows->base + window_offset(pwindows, num_passed + 1),
+			window_length(pwindows, num_passed + 1), MADV_WILLNEED);
+#endif
+}
+
+static inline size_t window_offset(file_reader_mmap_windows_t* pwindows, int i) {
+	return (size_t)i * pwindows->window_size;
+}
+
+// The last window may be partial.
+static inline size_t window_length(file_reader_mmap_windows_t* pwindows, int i) {
+	size_t length = pwindows->length - window_offset(pwindows, i);
+	return length < pwindows->window_size ? length : pwindows->window_size;
+}
+
+static void windows_release(file_reader_mmap_windows_t* pwindows, int i) {
+	munmap(pwindows->base + window_offset(pwindows, i), window_length(pwindows, i));
+	pwindows->num_released++;
+}
+
+// Once the reader has closed and all the windows are released, nothing else
+// refers to the windows, so they're freed after the mutex is let go.
+static int windows_are_done(file_reader_mmap_windows_t* pwindows) {
+	return pwindows->is_closed && pwindows->num_released == pwindows->num_windows;
+}
+
+static void windows_free(file_reader_mmap_windows_t* pwindows) {
+	pthread_mutex_destroy(&pwindows->mutex);
+	free(pwindows->windows);
+	free(pwindows);
+}
+#endif
+
+// ----------------------------------------------------------------
+static void blocks_open(file_reader_mmap_state_t* pstate, FILE* input_stream, char* prepipe, char* irs,
+	int skip_quoted)
+{
+	file_reader_mmap_blocks_t* pblocks = mlr_malloc_or_die(sizeof(file_reader_mmap_blocks_t));
+	pblocks->input_stream = input_stream;
+	pblocks->prepipe      = prepipe;
+	pblocks->fd           = pstate->fd;
+	pblocks->irs          = irs;
+	pblocks->irslen       = (irs == NULL) ? 0 : strlen(irs);
+	pblocks->skip_quoted  = skip_quoted;
+	pblocks->at_eof       = FALSE;
+	pblocks->is_closed    = FALSE;
+	pblocks->num_blocks   = 0;
+	pblocks->pspare       = NULL;
+	pthread_mutex_init(&pblocks->mutex, NULL);
+	pblocks->pcurrent     = blocks_get_block(pblocks, FILE_READER_MMAP_BLOCK_SIZE);
+
+	pstate->pblocks = pblocks;
+	pstate->sol = pstate->eof = pblocks->pcurrent->data;
+	file_reader_mmap_refill(pstate);
+}
+
+static void blocks_close(file_reader_mmap_blocks_t* pblocks) {
+	if (pblocks->input_stream != NULL) {
+		file_reader_stdio_vclose(NULL, pblocks->input_stream, pblocks->prepipe);
+	} else if (close(pblocks->fd) < 0) {
+		perror("close");
+		exit(1);
+	}
+
+	pthread_mutex_lock(&pblocks->mutex);
+	pblocks->is_closed = TRUE;
+	file_reader_mmap_block_t* pcurrent = pblocks->pcurrent;
+	pblocks->pcurrent = NULL;
+	int done = FALSE;
+	if (pblocks->pspare != NULL) {
+		file_reader_mmap_block_t* pspare = pblocks->pspare;
+		pblocks->pspare = NULL;
+		done = blocks_retire(pblocks, pspare);
+	}
+	// The blocks are freed along with the last of them.
+	if (pcurrent->hold_count == 0)
+		done = blocks_retire(pblocks, pcurrent);
+	pthread_mutex_unlock(&pblocks->mutex);
+	if (done)
+		blocks_free(pblocks);
+}
+
+// ----------------------------------------------------------------
+int file_reader_mmap_refill(file_reader_mmap_state_t* pstate) {
+	file_reader_mmap_blocks_t* pblocks = pstate->pblocks;
+	if (pblocks == NULL)
+		return FALSE;
+
+	file_reader_mmap_block_t* pblock = pblocks->pcurrent;
+	char* from = pstate->eof; // Start of what's not yet been parsed
+	char* unsearched = from;  // No line ends between from and here
+	// For CSV: from is at the start of a record, so outside quotes; quotes are
+	// counted from there up to quote_scanned.
+	char* quote_scanned = from;
+	int   in_quotes = FALSE;
+	while (TRUE) {
+		char* end = pblock->data + pblock->length;
+		char* line_end = pblocks->skip_quoted
+			? blocks_find_last_unquoted_line_end(pblocks, &quote_scanned, &in_quotes, unsearched, end)
+			: blocks_find_last_line_end(pblocks, unsearched, end);
+		if (line_end != NULL) {
+			pstate->sol = from;
+			pstate->eof = line_end;
+			return TRUE;
+		}
+		if (pblocks->at_eof) {
+			// The last line, if any, without a line ending
+			pstate->sol = from;
+			pstate->eof = end;
+			return end > from;
+		}
+		if (pblocks->irslen > 0 && end - unsearched >= pblocks->irslen)
+			unsearched = end - (pblocks->irslen - 1);
+
+		// Start a new block with the partial line at the end of this one. Lines
+		// longer than a block get a bigger one, as does the whole input when
+		// reading it into one block.
+		if (pblock->length == pblock->capacity) {
+			size_t partial_length = end - from;
+			size_t capacity = FILE_READER_MMAP_BLOCK_SIZE;
+			while (capacity < 2 * partial_length)
+				capacity *= 2;
+			pthread_mutex_lock(&pblocks->mutex);
+			file_reader_mmap_block_t* pnext = blocks_get_block(pblocks, capacity);
+			pblocks->pcurrent = pnext;
+			pthread_mutex_unlock(&pblocks->mutex);
+			memcpy(pnext->data, from, partial_length);
+			pnext->length = partial_length;
+			pnext->data[partial_length] = 0;
+			unsearched = pnext->data + (unsearched - from);
+			quote_scanned = pnext->data + (quote_scanned - from);
+			from = pnext->data;
+			pthread_mutex_lock(&pblocks->mutex);
+			if (pblock->hold_count == 0)
+				blocks_retire(pblocks, pblock); // The reader is open, so the blocks aren't done
+			pthread_mutex_unlock(&pblocks->mutex);
+			pblock = pnext;
+		}
+
+		// Take what's available, rather than waiting to fill the block, so that
+		// records from a slow pipe are processed as they arrive.
+		ssize_t num_read = read(pblocks->fd, pblock->data + pblock->length, pblock->capacity - pblock->length);
+		if (num_read < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("read");
+			fprintf(stderr, "%s: read error on input.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+		} else if (num_read == 0) {
+			pblocks->at_eof = TRUE;
+		} else {
+			pblock->length += num_read;
+			pblock->data[pblock->length] = 0;
+		}
+	}
+}
+
+// Returns a pointer just past the last irs in [p, e), or NULL if there is none.
+static char* blocks_find_last_line_end(file_reader_mmap_blocks_t* pblocks, char* p, char* e) {
+	int irslen = pblocks->irslen;
+	if (irslen == 0)
+		return NULL;
+	char* irs = pblocks->irs;
+	if (irslen == 1) {
+		char irs0 = irs[0];
+		for (char* q = e - 1; q >= p; q--)
+			if (*q == irs0)
+				return q + 1;
+	} else {
+		for (char* q = e - irslen; q >= p; q--)
+			if (memcmp(q, irs, irslen) == 0)
+				return q + irslen;
+	}
+	return NULL;
+}
+
+// As blocks_find_last_line_end, but only counting line ends outside double
+// quotes. Each double quote opens or closes quoting -- a doubled one inside
+// quotes does both -- so this agrees with the CSV reader on well-formed input;
+// on malformed quoting the reader reports the unmatched quote. The quote scan
+// resumes from *pquote_scanned with *pin_quotes, and both are updated.
+static char* blocks_find_last_unquoted_line_end(file_reader_mmap_blocks_t* pblocks, char** pquote_scanned,
+	int* pin_quotes, char* unsearched, char* e)
+{
+	char* line_end = NULL;
+	char* p = *pquote_scanned;
+	int in_quotes = *pin_quotes;
+	while (TRUE) {
+		char* q = memchr(p, '"', e - p);
+		if (!in_quotes) {
+			char* segment_end = blocks_find_last_line_end(pblocks, p > unsearched ? p : unsearched,
+				q == NULL ? e : q);
+			if (segment_end != NULL)
+				line_end = segment_end;
+		}
+		if (q == NULL)
+			break;
+		in_quotes = !in_quotes;
+		p = q + 1;
+	}
+	*pquote_scanned = p;
+	*pin_quotes = in_quotes;
+	return line_end;
+}
+
+// ----------------------------------------------------------------
+// The caller holds the mutex, except when opening.
+static file_reader_mmap_block_t* blocks_get_block(file_reader_mmap_blocks_t* pblocks, size_t capacity) {
+	file_reader_mmap_block_t* pblock = pblocks->pspare;
+	if (pblock != NULL && pblock->capacity >= capacity) {
+		pblocks->pspare = NULL;
+	} else {
+		pblock = mlr_malloc_or_die(sizeof(file_reader_mmap_block_t));
+		pblock->pblocks  = pblocks;
+		pblock->data     = mlr_malloc_or_die(capacity + 1);
+		pblock->capacity = capacity;
+		pblocks->num_blocks++;
+	}
+	pblock->length     = 0;
+	pblock->hold_count = 0;
+	pblock->data[0]    = 0;
+	return pblock;
+}
+
+// For blocks neither being read into nor held by any records: keeps one
+// ordinary-sized one for reuse while the input is open, and frees the rest.
+// The caller holds the mutex. Returns TRUE if that was the last block of a
+// closed reader, for the caller to free the blocks after letting go of it.
+static int blocks_retire(file_reader_mmap_blocks_t* pblocks, file_reader_mmap_block_t* pblock) {
+	if (!pblocks->is_closed && pblocks->pspare == NULL && pblock->capacity == FILE_READER_MMAP_BLOCK_SIZE) {
+		pblocks->pspare = pblock;
+		return FALSE;
+	}
+	free(pblock->data);
+	free(pblock);
+	pblocks->num_blocks--;
+	return pblocks->is_closed && pblocks->num_blocks == 0;
+}
+
+static void blocks_free(file_reader_mmap_blocks_t* pblocks) {
+	pthread_mutex_destroy(&pblocks->mutex);
+	free(pblocks);
+}
+
+static void file_reader_mmap_free_block_hold(lrec_t* prec) {
+	file_reader_mmap_block_t* pblock = prec->pvbacking;
+	file_reader_mmap_blocks_t* pblocks = pblock->pblocks;
+	int done = FALSE;
+	pthread_mutex_lock(&pblocks->mutex);
+	if (--pblock->hold_count == 0 && pblock != pblocks->pcurrent)
+		done = blocks_retire(pblocks, pblock);
+	pthread_mutex_unlock(&pblocks->mutex);
+	if (done)
+		blocks_free(pblocks);
+}
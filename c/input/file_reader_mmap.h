@@ -1,20 +1,90 @@
 // ================================================================
 // Abstraction layer for mmapped file-read logic.
+//
+// The lrec readers parse in place, poking null terminators into the mapping,
+// and the lrecs they return point into it. Since the mapping is private, every
+// page so touched becomes a private copy, and memory use would grow with file
+// size if the mapping were kept until the end. So the file is mapped once, as
+// one contiguous range so that records straddling window boundaries need no
+// special handling by the parsers, but it is accounted for in fixed-size
+// windows:
+//
+// * Each record holds the windows it points into, from the reader's position
+//   before parsing it to the position after. The mmap lrec readers call
+//   file_reader_mmap_hold on each record they return; when the record is
+//   freed, its windows are let go.
+//
+// * Once the reader has moved past a window and no records hold it, it is
+//   unmapped, returning its memory. Streaming over a file then takes memory
+//   for only a window or two, whatever the file size; retaining records (as
+//   with sort or tac) retains only their windows.
+//
+// * The mapping is advised for sequential access, and the window after the
+//   reader's is read ahead.
+//
+// Anything a reader keeps beyond a single record, such as CSV header fields,
+// must be copied out of the mapping.
+//
+// Input which can't be mapped -- standard input, prepipe output, FIFOs -- is
+// instead read into large blocks, over which the same parsers run. Readers
+// whose records are single lines open with file_reader_mmap_open_lines: each
+// time the reader reaches the end of what's been read, file_reader_mmap_refill
+// reads more and ends the parseable range after the last full line, so no
+// record is split across blocks. The CSV reader, whose records may have line
+// ends within double quotes, opens with file_reader_mmap_open_csv_lines, which
+// only counts line ends outside them. Records hold their block, as above for
+// windows; blocks are reused once let go. For other readers the whole input
+// is read into one block on open.
 // ================================================================
 
 #ifndef FILE_READER_MMAP_H
 #define FILE_READER_MMAP_H
 
+#include "containers/lrec.h"
+
+// Allow compile-time override, e.g using gcc -D.
+#ifndef FILE_READER_MMAP_DEFAULT_WINDOW_SIZE
+#define FILE_READER_MMAP_DEFAULT_WINDOW_SIZE (64LL*1024LL*1024LL)
+#endif
+#ifndef FILE_READER_MMAP_BLOCK_SIZE
+#define FILE_READER_MMAP_BLOCK_SIZE (1024*1024)
+#endif
+
+typedef struct _file_reader_mmap_windows_t file_reader_mmap_windows_t;
+typedef struct _file_reader_mmap_blocks_t file_reader_mmap_blocks_t;
+
 typedef struct _file_reader_mmap_state_t {
 	char* sol;
 	char* eof;
 	int   fd;
+	file_reader_mmap_windows_t* pwindows; // NULL for empty files
+	file_reader_mmap_blocks_t*  pblocks;  // Non-null for input read in blocks
 } file_reader_mmap_state_t;
 
 file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name);
+// Input not mapped is read in blocks ending with a full line, per the irs.
+file_reader_mmap_state_t* file_reader_mmap_open_lines(char* prepipe, char* file_name, char* irs);
+// As above, but line ends within double-quoted CSV fields don't end a block.
+file_reader_mmap_state_t* file_reader_mmap_open_csv_lines(char* prepipe, char* file_name, char* irs);
 void file_reader_mmap_close(file_reader_mmap_state_t* pstate, char* prepipe);
 
 void* file_reader_mmap_vopen(void* pvstate, char* prepipe, char* file_name);
 void file_reader_mmap_vclose(void* pvstate, void* pvhandle, char* prepipe);
 
+// Rounded up to a multiple of the page size. Applies to files opened afterward.
+void file_reader_mmap_set_window_size(long long window_size);
+
+// For readers which open by lines: called when sol has reached eof, reads more
+// input if there is any, and sets sol and eof to it. Returns FALSE at end of
+// input, and always for mapped files.
+int file_reader_mmap_refill(file_reader_mmap_state_t* pstate);
+
+// Makes the record (if non-null) hold the windows from start up to the
+// reader's current position. Returns the record.
+lrec_t* file_reader_mmap_hold(file_reader_mmap_state_t* pstate, char* start, lrec_t* prec);
+
+// For readers which don't return records one at a time from the file, such as
+// the JSON reader: keeps the whole file mapped.
+void file_reader_mmap_hold_all(file_reader_mmap_state_t* pstate);
+
 #endif // FILE_READER_MMAP_H
@@ -7,7 +7,9 @@
 #include "lib/mlrutil.h"
 #include "lib/mlrescape.h"
 #include "lib/mlr_globals.h"
+#include "lib/mlr_arch.h"
 #include "file_reader_stdio.h"
+#include "file_decompressor.h"
 
 // ----------------------------------------------------------------
 void* file_reader_stdio_vopen(void* pvstate, char* prepipe, char* filename) {
@@ -15,7 +17,7 @@ void* file_reader_stdio_vopen(void* pvstate, char* prepipe, char* filename) {
 
 	if (prepipe == NULL) {
 		if (!streq(filename, "-")) {
-			input_stream = fopen(filename, "r");
+			input_stream = file_decompressor_fopen(filename);
 			if (input_stream == NULL) {
 				fprintf(stderr, "%s: Couldn't open \"%s\" for read.\n", MLR_GLOBALS.bargv0, filename);
 				perror(filename);
@@ -29,7 +31,7 @@ void* file_reader_stdio_vopen(void* pvstate, char* prepipe, char* filename) {
 			sprintf(command, "%s", prepipe);
 		else
 			sprintf(command, "%s < %s", prepipe, escaped_filename);
-		input_stream = popen(command, "r");
+		input_stream = mlr_arch_popen_for_read(command);
 		if (input_stream == NULL) {
 			fprintf(stderr, "%s: Couldn't popen \"%s\" for read.\n", MLR_GLOBALS.bargv0, command);
 			perror(command);
@@ -48,6 +50,6 @@ void file_reader_stdio_vclose(void* pvstate, void* pvhandle, char* prepipe) {
 		if (input_stream != stdin)
 			fclose(input_stream);
 	} else {
-		pclose(input_stream);
+		mlr_arch_pclose_for_read(input_stream);
 	}
 }
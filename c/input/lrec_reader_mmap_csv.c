@@ -9,11 +9,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
 #include "lib/string_builder.h"
+#include "lib/byte_scan.h"
 #include "input/file_reader_mmap.h"
 #include "input/lrec_readers.h"
 #include "input/peek_file_reader.h"
@@ -77,8 +79,16 @@ typedef struct _lrec_reader_mmap_csv_state_t {
 	header_keeper_t*    pheader_keeper;
 	lhmslv_t*           pheader_keepers;
 
+	// Fields the verb chain won't look at aren't put into records. The flags
+	// say which of the current header's fields are, if pused_field_names is
+	// non-null; they're redone on header change.
+	hss_t*              pused_field_names;
+	header_keeper_t*    pused_fields_header_keeper;
+	char*               used_fields;
+
 } lrec_reader_mmap_csv_state_t;
 
+static void*   lrec_reader_mmap_csv_open(void* pvstate, char* prepipe, char* filename);
 static void    lrec_reader_mmap_csv_free(lrec_reader_t* preader);
 static void    lrec_reader_mmap_csv_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, context_t* pctx);
@@ -86,10 +96,11 @@ static int     lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pst
 	rslls_t* pfields, file_reader_mmap_state_t* phandle, context_t* pctx);
 static lrec_t* paste_indices_and_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx);
 static lrec_t* paste_header_and_data(lrec_reader_mmap_csv_state_t* pstate, rslls_t* pdata_fields, context_t* pctx);
+static void    set_used_fields(lrec_reader_mmap_csv_state_t* pstate);
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit_header,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -144,9 +155,12 @@ lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit
 	pstate->use_implicit_header       = use_implicit_header;
 	pstate->pheader_keeper            = NULL;
 	pstate->pheader_keepers           = lhmslv_alloc();
+	pstate->pused_field_names          = pused_field_names;
+	pstate->pused_fields_header_keeper = NULL;
+	pstate->used_fields                = NULL;
 
 	plrec_reader->pvstate       = (void*)pstate;
-	plrec_reader->popen_func    = file_reader_mmap_vopen;
+	plrec_reader->popen_func    = lrec_reader_mmap_csv_open;
 	plrec_reader->pclose_func   = file_reader_mmap_vclose;
 	plrec_reader->pprocess_func = lrec_reader_mmap_csv_process;
 	plrec_reader->psof_func     = lrec_reader_mmap_csv_sof;
@@ -155,6 +169,14 @@ lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit
 	return plrec_reader;
 }
 
+// ----------------------------------------------------------------
+// Input which can't be mapped is read in blocks of whole records: line ends
+// within double quotes don't end a block.
+static void* lrec_reader_mmap_csv_open(void* pvstate, char* prepipe, char* filename) {
+	lrec_reader_mmap_csv_state_t* pstate = pvstate;
+	return file_reader_mmap_open_csv_lines(prepipe, filename, pstate->irs);
+}
+
 // ----------------------------------------------------------------
 static void lrec_reader_mmap_csv_free(lrec_reader_t* preader) {
 	lrec_reader_mmap_csv_state_t* pstate = preader->pvstate;
@@ -163,6 +185,7 @@ static void lrec_reader_mmap_csv_free(lrec_reader_t* preader) {
 		header_keeper_free(pheader_keeper);
 	}
 	lhmslv_free(pstate->pheader_keepers);
+	free(pstate->used_fields);
 	parse_trie_free(pstate->pno_dquote_parse_trie);
 	parse_trie_free(pstate->pdquote_parse_trie);
 	rslls_free(pstate->pfields);
@@ -198,6 +221,8 @@ static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, conte
 	// Ingest the next header line, if expected
 	if (pstate->expect_header_line_next) {
 		while (TRUE) {
+			if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+				return NULL;
 			if (!lrec_reader_mmap_csv_get_fields(pstate, pstate->pfields, phandle, pctx))
 				return NULL;
 			pstate->ilno++;
@@ -245,6 +270,11 @@ static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, conte
 
 			pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
 			if (pstate->pheader_keeper == NULL) {
+				// Copied, since header keepers outlive the part of the file
+				// they came from; see file_reader_mmap.h.
+				slls_t* pheader_fields_copy = slls_copy(pheader_fields);
+				slls_free(pheader_fields);
+				pheader_fields = pheader_fields_copy;
 				pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
 				lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
 					NO_FREE); // freed by header-keeper
@@ -259,6 +289,9 @@ static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, conte
 
 	// Ingest the next data line, if expected
 	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
 		int rc = lrec_reader_mmap_csv_get_fields(pstate, pstate->pfields, phandle, pctx);
 		pstate->ilno++;
 		if (rc == FALSE) // EOF
@@ -294,7 +327,7 @@ static lrec_t* lrec_reader_mmap_csv_process(void* pvstate, void* pvhandle, conte
 			? paste_indices_and_data(pstate, pstate->pfields, pctx)
 			: paste_header_and_data(pstate, pstate->pfields, pctx);
 		rslls_reset(pstate->pfields);
-		return prec;
+		return file_reader_mmap_hold(phandle, start, prec);
 	}
 }
 
@@ -310,6 +343,13 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 	char* p = phandle->sol;
 	char* e = p;
 
+	// Every token starts with one of these bytes, so between them there is no
+	// need to try the parse trie. The separators may be multi-character; the
+	// trie match at each candidate byte tells whether they're really there.
+	char ifs0 = pstate->ifs[0];
+	char irs0 = pstate->irs[0];
+	char dquote0 = pstate->dquote[0];
+
 	// loop over fields in record
 	record_done = FALSE;
 	while (!record_done) {
@@ -320,6 +360,7 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 			field_done = FALSE;
 			while (!field_done) {
 				MLR_INTERNAL_CODING_ERROR_IF(e > phandle->eof);
+				e = byte_scan_3(e, phandle->eof, ifs0, irs0, dquote0);
 				rc = parse_trie_match(pstate->pno_dquote_parse_trie, e, phandle->eof, &stridx, &matchlen);
 				if (rc) {
 					switch(stridx) {
@@ -388,6 +429,15 @@ static int lrec_reader_mmap_csv_get_fields(lrec_reader_mmap_csv_state_t* pstate,
 			// we use the string-build logic to build up a dynamically allocated string. E.g.
 			// "ab""c" becomes ab"c.
 			while (!field_done) {
+				// All tokens within quotes start with a double quote.
+				if (e < phandle->eof && *e != dquote0) {
+					char* q = memchr(e, dquote0, phandle->eof - e);
+					if (q == NULL)
+						q = phandle->eof;
+					if (!contiguous)
+						sb_append_char_range(psb, e, q - 1);
+					e = q;
+				}
 				if (e >= phandle->eof) {
 					fprintf(stderr, "%s: unmatched double quote at line %lld.\n",
 						MLR_GLOBALS.bargv0, pstate->ilno);
@@ -480,13 +530,29 @@ static lrec_t* paste_header_and_data(lrec_reader_mmap_csv_state_t* pstate, rslls
 			pctx->filename, pstate->ilno);
 		exit(1);
 	}
+	if (pstate->pused_field_names != NULL && pstate->pused_fields_header_keeper != pstate->pheader_keeper)
+		set_used_fields(pstate);
+	char* used_fields = pstate->used_fields;
+
 	lrec_t* prec = lrec_unbacked_alloc();
 	sllse_t* ph  = pstate->pheader_keeper->pkeys->phead;
 	rsllse_t* pd = pdata_fields->phead;
-	for ( ; ph != NULL && pd != NULL; ph = ph->pnext, pd = pd->pnext) {
+	for (int i = 0; ph != NULL && pd != NULL; ph = ph->pnext, pd = pd->pnext, i++) {
+		if (used_fields != NULL && !used_fields[i])
+			continue; // The rslls frees the value if need be.
 		// Transfer pointer-free responsibility from the rslls to the lrec object
 		lrec_put_ext(prec, ph->value, pd->value, pd->free_flag, pd->quote_flag);
 		pd->free_flag = 0;
 	}
 	return prec;
 }
+
+static void set_used_fields(lrec_reader_mmap_csv_state_t* pstate) {
+	slls_t* pkeys = pstate->pheader_keeper->pkeys;
+	free(pstate->used_fields);
+	pstate->used_fields = mlr_malloc_or_die(pkeys->length);
+	int i = 0;
+	for (sllse_t* pe = pkeys->phead; pe != NULL; pe = pe->pnext, i++)
+		pstate->used_fields[i] = hss_has(pstate->pused_field_names, pe->value);
+	pstate->pused_fields_header_keeper = pstate->pheader_keeper;
+}
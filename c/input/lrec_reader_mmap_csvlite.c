@@ -180,6 +180,11 @@ static lrec_t* lrec_reader_mmap_csvlite_process_single_seps(void* pvstate, void*
 
 			pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
 			if (pstate->pheader_keeper == NULL) {
+				// Copied, since header keepers outlive the part of the file
+				// they came from; see file_reader_mmap.h.
+				slls_t* pheader_fields_copy = slls_copy(pheader_fields);
+				slls_free(pheader_fields);
+				pheader_fields = pheader_fields_copy;
 				pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
 				lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
 					NO_FREE); // freed by header-keeper
@@ -190,6 +195,7 @@ static lrec_t* lrec_reader_mmap_csvlite_process_single_seps(void* pvstate, void*
 		}
 
 		int end_of_stanza = FALSE;
+		char* start = phandle->sol;
 		lrec_t* prec = pstate->use_implicit_header
 			?  lrec_reader_mmap_csvlite_get_record_single_seps_implicit_header(phandle, pstate, pctx,
 				pstate->pheader_keeper, &end_of_stanza)
@@ -200,7 +206,7 @@ static lrec_t* lrec_reader_mmap_csvlite_process_single_seps(void* pvstate, void*
 		} else if (prec == NULL) { // EOF
 			return NULL;
 		} else {
-			return prec;
+			return file_reader_mmap_hold(phandle, start, prec);
 		}
 	}
 }
@@ -226,6 +232,11 @@ static lrec_t* lrec_reader_mmap_csvlite_process_multi_seps(void* pvstate, void*
 
 			pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
 			if (pstate->pheader_keeper == NULL) {
+				// Copied, since header keepers outlive the part of the file
+				// they came from; see file_reader_mmap.h.
+				slls_t* pheader_fields_copy = slls_copy(pheader_fields);
+				slls_free(pheader_fields);
+				pheader_fields = pheader_fields_copy;
 				pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
 				lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
 					NO_FREE); // freed by header-keeper
@@ -236,6 +247,7 @@ static lrec_t* lrec_reader_mmap_csvlite_process_multi_seps(void* pvstate, void*
 		}
 
 		int end_of_stanza = FALSE;
+		char* start = phandle->sol;
 		lrec_t* prec = pstate->use_implicit_header
 			? lrec_reader_mmap_csvlite_get_record_multi_seps_implicit_header(phandle, pstate, pctx,
 				pstate->pheader_keeper, &end_of_stanza)
@@ -246,7 +258,7 @@ static lrec_t* lrec_reader_mmap_csvlite_process_multi_seps(void* pvstate, void*
 		} else if (prec == NULL) { // EOF
 			return NULL;
 		} else {
-			return prec;
+			return file_reader_mmap_hold(phandle, start, prec);
 		}
 	}
 }
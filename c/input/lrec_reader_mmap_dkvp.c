@@ -9,9 +9,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_scan.h"
 #include "input/file_reader_mmap.h"
 #include "input/lrec_readers.h"
 
@@ -27,8 +29,10 @@ typedef struct _lrec_reader_mmap_dkvp_state_t {
 	comment_handling_t comment_handling;
 	char* comment_string;
 	int   comment_string_length;
+	hss_t* pused_field_names;
 } lrec_reader_mmap_dkvp_state_t;
 
+static void*   lrec_reader_mmap_dkvp_open(void* pvstate, char* prepipe, char* filename);
 static void    lrec_reader_mmap_dkvp_free(lrec_reader_t* preader);
 static void    lrec_reader_mmap_dkvp_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx);
@@ -61,7 +65,7 @@ static void skip_over_comment_lines_multi_irs(
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -77,9 +81,10 @@ lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int
 	pstate->comment_handling      = comment_handling;
 	pstate->comment_string        = comment_string;
 	pstate->comment_string_length = comment_string == NULL ? 0 : strlen(comment_string);
+	pstate->pused_field_names     = pused_field_names;
 
 	plrec_reader->pvstate     = (void*)pstate;
-	plrec_reader->popen_func  = file_reader_mmap_vopen;
+	plrec_reader->popen_func  = lrec_reader_mmap_dkvp_open;
 	plrec_reader->pclose_func = file_reader_mmap_vclose;
 	if (streq(irs, "auto")) {
 		// Auto means either lines end in "\n" or "\r\n" (LF or CRLF).  In
@@ -107,6 +112,12 @@ lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int
 	return plrec_reader;
 }
 
+// Input which can't be mapped is read in blocks of whole lines, i.e. of whole records.
+static void* lrec_reader_mmap_dkvp_open(void* pvstate, char* prepipe, char* filename) {
+	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
+	return file_reader_mmap_open_lines(prepipe, filename, pstate->irs);
+}
+
 static void lrec_reader_mmap_dkvp_free(lrec_reader_t* preader) {
 	free(preader->pvstate);
 	free(preader);
@@ -120,39 +131,55 @@ static void lrec_reader_mmap_dkvp_sof(void* pvstate, void* pvhandle) {
 static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_single_irs_single_others(phandle, pstate->irs[0], pstate->ifs[0], pstate->ips[0],
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_dkvp_single_irs_single_others(phandle, pstate->irs[0], pstate->ifs[0], pstate->ips[0],
 			pstate, pctx);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_single_irs_multi_others(phandle, pstate->irs[0], pstate, pctx);
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_dkvp_single_irs_multi_others(phandle, pstate->irs[0], pstate, pctx);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_single_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_multi_irs_single_others(phandle, pstate->ifs[0], pstate->ips[0],
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_dkvp_multi_irs_single_others(phandle, pstate->ifs[0], pstate->ips[0],
 			pstate, pctx);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_dkvp_multi_irs_multi_others(phandle, pstate, pctx);
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_dkvp_multi_irs_multi_others(phandle, pstate, pctx);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 // ----------------------------------------------------------------
@@ -167,65 +194,73 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_single_others(file_reader_mmap_st
 
 	char* line  = phandle->sol;
 	lrec_t* prec = lrec_unbacked_alloc();
-
+	hss_t* pused_field_names = pstate->pused_field_names;
+
+	// The separators are found a block at a time (see lib/byte_scan.h) rather
+	// than by comparing each byte against each of them. With --repifs, a field
+	// separator found at the start of a field is skipped over. Fields with keys
+	// not in pused_field_names, if it's given, are left out of the record. A
+	// record with all of the line's fields, each under its own key, keeps the
+	// line for the DKVP writer (see lrec_set_original_line).
 	int idx = 0;
-	char* p = line;
-	if (pstate->allow_repeat_ifs) {
-		while (*p == ifs)
-			p++;
-	}
-	char* key   = p;
-	char* value = p;
+	char* eof = phandle->eof;
+	char* p = eof;
+	char* key   = line;
+	char* value = line;
 
 	int saw_ps = FALSE;
 	int saw_rs = FALSE;
-
-	for ( ; p < phandle->eof && *p; ) {
-		if (*p == irs) {
-			*p = 0;
-
-			if (pstate->do_auto_line_term) {
-				if (p > line && p[-1] == '\r') {
-					p[-1] = 0;
-					context_set_autodetected_crlf(pctx);
-				} else {
-					context_set_autodetected_lf(pctx);
+	int all_keyed = TRUE;
+
+	for (char* block = line; !saw_rs && block < eof; block += BYTE_SCAN_BLOCK_SIZE) {
+		unsigned int mask = byte_scan_block_3(block, eof, irs, ifs, ips);
+		for ( ; mask != 0; mask &= mask - 1) {
+			char* q = block + __builtin_ctz(mask);
+			if (*q == irs) {
+				*q = 0;
+				p = q;
+
+				if (pstate->do_auto_line_term) {
+					if (q > line && q[-1] == '\r') {
+						q[-1] = 0;
+						p = q - 1;
+						context_set_autodetected_crlf(pctx);
+					} else {
+						context_set_autodetected_lf(pctx);
+					}
 				}
-			}
 
-			phandle->sol = p+1;
-			saw_rs = TRUE;
-			break;
-		} else if (*p == ifs) {
-			saw_ps = FALSE;
-			*p = 0;
-
-			idx++;
-			if (*key == 0 || value <= key) {
-				// E.g the pair has no equals sign: "a" rather than "a=1" or
-				// "a=".  Here we use the positional index as the key. This way
-				// DKVP is a generalization of NIDX.
-				char free_flags = NO_FREE;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
-			}
-			else {
-				lrec_put(prec, key, value, NO_FREE);
-			}
+				phandle->sol = q+1;
+				saw_rs = TRUE;
+				break;
+			} else if (*q == ifs) {
+				if (pstate->allow_repeat_ifs && q == key) {
+					key = value = q + 1;
+					continue;
+				}
+				saw_ps = FALSE;
+				*q = 0;
+
+				idx++;
+				if (*key == 0 || value <= key) {
+					// E.g the pair has no equals sign: "a" rather than "a=1" or
+					// "a=".  Here we use the positional index as the key. This way
+					// DKVP is a generalization of NIDX.
+					char free_flags = NO_FREE;
+					lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+					all_keyed = FALSE;
+				}
+				else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
+					lrec_put(prec, key, value, NO_FREE);
+				}
 
-			p++;
-			if (pstate->allow_repeat_ifs) {
-				while (*p == ifs)
-					p++;
+				key = q + 1;
+				value = q + 1;
+			} else if (!saw_ps) {
+				*q = 0;
+				value = q + 1;
+				saw_ps = TRUE;
 			}
-			key = p;
-			value = p;
-		} else if (*p == ips && !saw_ps) {
-			*p = 0;
-			p++;
-			value = p;
-			saw_ps = TRUE;
-		} else {
-			p++;
 		}
 	}
 	if (p >= phandle->eof)
@@ -246,11 +281,15 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_single_others(file_reader_mmap_st
 			else
 				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
-		else {
+		else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
 			if (value >= phandle->eof)
 				lrec_put(prec, key, "", NO_FREE);
 			else
 				lrec_put(prec, key, value, NO_FREE);
+			// No fields left out, merged as duplicate keys, or keyed by
+			// position; and no runs of field separators collapsed.
+			if (all_keyed && pused_field_names == NULL && !pstate->allow_repeat_ifs && prec->field_count == idx)
+				lrec_set_original_line(prec, line, p - line, ifs, ips);
 		}
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
@@ -266,7 +305,7 @@ static lrec_t* lrec_parse_mmap_dkvp_single_irs_single_others(file_reader_mmap_st
 				lrec_put(prec, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
 			}
 		}
-		else {
+		else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
 			if (value >= phandle->eof) {
 				lrec_put(prec, key, "", NO_FREE);
 			} else {
@@ -290,55 +329,60 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_single_others(file_reader_mmap_sta
 
 	char* line  = phandle->sol;
 	lrec_t* prec = lrec_unbacked_alloc();
+	hss_t* pused_field_names = pstate->pused_field_names;
 
+	// As above, but the candidate line ends are only where the irs starts.
 	int idx = 0;
-	char* p = line;
-	if (pstate->allow_repeat_ifs) {
-		while (*p == ifs)
-			p++;
-	}
-	char* key   = p;
-	char* value = p;
+	char* eof = phandle->eof;
+	char* p = eof;
+	char* key   = line;
+	char* value = line;
 
 	int saw_ps = FALSE;
 	int saw_rs = FALSE;
+	int all_keyed = TRUE;
+
+	char* irs = pstate->irs;
+	int irslen = pstate->irslen;
+
+	for (char* block = line; !saw_rs && block < eof; block += BYTE_SCAN_BLOCK_SIZE) {
+		unsigned int mask = byte_scan_block_3(block, eof, irs[0], ifs, ips);
+		for ( ; mask != 0; mask &= mask - 1) {
+			char* q = block + __builtin_ctz(mask);
+			if (streqn(q, irs, irslen)) {
+				*q = 0;
+				p = q;
+				phandle->sol = q + irslen;
+				saw_rs = TRUE;
+				break;
+			} else if (*q == ifs) {
+				if (pstate->allow_repeat_ifs && q == key) {
+					key = value = q + 1;
+					continue;
+				}
+				saw_ps = FALSE;
+				*q = 0;
+
+				idx++;
+				if (*key == 0 || value <= key) {
+					// E.g the pair has no equals sign: "a" rather than "a=1" or
+					// "a=".  Here we use the positional index as the key. This way
+					// DKVP is a generalization of NIDX.
+					char free_flags = NO_FREE;
+					lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+					all_keyed = FALSE;
+				}
+				else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
+					lrec_put(prec, key, value, NO_FREE);
+				}
 
-	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, pstate->irs, pstate->irslen)) {
-			*p = 0;
-			phandle->sol = p + pstate->irslen;
-			saw_rs = TRUE;
-			break;
-		} else if (*p == ifs) {
-			saw_ps = FALSE;
-			*p = 0;
-
-			idx++;
-			if (*key == 0 || value <= key) {
-				// E.g the pair has no equals sign: "a" rather than "a=1" or
-				// "a=".  Here we use the positional index as the key. This way
-				// DKVP is a generalization of NIDX.
-				char free_flags = NO_FREE;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
-			}
-			else {
-				lrec_put(prec, key, value, NO_FREE);
-			}
-
-			p++;
-			if (pstate->allow_repeat_ifs) {
-				while (*p == ifs)
-					p++;
+				key = q + 1;
+				value = q + 1;
+			} else if (*q == ips && !saw_ps) {
+				*q = 0;
+				value = q + 1;
+				saw_ps = TRUE;
 			}
-			key = p;
-			value = p;
-		} else if (*p == ips && !saw_ps) {
-			*p = 0;
-			p++;
-			value = p;
-			saw_ps = TRUE;
-		} else {
-			p++;
 		}
 	}
 	if (p >= phandle->eof)
@@ -359,11 +403,15 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_single_others(file_reader_mmap_sta
 			else
 				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
 		}
-		else {
+		else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
 			if (value >= phandle->eof)
 				lrec_put(prec, key, "", NO_FREE);
 			else
 				lrec_put(prec, key, value, NO_FREE);
+			// No fields left out, merged as duplicate keys, or keyed by
+			// position; and no runs of field separators collapsed.
+			if (all_keyed && pused_field_names == NULL && !pstate->allow_repeat_ifs && prec->field_count == idx)
+				lrec_set_original_line(prec, line, p - line, ifs, ips);
 		}
 	} else {
 		// Messier case: we read to end of file without seeing end of line.  We can't always zero-poke a null character
@@ -379,7 +427,7 @@ static lrec_t* lrec_parse_mmap_dkvp_multi_irs_single_others(file_reader_mmap_sta
 				lrec_put(prec, low_int_to_string(idx, &free_flags), copy, free_flags | FREE_ENTRY_VALUE);
 			}
 		}
-		else {
+		else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
 			if (value >= phandle->eof) {
 				lrec_put(prec, key, "", NO_FREE);
 			} else {
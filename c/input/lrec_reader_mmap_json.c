@@ -110,6 +110,8 @@ static void lrec_reader_mmap_json_free(lrec_reader_t* preader) {
 static void lrec_reader_mmap_json_sof(void* pvstate, void* pvhandle) {
 	lrec_reader_mmap_json_state_t* pstate = pvstate;
 	file_reader_mmap_state_t* phandle = pvhandle;
+	// The parsed JSON points into the file, and outlives the records.
+	file_reader_mmap_hold_all(phandle);
 	json_char* json_input = (json_char*)phandle->sol;
 	json_value_t* parsed_top_level_json;
 	json_char error_buf[JSON_ERROR_MAX];
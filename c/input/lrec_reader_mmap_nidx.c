@@ -8,8 +8,10 @@
 // ================================================================
 
 #include <stdlib.h>
+#include <string.h>
 #include "cli/comment_handling.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_scan.h"
 #include "input/file_reader_mmap.h"
 #include "input/lrec_readers.h"
 
@@ -25,6 +27,7 @@ typedef struct _lrec_reader_mmap_nidx_state_t {
 	int   comment_string_length;
 } lrec_reader_mmap_nidx_state_t;
 
+static void*   lrec_reader_mmap_nidx_open(void* pvstate, char* prepipe, char* filename);
 static void    lrec_reader_mmap_nidx_free(lrec_reader_t* preader);
 static void    lrec_reader_mmap_nidx_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_mmap_nidx_process_single_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx);
@@ -73,7 +76,7 @@ lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repea
 	pstate->comment_string_length    = comment_string == NULL ? 0 : strlen(comment_string);
 
 	plrec_reader->pvstate     = (void*)pstate;
-	plrec_reader->popen_func  = file_reader_mmap_vopen;
+	plrec_reader->popen_func  = lrec_reader_mmap_nidx_open;
 	plrec_reader->pclose_func = file_reader_mmap_vclose;
 
 	if (streq(irs, "auto")) {
@@ -103,6 +106,12 @@ lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repea
 	return plrec_reader;
 }
 
+// Input which can't be mapped is read in blocks of whole lines, i.e. of whole records.
+static void* lrec_reader_mmap_nidx_open(void* pvstate, char* prepipe, char* filename) {
+	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
+	return file_reader_mmap_open_lines(prepipe, filename, pstate->irs);
+}
+
 static void lrec_reader_mmap_nidx_free(lrec_reader_t* preader) {
 	free(preader->pvstate);
 	free(preader);
@@ -116,37 +125,53 @@ static void lrec_reader_mmap_nidx_sof(void* pvstate, void* pvhandle) {
 static lrec_t* lrec_reader_mmap_nidx_process_single_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_single_irs_single_ifs(phandle, pstate->irs[0], pstate->ifs[0], pstate, pctx);
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_nidx_single_irs_single_ifs(phandle, pstate->irs[0], pstate->ifs[0], pstate, pctx);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 static lrec_t* lrec_reader_mmap_nidx_process_single_irs_multi_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_single_irs_multi_ifs(phandle, pstate->irs[0], pstate, pctx);
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_nidx_single_irs_multi_ifs(phandle, pstate->irs[0], pstate, pctx);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 static lrec_t* lrec_reader_mmap_nidx_process_multi_irs_single_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_multi_irs_single_ifs(phandle, pstate->ifs[0], pstate);
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_nidx_multi_irs_single_ifs(phandle, pstate->ifs[0], pstate);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 static lrec_t* lrec_reader_mmap_nidx_process_multi_irs_multi_ifs(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_nidx_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
-		return NULL;
-	else
-		return lrec_parse_mmap_nidx_multi_irs_multi_ifs(phandle, pstate);
+	while (TRUE) {
+		if (phandle->sol >= phandle->eof && !file_reader_mmap_refill(phandle))
+			return NULL;
+		char* start = phandle->sol;
+		lrec_t* prec = lrec_parse_mmap_nidx_multi_irs_multi_ifs(phandle, pstate);
+		if (prec != NULL) // else only comment lines were left before the refill
+			return file_reader_mmap_hold(phandle, start, prec);
+	}
 }
 
 // ----------------------------------------------------------------
@@ -165,45 +190,46 @@ static lrec_t* lrec_parse_mmap_nidx_single_irs_single_ifs(file_reader_mmap_state
 	int idx = 0;
 	char free_flags = NO_FREE;
 
-	char* p = line;
-	if (pstate->allow_repeat_ifs) {
-		while (*p == ifs)
-			p++;
-	}
+	// The separators are found a block at a time (see lib/byte_scan.h). With
+	// --repifs, a field separator found at the start of a field is skipped over.
+	char* eof = phandle->eof;
+	char* p = eof;
 	char* key   = NULL;
-	char* value = p;
+	char* value = line;
 	int saw_rs = FALSE;
-	for ( ; p < phandle->eof && *p; ) {
-		if (*p == irs) {
-			*p = 0;
-
-			if (pstate->do_auto_line_term) {
-				if (p > line && p[-1] == '\r') {
-					p[-1] = 0;
-					context_set_autodetected_crlf(pctx);
-				} else {
-					context_set_autodetected_lf(pctx);
+	for (char* block = line; !saw_rs && block < eof; block += BYTE_SCAN_BLOCK_SIZE) {
+		unsigned int mask = byte_scan_block_2(block, eof, irs, ifs);
+		for ( ; mask != 0; mask &= mask - 1) {
+			char* q = block + __builtin_ctz(mask);
+			if (*q == irs) {
+				*q = 0;
+
+				if (pstate->do_auto_line_term) {
+					if (q > line && q[-1] == '\r') {
+						q[-1] = 0;
+						context_set_autodetected_crlf(pctx);
+					} else {
+						context_set_autodetected_lf(pctx);
+					}
 				}
-			}
 
-			phandle->sol = p+1;
-			saw_rs = TRUE;
-			break;
-		} else if (*p == ifs) {
-			*p = 0;
+				p = q;
+				phandle->sol = q+1;
+				saw_rs = TRUE;
+				break;
+			} else {
+				if (pstate->allow_repeat_ifs && q == value) {
+					value = q + 1;
+					continue;
+				}
+				*q = 0;
 
-			idx++;
-			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+				idx++;
+				key = low_int_to_string(idx, &free_flags);
+				lrec_put(prec, key, value, free_flags);
 
-			p++;
-			if (pstate->allow_repeat_ifs) {
-				while (*p == ifs)
-					p++;
+				value = q + 1;
 			}
-			value = p;
-		} else {
-			p++;
 		}
 	}
 	if (p >= phandle->eof)
@@ -325,39 +351,39 @@ static lrec_t* lrec_parse_mmap_nidx_multi_irs_single_ifs(file_reader_mmap_state_
 	int idx = 0;
 	char free_flags = NO_FREE;
 
-	char* p = line;
-	if (pstate->allow_repeat_ifs) {
-		while (*p == ifs)
-			p++;
-	}
+	// As above, but the candidate line ends are only where the irs starts.
+	char* eof = phandle->eof;
+	char* p = eof;
 	char* key   = NULL;
-	char* value = p;
+	char* value = line;
 	int saw_rs = FALSE;
 
 	char* irs = pstate->irs;
 	int irslen = pstate->irslen;
 
-	for ( ; p < phandle->eof && *p; ) {
-		if (streqn(p, irs, irslen)) {
-			*p = 0;
-			phandle->sol = p + irslen;
-			saw_rs = TRUE;
-			break;
-		} else if (*p == ifs) {
-			*p = 0;
+	for (char* block = line; !saw_rs && block < eof; block += BYTE_SCAN_BLOCK_SIZE) {
+		unsigned int mask = byte_scan_block_2(block, eof, irs[0], ifs);
+		for ( ; mask != 0; mask &= mask - 1) {
+			char* q = block + __builtin_ctz(mask);
+			if (streqn(q, irs, irslen)) {
+				*q = 0;
+				p = q;
+				phandle->sol = q + irslen;
+				saw_rs = TRUE;
+				break;
+			} else if (*q == ifs) {
+				if (pstate->allow_repeat_ifs && q == value) {
+					value = q + 1;
+					continue;
+				}
+				*q = 0;
 
-			idx++;
-			key = low_int_to_string(idx, &free_flags);
-			lrec_put(prec, key, value, free_flags);
+				idx++;
+				key = low_int_to_string(idx, &free_flags);
+				lrec_put(prec, key, value, free_flags);
 
-			p++;
-			if (pstate->allow_repeat_ifs) {
-				while (*p == ifs)
-					p++;
+				value = q + 1;
 			}
-			value = p;
-		} else {
-			p++;
 		}
 	}
 	if (p >= phandle->eof)
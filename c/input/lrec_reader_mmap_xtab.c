@@ -111,38 +111,46 @@ static void lrec_reader_mmap_xtab_sof(void* pvstate, void* pvhandle) {
 static lrec_t* lrec_reader_mmap_xtab_process_single_ifs_single_ips(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_xtab_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
+	char* start = phandle->sol;
+	if (start >= phandle->eof)
 		return NULL;
 	else
-		return lrec_parse_mmap_xtab_single_ifs_single_ips(phandle, pstate->ifs[0], pstate->ips[0],
-			pstate, pctx);
+		return file_reader_mmap_hold(phandle, start,
+			lrec_parse_mmap_xtab_single_ifs_single_ips(phandle, pstate->ifs[0], pstate->ips[0],
+				pstate, pctx));
 }
 
 static lrec_t* lrec_reader_mmap_xtab_process_single_ifs_multi_ips(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_xtab_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
+	char* start = phandle->sol;
+	if (start >= phandle->eof)
 		return NULL;
 	else
-		return lrec_parse_mmap_xtab_single_ifs_multi_ips(phandle, pstate->ifs[0], pstate, pctx);
+		return file_reader_mmap_hold(phandle, start,
+			lrec_parse_mmap_xtab_single_ifs_multi_ips(phandle, pstate->ifs[0], pstate, pctx));
 }
 
 static lrec_t* lrec_reader_mmap_xtab_process_multi_ifs_single_ips(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_xtab_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
+	char* start = phandle->sol;
+	if (start >= phandle->eof)
 		return NULL;
 	else
-		return lrec_parse_mmap_xtab_multi_ifs_single_ips(phandle, pstate->ips[0], pstate);
+		return file_reader_mmap_hold(phandle, start,
+			lrec_parse_mmap_xtab_multi_ifs_single_ips(phandle, pstate->ips[0], pstate));
 }
 
 static lrec_t* lrec_reader_mmap_xtab_process_multi_ifs_multi_ips(void* pvstate, void* pvhandle, context_t* pctx) {
 	file_reader_mmap_state_t* phandle = pvhandle;
 	lrec_reader_mmap_xtab_state_t* pstate = pvstate;
-	if (phandle->sol >= phandle->eof)
+	char* start = phandle->sol;
+	if (start >= phandle->eof)
 		return NULL;
 	else
-		return lrec_parse_mmap_xtab_multi_ifs_multi_ips(phandle, pstate);
+		return file_reader_mmap_hold(phandle, start,
+			lrec_parse_mmap_xtab_multi_ifs_multi_ips(phandle, pstate));
 }
 
 // ----------------------------------------------------------------
@@ -0,0 +1,267 @@
+// ================================================================
+// Reader for Miller's binary record format; see lib/bin_format.h.
+//
+// Each batch body is read whole, and all of the batch's records are made at
+// once, column by column, with keys and values pointing into the body. Field
+// names are checked for duplicates once per batch rather than once per field
+// per record. The body is freed along with the last of its records.
+//
+// There's no mmap version: the input is read a batch at a time either way, and
+// this works the same on pipes, which is what the format is mainly for.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "lib/bin_format.h"
+#include "containers/hss.h"
+#include "input/file_reader_stdio.h"
+#include "input/lrec_readers.h"
+
+// Records may be freed on other threads, e.g. by stats1 -j workers, so the hold
+// count is kept under the mutex.
+typedef struct _bin_batch_t {
+	pthread_mutex_t mutex;
+	char*     body;
+	long long hold_count; // How many records point into the body
+} bin_batch_t;
+
+typedef struct _lrec_reader_stdio_bin_state_t {
+	int      at_start_of_file;
+	lrec_t** precords; // Of the current batch
+	int      num_records;
+	int      num_records_allocated;
+	int      next_record;
+	char**   keys;
+	int      num_keys_allocated;
+} lrec_reader_stdio_bin_state_t;
+
+static void    lrec_reader_stdio_bin_free(lrec_reader_t* preader);
+static void    lrec_reader_stdio_bin_sof(void* pvstate, void* pvhandle);
+static void    lrec_reader_stdio_bin_close(void* pvstate, void* pvhandle, char* prepipe);
+static lrec_t* lrec_reader_stdio_bin_process(void* pvstate, void* pvhandle, context_t* pctx);
+static int     read_batch(lrec_reader_stdio_bin_state_t* pstate, FILE* input_stream, context_t* pctx);
+static void    free_unread_records(lrec_reader_stdio_bin_state_t* pstate);
+static void    free_batch_hold(lrec_t* prec);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_stdio_bin_alloc() {
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_stdio_bin_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_stdio_bin_state_t));
+	pstate->at_start_of_file      = TRUE;
+	pstate->precords              = NULL;
+	pstate->num_records           = 0;
+	pstate->num_records_allocated = 0;
+	pstate->next_record           = 0;
+	pstate->keys                  = NULL;
+	pstate->num_keys_allocated    = 0;
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_stdio_vopen;
+	plrec_reader->pclose_func   = lrec_reader_stdio_bin_close;
+	plrec_reader->pprocess_func = lrec_reader_stdio_bin_process;
+	plrec_reader->psof_func     = lrec_reader_stdio_bin_sof;
+	plrec_reader->pfree_func    = lrec_reader_stdio_bin_free;
+
+	return plrec_reader;
+}
+
+static void lrec_reader_stdio_bin_free(lrec_reader_t* preader) {
+	lrec_reader_stdio_bin_state_t* pstate = preader->pvstate;
+	free_unread_records(pstate);
+	free(pstate->precords);
+	free(pstate->keys);
+	free(pstate);
+	free(preader);
+}
+
+static void lrec_reader_stdio_bin_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_stdio_bin_state_t* pstate = pvstate;
+	pstate->at_start_of_file = TRUE;
+}
+
+// Reading may stop partway through a batch, e.g. for mlr head.
+static void lrec_reader_stdio_bin_close(void* pvstate, void* pvhandle, char* prepipe) {
+	free_unread_records(pvstate);
+	file_reader_stdio_vclose(pvstate, pvhandle, prepipe);
+}
+
+static void free_unread_records(lrec_reader_stdio_bin_state_t* pstate) {
+	for ( ; pstate->next_record < pstate->num_records; pstate->next_record++)
+		lrec_free(pstate->precords[pstate->next_record]);
+	pstate->num_records = 0;
+	pstate->next_record = 0;
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_stdio_bin_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_stdio_bin_state_t* pstate = pvstate;
+	while (pstate->next_record >= pstate->num_records) {
+		if (!read_batch(pstate, pvhandle, pctx))
+			return NULL;
+	}
+	return pstate->precords[pstate->next_record++];
+}
+
+// ----------------------------------------------------------------
+static void truncated(context_t* pctx) {
+	fprintf(stderr, "%s: truncated binary input in file \"%s\".\n", MLR_GLOBALS.bargv0, pctx->filename);
+	exit(1);
+}
+
+static void malformed(context_t* pctx) {
+	fprintf(stderr, "%s: malformed binary input in file \"%s\".\n", MLR_GLOBALS.bargv0, pctx->filename);
+	exit(1);
+}
+
+// Returns the string at *pp, which must be within the body, and moves *pp past it.
+static char* next_string(char** pp, char* end, uint32_t* pquoted, context_t* pctx) {
+	char* p = *pp;
+	if (end - p < 4)
+		malformed(pctx);
+	uint32_t length = bin_format_get_u32(p);
+	*pquoted = length & BIN_FORMAT_QUOTED_BIT;
+	length &= ~BIN_FORMAT_QUOTED_BIT;
+	p += 4;
+	if ((uint64_t)(end - p) < (uint64_t)length + 1 || p[length] != 0)
+		malformed(pctx);
+	*pp = p + length + 1;
+	return p;
+}
+
+// The buffer grows as the body is read, so that a corrupted length in a short
+// input is reported as such rather than as failure to allocate.
+static char* read_body(FILE* input_stream, size_t body_length, context_t* pctx) {
+	size_t alloc_length = body_length < BIN_FORMAT_MAX_BATCH_BYTES ? body_length : BIN_FORMAT_MAX_BATCH_BYTES;
+	char* body = mlr_malloc_or_die(alloc_length + 1);
+	size_t length = 0;
+	while (length < body_length) {
+		if (length == alloc_length) {
+			alloc_length = body_length - alloc_length < alloc_length ? body_length : 2 * alloc_length;
+			body = mlr_realloc_or_die(body, alloc_length + 1);
+		}
+		size_t nread = fread(&body[length], 1, alloc_length - length, input_stream);
+		if (nread == 0)
+			truncated(pctx);
+		length += nread;
+	}
+	return body;
+}
+
+// Returns FALSE at end of input.
+static int read_batch(lrec_reader_stdio_bin_state_t* pstate, FILE* input_stream, context_t* pctx) {
+	char header[BIN_FORMAT_BATCH_HEADER_SIZE];
+
+	while (TRUE) {
+		size_t nread = fread(header, 1, 4, input_stream);
+		if (nread == 0)
+			return FALSE;
+		if (nread < 4)
+			truncated(pctx);
+
+		if (memcmp(header, BIN_FORMAT_MAGIC, BIN_FORMAT_MAGIC_LENGTH) == 0) {
+			if (fread(&header[4], 1, 4, input_stream) < 4)
+				truncated(pctx);
+			uint32_t version = bin_format_get_u32(&header[4]);
+			if (version != BIN_FORMAT_VERSION) {
+				fprintf(stderr, "%s: unsupported binary format version %u in file \"%s\".\n",
+					MLR_GLOBALS.bargv0, (unsigned)version, pctx->filename);
+				exit(1);
+			}
+			pstate->at_start_of_file = FALSE;
+			continue;
+		}
+		if (pstate->at_start_of_file) {
+			fprintf(stderr, "%s: file \"%s\" is not in Miller's binary format.\n",
+				MLR_GLOBALS.bargv0, pctx->filename);
+			exit(1);
+		}
+
+		if (fread(&header[4], 1, BIN_FORMAT_BATCH_HEADER_SIZE - 4, input_stream) < BIN_FORMAT_BATCH_HEADER_SIZE - 4)
+			truncated(pctx);
+		uint32_t num_records = bin_format_get_u32(&header[0]);
+		uint32_t num_fields  = bin_format_get_u32(&header[4]);
+		uint64_t body_length = bin_format_get_u64(&header[8]);
+		// Each name and value takes at least five bytes. Records without fields
+		// take none, but the writer puts no more than a batch's worth together.
+		if ((uint64_t)num_fields * ((uint64_t)num_records + 1) > body_length / 5 || body_length > (size_t)-1 / 2)
+			malformed(pctx);
+		if (num_fields == 0 && num_records > BIN_FORMAT_MAX_BATCH_RECORDS)
+			malformed(pctx);
+		if (num_records > 0)
+			break;
+		if (body_length > 0)
+			malformed(pctx);
+	}
+
+	uint32_t num_records = bin_format_get_u32(&header[0]);
+	uint32_t num_fields  = bin_format_get_u32(&header[4]);
+	size_t   body_length = bin_format_get_u64(&header[8]);
+
+	bin_batch_t* pbatch = mlr_malloc_or_die(sizeof(bin_batch_t));
+	pbatch->body = read_body(input_stream, body_length, pctx);
+	pbatch->hold_count = num_records;
+	pthread_mutex_init(&pbatch->mutex, NULL);
+	char* p = pbatch->body;
+	char* end = p + body_length;
+
+	if (num_fields > pstate->num_keys_allocated) {
+		pstate->keys = mlr_realloc_or_die(pstate->keys, num_fields * sizeof(char*));
+		pstate->num_keys_allocated = num_fields;
+	}
+	uint32_t quoted;
+	for (uint32_t j = 0; j < num_fields; j++)
+		pstate->keys[j] = next_string(&p, end, &quoted, pctx);
+	if (num_fields > 1) {
+		hss_t* pnames = hss_alloc();
+		for (uint32_t j = 0; j < num_fields; j++) {
+			if (hss_has(pnames, pstate->keys[j])) {
+				fprintf(stderr, "%s: duplicate field name \"%s\" in binary input in file \"%s\".\n",
+					MLR_GLOBALS.bargv0, pstate->keys[j], pctx->filename);
+				exit(1);
+			}
+			hss_add(pnames, pstate->keys[j]);
+		}
+		hss_free(pnames);
+	}
+
+	if (num_records > pstate->num_records_allocated) {
+		pstate->precords = mlr_realloc_or_die(pstate->precords, num_records * sizeof(lrec_t*));
+		pstate->num_records_allocated = num_records;
+	}
+	for (uint32_t i = 0; i < num_records; i++) {
+		lrec_t* prec = lrec_unbacked_alloc();
+		prec->pvbacking = pbatch;
+		prec->pfree_backing_func = free_batch_hold;
+		pstate->precords[i] = prec;
+	}
+	for (uint32_t j = 0; j < num_fields; j++) {
+		char* key = pstate->keys[j];
+		for (uint32_t i = 0; i < num_records; i++) {
+			char* value = next_string(&p, end, &quoted, pctx);
+			lrec_append_unique(pstate->precords[i], key, value, NO_FREE, quoted ? FIELD_QUOTED_ON_INPUT : 0);
+		}
+	}
+	if (p != end)
+		malformed(pctx);
+
+	pstate->num_records = num_records;
+	pstate->next_record = 0;
+	return TRUE;
+}
+
+static void free_batch_hold(lrec_t* prec) {
+	bin_batch_t* pbatch = prec->pvbacking;
+	pthread_mutex_lock(&pbatch->mutex);
+	int done = --pbatch->hold_count == 0;
+	pthread_mutex_unlock(&pbatch->mutex);
+	if (done) {
+		pthread_mutex_destroy(&pbatch->mutex);
+		free(pbatch->body);
+		free(pbatch);
+	}
+}
@@ -90,6 +90,13 @@ typedef struct _lrec_reader_stdio_csv_state_t {
 	header_keeper_t*    pheader_keeper;
 	lhmslv_t*           pheader_keepers;
 
+	// Fields the verb chain won't look at aren't put into records. The flags
+	// say which of the current header's fields are, if pused_field_names is
+	// non-null; they're redone on header change.
+	hss_t*              pused_field_names;
+	header_keeper_t*    pused_fields_header_keeper;
+	char*               used_fields;
+
 } lrec_reader_stdio_csv_state_t;
 
 static void    lrec_reader_stdio_csv_free(lrec_reader_t* preader);
@@ -101,12 +108,13 @@ static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rsl
 	context_t* pctx);
 static lrec_t* paste_header_and_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
 	context_t* pctx);
+static void    set_used_fields(lrec_reader_stdio_csv_state_t* pstate);
 static void*   lrec_reader_stdio_csv_open(void* pvstate, char* prepipe, char* filename);
 static void    lrec_reader_stdio_csv_close(void* pvstate, void* pvhandle, char* prepipe);
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implicit_header,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -179,6 +187,9 @@ lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implici
 	pstate->use_implicit_header       = use_implicit_header;
 	pstate->pheader_keeper            = NULL;
 	pstate->pheader_keepers           = lhmslv_alloc();
+	pstate->pused_field_names          = pused_field_names;
+	pstate->pused_fields_header_keeper = NULL;
+	pstate->used_fields                = NULL;
 
 	plrec_reader->pvstate       = (void*)pstate;
 	plrec_reader->popen_func    = lrec_reader_stdio_csv_open;
@@ -198,6 +209,7 @@ static void lrec_reader_stdio_csv_free(lrec_reader_t* preader) {
 		header_keeper_free(pheader_keeper);
 	}
 	lhmslv_free(pstate->pheader_keepers);
+	free(pstate->used_fields);
 	pfr_free(pstate->pfr);
 	parse_trie_free(pstate->putf8_bom_parse_trie);
 	parse_trie_free(pstate->pno_dquote_parse_trie);
@@ -259,7 +271,7 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 
 			slls_t* pheader_fields = slls_alloc();
 			int i = 0;
-			for (rsllse_t* pe = pstate->pfields->phead; i < pstate->pfields->length && pe != NULL; pe = pe->pnext) {
+			for (rsllse_t* pe = pstate->pfields->phead; i < pstate->pfields->length && pe != NULL; pe = pe->pnext, i++) {
 				if (*pe->value == 0) {
 					fprintf(stderr, "%s: unacceptable empty CSV key at file \"%s\" line %lld.\n",
 						MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
@@ -509,7 +521,7 @@ static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rsl
 {
 	lrec_t* prec = lrec_unbacked_alloc();
 	int idx = 0;
-	for (rsllse_t* pd = pdata_fields->phead; pd != NULL; pd = pd->pnext) {
+	for (rsllse_t* pd = pdata_fields->phead; idx < pdata_fields->length && pd != NULL; pd = pd->pnext) {
 		idx++;
 		char key_free_flags = 0;
 		char* key = low_int_to_string(idx, &key_free_flags);
@@ -531,10 +543,16 @@ static lrec_t* paste_header_and_data(lrec_reader_stdio_csv_state_t* pstate, rsll
 			pctx->filename, pstate->ilno);
 		exit(1);
 	}
+	if (pstate->pused_field_names != NULL && pstate->pused_fields_header_keeper != pstate->pheader_keeper)
+		set_used_fields(pstate);
+	char* used_fields = pstate->used_fields;
+
 	lrec_t* prec = lrec_unbacked_alloc();
 	sllse_t* ph = pstate->pheader_keeper->pkeys->phead;
 	rsllse_t* pd = pdata_fields->phead;
-	for ( ; ph != NULL && pd != NULL; ph = ph->pnext, pd = pd->pnext) {
+	for (int i = 0; ph != NULL && pd != NULL; ph = ph->pnext, pd = pd->pnext, i++) {
+		if (used_fields != NULL && !used_fields[i])
+			continue; // The rslls frees the value if need be.
 		// Transfer pointer-free responsibility from the rslls to the lrec object
 		lrec_put_ext(prec, ph->value, pd->value, pd->free_flag, pd->quote_flag);
 		pd->free_flag = 0;
@@ -542,6 +560,16 @@ static lrec_t* paste_header_and_data(lrec_reader_stdio_csv_state_t* pstate, rsll
 	return prec;
 }
 
+static void set_used_fields(lrec_reader_stdio_csv_state_t* pstate) {
+	slls_t* pkeys = pstate->pheader_keeper->pkeys;
+	free(pstate->used_fields);
+	pstate->used_fields = mlr_malloc_or_die(pkeys->length);
+	int i = 0;
+	for (sllse_t* pe = pkeys->phead; pe != NULL; pe = pe->pnext, i++)
+		pstate->used_fields[i] = hss_has(pstate->pused_field_names, pe->value);
+	pstate->pused_fields_header_keeper = pstate->pheader_keeper;
+}
+
 // ----------------------------------------------------------------
 static void* lrec_reader_stdio_csv_open(void* pvstate, char* prepipe, char* filename) {
 	lrec_reader_stdio_csv_state_t* pstate = pvstate;
@@ -9,9 +9,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_scan.h"
 #include "input/file_reader_stdio.h"
 #include "input/line_readers.h"
 #include "input/lrec_readers.h"
@@ -27,6 +29,7 @@ typedef struct _lrec_reader_stdio_dkvp_state_t {
 	comment_handling_t comment_handling;
 	char*  comment_string;
 	size_t line_length;
+	hss_t* pused_field_names;
 } lrec_reader_stdio_dkvp_state_t;
 
 static void    lrec_reader_stdio_dkvp_free(lrec_reader_t* preader);
@@ -46,7 +49,7 @@ static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_multi_others(void* pvsta
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string)
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names)
 {
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
@@ -60,6 +63,7 @@ lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int
 	pstate->allow_repeat_ifs = allow_repeat_ifs;
 	pstate->comment_handling = comment_handling;
 	pstate->comment_string   = comment_string;
+	pstate->pused_field_names = pused_field_names;
 	// This is used to track nominal line length over the file read. Bootstrap with a default length.
 	pstate->line_length      = MLR_ALLOC_READ_LINE_INITIAL_SIZE;
 
@@ -116,7 +120,8 @@ static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_single_others_auto_line
 	if (line == NULL) {
 		return NULL;
 	} else {
-		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs,
+			pstate->pused_field_names);
 	}
 }
 
@@ -148,7 +153,8 @@ static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_single_others(void* pvs
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs,
+			pstate->pused_field_names);
 }
 
 static lrec_t* lrec_reader_stdio_dkvp_process_single_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -177,7 +183,8 @@ static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_single_others(void* pvst
 	if (line == NULL)
 		return NULL;
 	else
-		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+		return lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs,
+			pstate->pused_field_names);
 }
 
 static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_multi_others(void* pvstate, void* pvhandle, context_t* pctx) {
@@ -201,10 +208,21 @@ static lrec_t* lrec_reader_stdio_dkvp_process_multi_irs_multi_others(void* pvsta
 //      S     S     S
 // "abc" "def" "ghi" "jkl"
 
-// I couldn't find a performance gain using stdlib index(3) ... *maybe* even a
-// fraction of a percent *slower*.
-
-lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs) {
+// Rather than comparing each byte against each separator, the separators are
+// found a block at a time (see lib/byte_scan.h). With --repifs, a field
+// separator found at the start of a field is skipped over.
+//
+// Fields the verb chain won't look at aren't put into the record: for wide
+// records, most of the time would otherwise be in lrec_put's check for an
+// existing key. Fields keyed by position are kept regardless.
+//
+// A record which has all of the line's fields, each under its own key, keeps
+// the line, so that the DKVP writer can write it back out as is if nothing
+// changes the record.
+
+lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs,
+	hss_t* pused_field_names)
+{
 	lrec_t* prec = lrec_dkvp_alloc(line);
 
 	// It would be easier to split the line on field separator (e.g. ","), then
@@ -212,48 +230,45 @@ lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int all
 	// requires two passes through the data. Here we do it in one pass.
 
 	int idx = 0;
-	char* p = line;
-
-	if (allow_repeat_ifs) {
-		while (*p == ifs)
-			p++;
-	}
-	char* key   = p;
-	char* value = p;
+	char* eol = line + strlen(line);
+	char* key   = line;
+	char* value = line;
 
 	int saw_ps = FALSE;
-
-	for ( ; *p; ) {
-		if (*p == ifs) {
-			saw_ps = FALSE;
-			*p = 0;
-
-			idx++;
-			if (*key == 0 || value <= key) {
-				// E.g the pair has no equals sign: "a" rather than "a=1" or
-				// "a=".  Here we use the positional index as the key. This way
-				// DKVP is a generalization of NIDX.
-				char  free_flags = 0;
-				lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
-			}
-			else {
-				lrec_put(prec, key, value, NO_FREE);
+	int all_keyed = TRUE;
+
+	for (char* block = line; block < eol; block += BYTE_SCAN_BLOCK_SIZE) {
+		unsigned int mask = byte_scan_block_2(block, eol, ifs, ips);
+		for ( ; mask != 0; mask &= mask - 1) {
+			char* p = block + __builtin_ctz(mask);
+			if (*p == ifs) {
+				if (allow_repeat_ifs && p == key) {
+					key = value = p + 1;
+					continue;
+				}
+				saw_ps = FALSE;
+				*p = 0;
+
+				idx++;
+				if (*key == 0 || value <= key) {
+					// E.g the pair has no equals sign: "a" rather than "a=1" or
+					// "a=".  Here we use the positional index as the key. This way
+					// DKVP is a generalization of NIDX.
+					char  free_flags = 0;
+					lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+					all_keyed = FALSE;
+				}
+				else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
+					lrec_put(prec, key, value, NO_FREE);
+				}
+
+				key = p + 1;
+				value = p + 1;
+			} else if (!saw_ps) {
+				*p = 0;
+				value = p + 1;
+				saw_ps = TRUE;
 			}
-
-			p++;
-			if (allow_repeat_ifs) {
-				while (*p == ifs)
-					p++;
-			}
-			key = p;
-			value = p;
-		} else if (*p == ips && !saw_ps) {
-			*p = 0;
-			p++;
-			value = p;
-			saw_ps = TRUE;
-		} else {
-			p++;
 		}
 	}
 	idx++;
@@ -264,12 +279,18 @@ lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int all
 		if (*key == 0 || value <= key) {
 			char  free_flags = 0;
 			lrec_put(prec, low_int_to_string(idx, &free_flags), value, free_flags);
+			all_keyed = FALSE;
 		}
-		else {
+		else if (pused_field_names == NULL || hss_has(pused_field_names, key)) {
 			lrec_put(prec, key, value, NO_FREE);
 		}
 	}
 
+	// No fields left out, merged as duplicate keys, or keyed by position; and
+	// no runs of field separators collapsed.
+	if (all_keyed && pused_field_names == NULL && !allow_repeat_ifs && prec->field_count == idx)
+		lrec_set_original_line(prec, line, eol - line, ifs, ips);
+
 	return prec;
 }
 
@@ -8,8 +8,10 @@
 // ================================================================
 
 #include <stdlib.h>
+#include <string.h>
 #include "cli/comment_handling.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_scan.h"
 #include "input/file_reader_stdio.h"
 #include "input/line_readers.h"
 #include "input/lrec_readers.h"
@@ -186,35 +188,32 @@ static lrec_t* lrec_reader_stdio_nidx_process_multi_irs_multi_ifs(void* pvstate,
 }
 
 // ----------------------------------------------------------------
+// The field separators are found a block at a time (see lib/byte_scan.h). With
+// --repifs, one found at the start of a field is skipped over.
 lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_ifs) {
 	lrec_t* prec = lrec_nidx_alloc(line);
 
 	int idx = 0;
 	char  free_flags = 0;
 
-	char* p = line;
-	if (allow_repeat_ifs) {
-		while (*p == ifs)
-			p++;
-	}
+	char* eol = line + strlen(line);
 	char* key   = NULL;
-	char* value = p;
-	for ( ; *p; ) {
-		if (*p == ifs) {
+	char* value = line;
+	for (char* block = line; block < eol; block += BYTE_SCAN_BLOCK_SIZE) {
+		unsigned int mask = byte_scan_block_2(block, eol, ifs, ifs);
+		for ( ; mask != 0; mask &= mask - 1) {
+			char* p = block + __builtin_ctz(mask);
+			if (allow_repeat_ifs && p == value) {
+				value = p + 1;
+				continue;
+			}
 			*p = 0;
 
 			idx++;
 			key = low_int_to_string(idx, &free_flags);
 			lrec_put(prec, key, value, free_flags);
 
-			p++;
-			if (allow_repeat_ifs) {
-				while (*p == ifs)
-					p++;
-			}
-			value = p;
-		} else {
-			p++;
+			value = p + 1;
 		}
 	}
 	idx++;
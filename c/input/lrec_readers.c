@@ -11,17 +11,17 @@ lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts) {
 	} else if (streq(popts->ifile_fmt, "dkvp")) {
 		if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_dkvp_alloc(popts->irs, popts->ifs, popts->ips, popts->allow_repeat_ifs,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string, popts->pused_field_names);
 		else
 			return lrec_reader_stdio_dkvp_alloc(popts->irs, popts->ifs, popts->ips, popts->allow_repeat_ifs,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string, popts->pused_field_names);
 	} else if (streq(popts->ifile_fmt, "csv")) {
 		if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_csv_alloc(popts->irs, popts->ifs, popts->use_implicit_csv_header,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string, popts->pused_field_names);
 		else
 			return lrec_reader_stdio_csv_alloc(popts->irs, popts->ifs, popts->use_implicit_csv_header,
-				popts->comment_handling, popts->comment_string);
+				popts->comment_handling, popts->comment_string, popts->pused_field_names);
 	} else if (streq(popts->ifile_fmt, "csvlite")) {
 		if (popts->use_mmap_for_read)
 			return lrec_reader_mmap_csvlite_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
@@ -51,11 +51,17 @@ lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts) {
 		else
 			return lrec_reader_stdio_json_alloc(popts->input_json_flatten_separator,
 				popts->json_array_ingest, popts->irs, popts->comment_handling, popts->comment_string);
+	} else if (streq(popts->ifile_fmt, "bin")) {
+		return lrec_reader_stdio_bin_alloc();
 	} else {
 		return NULL;
 	}
 }
 
+int lrec_reader_mmap_reads_streams(cli_reader_opts_t* popts) {
+	return streq(popts->ifile_fmt, "dkvp") || streq(popts->ifile_fmt, "nidx") || streq(popts->ifile_fmt, "csv");
+}
+
 lrec_reader_t* lrec_reader_alloc_or_die(cli_reader_opts_t* popts) {
 	lrec_reader_t* plrec_reader = lrec_reader_alloc(popts);
 	if (plrec_reader == NULL) {
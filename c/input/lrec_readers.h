@@ -10,26 +10,33 @@
 lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts);
 lrec_reader_t*  lrec_reader_alloc_or_die(cli_reader_opts_t* popts);
 
+// Standard input and prepipe output can't be mmapped. The mmap readers for
+// line-oriented formats and CSV read them in blocks instead; the others would
+// read all the input into memory at once, so the stdio readers are better for
+// those.
+int lrec_reader_mmap_reads_streams(cli_reader_opts_t* popts);
+
 lrec_reader_t* lrec_reader_gen_alloc(char* field_name, unsigned long long start, unsigned long long stop, unsigned long long step);
 lrec_reader_t* lrec_reader_stdio_csvlite_alloc(char* irs, char* ifs, int allow_repeat_ifs, int use_implicit_header,
 	comment_handling_t comment_handling, char* comment_string);
 lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implicit_header,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names);
 lrec_reader_t* lrec_reader_stdio_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names);
 lrec_reader_t* lrec_reader_stdio_nidx_alloc(char* irs, char* ifs, int allow_repeat_ifs,
 	comment_handling_t comment_handling, char* comment_string);
 lrec_reader_t* lrec_reader_stdio_xtab_alloc(char* ifs, char* ips, int allow_repeat_ips,
 	comment_handling_t comment_handling, char* comment_string);
 lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator, json_array_ingest_t json_array_ingest, char* line_term,
 	comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_stdio_bin_alloc();
 
 lrec_reader_t* lrec_reader_mmap_csv_alloc(char* irs, char* ifs, int use_implicit_header,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names);
 lrec_reader_t* lrec_reader_mmap_csvlite_alloc(char* irs, char* ifs, int allow_repeat_ifs, int use_implicit_header,
 	comment_handling_t comment_handling, char* comment_string);
 lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
-	comment_handling_t comment_handling, char* comment_string);
+	comment_handling_t comment_handling, char* comment_string, hss_t* pused_field_names);
 lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repeat_ifs,
 	comment_handling_t comment_handling, char* comment_string);
 lrec_reader_t* lrec_reader_mmap_xtab_alloc(char* ifs, char* ips, int allow_repeat_ips,
@@ -45,7 +52,9 @@ lrec_reader_t* lrec_reader_in_memory_alloc(sllv_t* precords);
 lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_ifs);
 lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int allow_repeat_ifs);
 
-lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs);
+// With non-null pused_field_names, other fields having keys are left out.
+lrec_t* lrec_parse_stdio_dkvp_single_sep(char* line, char ifs, char ips, int allow_repeat_ifs,
+	hss_t* pused_field_names);
 lrec_t* lrec_parse_stdio_dkvp_multi_sep(char* line, char* ifs, char* ips, int ifslen, int ipslen, int allow_repeat_ifs);
 
 slls_t* split_csv_header_line(char* line, char ifs, int allow_repeat_ifs);
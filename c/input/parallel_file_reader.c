@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlr_arch.h"
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "input/lrec_readers.h"
+#include "input/parallel_file_reader.h"
+
+#if MLR_ARCH_THREADS_ENABLED
+#include <pthread.h>
+
+// Allow compile-time override, e.g using gcc -D.
+#ifndef PARALLEL_FILE_READER_BATCH_SIZE
+#define PARALLEL_FILE_READER_BATCH_SIZE 500
+#endif
+// Per file when ordered; per thread when unordered.
+#define MAX_QUEUED_BATCHES 4
+
+typedef struct _record_batch_t {
+	lrec_t**  precords;
+	int       num_records;
+	int       file_index;
+	long long start_fnr;      // Records in the file before this batch
+	int       is_last;        // The file's last batch, possibly empty
+	char*     auto_line_term; // Non-null once the reader has detected one
+	struct _record_batch_t* pnext;
+} record_batch_t;
+
+typedef struct _worker_t {
+	struct _parallel_file_reader_t* preader;
+	lrec_reader_t*                  plrec_reader;
+	pthread_t                       thread;
+} worker_t;
+
+typedef struct _batch_queue_t {
+	record_batch_t* phead;
+	record_batch_t* ptail;
+	int             length;
+} batch_queue_t;
+
+struct _parallel_file_reader_t {
+	cli_reader_opts_t reader_opts;
+	context_t         initial_context;
+	char**            filenames;
+	int               num_files;
+	int               ordered;
+	int               num_threads;
+	worker_t*         workers;
+
+	// Shared between the main thread and the workers, under the mutex.
+	pthread_mutex_t   mutex;
+	pthread_cond_t    batch_ready;
+	pthread_cond_t    space_ready;
+	batch_queue_t*    queues;           // One per file when ordered; else just one
+	int               max_queue_length;
+	int               next_file_index;  // The next file for a worker to take
+	int               num_files_done;   // Files whose last batch has been queued
+	int               stopping;
+
+	// Main thread only.
+	int               consume_file_index; // Ordered: the file being drained
+	record_batch_t*   pcurrent;
+	int               current_index;
+};
+
+static void* worker_main(void* pvarg);
+static int read_file(parallel_file_reader_t* preader, lrec_reader_t* plrec_reader, int file_index);
+static int put_batch(parallel_file_reader_t* preader, record_batch_t* pbatch);
+static record_batch_t* take_batch(parallel_file_reader_t* preader);
+static record_batch_t* batch_alloc(int file_index, long long start_fnr);
+static void batch_free(record_batch_t* pbatch, int first_untaken);
+
+// ----------------------------------------------------------------
+parallel_file_reader_t* parallel_file_reader_alloc(cli_reader_opts_t* preader_opts, slls_t* pfilenames,
+	int num_threads, int ordered, context_t* pctx)
+{
+	MLR_INTERNAL_CODING_ERROR_IF(num_threads < 1);
+	parallel_file_reader_t* preader = mlr_malloc_or_die(sizeof(parallel_file_reader_t));
+
+	preader->reader_opts = *preader_opts;
+	preader->reader_opts.use_mmap_for_read = FALSE;
+	preader->initial_context = *pctx;
+	preader->num_files = pfilenames->length;
+	preader->filenames = mlr_malloc_or_die(preader->num_files * sizeof(char*));
+	int i = 0;
+	for (sllse_t* pe = pfilenames->phead; pe != NULL; pe = pe->pnext)
+		preader->filenames[i++] = pe->value;
+	preader->ordered = ordered;
+	preader->num_threads = num_threads < preader->num_files ? num_threads : preader->num_files;
+
+	pthread_mutex_init(&preader->mutex, NULL);
+	pthread_cond_init(&preader->batch_ready, NULL);
+	pthread_cond_init(&preader->space_ready, NULL);
+	int num_queues = ordered ? preader->num_files : 1;
+	preader->queues = mlr_malloc_or_die(num_queues * sizeof(batch_queue_t));
+	memset(preader->queues, 0, num_queues * sizeof(batch_queue_t));
+	preader->max_queue_length = ordered ? MAX_QUEUED_BATCHES : MAX_QUEUED_BATCHES * preader->num_threads;
+	preader->next_file_index = 0;
+	preader->num_files_done = 0;
+	preader->stopping = FALSE;
+
+	preader->consume_file_index = 0;
+	preader->pcurrent = NULL;
+	preader->current_index = 0;
+
+	// The readers are kept until the end, since records may point into them:
+	// e.g. CSV header fields are shared by all the records with that header.
+	preader->workers = mlr_malloc_or_die(preader->num_threads * sizeof(worker_t));
+	for (i = 0; i < preader->num_threads; i++) {
+		worker_t* pworker = &preader->workers[i];
+		pworker->preader = preader;
+		pworker->plrec_reader = lrec_reader_alloc_or_die(&preader->reader_opts);
+		int rc = pthread_create(&pworker->thread, NULL, worker_main, pworker);
+		if (rc != 0) {
+			fprintf(stderr, "%s: could not start reader thread: %s.\n", MLR_GLOBALS.bargv0, strerror(rc));
+			exit(1);
+		}
+	}
+
+	return preader;
+}
+
+// ----------------------------------------------------------------
+void parallel_file_reader_free(parallel_file_reader_t* preader) {
+	if (preader == NULL)
+		return;
+
+	pthread_mutex_lock(&preader->mutex);
+	preader->stopping = TRUE;
+	pthread_cond_broadcast(&preader->space_ready);
+	pthread_mutex_unlock(&preader->mutex);
+	for (int i = 0; i < preader->num_threads; i++)
+		pthread_join(preader->workers[i].thread, NULL);
+
+	if (preader->pcurrent != NULL)
+		batch_free(preader->pcurrent, preader->current_index);
+	int num_queues = preader->ordered ? preader->num_files : 1;
+	for (int i = 0; i < num_queues; i++) {
+		record_batch_t* pnext = NULL;
+		for (record_batch_t* pbatch = preader->queues[i].phead; pbatch != NULL; pbatch = pnext) {
+			pnext = pbatch->pnext;
+			batch_free(pbatch, 0);
+		}
+	}
+
+	pthread_cond_destroy(&preader->space_ready);
+	pthread_cond_destroy(&preader->batch_ready);
+	pthread_mutex_destroy(&preader->mutex);
+	for (int i = 0; i < preader->num_threads; i++) {
+		lrec_reader_t* plrec_reader = preader->workers[i].plrec_reader;
+		plrec_reader->pfree_func(plrec_reader);
+	}
+
+	free(preader->queues);
+	free(preader->workers);
+	free(preader->filenames);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+lrec_t* parallel_file_reader_next(parallel_file_reader_t* preader, context_t* pctx) {
+	while (TRUE) {
+		record_batch_t* pbatch = preader->pcurrent;
+		if (pbatch != NULL) {
+			if (preader->current_index < pbatch->num_records) {
+				lrec_t* prec = pbatch->precords[preader->current_index++];
+				pctx->filenum  = preader->initial_context.filenum + pbatch->file_index + 1;
+				pctx->filename = preader->filenames[pbatch->file_index];
+				pctx->fnr      = pbatch->start_fnr + preader->current_index;
+				return prec;
+			}
+			batch_free(pbatch, pbatch->num_records);
+			preader->pcurrent = NULL;
+		}
+
+		pbatch = take_batch(preader);
+		if (pbatch == NULL)
+			return NULL;
+		preader->pcurrent = pbatch;
+		preader->current_index = 0;
+
+		// As if the file had been read through to here, in case it has no more
+		// records: at end of input the context is left as sequential reading
+		// would leave it.
+		pctx->filenum  = preader->initial_context.filenum + pbatch->file_index + 1;
+		pctx->filename = preader->filenames[pbatch->file_index];
+		pctx->fnr      = pbatch->start_fnr;
+		if (pbatch->auto_line_term != NULL && !pctx->auto_line_term_detected)
+			context_set_autodetected_line_term(pctx, pbatch->auto_line_term);
+	}
+}
+
+// ----------------------------------------------------------------
+static void* worker_main(void* pvarg) {
+	worker_t* pworker = pvarg;
+	parallel_file_reader_t* preader = pworker->preader;
+
+	while (TRUE) {
+		pthread_mutex_lock(&preader->mutex);
+		int file_index = preader->stopping ? preader->num_files : preader->next_file_index;
+		if (file_index < preader->num_files)
+			preader->next_file_index++;
+		pthread_mutex_unlock(&preader->mutex);
+
+		if (file_index >= preader->num_files)
+			break;
+		if (!read_file(preader, pworker->plrec_reader, file_index))
+			break;
+	}
+	return NULL;
+}
+
+// Returns FALSE if stopped partway.
+static int read_file(parallel_file_reader_t* preader, lrec_reader_t* plrec_reader, int file_index) {
+	char* filename = preader->filenames[file_index];
+	char* prepipe = preader->reader_opts.prepipe;
+
+	// The readers only use the context for separators and line-ending detection.
+	context_t ctx = preader->initial_context;
+	ctx.filenum += file_index + 1;
+	ctx.filename = filename;
+	ctx.fnr = 0LL;
+
+	void* pvhandle = plrec_reader->popen_func(plrec_reader->pvstate, prepipe, filename);
+	plrec_reader->psof_func(plrec_reader->pvstate, pvhandle);
+
+	int ok = TRUE;
+	record_batch_t* pbatch = batch_alloc(file_index, 0LL);
+	while (TRUE) {
+		lrec_t* prec = plrec_reader->pprocess_func(plrec_reader->pvstate, pvhandle, &ctx);
+		if (prec == NULL)
+			break;
+		ctx.fnr++;
+		pbatch->precords[pbatch->num_records++] = prec;
+		if (pbatch->num_records == PARALLEL_FILE_READER_BATCH_SIZE) {
+			if (ctx.auto_line_term_detected)
+				pbatch->auto_line_term = ctx.auto_line_term;
+			if (!put_batch(preader, pbatch)) {
+				ok = FALSE;
+				break;
+			}
+			pbatch = batch_alloc(file_index, ctx.fnr);
+		}
+	}
+
+	if (ok) {
+		if (ctx.auto_line_term_detected)
+			pbatch->auto_line_term = ctx.auto_line_term;
+		pbatch->is_last = TRUE;
+		ok = put_batch(preader, pbatch);
+	}
+
+	plrec_reader->pclose_func(plrec_reader->pvstate, pvhandle, prepipe);
+	return ok;
+}
+
+// ----------------------------------------------------------------
+// Blocks while the batch's queue is full. If the reader is being freed, frees
+// the batch and returns FALSE.
+static int put_batch(parallel_file_reader_t* preader, record_batch_t* pbatch) {
+	pthread_mutex_lock(&preader->mutex);
+	batch_queue_t* pqueue = &preader->queues[preader->ordered ? pbatch->file_index : 0];
+	while (!preader->stopping && pqueue->length >= preader->max_queue_length)
+		pthread_cond_wait(&preader->space_ready, &preader->mutex);
+	if (preader->stopping) {
+		pthread_mutex_unlock(&preader->mutex);
+		batch_free(pbatch, 0);
+		return FALSE;
+	}
+
+	if (pqueue->ptail == NULL)
+		pqueue->phead = pbatch;
+	else
+		pqueue->ptail->pnext = pbatch;
+	pqueue->ptail = pbatch;
+	pqueue->length++;
+	if (pbatch->is_last)
+		preader->num_files_done++;
+
+	pthread_cond_signal(&preader->batch_ready);
+	pthread_mutex_unlock(&preader->mutex);
+	return TRUE;
+}
+
+// Blocks until there is a batch to take. Returns NULL at end of input.
+static record_batch_t* take_batch(parallel_file_reader_t* preader) {
+	record_batch_t* pbatch = NULL;
+	pthread_mutex_lock(&preader->mutex);
+	while (TRUE) {
+		batch_queue_t* pqueue = NULL;
+		if (preader->ordered) {
+			if (preader->consume_file_index >= preader->num_files)
+				break;
+			pqueue = &preader->queues[preader->consume_file_index];
+		} else {
+			pqueue = &preader->queues[0];
+			if (pqueue->phead == NULL && preader->num_files_done == preader->num_files)
+				break;
+		}
+
+		if (pqueue->phead != NULL) {
+			pbatch = pqueue->phead;
+			pqueue->phead = pbatch->pnext;
+			if (pqueue->phead == NULL)
+				pqueue->ptail = NULL;
+			pqueue->length--;
+			pbatch->pnext = NULL;
+			if (preader->ordered && pbatch->is_last)
+				preader->consume_file_index++;
+			// Workers on other files may be waiting too, so wake them all.
+			pthread_cond_broadcast(&preader->space_ready);
+			break;
+		}
+		pthread_cond_wait(&preader->batch_ready, &preader->mutex);
+	}
+	pthread_mutex_unlock(&preader->mutex);
+	return pbatch;
+}
+
+// ----------------------------------------------------------------
+static record_batch_t* batch_alloc(int file_index, long long start_fnr) {
+	record_batch_t* pbatch = mlr_malloc_or_die(sizeof(record_batch_t));
+	pbatch->precords       = mlr_malloc_or_die(PARALLEL_FILE_READER_BATCH_SIZE * sizeof(lrec_t*));
+	pbatch->num_records    = 0;
+	pbatch->file_index     = file_index;
+	pbatch->start_fnr      = start_fnr;
+	pbatch->is_last        = FALSE;
+	pbatch->auto_line_term = NULL;
+	pbatch->pnext          = NULL;
+	return pbatch;
+}
+
+static void batch_free(record_batch_t* pbatch, int first_untaken) {
+	for (int i = first_untaken; i < pbatch->num_records; i++)
+		lrec_free(pbatch->precords[i]);
+	free(pbatch->precords);
+	free(pbatch);
+}
+
+#else // MLR_ARCH_THREADS_ENABLED
+
+// Not called: see can_read_files_in_parallel in stream.c.
+parallel_file_reader_t* parallel_file_reader_alloc(cli_reader_opts_t* preader_opts, slls_t* pfilenames,
+	int num_threads, int ordered, context_t* pctx)
+{
+	MLR_INTERNAL_CODING_ERROR();
+	return NULL;
+}
+
+lrec_t* parallel_file_reader_next(parallel_file_reader_t* preader, context_t* pctx) {
+	MLR_INTERNAL_CODING_ERROR();
+	return NULL;
+}
+
+void parallel_file_reader_free(parallel_file_reader_t* preader) {
+}
+
+#endif // MLR_ARCH_THREADS_ENABLED
@@ -0,0 +1,52 @@
+// ================================================================
+// Reading several input files at once, for --read-threads. Each of N worker
+// threads takes the next unread file name, opens it with its own lrec reader,
+// and parses it into batches of records, which are queued for the main thread.
+// The main thread takes the records back one at a time and runs them through
+// the mapper chain as usual, so only reading and parsing are done in parallel.
+//
+// In ordered mode each file has its own queue, and the main thread drains them
+// in command-line order: records come back exactly as they would from reading
+// the files one after another, with FILENAME, FILENUM, and FNR to match.
+// Workers ahead of the file being drained block once a few batches are queued,
+// bounding memory use.
+//
+// In unordered mode all files share one queue, and batches come back in
+// whatever order they're parsed. Each record still gets its own file's
+// FILENAME, FILENUM, and FNR, but records of different files are interleaved,
+// so this is only for chains where input order doesn't matter, such as stats1
+// or count.
+//
+// The workers use the stdio readers: the mmap readers' window and block
+// accounting isn't thread-safe, since records are parsed on one thread and
+// freed on another.
+//
+// A parse error in a later file ends the run when a worker reaches it, which
+// may be before the records of earlier files have all been output.
+// ================================================================
+
+#ifndef PARALLEL_FILE_READER_H
+#define PARALLEL_FILE_READER_H
+
+#include "cli/mlrcli.h"
+#include "containers/lrec.h"
+#include "containers/slls.h"
+#include "lib/context.h"
+
+typedef struct _parallel_file_reader_t parallel_file_reader_t;
+
+// The context supplies the starting FILENUM and the separators. Reading starts
+// right away.
+parallel_file_reader_t* parallel_file_reader_alloc(cli_reader_opts_t* preader_opts, slls_t* pfilenames,
+	int num_threads, int ordered, context_t* pctx);
+
+// Returns the next record, having set FILENAME, FILENUM, and FNR in the context
+// for it; or NULL at end of input.
+lrec_t* parallel_file_reader_next(parallel_file_reader_t* preader, context_t* pctx);
+
+// Stops the workers, if they aren't done, and frees any records not yet taken.
+// As with an lrec reader, records may point into the reader (e.g. CSV header
+// fields), so this is for after the end-of-stream processing.
+void parallel_file_reader_free(parallel_file_reader_t* preader);
+
+#endif // PARALLEL_FILE_READER_H
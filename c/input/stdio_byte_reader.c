@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "input/byte_readers.h"
+#include "input/file_decompressor.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlr_arch.h"
 #include "lib/mlrutil.h"
@@ -45,7 +46,7 @@ static int stdio_byte_reader_open_func(struct _byte_reader_t* pbr, char* prepipe
 		if (streq(pstate->filename, "-")) {
 			pstate->fp = stdin;
 		} else {
-			pstate->fp = fopen(filename, "r");
+			pstate->fp = file_decompressor_fopen(filename);
 			if (pstate->fp == NULL) {
 				perror("fopen");
 				fprintf(stderr, "%s: Couldn't fopen \"%s\" for read.\n", MLR_GLOBALS.bargv0, filename);
@@ -59,7 +60,7 @@ static int stdio_byte_reader_open_func(struct _byte_reader_t* pbr, char* prepipe
 			sprintf(command, "%s", prepipe);
 		else
 			sprintf(command, "%s < %s", prepipe, escaped_filename);
-		pstate->fp = popen(command, "r");
+		pstate->fp = mlr_arch_popen_for_read(command);
 		if (pstate->fp == NULL) {
 			fprintf(stderr, "%s: Couldn't popen \"%s\" for read.\n", MLR_GLOBALS.bargv0, command);
 			perror(command);
@@ -90,7 +91,7 @@ static void stdio_byte_reader_close_func(struct _byte_reader_t* pbr, char* prepi
 		if (pstate->fp != stdin)
 			fclose(pstate->fp);
 	} else {
-		pclose(pstate->fp);
+		mlr_arch_pclose_for_read(pstate->fp);
 	}
 	free(pstate->filename);
 	free(pstate);
@@ -0,0 +1,77 @@
+// ================================================================
+// Miller's binary record format, for --ibin/--obin: a columnar encoding for
+// passing records from one mlr process to the next, as in
+//
+//   mlr --icsv --obin cat a.csv | mlr --ibin --obin sort -f x | mlr --ibin --ojson head
+//
+// without formatting each record as text and scanning it back in. Records are
+// written in batches of consecutive records having the same field names. A
+// batch names the fields once, then gives each column's values one after
+// another, each with its length up front, so the reader needn't look for
+// separators or worry about escaping.
+//
+// All integers are unsigned and little-endian.
+//
+// * Stream header: the four bytes "MLRB", then a u32 format version. The writer
+//   starts its output with this. The reader accepts it before any batch, so
+//   that binary outputs can be concatenated.
+//
+// * Batch header: u32 number of records, u32 number of fields, u64 length of
+//   the batch body which follows.
+//
+// * Batch body: for each field, a u32 name length and the name; then for each
+//   field, for each record, a u32 value length and the value. Each name and
+//   value is followed by a null terminator, not counted in its length, so
+//   that records can point into the body as read.
+//
+// The high bit of a value's length is set if the value was double-quoted in CSV
+// input, for --quote-original on CSV output.
+//
+// Values are carried as strings, as records hold them: Miller infers numeric
+// types from field values only when they're used, e.g. in DSL expressions.
+// ================================================================
+
+#ifndef BIN_FORMAT_H
+#define BIN_FORMAT_H
+
+#include <stdint.h>
+
+#define BIN_FORMAT_MAGIC             "MLRB"
+#define BIN_FORMAT_MAGIC_LENGTH      4
+#define BIN_FORMAT_VERSION           1
+#define BIN_FORMAT_BATCH_HEADER_SIZE 16
+#define BIN_FORMAT_QUOTED_BIT        0x80000000U
+#define BIN_FORMAT_MAX_LENGTH        0x7fffffffU
+
+// Allow compile-time override, e.g using gcc -D.
+#ifndef BIN_FORMAT_MAX_BATCH_RECORDS
+#define BIN_FORMAT_MAX_BATCH_RECORDS 1024
+#endif
+#ifndef BIN_FORMAT_MAX_BATCH_BYTES
+#define BIN_FORMAT_MAX_BATCH_BYTES (1024*1024)
+#endif
+
+// ----------------------------------------------------------------
+static inline void bin_format_put_u32(char* p, uint32_t u) {
+	unsigned char* q = (unsigned char*)p;
+	q[0] = u & 0xff;
+	q[1] = (u >> 8) & 0xff;
+	q[2] = (u >> 16) & 0xff;
+	q[3] = (u >> 24) & 0xff;
+}
+
+static inline void bin_format_put_u64(char* p, uint64_t u) {
+	bin_format_put_u32(p, u & 0xffffffffU);
+	bin_format_put_u32(p + 4, u >> 32);
+}
+
+static inline uint32_t bin_format_get_u32(char* p) {
+	unsigned char* q = (unsigned char*)p;
+	return (uint32_t)q[0] | ((uint32_t)q[1] << 8) | ((uint32_t)q[2] << 16) | ((uint32_t)q[3] << 24);
+}
+
+static inline uint64_t bin_format_get_u64(char* p) {
+	return (uint64_t)bin_format_get_u32(p) | ((uint64_t)bin_format_get_u32(p + 4) << 32);
+}
+
+#endif // BIN_FORMAT_H
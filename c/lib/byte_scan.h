@@ -0,0 +1,130 @@
+// ================================================================
+// Finding the next occurrence of any of two to four delimiter bytes, for the
+// record readers' inner loops. Rather than trying a parse-trie match or a
+// multi-way comparison at every byte, a reader can skip directly to the next
+// byte which could start a separator, and do its full matching only there.
+//
+// Blocks of 32 bytes (with AVX2) or 16 bytes (with SSE2) are compared against
+// each delimiter at once, and the comparison results are OR-ed into one bit
+// mask per block, whose lowest set bit is the first match. There is a scalar
+// fallback for other architectures and for the tail of the input. Loads never
+// go past the end pointer, so these are safe on memory-mapped input.
+//
+// Where separators are only a few bytes apart, as in DKVP and NIDX, finding
+// each with its own scan costs a load per token. There the readers instead
+// take a bit mask of all the candidate bytes in a block, and go through its set
+// bits.
+//
+// For a single delimiter byte, use memchr, which the C library already
+// vectorizes.
+// ================================================================
+
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ----------------------------------------------------------------
+// Returns a pointer to the first byte in [p, e) equal to a, b, c, or d; else e.
+static inline char* byte_scan_4(char* p, char* e, char a, char b, char c, char d) {
+#if defined(__AVX2__)
+	__m256i va = _mm256_set1_epi8(a);
+	__m256i vb = _mm256_set1_epi8(b);
+	__m256i vc = _mm256_set1_epi8(c);
+	__m256i vd = _mm256_set1_epi8(d);
+	for ( ; e - p >= 32; p += 32) {
+		__m256i block = _mm256_loadu_si256((__m256i*)p);
+		__m256i hits = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, va), _mm256_cmpeq_epi8(block, vb)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, vc), _mm256_cmpeq_epi8(block, vd)));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(hits);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+	}
+#elif defined(__SSE2__)
+	__m128i va = _mm_set1_epi8(a);
+	__m128i vb = _mm_set1_epi8(b);
+	__m128i vc = _mm_set1_epi8(c);
+	__m128i vd = _mm_set1_epi8(d);
+	for ( ; e - p >= 16; p += 16) {
+		__m128i block = _mm_loadu_si128((__m128i*)p);
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb)),
+			_mm_or_si128(_mm_cmpeq_epi8(block, vc), _mm_cmpeq_epi8(block, vd)));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(hits);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+	}
+#endif
+	for ( ; p < e; p++)
+		if (*p == a || *p == b || *p == c || *p == d)
+			return p;
+	return e;
+}
+
+// Returns a pointer to the first byte in [p, e) equal to a, b, or c; else e.
+static inline char* byte_scan_3(char* p, char* e, char a, char b, char c) {
+	return byte_scan_4(p, e, a, b, c, c);
+}
+
+// Returns a pointer to the first byte in [p, e) equal to a or b; else e.
+static inline char* byte_scan_2(char* p, char* e, char a, char b) {
+	return byte_scan_3(p, e, a, b, b);
+}
+
+// ----------------------------------------------------------------
+#if defined(__AVX2__)
+#define BYTE_SCAN_BLOCK_SIZE 32
+#elif defined(__SSE2__)
+#define BYTE_SCAN_BLOCK_SIZE 16
+#else
+#define BYTE_SCAN_BLOCK_SIZE 32
+#endif
+
+// Returns a mask with bit i set if p[i] is a, b, c, or d, for the
+// BYTE_SCAN_BLOCK_SIZE bytes at p or as many as there are before e. Typical use:
+//
+//   for (char* block = p; block < e; block += BYTE_SCAN_BLOCK_SIZE) {
+//     unsigned int mask = byte_scan_block_4(block, e, a, b, c, d);
+//     for ( ; mask != 0; mask &= mask - 1) {
+//       char* q = block + __builtin_ctz(mask);
+//       ...
+static inline unsigned int byte_scan_block_4(char* p, char* e, char a, char b, char c, char d) {
+#if defined(__AVX2__)
+	if (e - p >= 32) {
+		__m256i block = _mm256_loadu_si256((__m256i*)p);
+		__m256i hits = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(a)), _mm256_cmpeq_epi8(block, _mm256_set1_epi8(b))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(c)), _mm256_cmpeq_epi8(block, _mm256_set1_epi8(d))));
+		return (unsigned int)_mm256_movemask_epi8(hits);
+	}
+#elif defined(__SSE2__)
+	if (e - p >= 16) {
+		__m128i block = _mm_loadu_si128((__m128i*)p);
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(a)), _mm_cmpeq_epi8(block, _mm_set1_epi8(b))),
+			_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)), _mm_cmpeq_epi8(block, _mm_set1_epi8(d))));
+		return (unsigned int)_mm_movemask_epi8(hits);
+	}
+#endif
+	unsigned int mask = 0;
+	int n = e - p < BYTE_SCAN_BLOCK_SIZE ? e - p : BYTE_SCAN_BLOCK_SIZE;
+	for (int i = 0; i < n; i++)
+		if (p[i] == a || p[i] == b || p[i] == c || p[i] == d)
+			mask |= 1U << i;
+	return mask;
+}
+
+static inline unsigned int byte_scan_block_3(char* p, char* e, char a, char b, char c) {
+	return byte_scan_block_4(p, e, a, b, c, c);
+}
+
+static inline unsigned int byte_scan_block_2(char* p, char* e, char a, char b) {
+	return byte_scan_block_4(p, e, a, b, b, b);
+}
+
+#endif // BYTE_SCAN_H
@@ -1,6 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include "mlr_globals.h"
 #include "mlr_arch.h"
 #include "mlrutil.h"
@@ -71,3 +78,94 @@ time_t mlr_arch_timegmlocal(struct tm* ptm, timezone_handling_t timezone_handlin
 	return ret;
 #endif
 }
+
+// ----------------------------------------------------------------
+// Commands are run with fork and exec, as popen does, keeping each one's
+// process ID so that it can be stopped. Otherwise pclose would wait for it: for
+// a command like grep over a large file, that may take as long as reading all
+// of the output would have.
+#ifndef MLR_ON_MSYS2
+typedef struct _popen_child_t {
+	FILE* input_stream;
+	pid_t pid;
+	struct _popen_child_t* pnext;
+} popen_child_t;
+
+// The --read-threads workers may open and close commands concurrently.
+static popen_child_t*  popen_children = NULL;
+static pthread_mutex_t popen_children_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+FILE* mlr_arch_popen_for_read(char* command) {
+#ifdef MLR_ON_MSYS2
+	return popen(command, "r");
+#else
+	int pipe_fds[2];
+	pthread_mutex_lock(&popen_children_mutex);
+	if (pipe(pipe_fds) < 0) {
+		pthread_mutex_unlock(&popen_children_mutex);
+		return NULL;
+	}
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(pipe_fds[0]);
+		if (pipe_fds[1] != STDOUT_FILENO) {
+			dup2(pipe_fds[1], STDOUT_FILENO);
+			close(pipe_fds[1]);
+		}
+		execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+		_exit(127);
+	}
+	close(pipe_fds[1]);
+	if (pid < 0) {
+		close(pipe_fds[0]);
+		pthread_mutex_unlock(&popen_children_mutex);
+		return NULL;
+	}
+
+	// As with popen, later commands don't inherit this one's output.
+	fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+	FILE* input_stream = fdopen(pipe_fds[0], "r");
+	if (input_stream == NULL) {
+		perror("fdopen");
+		exit(1);
+	}
+	popen_child_t* pchild = mlr_malloc_or_die(sizeof(popen_child_t));
+	pchild->input_stream = input_stream;
+	pchild->pid          = pid;
+	pchild->pnext        = popen_children;
+	popen_children       = pchild;
+	pthread_mutex_unlock(&popen_children_mutex);
+	return input_stream;
+#endif
+}
+
+void mlr_arch_pclose_for_read(FILE* input_stream) {
+#ifdef MLR_ON_MSYS2
+	pclose(input_stream);
+#else
+	pid_t pid = -1;
+	pthread_mutex_lock(&popen_children_mutex);
+	for (popen_child_t** ppchild = &popen_children; *ppchild != NULL; ppchild = &(*ppchild)->pnext) {
+		popen_child_t* pchild = *ppchild;
+		if (pchild->input_stream == input_stream) {
+			pid = pchild->pid;
+			*ppchild = pchild->pnext;
+			free(pchild);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&popen_children_mutex);
+	MLR_INTERNAL_CODING_ERROR_IF(pid < 0);
+
+	// Readers which use the file descriptor directly don't set end of file on
+	// the stream; a command which has exited has nothing more to stop.
+	int stopped_early = !feof(input_stream) && !ferror(input_stream);
+	fclose(input_stream);
+	if (stopped_early && waitpid(pid, NULL, WNOHANG) == 0)
+		kill(pid, SIGTERM);
+	while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+		;
+#endif
+}
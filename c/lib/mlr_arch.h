@@ -14,8 +14,8 @@
 #undef MLR_ON_MSYS2 // sedded to #define in appveyor setup
 
 // ----------------------------------------------------------------
-// Miller is single-threaded and the file-locking in getc is simply an unneeded
-// performance hit, so we intentionally call getc_unlocked().  But for MSYS2
+// Each input stream is only ever read by one thread and the file-locking in getc
+// is simply an unneeded performance hit, so we intentionally call getc_unlocked().  But for MSYS2
 // (Windows port), there exists no such.
 #ifdef MLR_ON_MSYS2
 #define mlr_arch_getc(stream) getc(stream)
@@ -31,6 +31,20 @@
 #include <sys/mman.h>
 #endif
 
+// Native decompression of input files uses zlib and a pthread.
+#ifdef MLR_ON_MSYS2
+#define MLR_ARCH_DECOMPRESSION_ENABLED 0
+#else
+#define MLR_ARCH_DECOMPRESSION_ENABLED 1
+#endif
+
+// Reading input files on worker threads, for --read-threads.
+#ifdef MLR_ON_MSYS2
+#define MLR_ARCH_THREADS_ENABLED 0
+#else
+#define MLR_ARCH_THREADS_ENABLED 1
+#endif
+
 // ----------------------------------------------------------------
 int mlr_arch_setenv(const char *name, const char *value);
 int mlr_arch_unsetenv(const char *name);
@@ -38,4 +52,10 @@ int mlr_arch_unsetenv(const char *name);
 char *mlr_arch_strptime(const char *s, const char *format, struct tm *ptm);
 time_t mlr_arch_timegmlocal(struct tm* ptm, timezone_handling_t timezone_handling);
 
+// For --prepipe: as popen and pclose for reading, except that closing before
+// the command's output has all been read, as when mlr head has all the records
+// it needs, stops the command rather than waiting for it to finish.
+FILE* mlr_arch_popen_for_read(char* command);
+void  mlr_arch_pclose_for_read(FILE* input_stream);
+
 #endif // MLR_ARCH_H
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "lib/mlrutil.h"
+#include "mapping/acc_state.h"
+
+static char* hex_digits = "0123456789ABCDEF";
+
+// ----------------------------------------------------------------
+static void acc_state_put_separator(string_builder_t* psb) {
+	if (!sb_is_empty(psb))
+		sb_append_char(psb, ACC_STATE_SEPARATOR);
+}
+
+void acc_state_put_int(string_builder_t* psb, long long intv) {
+	char buf[32];
+	acc_state_put_separator(psb);
+	snprintf(buf, sizeof(buf), "i%lld", intv);
+	sb_append_string(psb, buf);
+}
+
+void acc_state_put_float(string_builder_t* psb, double fltv) {
+	char buf[64];
+	acc_state_put_separator(psb);
+	snprintf(buf, sizeof(buf), "f%a", fltv);
+	sb_append_string(psb, buf);
+}
+
+void acc_state_put_string(string_builder_t* psb, char* strv) {
+	acc_state_put_separator(psb);
+	sb_append_char(psb, 's');
+	for (unsigned char* p = (unsigned char*)strv; *p; p++) {
+		if (isalnum(*p) || *p == '.' || *p == '_' || *p == '-') {
+			sb_append_char(psb, *p);
+		} else {
+			sb_append_char(psb, '%');
+			sb_append_char(psb, hex_digits[*p >> 4]);
+			sb_append_char(psb, hex_digits[*p & 0xf]);
+		}
+	}
+}
+
+void acc_state_put_mv(string_builder_t* psb, mv_t* pval) {
+	switch (pval->type) {
+	case MT_INT:
+		acc_state_put_int(psb, pval->u.intv);
+		break;
+	case MT_FLOAT:
+		acc_state_put_float(psb, pval->u.fltv);
+		break;
+	case MT_STRING:
+		acc_state_put_string(psb, pval->u.strv);
+		break;
+	default:
+		acc_state_put_separator(psb);
+		sb_append_char(psb, 'a');
+		break;
+	}
+}
+
+// ----------------------------------------------------------------
+// Returns the next item, null-terminated in place, or NULL if there are no more.
+static char* acc_state_next_item(char** ppos) {
+	char* item = *ppos;
+	if (item == NULL)
+		return NULL;
+	char* p = item;
+	while (*p && *p != ACC_STATE_SEPARATOR)
+		p++;
+	if (*p) {
+		*p = 0;
+		*ppos = p + 1;
+	} else {
+		*ppos = NULL;
+	}
+	return item;
+}
+
+static int hex_value(char c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+static int acc_state_scan_int(char* s, long long* pintv) {
+	char* end = NULL;
+	if (*s == 0)
+		return FALSE;
+	*pintv = strtoll(s, &end, 10);
+	return *end == 0;
+}
+
+static int acc_state_scan_float(char* s, double* pfltv) {
+	char* end = NULL;
+	if (*s == 0)
+		return FALSE;
+	*pfltv = strtod(s, &end);
+	return *end == 0;
+}
+
+// Percent-decodes in place.
+static int acc_state_scan_string(char* s) {
+	char* q = s;
+	for (char* p = s; *p; ) {
+		if (*p == '%') {
+			int hi = hex_value(p[1]);
+			int lo = hi < 0 ? -1 : hex_value(p[2]);
+			if (lo < 0)
+				return FALSE;
+			*q++ = (char)((hi << 4) | lo);
+			p += 3;
+		} else {
+			*q++ = *p++;
+		}
+	}
+	*q = 0;
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+int acc_state_get_int(char** ppos, long long* pintv) {
+	char* item = acc_state_next_item(ppos);
+	return item != NULL && item[0] == 'i' && acc_state_scan_int(&item[1], pintv);
+}
+
+int acc_state_get_float(char** ppos, double* pfltv) {
+	char* item = acc_state_next_item(ppos);
+	return item != NULL && item[0] == 'f' && acc_state_scan_float(&item[1], pfltv);
+}
+
+int acc_state_get_string(char** ppos, char** pstrv) {
+	char* item = acc_state_next_item(ppos);
+	if (item == NULL || item[0] != 's' || !acc_state_scan_string(&item[1]))
+		return FALSE;
+	*pstrv = &item[1];
+	return TRUE;
+}
+
+int acc_state_get_mv(char** ppos, mv_t* pval) {
+	char* item = acc_state_next_item(ppos);
+	if (item == NULL)
+		return FALSE;
+	switch (item[0]) {
+	case 'i':
+		*pval = mv_from_int(0LL);
+		return acc_state_scan_int(&item[1], &pval->u.intv);
+	case 'f':
+		*pval = mv_from_float(0.0);
+		return acc_state_scan_float(&item[1], &pval->u.fltv);
+	case 's':
+		if (!acc_state_scan_string(&item[1]))
+			return FALSE;
+		*pval = mv_from_string_with_free(mlr_strdup_or_die(&item[1]));
+		return TRUE;
+	case 'a':
+		*pval = mv_absent();
+		return item[1] == 0;
+	default:
+		return FALSE;
+	}
+}
+
+int acc_state_get_count(char** ppos, unsigned long long* pcount) {
+	long long intv = 0LL;
+	if (!acc_state_get_int(ppos, &intv) || intv < 0LL)
+		return FALSE;
+	*pcount = intv;
+	return TRUE;
+}
+
+int acc_state_at_end(char** ppos) {
+	return *ppos == NULL;
+}
@@ -0,0 +1,50 @@
+// ================================================================
+// Text encoding of accumulator states, for stats1/stats2 --dump-state and
+// --merge-state.
+//
+// A dumped state is a single field value, so that it can be carried in any of
+// Miller's file formats: a semicolon-separated list of items, each of which is
+// one of
+//
+//   i{decimal}    integer
+//   f{hexfloat}   float, in C99 %a format so that it reads back bit-for-bit
+//   s{string}     string, with all but alphanumerics and . _ - percent-encoded
+//   a             absent
+//
+// so a state never contains whitespace, commas, equals signs, quotes, or
+// anything else which some file format would need to escape.
+// ================================================================
+
+#ifndef ACC_STATE_H
+#define ACC_STATE_H
+
+#include "lib/mlrval.h"
+#include "lib/string_builder.h"
+
+#define ACC_STATE_SEPARATOR ';'
+
+// ----------------------------------------------------------------
+// Writers. Each appends one item, with a separator before it if the builder is
+// nonempty.
+void acc_state_put_int(string_builder_t* psb, long long intv);
+void acc_state_put_float(string_builder_t* psb, double fltv);
+void acc_state_put_string(string_builder_t* psb, char* strv);
+// Numbers and strings keep their types; empty and absent values are written as absent.
+void acc_state_put_mv(string_builder_t* psb, mv_t* pval);
+
+// ----------------------------------------------------------------
+// Readers. The cursor starts at the dumped string and is advanced past each
+// item read; the string is modified in place. Each returns FALSE if the next
+// item isn't of the expected type or there is none.
+int acc_state_get_int(char** ppos, long long* pintv);
+int acc_state_get_float(char** ppos, double* pfltv);
+// The string points into the dumped string.
+int acc_state_get_string(char** ppos, char** pstrv);
+// Strings are copied, with the copy owned by the returned mlrval.
+int acc_state_get_mv(char** ppos, mv_t* pval);
+// For the count which prefixes a variable-length list of items.
+int acc_state_get_count(char** ppos, unsigned long long* pcount);
+// TRUE if all items have been read.
+int acc_state_at_end(char** ppos);
+
+#endif // ACC_STATE_H
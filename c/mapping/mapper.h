@@ -6,6 +6,7 @@
 #include "cli/mlrcli.h"
 #include "containers/lrec.h"
 #include "containers/sllv.h"
+#include "containers/hss.h"
 
 // See ../README.md for memory-management conventions.
 
@@ -32,11 +33,30 @@ typedef void mapper_usage_func_t(FILE* o, char* argv0, char* verb);
 typedef      mapper_t* mapper_parse_cli_func_t(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts);
 
+// Which fields of its input records a mapper looks at, when that's known from
+// its arguments, so that the reader needn't make lrec entries for the others.
+// The func adds the field names to the set and says what becomes of the rest:
+//
+// * MAPPER_USES_NAMED_FIELDS_ONLY: its output depends on nothing else, as with
+//   cut -f or stats1. Nothing further down the chain sees the other fields.
+// * MAPPER_PASSES_OTHER_FIELDS: it passes records on to the next mapper with
+//   the other fields unlooked-at, as with sort -f or head -g; which of them
+//   are needed is up to the rest of the chain.
+// * MAPPER_USES_ALL_FIELDS: anything else, including not knowing.
+typedef enum _mapper_field_usage_t {
+	MAPPER_USES_ALL_FIELDS = 0,
+	MAPPER_USES_NAMED_FIELDS_ONLY,
+	MAPPER_PASSES_OTHER_FIELDS,
+} mapper_field_usage_t;
+
+typedef mapper_field_usage_t mapper_field_usage_func_t(mapper_t* pmapper, hss_t* pfield_names);
+
 typedef struct _mapper_setup_t {
 	char*                    verb;
 	mapper_usage_func_t*     pusage_func;
 	mapper_parse_cli_func_t* pparse_func;
 	int                      ignores_input; // most don't; data-generators like seqgen do
+	mapper_field_usage_func_t* pfield_usage_func; // optional; absent means all fields are used
 } mapper_setup_t;
 
 #endif // MAPPER_H
@@ -5,7 +5,7 @@
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
 #include "containers/sllv.h"
-#include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/lhmsv.h"
 #include "containers/lhmsll.h"
 #include "containers/mixutil.h"
@@ -17,8 +17,8 @@
 typedef struct _mapper_count_similar_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
-	lhmslv_t* pcounts_by_group;
-	lhmslv_t* precord_lists_by_group;
+	group_key_t* pgroup_key;
+	group_table_t* precord_lists_by_group;
 	char* output_field_name;
 } mapper_count_similar_state_t;
 
@@ -103,8 +103,8 @@ static mapper_t* mapper_count_similar_alloc(ap_state_t* pargp, slls_t* pgroup_by
 
 	pstate->pargp                  = pargp;
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
-	pstate->pcounts_by_group       = lhmslv_alloc();
-	pstate->precord_lists_by_group = lhmslv_alloc();
+	pstate->pgroup_key             = group_key_alloc();
+	pstate->precord_lists_by_group = group_table_alloc(pgroup_by_field_names->length);
 	pstate->output_field_name      = output_field_name;
 
 	pmapper->pvstate = pstate;
@@ -118,24 +118,18 @@ static void mapper_count_similar_free(mapper_t* pmapper, context_t* _) {
 	mapper_count_similar_state_t* pstate = pmapper->pvstate;
 	slls_free(pstate->pgroup_by_field_names);
 
-	// lhmslv_free will free the keys: we only need to free the void-star values.
-	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
-		unsigned long long* pcount = pa->pvvalue;
-		free(pcount);
-	}
-	lhmslv_free(pstate->pcounts_by_group);
-
-	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->precord_lists_by_group->phead; pa != NULL; pa = pa->pnext) {
-		sllv_t* precord_list_for_group = pa->pvvalue;
+	// group_table_free will free the keys; we need to free the void-star values.
+	for (int i = 0; i < pstate->precord_lists_by_group->num_entries; i++) {
+		sllv_t* precord_list_for_group = pstate->precord_lists_by_group->entries[i].pvvalue;
 		// outrecs were freed by caller of mapper_tail_process. Here, just free
 		// the sllv container itself.
 		sllv_free(precord_list_for_group);
 	}
-	lhmslv_free(pstate->precord_lists_by_group);
+	group_table_free(pstate->precord_lists_by_group);
+	group_key_free(pstate->pgroup_key);
 
 	pstate->pgroup_by_field_names = NULL;
-	pstate->pcounts_by_group = NULL;
+	pstate->precord_lists_by_group = NULL;
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -145,49 +139,29 @@ static void mapper_count_similar_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_count_similar_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_count_similar_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values == NULL) {
+		if (!group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
 			lrec_free(pinrec);
 			return NULL;
 		}
 
-		unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
-		if (pcount == NULL) {
-			pcount = mlr_malloc_or_die(sizeof(unsigned long long));
-			*pcount = 1LL;
-			lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
-		} else {
-			(*pcount)++;
-		}
-
-		sllv_t* precord_list_for_group = lhmslv_get(pstate->precord_lists_by_group, pgroup_by_field_values);
-		if (precord_list_for_group == NULL) {
-			precord_list_for_group = sllv_alloc();
-			lhmslv_put(pstate->precord_lists_by_group, slls_copy(pgroup_by_field_values), precord_list_for_group,
-				FREE_ENTRY_KEY);
+		sllv_t** pprecord_list_for_group = (sllv_t**)group_table_get_or_add(pstate->precord_lists_by_group,
+			pstate->pgroup_key);
+		if (*pprecord_list_for_group == NULL)
+			*pprecord_list_for_group = sllv_alloc();
+		sllv_append(*pprecord_list_for_group, pinrec);
 
-		}
-		sllv_append(precord_list_for_group, pinrec);
-
-		slls_free(pgroup_by_field_values);
 		return NULL;
 
 	} else {
 		sllv_t* poutrecs = sllv_alloc();
-		for (lhmslve_t* pa = pstate->precord_lists_by_group->phead; pa != NULL; pa = pa->pnext) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pa->key);
-			if (pcount == NULL) {
-				fprintf(stderr, "%s: internal coding error detected in file %s at line %d.\n",
-					MLR_GLOBALS.bargv0, __FILE__, __LINE__);
-				exit(1);
-			}
-
-			sllv_t* precord_list_for_group = pa->pvvalue;
+		for (int i = 0; i < pstate->precord_lists_by_group->num_entries; i++) {
+			sllv_t* precord_list_for_group = pstate->precord_lists_by_group->entries[i].pvvalue;
+			// The group's count is the length of its record list.
+			long long count = precord_list_for_group->length;
 			while (precord_list_for_group->phead != NULL) {
 				lrec_t* poutrec = sllv_pop(precord_list_for_group);
 
-				char* scount = mlr_alloc_string_from_ll(*pcount);
+				char* scount = mlr_alloc_string_from_ll(count);
 				lrec_put(poutrec, pstate->output_field_name, scount, FREE_ENTRY_VALUE);
 				sllv_append(poutrecs, poutrec);
 			}
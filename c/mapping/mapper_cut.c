@@ -23,6 +23,7 @@ static mapper_t* mapper_cut_parse_cli(int* pargi, int argc, char** argv,
 static mapper_t* mapper_cut_alloc(ap_state_t* pargp, slls_t* pfield_name_list,
 	int do_arg_order, int do_complement, int do_regexes);
 static void      mapper_cut_free(mapper_t* pmapper, context_t* _);
+static mapper_field_usage_t mapper_cut_field_usage(mapper_t* pmapper, hss_t* pfield_names);
 static sllv_t*   mapper_cut_process_no_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_cut_process_with_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -32,6 +33,7 @@ mapper_setup_t mapper_cut_setup = {
 	.pusage_func = mapper_cut_usage,
 	.pparse_func = mapper_cut_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_cut_field_usage,
 };
 
 // ----------------------------------------------------------------
@@ -135,6 +137,17 @@ static void mapper_cut_free(mapper_t* pmapper, context_t* _) {
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+// Field names given as regexes or with -x don't say which fields are output.
+static mapper_field_usage_t mapper_cut_field_usage(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_cut_state_t* pstate = pmapper->pvstate;
+	if (pstate->pfield_name_list == NULL || pstate->do_complement)
+		return MAPPER_USES_ALL_FIELDS;
+	for (sllse_t* pe = pstate->pfield_name_list->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_USES_NAMED_FIELDS_ONLY;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_cut_process_no_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	if (pinrec != NULL) {
@@ -4,7 +4,7 @@
 #include <math.h>
 #include "lib/mlrutil.h"
 #include "containers/sllv.h"
-#include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
 #include "mapping/mappers.h"
@@ -15,14 +15,19 @@ typedef struct _mapper_head_state_t {
 	slls_t* pgroup_by_field_names;
 	unsigned long long head_count;
 	unsigned long long unkeyed_record_count;
-	lhmslv_t* pcounts_by_group;
+	unsigned long long num_groups_known;
+	unsigned long long num_groups_filled;
+	group_key_t* pgroup_key;
+	group_table_t* pcounts_by_group;
 } mapper_head_state_t;
 
 static void      mapper_head_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_head_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
-static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, unsigned long long head_count);
+static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, unsigned long long head_count,
+	unsigned long long num_groups_known);
 static void      mapper_head_free(mapper_t* pmapper, context_t* _);
+static mapper_field_usage_t mapper_head_field_usage(mapper_t* pmapper, hss_t* pfield_names);
 static sllv_t*   mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_head_process_keyed(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -32,6 +37,7 @@ mapper_setup_t mapper_head_setup = {
 	.pusage_func = mapper_head_usage,
 	.pparse_func = mapper_head_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_head_field_usage,
 };
 
 // ----------------------------------------------------------------
@@ -39,15 +45,18 @@ static void mapper_head_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "Usage: %s %s [options]\n", argv0, verb);
 	fprintf(o, "-n {count}    Head count to print; default 10\n");
 	fprintf(o, "-g {a,b,c}    Optional group-by-field names for head counts\n");
+	fprintf(o, "--groups-known {m} With -g: there are at most m distinct groups in the\n");
+	fprintf(o, "              input. Once m groups each have n records, no more input is read.\n");
 	fprintf(o, "Passes through the first n records, optionally by category.\n");
 	fprintf(o, "Without -g, ceases consuming more input (i.e. is fast) when n\n");
-	fprintf(o, "records have been read.\n");
+	fprintf(o, "records have been read; likewise with -g and --groups-known.\n");
 }
 
 static mapper_t* mapper_head_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __)
 {
 	int     head_count            = 10;
+	int     num_groups_known      = 0;
 	slls_t* pgroup_by_field_names = slls_alloc();
 
 	char* verb = argv[(*pargi)++];
@@ -55,17 +64,24 @@ static mapper_t* mapper_head_parse_cli(int* pargi, int argc, char** argv,
 	ap_state_t* pstate = ap_alloc();
 	ap_define_int_flag(pstate, "-n", &head_count);
 	ap_define_string_list_flag(pstate, "-g", &pgroup_by_field_names);
+	ap_define_int_flag(pstate, "--groups-known", &num_groups_known);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_head_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (num_groups_known < 0 || (num_groups_known > 0 && pgroup_by_field_names->length == 0)) {
+		mapper_head_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
-	return mapper_head_alloc(pstate, pgroup_by_field_names, head_count);
+	return mapper_head_alloc(pstate, pgroup_by_field_names, head_count, num_groups_known);
 }
 
 // ----------------------------------------------------------------
-static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, unsigned long long head_count) {
+static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names, unsigned long long head_count,
+	unsigned long long num_groups_known)
+{
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
 	mapper_head_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_head_state_t));
@@ -74,7 +90,10 @@ static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
 	pstate->head_count             = head_count;
 	pstate->unkeyed_record_count   = 0LL;
-	pstate->pcounts_by_group       = lhmslv_alloc();
+	pstate->num_groups_known       = num_groups_known;
+	pstate->num_groups_filled      = 0LL;
+	pstate->pgroup_key             = group_key_alloc();
+	pstate->pcounts_by_group       = group_table_alloc(pgroup_by_field_names->length);
 
 	pmapper->pvstate        = pstate;
 	pmapper->pprocess_func  = pgroup_by_field_names->length == 0
@@ -89,23 +108,33 @@ static void mapper_head_free(mapper_t* pmapper, context_t* _) {
 	mapper_head_state_t* pstate = pmapper->pvstate;
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
-	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
-		unsigned long long* pcount_for_group = pa->pvvalue;
-		free(pcount_for_group);
-	}
-	lhmslv_free(pstate->pcounts_by_group);
+	// group_table_free will free the keys; we need to free the void-star values.
+	for (int i = 0; i < pstate->pcounts_by_group->num_entries; i++)
+		free(pstate->pcounts_by_group->entries[i].pvvalue);
+	group_table_free(pstate->pcounts_by_group);
+	group_key_free(pstate->pgroup_key);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
 }
 
+static mapper_field_usage_t mapper_head_field_usage(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_head_state_t* pstate = pmapper->pvstate;
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_PASSES_OTHER_FIELDS;
+}
+
 // ----------------------------------------------------------------
+// Input stops as soon as the last record to be passed through has been seen,
+// so that e.g. mlr head -n 1 on a pipe needn't wait for a second line.
 static sllv_t* mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_head_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
 		pstate->unkeyed_record_count++;
 		if (pstate->unkeyed_record_count <= pstate->head_count) {
+			if (pstate->unkeyed_record_count == pstate->head_count)
+				pctx->force_eof = TRUE;
 			return sllv_single(pinrec);
 		} else {
 			pctx->force_eof = TRUE;
@@ -121,23 +150,24 @@ static sllv_t* mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void
 static sllv_t* mapper_head_process_keyed(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_head_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values == NULL) {
+		if (!group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
 			lrec_free(pinrec);
 			return NULL;
 		} else {
-			unsigned long long* pcount_for_group = lhmslv_get(pstate->pcounts_by_group,
-				pgroup_by_field_values);
-			if (pcount_for_group == NULL) {
-				pcount_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
-				*pcount_for_group = 0LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values),
-					pcount_for_group, FREE_ENTRY_KEY);
+			unsigned long long** ppcount_for_group = (unsigned long long**)group_table_get_or_add(
+				pstate->pcounts_by_group, pstate->pgroup_key);
+			if (*ppcount_for_group == NULL) {
+				*ppcount_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
+				**ppcount_for_group = 0LL;
 			}
-			slls_free(pgroup_by_field_values);
+			unsigned long long* pcount_for_group = *ppcount_for_group;
 			(*pcount_for_group)++;
 			if (*pcount_for_group <= pstate->head_count) {
+				if (*pcount_for_group == pstate->head_count) {
+					pstate->num_groups_filled++;
+					if (pstate->num_groups_filled == pstate->num_groups_known)
+						pctx->force_eof = TRUE;
+				}
 				return sllv_single(pinrec);
 			} else {
 				lrec_free(pinrec);
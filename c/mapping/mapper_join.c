@@ -7,6 +7,7 @@
 #include "containers/join_bucket_keeper.h"
 #include "mapping/mappers.h"
 #include "input/lrec_readers.h"
+#include "input/file_decompressor.h"
 
 // ----------------------------------------------------------------
 typedef struct _mapper_join_opts_t {
@@ -237,16 +238,17 @@ static mapper_t* mapper_join_parse_cli(int* pargi, int argc, char** argv,
 
 	cli_merge_reader_opts(&popts->reader_opts, pmain_reader_opts);
 
-	// popen is a stdio construct, not an mmap construct, and it can't be supported here.
-	if (popts->prepipe != NULL)
-		popts->reader_opts.use_mmap_for_read = FALSE;
-
 	if (popts->left_file_name == NULL) {
 		fprintf(stderr, "%s %s: need left file name\n", MLR_GLOBALS.bargv0, verb);
 		mapper_join_usage(stderr, argv[0], verb);
 		return NULL;
 	}
 
+	// Gzipped files are read from a pipe, as with --prepipe.
+	if ((popts->prepipe != NULL || file_decompressor_is_gzipped(popts->left_file_name))
+		&& !lrec_reader_mmap_reads_streams(&popts->reader_opts))
+		popts->reader_opts.use_mmap_for_read = FALSE;
+
 	if (!popts->emit_pairables && !popts->emit_left_unpairables && !popts->emit_right_unpairables) {
 		fprintf(stderr, "%s %s: all emit flags are unset; no output is possible.\n",
 			MLR_GLOBALS.bargv0, verb);
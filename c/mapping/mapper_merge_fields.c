@@ -12,6 +12,7 @@
 #include "containers/lhmslv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
+#include "containers/percentile_sketch.h"
 #include "lib/mlrval.h"
 #include "mapping/mappers.h"
 #include "mapping/stats1_accumulators.h"
@@ -49,6 +50,7 @@ typedef struct _mapper_merge_fields_state_t {
 	char*    output_field_basename;
 	int      allow_int_float;
 	int      do_interpolated_percentiles;
+	int      percentile_sketch_k;
 	int      keep_input_fields;
 	string_builder_t* psb;
 } mapper_merge_fields_state_t;
@@ -59,7 +61,7 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_merge_fields_alloc(slls_t* paccumulator_names, merge_by_t do_which,
 	slls_t* pvalue_field_names, char* output_field_basename, int allow_int_float, int do_interpolated_percentiles,
-	int keep_input_fields);
+	int percentile_sketch_k, int keep_input_fields);
 static void      mapper_merge_fields_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_merge_fields_process_by_name_list(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_merge_fields_process_by_name_regex(lrec_t* pinrec, context_t* pctx, void* pvstate);
@@ -91,6 +93,10 @@ static void mapper_merge_fields_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "            examples below.\n");
 	fprintf(o, "-i          Use interpolated percentiles, like R's type=7; default like type=1.\n");
 	fprintf(o, "            Not sensical for string-valued fields.\n");
+	fprintf(o, "--approx    Compute percentiles approximately, in bounded memory, as for\n");
+	fprintf(o, "            %s stats1 --approx. Exact for up to %d values. Requires numeric input.\n",
+		argv0, PERCENTILE_SKETCH_DEFAULT_K);
+	fprintf(o, "--approx-k {k} As --approx, with accuracy parameter k (at least %d).\n", PERCENTILE_SKETCH_MIN_K);
 	fprintf(o, "-o {name}   Output field basename for -f/-r.\n");
 	fprintf(o, "-k          Keep the input fields which contributed to the output statistics;\n");
 	fprintf(o, "            the default is to omit them.\n");
@@ -120,6 +126,7 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 	char*      output_field_basename       = NULL;
 	int        allow_int_float             = TRUE;
 	int        do_interpolated_percentiles = FALSE;
+	int        percentile_sketch_k         = 0;
 	int        keep_input_fields           = FALSE;
 	merge_by_t do_which                    = MERGE_UNSPECIFIED;
 
@@ -189,6 +196,21 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 		} else if (streq(argv[argi], "-i")) {
 			do_interpolated_percentiles = TRUE;
 			argi += 1;
+		} else if (streq(argv[argi], "--approx")) {
+			percentile_sketch_k = PERCENTILE_SKETCH_DEFAULT_K;
+			argi += 1;
+		} else if (streq(argv[argi], "--approx-k")) {
+			if (argc - argi < 2) {
+				mapper_merge_fields_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			if (sscanf(argv[argi+1], "%d", &percentile_sketch_k) != 1
+				|| percentile_sketch_k < PERCENTILE_SKETCH_MIN_K)
+			{
+				mapper_merge_fields_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			argi += 2;
 		} else {
 			mapper_merge_fields_usage(stderr, argv[0], verb);
 			return NULL;
@@ -214,13 +236,13 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 	*pargi = argi;
 	return mapper_merge_fields_alloc(paccumulator_names, do_which,
 		pvalue_field_names, output_field_basename, allow_int_float, do_interpolated_percentiles,
-		keep_input_fields);
+		percentile_sketch_k, keep_input_fields);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_merge_fields_alloc(slls_t* paccumulator_names, merge_by_t do_which,
 	slls_t* pvalue_field_names, char* output_field_basename, int allow_int_float, int do_interpolated_percentiles,
-	int keep_input_fields)
+	int percentile_sketch_k, int keep_input_fields)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -238,6 +260,7 @@ static mapper_t* mapper_merge_fields_alloc(slls_t* paccumulator_names, merge_by_
 	pstate->output_field_basename       = output_field_basename;
 	pstate->allow_int_float             = allow_int_float;
 	pstate->do_interpolated_percentiles = do_interpolated_percentiles;
+	pstate->percentile_sketch_k         = percentile_sketch_k;
 	pstate->keep_input_fields           = keep_input_fields;
 	pstate->psb                         = sb_alloc(SB_ALLOC_LENGTH);
 
@@ -279,7 +302,8 @@ static sllv_t* mapper_merge_fields_process_by_name_list(lrec_t* pinrec, context_
 	lhmsv_t* poutaccs = lhmsv_alloc();
 
 	make_stats1_accs(pstate->output_field_basename, pstate->paccumulator_names,
-	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pinaccs, poutaccs);
+	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pstate->percentile_sketch_k,
+	    pinaccs, poutaccs);
 
 	for (sllse_t* pb = pstate->pvalue_field_names->phead; pb != NULL; pb = pb->pnext) {
 		char* field_name = pb->value;
@@ -354,7 +378,8 @@ static sllv_t* mapper_merge_fields_process_by_name_regex(lrec_t* pinrec, context
 	lhmsv_t* poutaccs = lhmsv_alloc();
 
 	make_stats1_accs(pstate->output_field_basename, pstate->paccumulator_names,
-	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pinaccs, poutaccs);
+	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pstate->percentile_sketch_k,
+	    pinaccs, poutaccs);
 
 	for (lrece_t* pb = pinrec->phead; pb != NULL; /* increment inside loop */ ) {
 		char* field_name = pb->key;
@@ -461,7 +486,7 @@ static sllv_t* mapper_merge_fields_process_by_collapsing(lrec_t* pinrec, context
 					out_acc_map_for_short_name = lhmsv_alloc();
 
 					make_stats1_accs(short_name, pstate->paccumulator_names,
-						pstate->allow_int_float, pstate->do_interpolated_percentiles,
+						pstate->allow_int_float, pstate->do_interpolated_percentiles, pstate->percentile_sketch_k,
 						in_acc_map_for_short_name, out_acc_map_for_short_name);
 
 					lhmsv_put(short_names_to_in_acc_maps, mlr_strdup_or_die(short_name), in_acc_map_for_short_name,
@@ -4,9 +4,8 @@
 #include <math.h>
 #include "lib/mlrutil.h"
 #include "containers/sllv.h"
-#include "containers/lhmslv.h"
-#include "containers/lhmsv.h"
-#include "containers/mixutil.h"
+#include "containers/group_table.h"
+#include "containers/heavy_hitters.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
@@ -16,7 +15,9 @@
 typedef struct _mapper_most_or_least_frequent_state_t {
 	ap_state_t* pargp;
 	slls_t*     pgroup_by_field_names;
-	lhmslv_t*   pcounts_by_group;
+	group_key_t*   pgroup_key;
+	group_table_t* pcounts_by_group;
+	heavy_hitters_t* pheavy_hitters; // With --approx; else NULL
 	long long   max_output_length;
 	int         descending;
 	int         show_counts;
@@ -31,18 +32,20 @@ static mapper_t* mapper_least_frequent_parse_cli(int* pargi, int argc, char** ar
 static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, char** argv, int descending);
 
 static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
-	long long max_output_length, int descending, int show_counts, char* output_field_name);
+	long long max_output_length, int descending, int show_counts, char* output_field_name, int approx_capacity);
 static void      mapper_most_or_least_frequent_free(mapper_t* pmapper, context_t* _);
 
 static sllv_t*   mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_most_frequent_process_approx(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
 // qsort callbacks
 static int descending_vcmp(const void* pva, const void* pvb);
 static int ascending_vcmp(const void* pva, const void* pvb);
 
 typedef struct _sort_pair_t {
-	slls_t* pgroup_by_field_values;
-	long long count; // signed, not unsigned, for sort-cmp callback
+	char**             key_values;
+	unsigned long long count;
+	int                index; // Order of first appearance, for breaking ties
 } sort_pair_t;
 
 // ----------------------------------------------------------------
@@ -70,6 +73,14 @@ static void mapper_most_frequent_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "-n {count}. Optional flag defaulting to %lld.\n", DEFAULT_MAX_OUTPUT_LENGTH);
 	fprintf(o, "-b          Suppress counts; show only field values.\n");
 	fprintf(o, "-o {name}   Field name for output count. Default \"%s\".\n", DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "--approx    Count in bounded memory, using %d counters, rather than counting\n",
+		HEAVY_HITTERS_DEFAULT_CAPACITY);
+	fprintf(o, "            every distinct value. Any value occurring more than N/m times\n");
+	fprintf(o, "            in N records with m counters is sure to be found. Each count\n");
+	fprintf(o, "            shown is at least the true count, and more by at most N/m.\n");
+	fprintf(o, "            Counts are exact if there are at most m distinct values.\n");
+	fprintf(o, "--approx-counters {m} As --approx, with m counters.\n");
+	fprintf(o, "Ties are shown in order of first appearance.\n");
 	fprintf(o, "See also \"%s %s\".\n", argv0, "least-frequent");
 }
 
@@ -82,6 +93,7 @@ static void mapper_least_frequent_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "-n {count}. Optional flag defaulting to %lld.\n", DEFAULT_MAX_OUTPUT_LENGTH);
 	fprintf(o, "-b          Suppress counts; show only field values.\n");
 	fprintf(o, "-o {name}   Field name for output count. Default \"%s\".\n", DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "Ties are shown in order of first appearance.\n");
 	fprintf(o, "See also \"%s %s\".\n", argv0, "most-frequent");
 }
 
@@ -102,6 +114,7 @@ static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, c
 	long long max_output_length     = DEFAULT_MAX_OUTPUT_LENGTH;
 	int       show_counts           = TRUE;
 	char*     output_field_name     = DEFAULT_OUTPUT_FIELD_NAME;
+	int       approx_capacity       = 0;
 
 	char* verb = argv[(*pargi)++];
 
@@ -110,6 +123,10 @@ static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, c
 	ap_define_long_long_flag(pstate,   "-n", &max_output_length);
 	ap_define_false_flag(pstate,       "-b", &show_counts);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
+	if (descending) {
+		ap_define_int_value_flag(pstate, "--approx", HEAVY_HITTERS_DEFAULT_CAPACITY, &approx_capacity);
+		ap_define_int_flag(pstate,       "--approx-counters", &approx_capacity);
+	}
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_most_frequent_usage(stderr, argv[0], verb);
@@ -120,14 +137,21 @@ static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, c
 		mapper_most_frequent_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (approx_capacity < 0) {
+		mapper_most_frequent_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	// Enough counters for all the output.
+	if (approx_capacity > 0 && approx_capacity < max_output_length)
+		approx_capacity = max_output_length;
 
 	return mapper_most_or_least_frequent_alloc(pstate, pgroup_by_field_names, max_output_length, descending,
-		show_counts, output_field_name);
+		show_counts, output_field_name, approx_capacity);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
-	long long max_output_length, int descending, int show_counts, char* output_field_name)
+	long long max_output_length, int descending, int show_counts, char* output_field_name, int approx_capacity)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -135,14 +159,18 @@ static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t*
 
 	pstate->pargp                 = pargp;
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
-	pstate->pcounts_by_group      = lhmslv_alloc();
+	pstate->pgroup_key            = group_key_alloc();
+	pstate->pcounts_by_group      = group_table_alloc(pgroup_by_field_names->length);
+	pstate->pheavy_hitters        = approx_capacity > 0
+		? heavy_hitters_alloc(pgroup_by_field_names->length, approx_capacity) : NULL;
 	pstate->max_output_length     = max_output_length;
 	pstate->descending            = descending;
 	pstate->show_counts           = show_counts;
 	pstate->output_field_name     = output_field_name;
 
 	pmapper->pvstate       = pstate;
-	pmapper->pprocess_func = mapper_most_or_least_frequent_process;
+	pmapper->pprocess_func = approx_capacity > 0
+		? mapper_most_frequent_process_approx : mapper_most_or_least_frequent_process;
 	pmapper->pfree_func    = mapper_most_or_least_frequent_free;
 
 	return pmapper;
@@ -151,12 +179,12 @@ static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t*
 static void mapper_most_or_least_frequent_free(mapper_t* pmapper, context_t* _) {
 	mapper_most_or_least_frequent_state_t* pstate = pmapper->pvstate;
 	slls_free(pstate->pgroup_by_field_names);
-	// lhmslv_free will free the keys: we only need to free the void-star values.
-	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
-		unsigned long long* pcount = pa->pvvalue;
-		free(pcount);
-	}
-	lhmslv_free(pstate->pcounts_by_group);
+	// group_table_free will free the keys: we only need to free the void-star values.
+	for (int i = 0; i < pstate->pcounts_by_group->num_entries; i++)
+		free(pstate->pcounts_by_group->entries[i].pvvalue);
+	group_table_free(pstate->pcounts_by_group);
+	group_key_free(pstate->pgroup_key);
+	heavy_hitters_free(pstate->pheavy_hitters);
 	pstate->pgroup_by_field_names = NULL;
 	pstate->pcounts_by_group = NULL;
 	ap_free(pstate->pargp);
@@ -165,58 +193,93 @@ static void mapper_most_or_least_frequent_free(mapper_t* pmapper, context_t* _)
 }
 
 // ----------------------------------------------------------------
+static lrec_t* mapper_most_or_least_frequent_make_output(mapper_most_or_least_frequent_state_t* pstate,
+	char** key_values, unsigned long long count)
+{
+	lrec_t* poutrec = lrec_unbacked_alloc();
+	int j = 0;
+	for (sllse_t* pb = pstate->pgroup_by_field_names->phead; pb != NULL; pb = pb->pnext, j++)
+		lrec_put(poutrec, pb->value, key_values[j], NO_FREE);
+	if (pstate->show_counts)
+		lrec_put(poutrec, pstate->output_field_name, mlr_alloc_string_from_ull(count), FREE_ENTRY_VALUE);
+	return poutrec;
+}
+
+// Whether a is output before b.
+static inline int sort_pair_before(sort_pair_t* pa, sort_pair_t* pb, int descending) {
+	if (pa->count != pb->count)
+		return descending ? pa->count > pb->count : pa->count < pb->count;
+	return pa->index < pb->index;
+}
+
+// Keeps the top n in a heap with the last of them, in output order, at the
+// root: O(N log n) for N distinct values rather than sorting all of them.
+static void top_pairs_offer(sort_pair_t* heap, int* pheap_size, int n, sort_pair_t* ppair, int descending) {
+	int i;
+	if (*pheap_size < n) {
+		i = (*pheap_size)++;
+		while (i > 0 && sort_pair_before(&heap[(i - 1) / 2], ppair, descending)) {
+			heap[i] = heap[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	} else if (sort_pair_before(ppair, &heap[0], descending)) {
+		i = 0;
+		while (TRUE) {
+			int child = 2 * i + 1;
+			if (child >= n)
+				break;
+			if (child + 1 < n && sort_pair_before(&heap[child], &heap[child + 1], descending))
+				child++;
+			if (!sort_pair_before(ppair, &heap[child], descending))
+				break;
+			heap[i] = heap[child];
+			i = child;
+		}
+	} else {
+		return;
+	}
+	heap[i] = *ppair;
+}
+
 static sllv_t* mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_most_or_least_frequent_state_t* pstate = pvstate;
 
 	if (pinrec != NULL) { // Not end of input record stream
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
-			if (pcount == NULL) {
-				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
-				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+		if (group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
+			unsigned long long** ppcount = (unsigned long long**)group_table_get_or_add(pstate->pcounts_by_group,
+				pstate->pgroup_key);
+			if (*ppcount == NULL) {
+				*ppcount = mlr_malloc_or_die(sizeof(unsigned long long));
+				**ppcount = 1LL;
 			} else {
-				(*pcount)++;
+				(**ppcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
 
 	} else { // End of input record stream
 
-		// Copy keys and counters from hashmap to array for sorting
-		int input_length = pstate->pcounts_by_group->num_occupied;
-		sort_pair_t* sort_pairs = mlr_malloc_or_die(input_length * sizeof(sort_pair_t));
-		int i = 0;
-		for (lhmslve_t* pe = pstate->pcounts_by_group->phead; pe != NULL; pe = pe->pnext) {
-			sort_pairs[i].pgroup_by_field_values = pe->key;
-			sort_pairs[i].count = *(long long *)pe->pvvalue;
-			i++;
+		// Select the top n from the table, then sort only those.
+		int input_length = group_table_size(pstate->pcounts_by_group);
+		int output_length = (input_length < pstate->max_output_length) ? input_length : pstate->max_output_length;
+		if (output_length < 0)
+			output_length = 0;
+		sort_pair_t* sort_pairs = mlr_malloc_or_die((output_length + 1) * sizeof(sort_pair_t));
+		int heap_size = 0;
+		for (int i = 0; i < input_length && output_length > 0; i++) {
+			group_table_entry_t* pe = &pstate->pcounts_by_group->entries[i];
+			sort_pair_t pair = { pe->key_values, *(unsigned long long*)pe->pvvalue, i };
+			top_pairs_offer(sort_pairs, &heap_size, output_length, &pair, pstate->descending);
 		}
-
-		// Sort by count
-		qsort(sort_pairs, input_length, sizeof(sort_pair_t),
+		qsort(sort_pairs, heap_size, sizeof(sort_pair_t),
 			pstate->descending ? descending_vcmp : ascending_vcmp);
 
 		// Emit top n
 		sllv_t* poutrecs = sllv_alloc();
-		int output_length = (input_length < pstate->max_output_length) ? input_length : pstate->max_output_length;
-		for (i = 0; i < output_length; i++) {
-			lrec_t* poutrec = lrec_unbacked_alloc();
-			slls_t* pgroup_by_field_values = sort_pairs[i].pgroup_by_field_values;
-			sllse_t* pb = pstate->pgroup_by_field_names->phead;
-			sllse_t* pc =         pgroup_by_field_values->phead;
-			for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-				lrec_put(poutrec, pb->value, pc->value, NO_FREE);
-			}
-			if (pstate->show_counts) {
-				lrec_put(poutrec, pstate->output_field_name,
-					mlr_alloc_string_from_ull(sort_pairs[i].count), FREE_ENTRY_VALUE);
-			}
-			sllv_append(poutrecs, poutrec);
+		for (int i = 0; i < heap_size; i++) {
+			sllv_append(poutrecs, mapper_most_or_least_frequent_make_output(pstate,
+				sort_pairs[i].key_values, sort_pairs[i].count));
 		}
 		sllv_append(poutrecs, NULL);
 
@@ -225,13 +288,39 @@ static sllv_t* mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t*
 	}
 }
 
+// ----------------------------------------------------------------
+static sllv_t* mapper_most_frequent_process_approx(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_most_or_least_frequent_state_t* pstate = pvstate;
+
+	if (pinrec != NULL) {
+		if (group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names))
+			heavy_hitters_ingest(pstate->pheavy_hitters, pstate->pgroup_key);
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	heavy_hitter_t** sorted = heavy_hitters_sorted(pstate->pheavy_hitters);
+	sllv_t* poutrecs = sllv_alloc();
+	for (int i = 0; i < pstate->pheavy_hitters->num_counters && i < pstate->max_output_length; i++) {
+		sllv_append(poutrecs, mapper_most_or_least_frequent_make_output(pstate,
+			sorted[i]->key_values, sorted[i]->count));
+	}
+	sllv_append(poutrecs, NULL);
+	free(sorted);
+	return poutrecs;
+}
+
 static int descending_vcmp(const void* pva, const void* pvb) {
 	const sort_pair_t* pa = pva;
 	const sort_pair_t* pb = pvb;
-	return pb->count - pa->count;
+	if (pa->count != pb->count)
+		return pa->count > pb->count ? -1 : 1;
+	return pa->index - pb->index;
 }
 static int ascending_vcmp(const void* pva, const void* pvb) {
 	const sort_pair_t* pa = pva;
 	const sort_pair_t* pb = pvb;
-	return pa->count - pb->count;
+	if (pa->count != pb->count)
+		return pa->count < pb->count ? -1 : 1;
+	return pa->index - pb->index;
 }
@@ -5,6 +5,7 @@
 #include "containers/lhmss.h"
 #include "containers/sllv.h"
 #include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/mixutil.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
@@ -20,7 +21,9 @@ typedef struct _mapper_nest_state_t {
 	char* nested_ps;
 	int   nested_ps_length;
 
+	// Other-field names -> other-field values -> bucket
 	lhmslv_t* other_keys_to_other_values_to_buckets;
+	group_key_t* pother_values;
 	string_builder_t* psb;
 	regex_t regex;
 } mapper_nest_state_t;
@@ -210,6 +213,7 @@ static mapper_t* mapper_nest_alloc(ap_state_t* pargp, char* argv0,
 		}
 	}
 	pstate->other_keys_to_other_values_to_buckets = lhmslv_alloc();
+	pstate->pother_values = group_key_alloc();
 	pstate->psb = sb_alloc(SB_ALLOC_LENGTH);
 	char* pattern = mlr_malloc_or_die(strlen(field_name) + 12);
 	sprintf(pattern, "^%s_[0-9]+$", field_name);
@@ -227,15 +231,16 @@ static void mapper_nest_free(mapper_t* pmapper, context_t* _) {
 
 	if (pstate->other_keys_to_other_values_to_buckets != NULL) {
 		for (lhmslve_t* pe = pstate->other_keys_to_other_values_to_buckets->phead; pe != NULL; pe = pe->pnext) {
-			lhmslv_t* other_values_to_buckets = pe->pvvalue;
-			for (lhmslve_t* pf = other_values_to_buckets->phead; pf != NULL; pf = pf->pnext) {
-				nest_bucket_t* pbucket = pf->pvvalue;
+			group_table_t* other_values_to_buckets = pe->pvvalue;
+			for (int i = 0; i < other_values_to_buckets->num_entries; i++) {
+				nest_bucket_t* pbucket = other_values_to_buckets->entries[i].pvvalue;
 				nest_bucket_free(pbucket);
 			}
-			lhmslv_free(other_values_to_buckets);
+			group_table_free(other_values_to_buckets);
 		}
 		lhmslv_free(pstate->other_keys_to_other_values_to_buckets);
 	}
+	group_key_free(pstate->pother_values);
 
 	sb_free(pstate->psb);
 	free(pstate->nested_fs);
@@ -353,26 +358,27 @@ static sllv_t* mapper_nest_implode_values_across_records(lrec_t* pinrec, context
 
 		// Don't lrec_remove pstate->field_name so we can implode in-place at the end.
 		slls_t* other_keys = mlr_reference_keys_from_record_except(pinrec, px);
-		lhmslv_t* other_values_to_buckets = lhmslv_get(pstate->other_keys_to_other_values_to_buckets, other_keys);
+		group_table_t* other_values_to_buckets = lhmslv_get(pstate->other_keys_to_other_values_to_buckets, other_keys);
 		if (other_values_to_buckets == NULL) {
-			other_values_to_buckets = lhmslv_alloc();
+			other_values_to_buckets = group_table_alloc(other_keys->length);
 			lhmslv_put(pstate->other_keys_to_other_values_to_buckets,
 				slls_copy(other_keys), other_values_to_buckets, FREE_ENTRY_KEY);
 		}
 
 		slls_t* other_values = mlr_reference_values_from_record_except(pinrec, px);
-		nest_bucket_t* pbucket = lhmslv_get(other_values_to_buckets, other_values);
-		if (pbucket == NULL) {
-			pbucket = nest_bucket_alloc(pinrec);
-			lhmslv_put(other_values_to_buckets, slls_copy(other_values), pbucket, FREE_ENTRY_KEY);
+		group_key_from_list(pstate->pother_values, other_values);
+		nest_bucket_t** ppbucket = (nest_bucket_t**)group_table_get_or_add(other_values_to_buckets,
+			pstate->pother_values);
+		slls_free(other_values);
+		if (*ppbucket == NULL) {
+			*ppbucket = nest_bucket_alloc(pinrec);
 		} else {
 			lrec_free(pinrec);
 		}
 		lrec_t* pair = lrec_unbacked_alloc();
 		lrec_put(pair, pstate->field_name, field_value_copy, FREE_ENTRY_VALUE);
-		sllv_append(pbucket->pairs, pair);
+		sllv_append((*ppbucket)->pairs, pair);
 
-		slls_free(other_values);
 		slls_free(other_keys);
 
 		return NULL;
@@ -381,9 +387,9 @@ static sllv_t* mapper_nest_implode_values_across_records(lrec_t* pinrec, context
 		sllv_t* poutrecs = sllv_alloc();
 
 		for (lhmslve_t* pe = pstate->other_keys_to_other_values_to_buckets->phead; pe != NULL; pe = pe->pnext) {
-			lhmslv_t* other_values_to_buckets = pe->pvvalue;
-			for (lhmslve_t* pf = other_values_to_buckets->phead; pf != NULL; pf = pf->pnext) {
-				nest_bucket_t* pbucket = pf->pvvalue;
+			group_table_t* other_values_to_buckets = pe->pvvalue;
+			for (int i = 0; i < other_values_to_buckets->num_entries; i++) {
+				nest_bucket_t* pbucket = other_values_to_buckets->entries[i].pvvalue;
 				lrec_t* poutrec = pbucket->prepresentative;
 				pbucket->prepresentative = NULL; // ownership transfer
 				for (sllve_t* pg = pbucket->pairs->phead; pg != NULL; pg = pg->pnext) {
@@ -9,6 +9,7 @@
 #include "parsing/mlr_dsl_wrapper.h"
 #include "dsl/rval_evaluators.h"
 #include "dsl/mlr_dsl_cst.h"
+#include "dsl/columnar_filter.h"
 #include "mapping/mappers.h"
 
 #define DEFAULT_OOSVAR_FLATTEN_SEPARATOR ":"
@@ -34,6 +35,17 @@ typedef struct _mapper_put_or_filter_state_t {
 	int            put_output_disabled; // mlr put -q
 	int            do_final_filter;     // mlr filter
 	int            negate_final_filter; // mlr filter -x
+
+	// Fields the expression refers to, for the reader; null if it can refer to
+	// fields not named in it, as with $*, $[...], or NF.
+	slls_t*        pused_field_names;
+
+	// mlr filter --columnar: non-null only if the expression is eligible.
+	columnar_filter_t* pcolumnar_filter;
+	lrec_t**       pbatch;
+	int            batch_count;
+	uint64_t*      pselected_bits;
+	uint64_t*      perror_bits;
 } mapper_put_or_filter_state_t;
 
 typedef struct _expression_info_t {
@@ -68,12 +80,18 @@ static mapper_t* mapper_put_or_filter_alloc(
 	int                type_inferencing,
 	char*              oosvar_flatten_separator,
 	int                flush_every_record,
+	int                columnar_batch_size, // mlr filter --columnar; 0 for row-at-a-time
 	cli_writer_opts_t* pwriter_opts,
 	cli_writer_opts_t* pmain_writer_opts);
 
 static void      mapper_put_or_filter_free(mapper_t* pmapper, context_t* pctx);
+static mapper_field_usage_t mapper_put_or_filter_field_usage(mapper_t* pmapper, hss_t* pfield_names);
+static int       get_ast_field_names(mlr_dsl_ast_node_t* pnode, slls_t* pfield_names);
 
 static sllv_t*   mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_filter_columnar_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_put_or_filter_process_record(mapper_put_or_filter_state_t* pstate,
+	lrec_t* pinrec, context_t* pctx, sllv_t* poutrecs);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_put_setup = {
@@ -81,6 +99,7 @@ mapper_setup_t mapper_put_setup = {
 	.pusage_func = mapper_put_usage,
 	.pparse_func = mapper_put_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_put_or_filter_field_usage,
 };
 
 mapper_setup_t mapper_filter_setup = {
@@ -88,6 +107,7 @@ mapper_setup_t mapper_filter_setup = {
 	.pusage_func = mapper_filter_usage,
 	.pparse_func = mapper_filter_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_put_or_filter_field_usage,
 };
 
 // ----------------------------------------------------------------
@@ -195,7 +215,8 @@ static void shared_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "the input is CSV, the output is pretty-print tabular, but the tee-file output\n");
 	fprintf(o, "is written in JSON format.\n");
 	fprintf(o, "--no-fflush: for emit, tee, print, and dump, don't call fflush() after every\n");
-	fprintf(o, "    record.\n");
+	fprintf(o, "    record. (Redirects to files are always buffered, and flushed when their\n");
+	fprintf(o, "    buffers fill and at end of stream; this applies to stdout and pipes.)\n");
 	fprintf(o, "\n");
 
 	fprintf(o, "Expression-specification options:\n");
@@ -228,6 +249,16 @@ static void shared_usage(FILE* o, char* argv0, char* verb) {
 	}
 	if (streq(verb, "filter")) {
 		fprintf(o, "-x: Prints records for which {expression} evaluates to false.\n");
+		fprintf(o, "--columnar: Evaluates the expression a batch of records at a time, field by\n");
+		fprintf(o, "    field, rather than record by record. This is much faster for expressions\n");
+		fprintf(o, "    which only compare fields to literals or to other fields, combined with\n");
+		fprintf(o, "    &&, ||, and !, e.g. '$status == 500 && $latency > 2.5'. Other expressions\n");
+		fprintf(o, "    (with assignments, functions, regexes, context variables, out-of-stream\n");
+		fprintf(o, "    variables, emit/tee/print/dump, begin/end blocks, etc.) are evaluated\n");
+		fprintf(o, "    record by record as usual. Since records are passed along in batches,\n");
+		fprintf(o, "    NR/FNR/FILENAME in downstream verbs are those of the batch's last record.\n");
+		fprintf(o, "--columnar-batch-size {n}: Implies --columnar, with batches of n records.\n");
+		fprintf(o, "    Default %d.\n", COLUMNAR_FILTER_DEFAULT_BATCH_SIZE);
 	}
 	fprintf(o, "\n");
 
@@ -269,6 +300,7 @@ static mapper_t* shared_parse_cli(int* pargi, int argc, char** argv,
 	int     trace_execution          = FALSE;
 	char*   oosvar_flatten_separator = DEFAULT_OOSVAR_FLATTEN_SEPARATOR;
 	int     flush_every_record       = TRUE;
+	int     columnar_batch_size      = 0;
 
 	cli_writer_opts_t* pwriter_opts = mlr_malloc_or_die(sizeof(cli_writer_opts_t));
 	cli_writer_opts_init(pwriter_opts);
@@ -333,6 +365,19 @@ static mapper_t* shared_parse_cli(int* pargi, int argc, char** argv,
 		} else if (streq(argv[argi], "-x") && streq(verb, "filter")) {
 			negate_final_filter = TRUE;
 			argi += 1;
+		} else if (streq(argv[argi], "--columnar") && streq(verb, "filter")) {
+			columnar_batch_size = COLUMNAR_FILTER_DEFAULT_BATCH_SIZE;
+			argi += 1;
+		} else if (streq(argv[argi], "--columnar-batch-size") && streq(verb, "filter")) {
+			if ((argc - argi) < 2) {
+				mapper_put_or_filter_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			if (sscanf(argv[argi+1], "%d", &columnar_batch_size) != 1 || columnar_batch_size < 1) {
+				mapper_put_or_filter_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			argi += 2;
 
 		} else if (streq(argv[argi], "-S")) {
 			type_inferencing = TYPE_INFER_STRING_ONLY;
@@ -413,7 +458,7 @@ static mapper_t* shared_parse_cli(int* pargi, int argc, char** argv,
 	*pargi = argi;
 	return mapper_put_or_filter_alloc(mlr_dsl_expression, print_ast, trace_stack_allocation, trace_execution,
 		past, put_output_disabled, do_final_filter, negate_final_filter, type_inferencing, oosvar_flatten_separator,
-			flush_every_record, pwriter_opts, pmain_writer_opts);
+			flush_every_record, columnar_batch_size, pwriter_opts, pmain_writer_opts);
 }
 
 // ----------------------------------------------------------------
@@ -429,6 +474,7 @@ static mapper_t* mapper_put_or_filter_alloc(
 	int                type_inferencing,
 	char*              oosvar_flatten_separator,
 	int                flush_every_record,
+	int                columnar_batch_size, // mlr filter --columnar; 0 for row-at-a-time
 	cli_writer_opts_t* pwriter_opts,
 	cli_writer_opts_t* pmain_writer_opts)
 {
@@ -436,6 +482,12 @@ static mapper_t* mapper_put_or_filter_alloc(
 	// Retain the string contents along with any in-pointers from the AST/CST
 	pstate->mlr_dsl_expression = mlr_dsl_expression;
 	pstate->past                     = past;
+	// Before the CST takes over parts of the AST.
+	pstate->pused_field_names        = slls_alloc();
+	if (past->proot != NULL && !get_ast_field_names(past->proot, pstate->pused_field_names)) {
+		slls_free(pstate->pused_field_names);
+		pstate->pused_field_names = NULL;
+	}
 	pstate->pcst                     = mlr_dsl_cst_alloc(past, print_ast, trace_stack_allocation,
 		type_inferencing, flush_every_record, do_final_filter, negate_final_filter);
 	pstate->at_begin                     = TRUE;
@@ -450,9 +502,29 @@ static mapper_t* mapper_put_or_filter_alloc(
 
 	cli_merge_writer_opts(pstate->pwriter_opts, pmain_writer_opts);
 
+	// Expressions the columnar evaluator can't handle, and execution tracing,
+	// fall back to the row engine.
+	pstate->pcolumnar_filter = NULL;
+	pstate->pbatch           = NULL;
+	pstate->batch_count      = 0;
+	pstate->pselected_bits   = NULL;
+	pstate->perror_bits      = NULL;
+	if (do_final_filter && columnar_batch_size > 0 && !trace_execution) {
+		pstate->pcolumnar_filter = columnar_filter_alloc(pstate->pcst, type_inferencing, negate_final_filter,
+			columnar_batch_size);
+	}
+	if (pstate->pcolumnar_filter != NULL) {
+		int num_words = (columnar_batch_size + 63) / 64;
+		pstate->pbatch         = mlr_malloc_or_die(columnar_batch_size * sizeof(lrec_t*));
+		pstate->pselected_bits = mlr_malloc_or_die(num_words * sizeof(uint64_t));
+		pstate->perror_bits    = mlr_malloc_or_die(num_words * sizeof(uint64_t));
+	}
+
 	mapper_t* pmapper      = mlr_malloc_or_die(sizeof(mapper_t));
 	pmapper->pvstate       = (void*)pstate;
-	pmapper->pprocess_func = mapper_put_or_filter_process;
+	pmapper->pprocess_func = (pstate->pcolumnar_filter != NULL)
+		? mapper_filter_columnar_process
+		: mapper_put_or_filter_process;
 	pmapper->pfree_func    = mapper_put_or_filter_free;
 
 	return pmapper;
@@ -469,11 +541,61 @@ static void mapper_put_or_filter_free(mapper_t* pmapper, context_t* pctx) {
 	// Free what's left of the stripped AST after the CST reorganized it.
 	mlr_dsl_ast_free(pstate->past);
 
+	columnar_filter_free(pstate->pcolumnar_filter);
+	free(pstate->pbatch);
+	free(pstate->pselected_bits);
+	free(pstate->perror_bits);
+
+	slls_free(pstate->pused_field_names);
 	free(pstate->pwriter_opts);
 	free(pstate);
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+// Records are passed on (or not) with any fields the expression doesn't refer
+// to left as they were, except with put -q, where only emitted records go on.
+static mapper_field_usage_t mapper_put_or_filter_field_usage(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_put_or_filter_state_t* pstate = pmapper->pvstate;
+	if (pstate->pused_field_names == NULL)
+		return MAPPER_USES_ALL_FIELDS;
+	for (sllse_t* pe = pstate->pused_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return pstate->put_output_disabled ? MAPPER_USES_NAMED_FIELDS_ONLY : MAPPER_PASSES_OTHER_FIELDS;
+}
+
+// Appends the names of the fields referred to, assigned to, or unset. Returns
+// FALSE if the expression can refer to others.
+static int get_ast_field_names(mlr_dsl_ast_node_t* pnode, slls_t* pfield_names) {
+	switch (pnode->type) {
+	case MD_AST_NODE_TYPE_FIELD_NAME:
+		slls_append_with_free(pfield_names, mlr_strdup_or_die(pnode->text));
+		break;
+	case MD_AST_NODE_TYPE_INDIRECT_FIELD_NAME:
+	case MD_AST_NODE_TYPE_INDIRECT_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_FULL_SREC:
+	case MD_AST_NODE_TYPE_FULL_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_OOSVAR_FROM_FULL_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_FULL_OOSVAR_FROM_FULL_SREC_ASSIGNMENT:
+	case MD_AST_NODE_TYPE_FOR_SREC:
+	case MD_AST_NODE_TYPE_FOR_SREC_KEY_ONLY:
+		return FALSE;
+	case MD_AST_NODE_TYPE_CONTEXT_VARIABLE:
+		if (streq(pnode->text, "NF"))
+			return FALSE;
+		break;
+	default:
+		break;
+	}
+	if (pnode->pchildren != NULL) {
+		for (sllve_t* pe = pnode->pchildren->phead; pe != NULL; pe = pe->pnext) {
+			if (!get_ast_field_names(pe->pvvalue, pfield_names))
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 // ----------------------------------------------------------------
 // The typed-overlay holds intermediate values such as in
 //
@@ -594,10 +716,21 @@ static sllv_t* mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, voi
 		return poutrecs;
 	}
 
+	mapper_put_or_filter_process_record(pstate, pinrec, pctx, poutrecs);
+	return poutrecs;
+}
+
+// ----------------------------------------------------------------
+// Runs the main block on a single record, appending it to the output list
+// unless it's filtered out.
+
+static void mapper_put_or_filter_process_record(mapper_put_or_filter_state_t* pstate,
+	lrec_t* pinrec, context_t* pctx, sllv_t* poutrecs)
+{
 	lhmsmv_t* ptyped_overlay = lhmsmv_alloc();
 	string_array_t* pregex_captures = NULL; // May be set to non-null on evaluation
 
-	should_emit_rec = TRUE;
+	int should_emit_rec = TRUE;
 
 	variables_t variables = (variables_t) {
 		.pinrec           = pinrec, // Note variables.pinrec pointer can update on '$* = ...'
@@ -650,5 +783,44 @@ static sllv_t* mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, voi
 	} else {
 		lrec_free(variables.pinrec);
 	}
+}
+
+// ----------------------------------------------------------------
+// mlr filter --columnar. Eligible expressions have no begin/end blocks, so
+// there is nothing to do at start of stream; at end of stream, or when the
+// batch is full, the batch is evaluated and the selected records are passed
+// along in their original order. Records for which the expression evaluates
+// to error are re-run through the row engine so that the error handling is
+// exactly as without --columnar.
+
+static sllv_t* mapper_filter_columnar_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_put_or_filter_state_t* pstate = (mapper_put_or_filter_state_t*)pvstate;
+
+	if (pinrec != NULL) {
+		pstate->pbatch[pstate->batch_count++] = pinrec;
+		if (pstate->batch_count < columnar_filter_get_batch_size(pstate->pcolumnar_filter))
+			return NULL;
+	}
+
+	sllv_t* poutrecs = sllv_alloc();
+	int n = pstate->batch_count;
+	if (n > 0) {
+		columnar_filter_evaluate(pstate->pcolumnar_filter, pstate->pbatch, n,
+			pstate->pselected_bits, pstate->perror_bits);
+		for (int i = 0; i < n; i++) {
+			uint64_t bit = ((uint64_t)1) << (i % 64);
+			lrec_t* prec = pstate->pbatch[i];
+			if (pstate->perror_bits[i / 64] & bit)
+				mapper_put_or_filter_process_record(pstate, prec, pctx, poutrecs);
+			else if (pstate->pselected_bits[i / 64] & bit)
+				sllv_append(poutrecs, prec);
+			else
+				lrec_free(prec);
+		}
+		pstate->batch_count = 0;
+	}
+
+	if (pinrec == NULL) // End of input stream
+		sllv_append(poutrecs, NULL);
 	return poutrecs;
 }
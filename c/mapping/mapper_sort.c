@@ -6,7 +6,7 @@
 #include "lib/mlr_globals.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
-#include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/mixutil.h"
 #include "mapping/mappers.h"
 
@@ -34,8 +34,8 @@
 //     {"a":"red","b":"square","x":"1.0","z":"5.7", "q":"even"}
 //   would both land in the ["red","1.0"] bucket.
 //
-// * Buckets are retained in a hash map: the key is the string-list of the form
-//   ["red","1.0"] and the value is the pairing of parsed-value array ["red",1.0]
+// * Buckets are retained in a group table: the key is the value tuple
+//   ("red","1.0") and the value is the pairing of parsed-value array ["red",1.0]
 //   ane linked list of records.
 //
 // * Once all the input records are ingested into this hash map, we copy the
@@ -60,7 +60,8 @@ typedef struct _mapper_sort_state_t {
 	int*    sort_params;      // Lexical/numeric; ascending/descending
 	int do_sort;              // If false, just do group-by
 	// Sort state: buckets of like records.
-	lhmslv_t* pbuckets_by_key_field_values;
+	group_key_t*   pkey_field_values;
+	group_table_t* pbuckets_by_key_field_values;
 	sllv_t*   precords_missing_sort_keys;
 } mapper_sort_state_t;
 
@@ -86,9 +87,11 @@ static mapper_t* mapper_group_by_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, int do_sort);
 static void      mapper_sort_free(mapper_t* pmapper, context_t* _);
+static mapper_field_usage_t mapper_sort_field_usage(mapper_t* pmapper, hss_t* pfield_names);
 static sllv_t*   mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
-static typed_sort_key_t* parse_sort_keys(slls_t* pkey_field_values, int* sort_params, context_t* pctx);
+static typed_sort_key_t* parse_sort_keys(char** key_field_values, int num_key_fields, int* sort_params,
+	context_t* pctx);
 
 // qsort is non-reentrant but qsort_r isn't portable. But since Miller is
 // single-threaded, even if we've got one sort chained to another, only one is
@@ -104,6 +107,7 @@ mapper_setup_t mapper_sort_setup = {
 	.pusage_func = mapper_sort_usage,
 	.pparse_func = mapper_sort_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_sort_field_usage,
 };
 
 mapper_setup_t mapper_group_by_setup = {
@@ -111,6 +115,7 @@ mapper_setup_t mapper_group_by_setup = {
 	.pusage_func = mapper_group_by_usage,
 	.pparse_func = mapper_group_by_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_sort_field_usage,
 };
 
 // ----------------------------------------------------------------
@@ -224,7 +229,8 @@ static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, i
 
 	pstate->pkey_field_names             = pkey_field_names;
 	pstate->sort_params                  = sort_params;
-	pstate->pbuckets_by_key_field_values = lhmslv_alloc();
+	pstate->pkey_field_values            = group_key_alloc();
+	pstate->pbuckets_by_key_field_values = group_table_alloc(pkey_field_names->length);
 	pstate->precords_missing_sort_keys   = sllv_alloc();
 	pstate->do_sort                      = do_sort;
 
@@ -240,49 +246,58 @@ static void mapper_sort_free(mapper_t* pmapper, context_t* _) {
 	mapper_sort_state_t* pstate = pmapper->pvstate;
 	if (pstate->pkey_field_names != NULL)
 		slls_free(pstate->pkey_field_names);
-	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->pbuckets_by_key_field_values->phead; pa != NULL; pa = pa->pnext) {
-		sort_bucket_t* pbucket = pa->pvvalue;
+	// group_table_free will free the keys; we need to free the void-star values.
+	for (int i = 0; i < pstate->pbuckets_by_key_field_values->num_entries; i++) {
+		sort_bucket_t* pbucket = pstate->pbuckets_by_key_field_values->entries[i].pvvalue;
 		free(pbucket->typed_sort_keys);
 		free(pbucket);
 		// precords freed in emitter
 	}
-	lhmslv_free(pstate->pbuckets_by_key_field_values);
+	group_table_free(pstate->pbuckets_by_key_field_values);
+	group_key_free(pstate->pkey_field_values);
 	sllv_free(pstate->precords_missing_sort_keys);
 	free(pstate->sort_params);
 	free(pstate);
 	free(pmapper);
 }
 
+// Records are only reordered, or grouped, by the key fields.
+static mapper_field_usage_t mapper_sort_field_usage(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_sort_state_t* pstate = pmapper->pvstate;
+	if (pstate->pkey_field_names == NULL)
+		return MAPPER_USES_ALL_FIELDS;
+	for (sllse_t* pe = pstate->pkey_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return MAPPER_PASSES_OTHER_FIELDS;
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_sort_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
 		// Consume another input record.
-		slls_t* pkey_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pkey_field_names);
-		if (pkey_field_values == NULL) {
+		if (!group_key_from_record(pstate->pkey_field_values, pinrec, pstate->pkey_field_names)) {
 			sllv_append(pstate->precords_missing_sort_keys, pinrec);
 		} else {
-			sort_bucket_t* pbucket = lhmslv_get(pstate->pbuckets_by_key_field_values, pkey_field_values);
-			if (pbucket == NULL) { // New key-field-value: new bucket and hash-map entry
-				slls_t* pkey_field_values_copy = slls_copy(pkey_field_values);
+			group_table_t* ptable = pstate->pbuckets_by_key_field_values;
+			sort_bucket_t** ppbucket = (sort_bucket_t**)group_table_get_or_add(ptable, pstate->pkey_field_values);
+			if (*ppbucket == NULL) { // New key-field-value: new bucket and table entry
+				// Parse from the table's copy of the key, which string sort keys point into.
+				char** key_field_values = ptable->entries[ptable->num_entries - 1].key_values;
 				sort_bucket_t* pbucket = mlr_malloc_or_die(sizeof(sort_bucket_t));
-				pbucket->typed_sort_keys = parse_sort_keys(pkey_field_values_copy, pstate->sort_params, pctx);
+				pbucket->typed_sort_keys = parse_sort_keys(key_field_values, ptable->num_key_fields,
+					pstate->sort_params, pctx);
 				pbucket->precords = sllv_alloc();
-				sllv_append(pbucket->precords, pinrec);
-				lhmslv_put(pstate->pbuckets_by_key_field_values, pkey_field_values_copy, pbucket,
-					FREE_ENTRY_KEY);
-			} else { // Previously seen key-field-value: append record to bucket
-				sllv_append(pbucket->precords, pinrec);
+				*ppbucket = pbucket;
 			}
-			slls_free(pkey_field_values);
+			sllv_append((*ppbucket)->precords, pinrec);
 		}
 		return NULL;
 	} else if (!pstate->do_sort) {
 		// End of input stream: do output for group-by
 		sllv_t* poutput = sllv_alloc();
-		for (lhmslve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext) {
-			sort_bucket_t* pbucket = pe->pvvalue;
+		for (int i = 0; i < pstate->pbuckets_by_key_field_values->num_entries; i++) {
+			sort_bucket_t* pbucket = pstate->pbuckets_by_key_field_values->entries[i].pvvalue;
 			sllv_transfer(poutput, pbucket->precords);
 			sllv_free(pbucket->precords);
 		}
@@ -291,13 +306,12 @@ static sllv_t* mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 		return poutput;
 	} else {
 		// End of input stream: sort bucket labels
-		int num_buckets = pstate->pbuckets_by_key_field_values->num_occupied;
+		int num_buckets = group_table_size(pstate->pbuckets_by_key_field_values);
 		sort_bucket_t** pbucket_array = mlr_malloc_or_die(num_buckets * sizeof(sort_bucket_t*));
 
 		// Copy bucket-pointers to an array for qsort
-		int i = 0;
-		for (lhmslve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
-			pbucket_array[i] = pe->pvvalue;
+		for (int i = 0; i < num_buckets; i++) {
+			pbucket_array[i] = pstate->pbuckets_by_key_field_values->entries[i].pvvalue;
 		}
 
 		pcmp_sort_params  = pstate->sort_params;
@@ -310,7 +324,7 @@ static sllv_t* mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 
 		// Emit each bucket's record
 		sllv_t* poutput = sllv_alloc();
-		for (i = 0; i < num_buckets; i++) {
+		for (int i = 0; i < num_buckets; i++) {
 			sllv_t* plist = pbucket_array[i]->precords;
 			sllv_transfer(poutput, plist);
 			sllv_free(plist);
@@ -355,20 +369,22 @@ static int pbucket_comparator(const void* pva, const void* pvb) {
 }
 
 // E.g. parse the list ["red","1.0"] into the array ["red",1.0].
-static typed_sort_key_t* parse_sort_keys(slls_t* pkey_field_values, int* sort_params, context_t* pctx) {
-	typed_sort_key_t* typed_sort_keys = mlr_malloc_or_die(pkey_field_values->length * sizeof(typed_sort_key_t));
-	int i = 0;
-	for (sllse_t* pe = pkey_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
+static typed_sort_key_t* parse_sort_keys(char** key_field_values, int num_key_fields, int* sort_params,
+	context_t* pctx)
+{
+	typed_sort_key_t* typed_sort_keys = mlr_malloc_or_die(num_key_fields * sizeof(typed_sort_key_t));
+	for (int i = 0; i < num_key_fields; i++) {
+		char* value = key_field_values[i];
 		if (sort_params[i] & SORT_NUMERIC) {
-			if (*pe->value == 0) { // null input value
+			if (*value == 0) { // null input value
 				typed_sort_keys[i].u.d = nan("");
-			} else if (!mlr_try_float_from_string(pe->value, &typed_sort_keys[i].u.d)) {
+			} else if (!mlr_try_float_from_string(value, &typed_sort_keys[i].u.d)) {
 				fprintf(stderr, "%s: couldn't parse \"%s\" as number in file \"%s\" record %lld.\n",
-					MLR_GLOBALS.bargv0, pe->value, pctx->filename, pctx->fnr);
+					MLR_GLOBALS.bargv0, value, pctx->filename, pctx->fnr);
 				exit(1);
 			}
 		} else {
-			typed_sort_keys[i].u.s = pe->value;
+			typed_sort_keys[i].u.s = value;
 		}
 	}
 	return typed_sort_keys;
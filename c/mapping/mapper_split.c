@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "lib/string_builder.h"
+#include "containers/sllv.h"
+#include "containers/lhmslv.h"
+#include "containers/mixutil.h"
+#include "mapping/mappers.h"
+#include "output/lrec_writers.h"
+#include "output/multi_lrec_writer.h"
+#include "output/output_handle_pool.h"
+
+// ----------------------------------------------------------------
+// Records are partitioned by the group-by field values into one output file per
+// group. Each group is assigned to one writer, which owns the lrec-writers and
+// output handles for its groups; so records within a group are written in
+// arrival order. With -j 1 the one writer runs in the main thread. Otherwise
+// each writer is a thread fed by a bounded queue of record batches, so that
+// formatting and write syscalls for different files proceed in parallel with
+// each other and with input parsing.
+
+#define SPLIT_BATCH_SIZE        500
+#define SPLIT_MAX_QUEUED_BATCHES  8
+#define DEFAULT_PREFIX "split"
+
+typedef struct _split_batch_t {
+	int     length;
+	lrec_t* precs[SPLIT_BATCH_SIZE];
+	char*   filenames[SPLIT_BATCH_SIZE]; // Owned by the group table
+	context_t ctx;                       // For auto_line_term
+	struct _split_batch_t* pnext;
+} split_batch_t;
+
+typedef struct _split_writer_t {
+	output_handle_pool_t* phandle_pool;
+	multi_lrec_writer_t*  pmulti_lrec_writer;
+
+	// Used only when writer threads are running.
+	pthread_t       thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t  nonempty_cond;
+	pthread_cond_t  nonfull_cond;
+	split_batch_t*  pqueue_head;
+	split_batch_t*  pqueue_tail;
+	int             queue_length;
+	int             done;
+	split_batch_t*  ppending; // Being filled by the main thread
+} split_writer_t;
+
+typedef struct _split_group_t {
+	char*           filename;
+	split_writer_t* pwriter;
+} split_group_t;
+
+typedef struct _mapper_split_state_t {
+	slls_t*            pgroup_by_field_names;
+	char*              prefix;
+	char*              suffix;
+	cli_writer_opts_t* pwriter_opts;
+	lhmslv_t*          pgroups; // group-by field values -> split_group_t*
+	int                num_writers;
+	int                next_writer_index;
+	int                use_threads;
+	int                copy_records;
+	split_writer_t*    pwriters;
+} mapper_split_state_t;
+
+static void      mapper_split_usage(FILE* o, char* argv0, char* verb);
+static mapper_t* mapper_split_parse_cli(int* pargi, int argc, char** argv,
+	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts);
+static mapper_t* mapper_split_alloc(slls_t* pgroup_by_field_names, char* prefix, char* suffix,
+	int num_writers, char* ifile_fmt, cli_writer_opts_t* pwriter_opts, cli_writer_opts_t* pmain_writer_opts);
+static void      mapper_split_free(mapper_t* pmapper, context_t* pctx);
+static sllv_t*   mapper_split_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+
+static split_group_t* split_group_alloc(mapper_split_state_t* pstate, slls_t* pgroup_by_field_values);
+static void  split_writer_enqueue(split_writer_t* pwriter, lrec_t* prec, char* filename, context_t* pctx);
+static void  split_writer_flush_pending(split_writer_t* pwriter);
+static void* split_writer_thread_main(void* pvarg);
+static char* split_default_suffix(char* ofile_fmt);
+
+// ----------------------------------------------------------------
+mapper_setup_t mapper_split_setup = {
+	.verb = "split",
+	.pusage_func = mapper_split_usage,
+	.pparse_func = mapper_split_parse_cli,
+	.ignores_input = FALSE,
+};
+
+// ----------------------------------------------------------------
+static void mapper_split_usage(FILE* o, char* argv0, char* verb) {
+	fprintf(o, "Usage: %s %s [options]\n", argv0, verb);
+	fprintf(o, "Writes records to one output file per distinct value of the group-by field(s).\n");
+	fprintf(o, "For example, with -g a,b and records having a=pan,b=wye, output goes to\n");
+	fprintf(o, "split_pan_wye.csv (if the output format is CSV). Records lacking any group-by\n");
+	fprintf(o, "field are discarded. No records are passed through to the main output stream.\n");
+	fprintf(o, "This is the same as %s put -q 'tee > \"split_\".$a.\"_\".$b.\".csv\", $*' but\n",
+		MLR_GLOBALS.bargv0);
+	fprintf(o, "without the overhead of the DSL, and with optional writer threads.\n");
+	fprintf(o, "Options:\n");
+	fprintf(o, "-g {a,b,c}        Group-by field names. Required.\n");
+	fprintf(o, "--prefix {p}      Filename prefix; default \"%s\". May include a directory.\n", DEFAULT_PREFIX);
+	fprintf(o, "--suffix {s}      Filename suffix; default from the output format, e.g. \"csv\".\n");
+	fprintf(o, "-j {n}            Number of writer threads; default 1. Each output file is\n");
+	fprintf(o, "                  written by a single thread, so records within each file are\n");
+	fprintf(o, "                  in input order.\n");
+	fprintf(o, "Slashes in field values are replaced with underscores in output filenames.\n");
+	fprintf(o, "At most --max-open-files (see %s --help) output files are kept open at a time;\n",
+		MLR_GLOBALS.bargv0);
+	fprintf(o, "others are closed and reopened in append mode as needed.\n");
+	fprintf(o, "Any of the output-format command-line flags (see %s -h). Example: using\n",
+		MLR_GLOBALS.bargv0);
+	fprintf(o, "  %s --icsv --opprint ... then split --ojson -g a then ...\n", MLR_GLOBALS.bargv0);
+	fprintf(o, "the input is CSV, but the split-file output is written in JSON format.\n");
+}
+
+static mapper_t* mapper_split_parse_cli(int* pargi, int argc, char** argv,
+	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* pmain_writer_opts)
+{
+	slls_t* pgroup_by_field_names = NULL;
+	char*   prefix = DEFAULT_PREFIX;
+	char*   suffix = NULL;
+	int     num_writers = 1;
+	cli_writer_opts_t* pwriter_opts = mlr_malloc_or_die(sizeof(cli_writer_opts_t));
+	cli_writer_opts_init(pwriter_opts);
+
+	int argi = *pargi;
+	char* verb = argv[argi++];
+
+	for (; argi < argc; /* variable increment: 1 or 2 depending on flag */) {
+
+		if (argv[argi][0] != '-') {
+			break; // No more flag options to process
+
+		} else if (cli_handle_writer_options(argv, argc, &argi, pwriter_opts)) {
+			// handled
+
+		} else if (streq(argv[argi], "-g") && argc - argi >= 2) {
+			if (pgroup_by_field_names != NULL)
+				slls_free(pgroup_by_field_names);
+			pgroup_by_field_names = slls_from_line(argv[argi+1], ',', FALSE);
+			argi += 2;
+
+		} else if (streq(argv[argi], "--prefix") && argc - argi >= 2) {
+			prefix = argv[argi+1];
+			argi += 2;
+
+		} else if (streq(argv[argi], "--suffix") && argc - argi >= 2) {
+			suffix = argv[argi+1];
+			argi += 2;
+
+		} else if (streq(argv[argi], "-j") && argc - argi >= 2) {
+			if (sscanf(argv[argi+1], "%d", &num_writers) != 1 || num_writers < 1) {
+				mapper_split_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			argi += 2;
+
+		} else {
+			mapper_split_usage(stderr, argv[0], verb);
+			return NULL;
+		}
+	}
+
+	if (pgroup_by_field_names == NULL) {
+		mapper_split_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+
+	*pargi = argi;
+	return mapper_split_alloc(pgroup_by_field_names, prefix, suffix, num_writers,
+		pmain_reader_opts == NULL ? NULL : pmain_reader_opts->ifile_fmt,
+		pwriter_opts, pmain_writer_opts);
+}
+
+// ----------------------------------------------------------------
+static mapper_t* mapper_split_alloc(slls_t* pgroup_by_field_names, char* prefix, char* suffix,
+	int num_writers, char* ifile_fmt, cli_writer_opts_t* pwriter_opts, cli_writer_opts_t* pmain_writer_opts)
+{
+	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
+	mapper_split_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_split_state_t));
+
+	cli_merge_writer_opts(pwriter_opts, pmain_writer_opts);
+
+	pstate->pgroup_by_field_names = pgroup_by_field_names;
+	pstate->prefix                = prefix;
+	pstate->suffix                = suffix != NULL ? suffix : split_default_suffix(pwriter_opts->ofile_fmt);
+	pstate->pwriter_opts          = pwriter_opts;
+	pstate->pgroups               = lhmslv_alloc();
+	pstate->num_writers           = num_writers;
+	pstate->next_writer_index     = 0;
+	pstate->use_threads           = num_writers > 1;
+	// The JSON reader frees each file's parsed data, which its records point into,
+	// when it starts on the next file. Writer threads may still be working on the
+	// previous file's records at that point, so they get their own copies.
+	pstate->copy_records          = pstate->use_threads && ifile_fmt != NULL && streq(ifile_fmt, "json");
+	pstate->pwriters              = mlr_malloc_or_die(num_writers * sizeof(split_writer_t));
+
+	// The open-file budget is shared among the writers.
+	int max_open_files_per_writer = output_handle_pool_get_max_open_files() / num_writers;
+
+	for (int i = 0; i < num_writers; i++) {
+		split_writer_t* pwriter = &pstate->pwriters[i];
+		pwriter->phandle_pool       = output_handle_pool_alloc(max_open_files_per_writer);
+		pwriter->pmulti_lrec_writer = multi_lrec_writer_alloc_in_pool(pwriter_opts, pwriter->phandle_pool);
+		pwriter->pqueue_head        = NULL;
+		pwriter->pqueue_tail        = NULL;
+		pwriter->queue_length       = 0;
+		pwriter->done               = FALSE;
+		pwriter->ppending           = NULL;
+		if (pstate->use_threads) {
+			pthread_mutex_init(&pwriter->mutex, NULL);
+			pthread_cond_init(&pwriter->nonempty_cond, NULL);
+			pthread_cond_init(&pwriter->nonfull_cond, NULL);
+			if (pthread_create(&pwriter->thread, NULL, split_writer_thread_main, pwriter) != 0) {
+				perror("pthread_create");
+				fprintf(stderr, "%s %s: could not create writer thread.\n",
+					MLR_GLOBALS.bargv0, mapper_split_setup.verb);
+				exit(1);
+			}
+		}
+	}
+
+	pmapper->pvstate       = pstate;
+	pmapper->pprocess_func = mapper_split_process;
+	pmapper->pfree_func    = mapper_split_free;
+
+	return pmapper;
+}
+
+static void mapper_split_free(mapper_t* pmapper, context_t* pctx) {
+	mapper_split_state_t* pstate = pmapper->pvstate;
+
+	for (int i = 0; i < pstate->num_writers; i++) {
+		split_writer_t* pwriter = &pstate->pwriters[i];
+		multi_lrec_writer_free(pwriter->pmulti_lrec_writer, pctx);
+		output_handle_pool_free(pwriter->phandle_pool);
+		if (pstate->use_threads) {
+			pthread_mutex_destroy(&pwriter->mutex);
+			pthread_cond_destroy(&pwriter->nonempty_cond);
+			pthread_cond_destroy(&pwriter->nonfull_cond);
+		}
+	}
+	free(pstate->pwriters);
+
+	for (lhmslve_t* pe = pstate->pgroups->phead; pe != NULL; pe = pe->pnext) {
+		split_group_t* pgroup = pe->pvvalue;
+		free(pgroup->filename);
+		free(pgroup);
+	}
+	lhmslv_free(pstate->pgroups);
+
+	slls_free(pstate->pgroup_by_field_names);
+	free(pstate->pwriter_opts);
+	free(pstate);
+	free(pmapper);
+}
+
+// ----------------------------------------------------------------
+static sllv_t* mapper_split_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_split_state_t* pstate = pvstate;
+
+	if (pinrec != NULL) {
+		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
+			pstate->pgroup_by_field_names);
+		if (pgroup_by_field_values == NULL) {
+			lrec_free(pinrec);
+			return NULL;
+		}
+
+		split_group_t* pgroup = lhmslv_get(pstate->pgroups, pgroup_by_field_values);
+		if (pgroup == NULL)
+			pgroup = split_group_alloc(pstate, pgroup_by_field_values);
+		slls_free(pgroup_by_field_values);
+
+		if (pstate->use_threads) {
+			if (pstate->copy_records) {
+				lrec_t* pcopy = lrec_copy(pinrec);
+				lrec_free(pinrec);
+				pinrec = pcopy;
+			}
+			split_writer_enqueue(pgroup->pwriter, pinrec, pgroup->filename, pctx);
+		} else {
+			multi_lrec_writer_output_srec(pgroup->pwriter->pmulti_lrec_writer, pinrec, pgroup->filename,
+				MODE_WRITE, FALSE, pctx);
+		}
+		return NULL;
+
+	} else {
+		for (int i = 0; i < pstate->num_writers; i++) {
+			split_writer_t* pwriter = &pstate->pwriters[i];
+			if (pstate->use_threads) {
+				split_writer_flush_pending(pwriter);
+				pthread_mutex_lock(&pwriter->mutex);
+				pwriter->done = TRUE;
+				pthread_cond_signal(&pwriter->nonempty_cond);
+				pthread_mutex_unlock(&pwriter->mutex);
+			} else {
+				multi_lrec_writer_drain(pwriter->pmulti_lrec_writer, pctx);
+			}
+		}
+		if (pstate->use_threads) {
+			for (int i = 0; i < pstate->num_writers; i++)
+				pthread_join(pstate->pwriters[i].thread, NULL);
+		}
+		return sllv_single(NULL);
+	}
+}
+
+// ----------------------------------------------------------------
+static split_group_t* split_group_alloc(mapper_split_state_t* pstate, slls_t* pgroup_by_field_values) {
+	string_builder_t* psb = sb_alloc(64);
+	sb_append_string(psb, pstate->prefix);
+	for (sllse_t* pe = pgroup_by_field_values->phead; pe != NULL; pe = pe->pnext) {
+		sb_append_char(psb, '_');
+		for (char* p = pe->value; *p; p++)
+			sb_append_char(psb, *p == '/' ? '_' : *p);
+	}
+	sb_append_char(psb, '.');
+	sb_append_string(psb, pstate->suffix);
+
+	split_group_t* pgroup = mlr_malloc_or_die(sizeof(split_group_t));
+	pgroup->filename = sb_finish(psb);
+	sb_free(psb);
+
+	// Round-robin assignment balances the number of files per writer.
+	pgroup->pwriter = &pstate->pwriters[pstate->next_writer_index];
+	pstate->next_writer_index = (pstate->next_writer_index + 1) % pstate->num_writers;
+
+	lhmslv_put(pstate->pgroups, slls_copy(pgroup_by_field_values), pgroup, FREE_ENTRY_KEY);
+	return pgroup;
+}
+
+// ----------------------------------------------------------------
+// Main-thread side: records are accumulated into a pending batch which is
+// handed to the writer thread when full. If the writer is SPLIT_MAX_QUEUED_BATCHES
+// behind, the main thread waits, which bounds memory use when output is slower
+// than input.
+static void split_writer_enqueue(split_writer_t* pwriter, lrec_t* prec, char* filename, context_t* pctx) {
+	split_batch_t* pbatch = pwriter->ppending;
+	if (pbatch != NULL && pbatch->ctx.auto_line_term != pctx->auto_line_term) {
+		split_writer_flush_pending(pwriter);
+		pbatch = NULL;
+	}
+	if (pbatch == NULL) {
+		pbatch = mlr_malloc_or_die(sizeof(split_batch_t));
+		pbatch->length = 0;
+		pbatch->ctx    = *pctx;
+		pbatch->pnext  = NULL;
+		pwriter->ppending = pbatch;
+	}
+	pbatch->precs[pbatch->length]     = prec;
+	pbatch->filenames[pbatch->length] = filename;
+	pbatch->length++;
+	if (pbatch->length == SPLIT_BATCH_SIZE)
+		split_writer_flush_pending(pwriter);
+}
+
+static void split_writer_flush_pending(split_writer_t* pwriter) {
+	split_batch_t* pbatch = pwriter->ppending;
+	if (pbatch == NULL)
+		return;
+	pwriter->ppending = NULL;
+
+	pthread_mutex_lock(&pwriter->mutex);
+	while (pwriter->queue_length >= SPLIT_MAX_QUEUED_BATCHES)
+		pthread_cond_wait(&pwriter->nonfull_cond, &pwriter->mutex);
+	if (pwriter->pqueue_tail == NULL)
+		pwriter->pqueue_head = pbatch;
+	else
+		pwriter->pqueue_tail->pnext = pbatch;
+	pwriter->pqueue_tail = pbatch;
+	pwriter->queue_length++;
+	pthread_cond_signal(&pwriter->nonempty_cond);
+	pthread_mutex_unlock(&pwriter->mutex);
+}
+
+// ----------------------------------------------------------------
+// Writer-thread side.
+static void* split_writer_thread_main(void* pvarg) {
+	split_writer_t* pwriter = pvarg;
+	context_t ctx;
+	int have_ctx = FALSE;
+
+	while (TRUE) {
+		pthread_mutex_lock(&pwriter->mutex);
+		while (pwriter->pqueue_head == NULL && !pwriter->done)
+			pthread_cond_wait(&pwriter->nonempty_cond, &pwriter->mutex);
+		split_batch_t* pbatch = pwriter->pqueue_head;
+		if (pbatch != NULL) {
+			pwriter->pqueue_head = pbatch->pnext;
+			if (pwriter->pqueue_head == NULL)
+				pwriter->pqueue_tail = NULL;
+			pwriter->queue_length--;
+			pthread_cond_signal(&pwriter->nonfull_cond);
+		}
+		pthread_mutex_unlock(&pwriter->mutex);
+
+		if (pbatch == NULL) // Done, and queue drained
+			break;
+
+		for (int i = 0; i < pbatch->length; i++) {
+			multi_lrec_writer_output_srec(pwriter->pmulti_lrec_writer, pbatch->precs[i], pbatch->filenames[i],
+				MODE_WRITE, FALSE, &pbatch->ctx);
+		}
+		ctx = pbatch->ctx;
+		have_ctx = TRUE;
+		free(pbatch);
+	}
+
+	if (have_ctx)
+		multi_lrec_writer_drain(pwriter->pmulti_lrec_writer, &ctx);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* split_default_suffix(char* ofile_fmt) {
+	if (streq(ofile_fmt, "csvlite"))
+		return "csv";
+	else if (streq(ofile_fmt, "markdown"))
+		return "md";
+	else
+		return ofile_fmt;
+}
@@ -1,16 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
 #include "lib/string_array.h"
 #include "lib/mlrregex.h"
+#include "lib/string_builder.h"
 #include "cli/argparse.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
 #include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
+#include "containers/percentile_sketch.h"
 #include "lib/mlrval.h"
 #include "mapping/mappers.h"
 #include "mapping/stats1_accumulators.h"
@@ -18,10 +22,55 @@
 static char* fake_acc_name_for_setups = "__setup_done__";
 
 // ----------------------------------------------------------------
+// With -j, the record stream is cut into segments of consecutive records, dealt
+// round-robin to worker threads, which each ingest a segment into group maps of
+// their own. The main thread passes records to the workers in batches, through
+// bounded queues. Completed segments are merged into the main group maps
+// strictly in segment order, by whichever worker finds the next one ready, so
+// that group first-seen order, mode tie-breaking, and percentile inputs come
+// out the same as with serial ingest. Segments are long so that the cost of
+// setting up and merging each group's accumulators is spread over many records.
+#define STATS1_BATCH_SIZE          1000
+#define STATS1_BATCHES_PER_SEGMENT  100
+#define STATS1_MAX_QUEUED_BATCHES     4
+
+// The multilevel maps records are ingested into, described below.
+typedef struct _stats1_groups_t {
+	group_table_t*   groups_without_group_by_regex;
+	lhmslv_t*        groups_with_group_by_regex;
+	group_key_t*     pgroup_key;          // scratch space used per-record
+	string_array_t*  pvalue_field_values; // scratch space used per-record
+} stats1_groups_t;
+
+typedef struct _stats1_batch_t {
+	int     length;
+	int     ends_segment;
+	lrec_t* precs[STATS1_BATCH_SIZE];
+	struct _stats1_batch_t* pnext;
+} stats1_batch_t;
+
+typedef struct _stats1_segment_t {
+	long long        index;
+	stats1_groups_t* pgroups;
+	struct _stats1_segment_t* pnext;
+} stats1_segment_t;
+
 struct _mapper_stats1_state_t; // forward reference
-typedef void group_by_ingestor_func_t(lrec_t* pinrec, struct _mapper_stats1_state_t* pstate);
+
+typedef struct _stats1_worker_t {
+	struct _mapper_stats1_state_t* pstate;
+	pthread_t       thread;
+	pthread_cond_t  nonempty_cond;
+	pthread_cond_t  nonfull_cond;
+	stats1_batch_t* pqueue_head;
+	stats1_batch_t* pqueue_tail;
+	int             queue_length;
+} stats1_worker_t;
+
+typedef void group_by_ingestor_func_t(lrec_t* pinrec, struct _mapper_stats1_state_t* pstate,
+	stats1_groups_t* pgroups);
 typedef void value_ingestor_func_t(lrec_t* pinrec, struct _mapper_stats1_state_t* pstate,
-	lhmsv_t* pgroup_by_field_values_to_acc_fields);
+	stats1_groups_t* pgroups, lhmsv_t* pgroup_by_field_values_to_acc_fields);
 typedef sllv_t* emitter_func_t(struct _mapper_stats1_state_t* pstate);
 
 typedef struct _mapper_stats1_state_t {
@@ -29,7 +78,6 @@ typedef struct _mapper_stats1_state_t {
 
 	slls_t*          paccumulator_names;
 	string_array_t*  pvalue_field_names;     // parameter
-	string_array_t*  pvalue_field_values;    // scratch space used per-record
 	slls_t*          pgroup_by_field_names;  // parameter
 
 	group_by_ingestor_func_t* pgroup_by_ingestor;
@@ -44,11 +92,31 @@ typedef struct _mapper_stats1_state_t {
 	int              num_group_by_field_regexes;
 	int              invert_regex_group_by_field_names;
 
-	lhmslv_t*        groups_without_group_by_regex;
-	lhmslv_t*        groups_with_group_by_regex;
+	stats1_groups_t* pgroups;
 	int              do_iterative_stats;
 	int              allow_int_float;
 	int              do_interpolated_percentiles;
+	int              percentile_sketch_k;
+
+	// For --dump-state and --merge-state
+	int               do_dump_state;
+	int               do_merge_state;
+	slls_t*           pstate_names;  // Distinct accumulator-state names, e.g. sum and percentiles
+	lrec_t*           pdump_fields;  // The current input record's dumped states
+	string_builder_t* psb;
+
+	// For -j
+	int               num_threads;
+	int               copy_records;
+	stats1_worker_t*  pworkers;
+	pthread_mutex_t   mutex;      // For all the workers' queues, and for merging
+	stats1_batch_t*   ppending;   // Being filled by the main thread
+	int               num_batches_in_segment;
+	long long         num_segments;
+	stats1_segment_t* pcompleted; // Ingested but not yet merged, in index order
+	long long         next_merge_index;
+	int               merging;
+	int               done;
 } mapper_stats1_state_t;
 
 
@@ -58,43 +126,76 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_names, int do_regex_value_field_names, int invert_regex_value_field_names,
 	slls_t* pgroup_by_field_names, int do_regex_group_by_field_names, int invert_regex_group_by_field_names,
-	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles);
+	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles, int percentile_sketch_k,
+	int num_threads, int do_dump_state, int do_merge_state, char* ifile_fmt);
 static void      mapper_stats1_free(mapper_t* pmapper, context_t* _);
+static mapper_field_usage_t mapper_stats1_field_usage(mapper_t* pmapper, hss_t* pfield_names);
 static sllv_t*   mapper_stats1_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_stats1_process_threaded(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_stats1_process_merging(lrec_t* pinrec, context_t* pctx, void* pvstate);
+
+static stats1_groups_t* stats1_groups_alloc(mapper_stats1_state_t* pstate);
+static void stats1_groups_free(stats1_groups_t* pgroups);
+static void stats1_groups_merge(stats1_groups_t* pgroups, stats1_groups_t* pother);
+static void stats1_group_merge(stats1_groups_t* pgroups, lhmsv_t* pgroup_to_acc_field,
+	lhmsv_t* pother_group_to_acc_field);
+static void stats1_group_free(lhmsv_t* pgroup_to_acc_field);
+
+static void  stats1_enqueue_pending(mapper_stats1_state_t* pstate, int ends_segment);
+static void* stats1_worker_thread_main(void* pvworker);
+static void  stats1_merge_completed(mapper_stats1_state_t* pstate, long long segment_index,
+	stats1_groups_t* pgroups);
 
 static void mapper_stats1_group_by_ingest_without_regexes(
 	lrec_t*                pinrec,
-	mapper_stats1_state_t* pstate);
+	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups);
 static void mapper_stats1_group_by_ingest_with_regexes(
 	lrec_t*                pinrec,
-	mapper_stats1_state_t* pstate);
+	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups);
 static void mapper_stats1_value_ingest_without_regexes(
 	lrec_t*                pinrec,
 	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups,
 	lhmsv_t*               pgroup_by_field_values_to_acc_fields);
 static void mapper_stats1_value_ingest_with_regexes(
 	lrec_t*                pinrec,
 	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups,
+	lhmsv_t*               pgroup_by_field_values_to_acc_fields);
+static void mapper_stats1_value_ingest_dumps(
+	lrec_t*                pinrec,
+	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups,
 	lhmsv_t*               pgroup_by_field_values_to_acc_fields);
+static char* mapper_stats1_split_state_field_name(mapper_stats1_state_t* pstate, char* field_name,
+	char** pstate_name);
 
 static void      mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_t* pstate,
-	char* value_field_name, char* value_field_sval, lhmsv_t* pgroup_to_acc_field);
+	stats1_groups_t* pgroups, char* value_field_name, char* value_field_sval, lhmsv_t* pgroup_to_acc_field);
 static sllv_t*   mapper_stats1_emit_all_without_group_by_regexes(mapper_stats1_state_t* pstate);
 static sllv_t*   mapper_stats1_emit_all_with_group_by_regexes(mapper_stats1_state_t* pstate);
 static lrec_t*   mapper_stats1_emit(mapper_stats1_state_t* pstate, lrec_t* poutrec,
 	char* value_field_name, lhmsv_t* acc_field_to_acc_state_out);
+static void      mapper_stats1_emit_dumps(mapper_stats1_state_t* pstate, lrec_t* poutrec,
+	char* value_field_name, lhmsv_t* acc_field_to_acc_state_in);
 
 typedef struct _acc_map_pair_t {
 	lhmsv_t* pin;
 	lhmsv_t* pout;
 } acc_map_pair_t;
 
+static acc_map_pair_t* mapper_stats1_get_accs(mapper_stats1_state_t* pstate, stats1_groups_t* pgroups,
+	char* value_field_name, lhmsv_t* pgroup_to_acc_field);
+
 // ----------------------------------------------------------------
 mapper_setup_t mapper_stats1_setup = {
 	.verb        = "stats1",
 	.pusage_func = mapper_stats1_usage,
 	.pparse_func = mapper_stats1_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_stats1_field_usage,
 };
 
 // ----------------------------------------------------------------
@@ -121,16 +222,41 @@ static void mapper_stats1_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "--grfx {regex} Shorthand for --gr {regex} --fx {that same regex}\n");
 	fprintf(o, "-i           Use interpolated percentiles, like R's type=7; default like type=1.\n");
 	fprintf(o, "             Not sensical for string-valued fields.\n");
+	fprintf(o, "--approx     Compute percentiles approximately, using bounded memory per group\n");
+	fprintf(o, "             and field rather than keeping all values. Results are exact for up\n");
+	fprintf(o, "             to k values; beyond that, each is the value at a rank within about\n");
+	fprintf(o, "             1.65%% of the count from the requested one (with 99%% confidence), for\n");
+	fprintf(o, "             the default k=%d. Requires numeric input.\n", PERCENTILE_SKETCH_DEFAULT_K);
+	fprintf(o, "--approx-k {k} As --approx, with accuracy parameter k (at least %d). Error is\n",
+		PERCENTILE_SKETCH_MIN_K);
+	fprintf(o, "             roughly proportional to 1/k; memory is proportional to k.\n");
 	fprintf(o, "-s           Print iterative stats. Useful in tail -f contexts (in which\n");
 	fprintf(o, "             case please avoid pprint-format output since end of input\n");
 	fprintf(o, "             stream will never be seen).\n");
 	fprintf(o, "-F           Computes integerable things (e.g. count) in floating point.\n");
+	fprintf(o, "-j {n}       Ingest records using n threads. Default 1. Not compatible with -s.\n");
+	fprintf(o, "             Output is the same as for -j 1 except that floating-point sums,\n");
+	fprintf(o, "             being added in a different order, may differ in the last digits.\n");
+	fprintf(o, "--dump-state Instead of statistics, output accumulator states: one record per\n");
+	fprintf(o, "             group, with fields such as x_sum and x_percentiles. These may be\n");
+	fprintf(o, "             saved, e.g. one file per shard of a larger data set, for use with\n");
+	fprintf(o, "             --merge-state.\n");
+	fprintf(o, "--merge-state Take as input the records output by --dump-state, from any number\n");
+	fprintf(o, "             of runs with the same -a, -f/--fr/--fx, -g/--gr/--gx, -F, and\n");
+	fprintf(o, "             --approx or not.\n");
+	fprintf(o, "             Output is as if a single run had seen all the original data.\n");
+	fprintf(o, "             With --dump-state, outputs the merged states instead.\n");
+	fprintf(o, "             Not compatible with -j or -s.\n");
 	fprintf(o, "Example: %s %s -a min,p10,p50,p90,max -f value -g size,shape\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a count,mode -f size\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a count,mode -f size -g shape\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a count,mode --fr '^[a-h].*$' -gr '^k.*$'\n", argv0, verb);
 	fprintf(o, "         This computes count and mode statistics on all field names beginning\n");
 	fprintf(o, "         with a through h, grouped by all field names starting with k.\n");
+	fprintf(o, "Example: %s --ojson %s -a mean,p50 -f x -g a --dump-state shard1.csv > state1.json\n",
+		argv0, verb);
+	fprintf(o, "         %s --ijson %s -a mean,p50 -f x -g a --merge-state state*.json\n", argv0, verb);
+	fprintf(o, "         These compute the mean and median of x, grouped by a, across shards.\n");
 	fprintf(o, "Notes:\n");
 	fprintf(o, "* p50 and median are synonymous.\n");
 	fprintf(o, "* min and max output the same results as p0 and p100, respectively, but use\n");
@@ -144,7 +270,7 @@ static void mapper_stats1_usage(FILE* o, char* argv0, char* verb) {
 }
 
 static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
-	cli_reader_opts_t* _, cli_writer_opts_t* __)
+	cli_reader_opts_t* pmain_reader_opts, cli_writer_opts_t* __)
 {
 	slls_t*         paccumulator_names                = NULL;
 	string_array_t* pvalue_field_names                = NULL;
@@ -152,10 +278,14 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 	int             do_iterative_stats                = FALSE;
 	int             allow_int_float                   = TRUE;
 	int             do_interpolated_percentiles       = FALSE;
+	int             percentile_sketch_k               = 0;
 	int             do_regex_value_field_names        = FALSE;
 	int             invert_regex_value_field_names    = FALSE;
 	int             do_regex_group_by_field_names     = FALSE;
 	int             invert_regex_group_by_field_names = FALSE;
+	int             num_threads                       = 1;
+	int             do_dump_state                     = FALSE;
+	int             do_merge_state                    = FALSE;
 
 	char* verb = argv[(*pargi)++];
 
@@ -173,6 +303,11 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 	ap_define_true_flag(pstate,         "-s",   &do_iterative_stats);
 	ap_define_false_flag(pstate,        "-F",   &allow_int_float);
 	ap_define_true_flag(pstate,         "-i",   &do_interpolated_percentiles);
+	ap_define_int_value_flag(pstate,    "--approx", PERCENTILE_SKETCH_DEFAULT_K, &percentile_sketch_k);
+	ap_define_int_flag(pstate,          "--approx-k", &percentile_sketch_k);
+	ap_define_int_flag(pstate,          "-j",   &num_threads);
+	ap_define_true_flag(pstate,         "--dump-state",  &do_dump_state);
+	ap_define_true_flag(pstate,         "--merge-state", &do_merge_state);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_stats1_usage(stderr, argv[0], verb);
@@ -208,18 +343,37 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 		mapper_stats1_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (num_threads < 1 || (num_threads > 1 && do_iterative_stats)) {
+		mapper_stats1_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if ((do_dump_state || do_merge_state) && do_iterative_stats) {
+		mapper_stats1_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (do_merge_state && num_threads > 1) {
+		mapper_stats1_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (percentile_sketch_k != 0 && percentile_sketch_k < PERCENTILE_SKETCH_MIN_K) {
+		mapper_stats1_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
 	return mapper_stats1_alloc(pstate, paccumulator_names,
 		pvalue_field_names, do_regex_value_field_names, invert_regex_value_field_names,
 		pgroup_by_field_names, do_regex_group_by_field_names, invert_regex_group_by_field_names,
-		do_iterative_stats, allow_int_float, do_interpolated_percentiles);
+		do_iterative_stats, allow_int_float, do_interpolated_percentiles, percentile_sketch_k,
+		num_threads, do_dump_state, do_merge_state,
+		pmain_reader_opts == NULL ? NULL : pmain_reader_opts->ifile_fmt);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_names, int do_regex_value_field_names, int invert_regex_value_field_names,
 	slls_t* pgroup_by_field_names, int do_regex_group_by_field_names, int invert_regex_group_by_field_names,
-	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles)
+	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles, int percentile_sketch_k,
+	int num_threads, int do_dump_state, int do_merge_state, char* ifile_fmt)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -230,7 +384,6 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 
 	if (do_regex_value_field_names) {
 		pstate->pvalue_field_names      = NULL;
-		pstate->pvalue_field_values     = NULL;
 		pstate->num_value_field_regexes = pvalue_field_names->length;
 		pstate->value_field_regexes     = mlr_malloc_or_die(sizeof(regex_t) * pstate->num_value_field_regexes);
 		for (int i = 0; i < pvalue_field_names->length; i++) {
@@ -243,7 +396,6 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 		pstate->pvalue_ingestor                = mapper_stats1_value_ingest_with_regexes;
 	} else {
 		pstate->pvalue_field_names             = pvalue_field_names;
-		pstate->pvalue_field_values            = string_array_alloc(pvalue_field_names->length);
 		pstate->value_field_regexes            = NULL;
 		pstate->num_value_field_regexes        = 0;
 		pstate->invert_regex_value_field_names = FALSE;
@@ -264,8 +416,6 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 		pstate->pgroup_by_ingestor                = mapper_stats1_group_by_ingest_with_regexes;
 		pstate->pemitter                          = mapper_stats1_emit_all_with_group_by_regexes;
 		pstate->invert_regex_group_by_field_names = invert_regex_group_by_field_names;
-		pstate->groups_without_group_by_regex     = NULL;
-		pstate->groups_with_group_by_regex        = lhmslv_alloc();
 	} else {
 		pstate->pgroup_by_ingestor                = mapper_stats1_group_by_ingest_without_regexes;
 		pstate->pemitter                          = mapper_stats1_emit_all_without_group_by_regexes;
@@ -273,16 +423,72 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 		pstate->group_by_field_regexes            = NULL;
 		pstate->num_group_by_field_regexes        = 0;
 		pstate->invert_regex_group_by_field_names = FALSE;
-		pstate->groups_without_group_by_regex     = lhmslv_alloc();
-		pstate->groups_with_group_by_regex        = NULL;
 	}
 
 	pstate->do_iterative_stats            = do_iterative_stats;
 	pstate->allow_int_float               = allow_int_float;
 	pstate->do_interpolated_percentiles   = do_interpolated_percentiles;
+	pstate->percentile_sketch_k           = percentile_sketch_k;
+
+	pstate->do_dump_state  = do_dump_state;
+	pstate->do_merge_state = do_merge_state;
+	pstate->pstate_names   = slls_alloc();
+	for (sllse_t* pe = paccumulator_names->phead; pe != NULL; pe = pe->pnext) {
+		char* state_name = stats1_acc_state_name(pe->value);
+		int found = FALSE;
+		for (sllse_t* pf = pstate->pstate_names->phead; pf != NULL && !found; pf = pf->pnext)
+			found = streq(pf->value, state_name);
+		if (!found)
+			slls_append_no_free(pstate->pstate_names, state_name);
+	}
+	pstate->pdump_fields   = NULL;
+	pstate->psb            = sb_alloc(1024);
+	if (do_merge_state)
+		pstate->pvalue_ingestor = mapper_stats1_value_ingest_dumps;
+
+	pstate->num_threads      = num_threads;
+	// The JSON reader frees each file's parsed data, which its records point into,
+	// when it starts on the next file. Worker threads may still be working on the
+	// previous file's records at that point, so they get their own copies.
+	pstate->copy_records     = num_threads > 1 && ifile_fmt != NULL && streq(ifile_fmt, "json");
+	pstate->pworkers         = NULL;
+	pstate->ppending         = NULL;
+	pstate->num_batches_in_segment = 0;
+	pstate->num_segments     = 0LL;
+	pstate->pcompleted       = NULL;
+	pstate->next_merge_index = 0LL;
+	pstate->merging          = FALSE;
+	pstate->done             = FALSE;
+	pstate->pgroups          = stats1_groups_alloc(pstate);
+
+	if (num_threads > 1) {
+		pthread_mutex_init(&pstate->mutex, NULL);
+		pstate->pworkers = mlr_malloc_or_die(num_threads * sizeof(stats1_worker_t));
+		for (int i = 0; i < num_threads; i++) {
+			stats1_worker_t* pworker = &pstate->pworkers[i];
+			pworker->pstate       = pstate;
+			pworker->pqueue_head  = NULL;
+			pworker->pqueue_tail  = NULL;
+			pworker->queue_length = 0;
+			pthread_cond_init(&pworker->nonempty_cond, NULL);
+			pthread_cond_init(&pworker->nonfull_cond, NULL);
+		}
+		for (int i = 0; i < num_threads; i++) {
+			if (pthread_create(&pstate->pworkers[i].thread, NULL, stats1_worker_thread_main,
+				&pstate->pworkers[i]) != 0)
+			{
+				perror("pthread_create");
+				fprintf(stderr, "%s %s: could not create worker thread.\n",
+					MLR_GLOBALS.bargv0, mapper_stats1_setup.verb);
+				exit(1);
+			}
+		}
+	}
 
 	pmapper->pvstate       = pstate;
-	pmapper->pprocess_func = mapper_stats1_process;
+	pmapper->pprocess_func = do_merge_state ? mapper_stats1_process_merging
+		: num_threads > 1 ? mapper_stats1_process_threaded
+		: mapper_stats1_process;
 	pmapper->pfree_func    = mapper_stats1_free;
 
 	return pmapper;
@@ -292,7 +498,6 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 	mapper_stats1_state_t* pstate = pmapper->pvstate;
 	slls_free(pstate->paccumulator_names);
 	string_array_free(pstate->pvalue_field_names);
-	string_array_free(pstate->pvalue_field_values);
 	slls_free(pstate->pgroup_by_field_names);
 
 	if (pstate->value_field_regexes != NULL) {
@@ -307,59 +512,171 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 		free(pstate->group_by_field_regexes);
 	}
 
-	// lhmslv_free and lhmsv_free will free the hashmap keys; we need to free
-	// the void-star hashmap values.
-	if (pstate->groups_without_group_by_regex != NULL) {
-		for (lhmslve_t* pa = pstate->groups_without_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
-			lhmsv_t* pgroup_to_acc_field = pa->pvvalue;
-			for (lhmsve_t* pb = pgroup_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
-				acc_map_pair_t* pacc_field_to_acc_states = pb->pvvalue;
-				lhmsv_t* pacc_field_to_acc_state_in  = pacc_field_to_acc_states->pin;
-				lhmsv_t* pacc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
-				for (lhmsve_t* pc = pacc_field_to_acc_state_out->phead; pc != NULL; pc = pc->pnext) {
-					if (streq(pc->key, fake_acc_name_for_setups))
-						continue;
-					stats1_acc_t* pstats1_acc = pc->pvvalue;
-					pstats1_acc->pfree_func(pstats1_acc);
-				}
-				lhmsv_free(pacc_field_to_acc_state_in);
-				lhmsv_free(pacc_field_to_acc_state_out);
-				free(pacc_field_to_acc_states);
-			}
-			lhmsv_free(pgroup_to_acc_field);
+	stats1_groups_free(pstate->pgroups);
+	slls_free(pstate->pstate_names);
+	sb_free(pstate->psb);
+
+	if (pstate->num_threads > 1) {
+		for (int i = 0; i < pstate->num_threads; i++) {
+			pthread_cond_destroy(&pstate->pworkers[i].nonempty_cond);
+			pthread_cond_destroy(&pstate->pworkers[i].nonfull_cond);
 		}
-		lhmslv_free(pstate->groups_without_group_by_regex);
+		pthread_mutex_destroy(&pstate->mutex);
+		free(pstate->pworkers);
 	}
 
-	if (pstate->groups_with_group_by_regex != NULL) {
-		for (lhmslve_t* pa = pstate->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
+	ap_free(pstate->pargp);
+	free(pstate);
+	free(pmapper);
+}
+
+// ----------------------------------------------------------------
+// Field names given as regexes could match any field, and with --merge-state
+// the input fields are dumped states. With -s, the input records are passed
+// through with the stats so far added to them.
+static mapper_field_usage_t mapper_stats1_field_usage(mapper_t* pmapper, hss_t* pfield_names) {
+	mapper_stats1_state_t* pstate = pmapper->pvstate;
+	if (pstate->pvalue_field_names == NULL || pstate->pgroup_by_field_names == NULL || pstate->do_merge_state)
+		return MAPPER_USES_ALL_FIELDS;
+	for (int i = 0; i < pstate->pvalue_field_names->length; i++)
+		hss_add(pfield_names, pstate->pvalue_field_names->strings[i]);
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	return pstate->do_iterative_stats ? MAPPER_PASSES_OTHER_FIELDS : MAPPER_USES_NAMED_FIELDS_ONLY;
+}
+
+// ----------------------------------------------------------------
+static stats1_groups_t* stats1_groups_alloc(mapper_stats1_state_t* pstate) {
+	stats1_groups_t* pgroups = mlr_malloc_or_die(sizeof(stats1_groups_t));
+	if (pstate->group_by_field_regexes != NULL) {
+		pgroups->groups_without_group_by_regex = NULL;
+		pgroups->groups_with_group_by_regex    = lhmslv_alloc();
+	} else {
+		pgroups->groups_without_group_by_regex = group_table_alloc(pstate->pgroup_by_field_names->length);
+		pgroups->groups_with_group_by_regex    = NULL;
+	}
+	pgroups->pgroup_key = group_key_alloc();
+	pgroups->pvalue_field_values = pstate->pvalue_field_names == NULL
+		? NULL
+		: string_array_alloc(pstate->pvalue_field_names->length);
+	return pgroups;
+}
+
+// group_table_free, lhmslv_free, and lhmsv_free will free the hashmap keys; we
+// need to free the void-star hashmap values. Ones which were moved elsewhere
+// by a merge are NULL.
+static void stats1_groups_free(stats1_groups_t* pgroups) {
+	if (pgroups->groups_without_group_by_regex != NULL) {
+		group_table_t* ptable = pgroups->groups_without_group_by_regex;
+		for (int i = 0; i < ptable->num_entries; i++)
+			stats1_group_free(ptable->entries[i].pvvalue);
+		group_table_free(ptable);
+	}
+
+	if (pgroups->groups_with_group_by_regex != NULL) {
+		for (lhmslve_t* pa = pgroups->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
 			lhmslv_t* pgroups_by_names = pa->pvvalue;
-			for (lhmslve_t* pb = pgroups_by_names->phead; pb != NULL; pb = pb->pnext) {
-				lhmsv_t* pgroup_to_acc_field = pb->pvvalue;
-				for (lhmsve_t* pc = pgroup_to_acc_field->phead; pc != NULL; pc = pc->pnext) {
-					acc_map_pair_t* pacc_field_to_acc_states = pc->pvvalue;
-					lhmsv_t* pacc_field_to_acc_state_in  = pacc_field_to_acc_states->pin;
-					lhmsv_t* pacc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
-					for (lhmsve_t* pd = pacc_field_to_acc_state_out->phead; pd != NULL; pd = pd->pnext) {
-						if (streq(pd->key, fake_acc_name_for_setups))
-							continue;
-						stats1_acc_t* pstats1_acc = pd->pvvalue;
-						pstats1_acc->pfree_func(pstats1_acc);
-					}
-					lhmsv_free(pacc_field_to_acc_state_in);
-					lhmsv_free(pacc_field_to_acc_state_out);
-					free(pacc_field_to_acc_states);
+			if (pgroups_by_names == NULL)
+				continue;
+			for (lhmslve_t* pb = pgroups_by_names->phead; pb != NULL; pb = pb->pnext)
+				stats1_group_free(pb->pvvalue);
+			lhmslv_free(pgroups_by_names);
+		}
+		lhmslv_free(pgroups->groups_with_group_by_regex);
+	}
+
+	group_key_free(pgroups->pgroup_key);
+	string_array_free(pgroups->pvalue_field_values);
+	free(pgroups);
+}
+
+static void stats1_group_free(lhmsv_t* pgroup_to_acc_field) {
+	if (pgroup_to_acc_field == NULL)
+		return;
+	for (lhmsve_t* pb = pgroup_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
+		acc_map_pair_t* pacc_field_to_acc_states = pb->pvvalue;
+		if (pacc_field_to_acc_states == NULL)
+			continue;
+		lhmsv_t* pacc_field_to_acc_state_in  = pacc_field_to_acc_states->pin;
+		lhmsv_t* pacc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
+		for (lhmsve_t* pc = pacc_field_to_acc_state_out->phead; pc != NULL; pc = pc->pnext) {
+			if (streq(pc->key, fake_acc_name_for_setups))
+				continue;
+			stats1_acc_t* pstats1_acc = pc->pvvalue;
+			pstats1_acc->pfree_func(pstats1_acc);
+		}
+		lhmsv_free(pacc_field_to_acc_state_in);
+		lhmsv_free(pacc_field_to_acc_state_out);
+		free(pacc_field_to_acc_states);
+	}
+	lhmsv_free(pgroup_to_acc_field);
+}
+
+// ----------------------------------------------------------------
+// Folds the other group maps, from later in the record stream, into these.
+// Groups and value fields new to these maps are moved over, appended in the
+// other maps' order; for ones already present, the accumulators are merged.
+// The other maps must still be freed.
+static void stats1_groups_merge(stats1_groups_t* pgroups, stats1_groups_t* pother) {
+	if (pgroups->groups_without_group_by_regex != NULL) {
+		group_table_t* pother_table = pother->groups_without_group_by_regex;
+		for (int i = 0; i < pother_table->num_entries; i++) {
+			group_table_entry_t* pa = &pother_table->entries[i];
+			group_key_from_array(pgroups->pgroup_key, pa->key_values, pother_table->num_key_fields);
+			lhmsv_t** ppgroup_to_acc_field = (lhmsv_t**)group_table_get_or_add(
+				pgroups->groups_without_group_by_regex, pgroups->pgroup_key);
+			if (*ppgroup_to_acc_field == NULL) {
+				*ppgroup_to_acc_field = pa->pvvalue;
+				pa->pvvalue = NULL;
+			} else {
+				stats1_group_merge(pgroups, *ppgroup_to_acc_field, pa->pvvalue);
+			}
+		}
+	} else {
+		for (lhmslve_t* pa = pother->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
+			lhmslv_t* pgroups_by_names = lhmslv_get(pgroups->groups_with_group_by_regex, pa->key);
+			if (pgroups_by_names == NULL) {
+				lhmslv_put(pgroups->groups_with_group_by_regex, slls_copy(pa->key), pa->pvvalue, FREE_ENTRY_KEY);
+				pa->pvvalue = NULL;
+				continue;
+			}
+			lhmslv_t* pother_groups_by_names = pa->pvvalue;
+			for (lhmslve_t* pb = pother_groups_by_names->phead; pb != NULL; pb = pb->pnext) {
+				lhmsv_t* pgroup_to_acc_field = lhmslv_get(pgroups_by_names, pb->key);
+				if (pgroup_to_acc_field == NULL) {
+					lhmslv_put(pgroups_by_names, slls_copy(pb->key), pb->pvvalue, FREE_ENTRY_KEY);
+					pb->pvvalue = NULL;
+				} else {
+					stats1_group_merge(pgroups, pgroup_to_acc_field, pb->pvvalue);
 				}
-				lhmsv_free(pgroup_to_acc_field);
 			}
-			lhmslv_free(pgroups_by_names);
 		}
-		lhmslv_free(pstate->groups_with_group_by_regex);
 	}
+}
 
-	ap_free(pstate->pargp);
-	free(pstate);
-	free(pmapper);
+static void stats1_group_merge(stats1_groups_t* pgroups, lhmsv_t* pgroup_to_acc_field,
+	lhmsv_t* pother_group_to_acc_field)
+{
+	for (lhmsve_t* pb = pother_group_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
+		acc_map_pair_t* pother_acc_field_to_acc_states = pb->pvvalue;
+		acc_map_pair_t* pacc_field_to_acc_states = lhmsv_get(pgroup_to_acc_field, pb->key);
+		if (pacc_field_to_acc_states == NULL) {
+			// The accumulators may reference the key, so it moves along with them.
+			lhmsv_put(pgroup_to_acc_field, pb->key, pother_acc_field_to_acc_states, pb->free_flags);
+			pb->pvvalue = NULL;
+			pb->free_flags = NO_FREE;
+			continue;
+		}
+		// The input accumulators are the unique ones; see mapper_stats1_ingest_name_value.
+		for (lhmsve_t* pc = pother_acc_field_to_acc_states->pin->phead; pc != NULL; pc = pc->pnext) {
+			if (streq(pc->key, fake_acc_name_for_setups))
+				continue;
+			stats1_acc_t* pother_stats1_acc = pc->pvvalue;
+			stats1_acc_t* pstats1_acc = lhmsv_get(pacc_field_to_acc_states->pin, pc->key);
+			MLR_INTERNAL_CODING_ERROR_IF(pstats1_acc == NULL);
+			pstats1_acc->pmerge_func(pstats1_acc->pvstate, pother_stats1_acc->pvstate);
+		}
+	}
 }
 
 // ================================================================
@@ -411,7 +728,7 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_stats1_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_stats1_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		pstate->pgroup_by_ingestor(pinrec, pstate);
+		pstate->pgroup_by_ingestor(pinrec, pstate, pstate->pgroups);
 		if (pstate->do_iterative_stats) {
 			// The input record is modified in this case, with new fields appended
 			return sllv_single(pinrec);
@@ -427,37 +744,256 @@ static sllv_t* mapper_stats1_process(lrec_t* pinrec, context_t* pctx, void* pvst
 }
 
 // ----------------------------------------------------------------
-static void mapper_stats1_group_by_ingest_without_regexes(lrec_t* pinrec, mapper_stats1_state_t* pstate) {
+// Main-thread side of -j. The mapper chain runs only in the main thread, so
+// the pending batch needs no locking.
+static sllv_t* mapper_stats1_process_threaded(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_stats1_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		if (pstate->copy_records) {
+			lrec_t* pcopy = lrec_copy(pinrec);
+			lrec_free(pinrec);
+			pinrec = pcopy;
+		}
+		stats1_batch_t* pbatch = pstate->ppending;
+		if (pbatch == NULL) {
+			pbatch = mlr_malloc_or_die(sizeof(stats1_batch_t));
+			pbatch->length       = 0;
+			pbatch->ends_segment = FALSE;
+			pbatch->pnext        = NULL;
+			pstate->ppending = pbatch;
+		}
+		pbatch->precs[pbatch->length++] = pinrec;
+		if (pbatch->length == STATS1_BATCH_SIZE)
+			stats1_enqueue_pending(pstate, FALSE);
+		return NULL;
+
+	} else {
+		// Close out the last segment, if it's been started.
+		if (pstate->ppending == NULL && pstate->num_batches_in_segment > 0) {
+			pstate->ppending = mlr_malloc_or_die(sizeof(stats1_batch_t));
+			pstate->ppending->length = 0;
+			pstate->ppending->pnext  = NULL;
+		}
+		stats1_enqueue_pending(pstate, TRUE);
+
+		pthread_mutex_lock(&pstate->mutex);
+		pstate->done = TRUE;
+		for (int i = 0; i < pstate->num_threads; i++)
+			pthread_cond_signal(&pstate->pworkers[i].nonempty_cond);
+		pthread_mutex_unlock(&pstate->mutex);
+		for (int i = 0; i < pstate->num_threads; i++)
+			pthread_join(pstate->pworkers[i].thread, NULL);
+		MLR_INTERNAL_CODING_ERROR_IF(pstate->next_merge_index != pstate->num_segments);
+		return pstate->pemitter(pstate);
+	}
+}
+
+// Hands the pending batch to the current segment's worker, waiting if that
+// worker's queue is full so as to bound memory use when input outpaces it.
+static void stats1_enqueue_pending(mapper_stats1_state_t* pstate, int ends_segment) {
+	stats1_batch_t* pbatch = pstate->ppending;
+	if (pbatch == NULL)
+		return;
+	pstate->ppending = NULL;
+
+	stats1_worker_t* pworker = &pstate->pworkers[pstate->num_segments % pstate->num_threads];
+	if (++pstate->num_batches_in_segment == STATS1_BATCHES_PER_SEGMENT || ends_segment) {
+		pbatch->ends_segment = TRUE;
+		pstate->num_batches_in_segment = 0;
+		pstate->num_segments++;
+	} else {
+		pbatch->ends_segment = FALSE;
+	}
+
+	pthread_mutex_lock(&pstate->mutex);
+	while (pworker->queue_length >= STATS1_MAX_QUEUED_BATCHES)
+		pthread_cond_wait(&pworker->nonfull_cond, &pstate->mutex);
+	if (pworker->pqueue_tail == NULL)
+		pworker->pqueue_head = pbatch;
+	else
+		pworker->pqueue_tail->pnext = pbatch;
+	pworker->pqueue_tail = pbatch;
+	pworker->queue_length++;
+	pthread_cond_signal(&pworker->nonempty_cond);
+	pthread_mutex_unlock(&pstate->mutex);
+}
+
+// ----------------------------------------------------------------
+// Worker i gets segments i, i+n, i+2n, etc. for n threads.
+static void* stats1_worker_thread_main(void* pvworker) {
+	stats1_worker_t* pworker = pvworker;
+	mapper_stats1_state_t* pstate = pworker->pstate;
+	long long segment_index = pworker - pstate->pworkers;
+	stats1_groups_t* pgroups = NULL;
+
+	while (TRUE) {
+		pthread_mutex_lock(&pstate->mutex);
+		while (pworker->pqueue_head == NULL && !pstate->done)
+			pthread_cond_wait(&pworker->nonempty_cond, &pstate->mutex);
+		stats1_batch_t* pbatch = pworker->pqueue_head;
+		if (pbatch != NULL) {
+			pworker->pqueue_head = pbatch->pnext;
+			if (pworker->pqueue_head == NULL)
+				pworker->pqueue_tail = NULL;
+			pworker->queue_length--;
+			pthread_cond_signal(&pworker->nonfull_cond);
+		}
+		pthread_mutex_unlock(&pstate->mutex);
+
+		if (pbatch == NULL) // Done, and queue drained
+			break;
+
+		if (pgroups == NULL)
+			pgroups = stats1_groups_alloc(pstate);
+		for (int i = 0; i < pbatch->length; i++) {
+			pstate->pgroup_by_ingestor(pbatch->precs[i], pstate, pgroups);
+			lrec_free(pbatch->precs[i]);
+		}
+		if (pbatch->ends_segment) {
+			stats1_merge_completed(pstate, segment_index, pgroups);
+			pgroups = NULL;
+			segment_index += pstate->num_threads;
+		}
+		free(pbatch);
+	}
+
+	MLR_INTERNAL_CODING_ERROR_IF(pgroups != NULL);
+	return NULL;
+}
+
+// Files the segment among the completed ones, then, unless another worker is
+// already doing so, merges completed segments into the main group maps for as
+// long as the next one in sequence is available. The merge itself is done
+// outside the lock so that other workers can keep dequeueing and filing.
+static void stats1_merge_completed(mapper_stats1_state_t* pstate, long long segment_index,
+	stats1_groups_t* pgroups)
+{
+	stats1_segment_t* psegment = mlr_malloc_or_die(sizeof(stats1_segment_t));
+	psegment->index   = segment_index;
+	psegment->pgroups = pgroups;
+
+	pthread_mutex_lock(&pstate->mutex);
+	stats1_segment_t** ppnext = &pstate->pcompleted;
+	while (*ppnext != NULL && (*ppnext)->index < segment_index)
+		ppnext = &(*ppnext)->pnext;
+	psegment->pnext = *ppnext;
+	*ppnext = psegment;
+
+	if (!pstate->merging) {
+		pstate->merging = TRUE;
+		while (pstate->pcompleted != NULL && pstate->pcompleted->index == pstate->next_merge_index) {
+			stats1_segment_t* pnext_segment = pstate->pcompleted;
+			pstate->pcompleted = pnext_segment->pnext;
+			pthread_mutex_unlock(&pstate->mutex);
+
+			stats1_groups_merge(pstate->pgroups, pnext_segment->pgroups);
+			stats1_groups_free(pnext_segment->pgroups);
+			free(pnext_segment);
+
+			pthread_mutex_lock(&pstate->mutex);
+			pstate->next_merge_index++;
+		}
+		pstate->merging = FALSE;
+	}
+	pthread_mutex_unlock(&pstate->mutex);
+}
+
+// ----------------------------------------------------------------
+// For --merge-state. Each input record is as output by --dump-state: group-by
+// fields along with dumped states in fields named {value-field name}_{state name}.
+// The latter are split off, so that group-by regexes don't see them, for the
+// value ingestor to merge in.
+static sllv_t* mapper_stats1_process_merging(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_stats1_state_t* pstate = pvstate;
+	if (pinrec == NULL)
+		return pstate->pemitter(pstate);
+
+	lrec_t* pgroup_by_rec = lrec_unbacked_alloc();
+	pstate->pdump_fields = lrec_unbacked_alloc();
+	for (lrece_t* pe = pinrec->phead; pe != NULL; pe = pe->pnext) {
+		char* state_name = NULL;
+		char* value_field_name = mapper_stats1_split_state_field_name(pstate, pe->key, &state_name);
+		if (value_field_name != NULL) {
+			lrec_put(pstate->pdump_fields, pe->key, pe->value, NO_FREE);
+			free(value_field_name);
+		} else {
+			lrec_put(pgroup_by_rec, pe->key, pe->value, NO_FREE);
+		}
+	}
+
+	pstate->pgroup_by_ingestor(pgroup_by_rec, pstate, pstate->pgroups);
+
+	lrec_free(pstate->pdump_fields);
+	pstate->pdump_fields = NULL;
+	lrec_free(pgroup_by_rec);
+	lrec_free(pinrec);
+	return NULL;
+}
+
+// If the field name is a value-field name, as selected by -f/--fr/--fx, followed
+// by an underscore and an accumulator-state name, returns a copy of the
+// value-field name and points to the state name. Else returns NULL.
+static char* mapper_stats1_split_state_field_name(mapper_stats1_state_t* pstate, char* field_name,
+	char** pstate_name)
+{
+	int field_name_length = strlen(field_name);
+	for (sllse_t* pe = pstate->pstate_names->phead; pe != NULL; pe = pe->pnext) {
+		char* state_name = pe->value;
+		int prefix_length = field_name_length - strlen(state_name) - 1;
+		if (prefix_length < 1 || field_name[prefix_length] != '_'
+			|| !streq(&field_name[prefix_length + 1], state_name))
+		{
+			continue;
+		}
+		char* value_field_name = mlr_malloc_or_die(prefix_length + 1);
+		memcpy(value_field_name, field_name, prefix_length);
+		value_field_name[prefix_length] = 0;
+
+		int selected = FALSE;
+		if (pstate->pvalue_field_names != NULL) {
+			for (int i = 0; i < pstate->pvalue_field_names->length && !selected; i++)
+				selected = streq(pstate->pvalue_field_names->strings[i], value_field_name);
+		} else {
+			for (int i = 0; i < pstate->num_value_field_regexes && !selected; i++)
+				selected = regmatch_or_die(&pstate->value_field_regexes[i], value_field_name, 0, NULL);
+			selected ^= pstate->invert_regex_value_field_names;
+		}
+		if (selected) {
+			*pstate_name = state_name;
+			return value_field_name;
+		}
+		free(value_field_name);
+	}
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static void mapper_stats1_group_by_ingest_without_regexes(lrec_t* pinrec, mapper_stats1_state_t* pstate,
+	stats1_groups_t* pgroups)
+{
 	// E.g. ["s", "t"]
 	// To do: make value_field_values into a hashmap. Then accept partial
 	// population on that, but retain full-population requirement on group-by.
 	// E.g. if accumulating stats of x,y on a,b then skip record with x,y,a but
 	// process record with x,a,b.
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-	if (pgroup_by_field_values == NULL) {
-		slls_free(pgroup_by_field_values);
+	if (!group_key_from_record(pgroups->pgroup_key, pinrec, pstate->pgroup_by_field_names))
 		return;
-	}
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	lhmsv_t* pgroup_by_field_values_to_acc_fields = lhmslv_get(pstate->groups_without_group_by_regex,
-		pgroup_by_field_values);
-	if (pgroup_by_field_values_to_acc_fields == NULL) {
-		pgroup_by_field_values_to_acc_fields = lhmsv_alloc();
-		lhmslv_put(pstate->groups_without_group_by_regex, slls_copy(pgroup_by_field_values),
-			pgroup_by_field_values_to_acc_fields, FREE_ENTRY_KEY);
-	}
+	lhmsv_t** ppgroup_by_field_values_to_acc_fields = (lhmsv_t**)group_table_get_or_add(
+		pgroups->groups_without_group_by_regex, pgroups->pgroup_key);
+	if (*ppgroup_by_field_values_to_acc_fields == NULL)
+		*ppgroup_by_field_values_to_acc_fields = lhmsv_alloc();
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	// for x=1 and y=2
-	pstate->pvalue_ingestor(pinrec, pstate, pgroup_by_field_values_to_acc_fields);
-
-	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	slls_free(pgroup_by_field_values);
+	pstate->pvalue_ingestor(pinrec, pstate, pgroups, *ppgroup_by_field_values_to_acc_fields);
 }
 
 // ----------------------------------------------------------------
-static void mapper_stats1_group_by_ingest_with_regexes(lrec_t* pinrec, mapper_stats1_state_t* pstate) {
+static void mapper_stats1_group_by_ingest_with_regexes(lrec_t* pinrec, mapper_stats1_state_t* pstate,
+	stats1_groups_t* pgroups)
+{
 	// E.g. {"a": "s", "b":"t"}
 	lhmss_t* group_by_pairs = mlr_reference_key_value_pairs_from_regex_names(pinrec,
 		pstate->group_by_field_regexes, pstate->num_group_by_field_regexes, pstate->invert_regex_group_by_field_names);
@@ -472,10 +1008,10 @@ static void mapper_stats1_group_by_ingest_with_regexes(lrec_t* pinrec, mapper_st
 	}
 
 	// Two-level map: group-by field names -> group-by field values -> acc-field map
-	lhmslv_t* pgroups_by_names = lhmslv_get(pstate->groups_with_group_by_regex, pgroup_by_field_names);
+	lhmslv_t* pgroups_by_names = lhmslv_get(pgroups->groups_with_group_by_regex, pgroup_by_field_names);
 	if (pgroups_by_names == NULL) {
 		pgroups_by_names = lhmslv_alloc();
-		lhmslv_put(pstate->groups_with_group_by_regex, slls_copy(pgroup_by_field_names), pgroups_by_names,
+		lhmslv_put(pgroups->groups_with_group_by_regex, slls_copy(pgroup_by_field_names), pgroups_by_names,
 			FREE_ENTRY_KEY);
 	}
 
@@ -489,7 +1025,7 @@ static void mapper_stats1_group_by_ingest_with_regexes(lrec_t* pinrec, mapper_st
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	// E.g. {"x": 1, "y": 2}
-	pstate->pvalue_ingestor(pinrec, pstate, pgroup_by_field_values_to_acc_fields);
+	pstate->pvalue_ingestor(pinrec, pstate, pgroups, pgroup_by_field_values_to_acc_fields);
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	slls_free(pgroup_by_field_names);
@@ -501,15 +1037,16 @@ static void mapper_stats1_group_by_ingest_with_regexes(lrec_t* pinrec, mapper_st
 static void mapper_stats1_value_ingest_without_regexes(
 	lrec_t*                pinrec,
 	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups,
 	lhmsv_t*               pgroup_by_field_values_to_acc_fields)
 {
 	mlr_reference_values_from_record_into_string_array(pinrec, pstate->pvalue_field_names,
-		pstate->pvalue_field_values);
+		pgroups->pvalue_field_values);
 	int n = pstate->pvalue_field_names->length;
 	for (int i = 0; i < n; i++) {
 		char* value_field_name = pstate->pvalue_field_names->strings[i];
-		char* value_field_sval = pstate->pvalue_field_values->strings[i];
-		mapper_stats1_ingest_name_value(pinrec, pstate, value_field_name, value_field_sval,
+		char* value_field_sval = pgroups->pvalue_field_values->strings[i];
+		mapper_stats1_ingest_name_value(pinrec, pstate, pgroups, value_field_name, value_field_sval,
 			pgroup_by_field_values_to_acc_fields);
 	}
 }
@@ -518,6 +1055,7 @@ static void mapper_stats1_value_ingest_without_regexes(
 static void mapper_stats1_value_ingest_with_regexes(
 	lrec_t*                pinrec,
 	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups,
 	lhmsv_t*               pgroup_by_field_values_to_acc_fields)
 {
 	lhmss_t* value_pairs = mlr_reference_key_value_pairs_from_regex_names(pinrec,
@@ -525,38 +1063,79 @@ static void mapper_stats1_value_ingest_with_regexes(
 	for (lhmsse_t* pf = value_pairs->phead; pf != NULL; pf = pf->pnext) {
 		char* value_field_name = pf->key;
 		char* value_field_sval = pf->value;
-		mapper_stats1_ingest_name_value(pinrec, pstate, value_field_name, value_field_sval,
+		mapper_stats1_ingest_name_value(pinrec, pstate, pgroups, value_field_name, value_field_sval,
 			pgroup_by_field_values_to_acc_fields);
 	}
 	lhmss_free(value_pairs);
 }
 
 // ----------------------------------------------------------------
-static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_t* pstate,
-	char* value_field_name, char* value_field_sval, lhmsv_t* pgroup_to_acc_field)
+// For --merge-state: folds the current record's dumped states into the group's accumulators.
+static void mapper_stats1_value_ingest_dumps(
+	lrec_t*                pinrec,
+	mapper_stats1_state_t* pstate,
+	stats1_groups_t*       pgroups,
+	lhmsv_t*               pgroup_by_field_values_to_acc_fields)
+{
+	for (lrece_t* pe = pstate->pdump_fields->phead; pe != NULL; pe = pe->pnext) {
+		char* state_name = NULL;
+		char* value_field_name = mapper_stats1_split_state_field_name(pstate, pe->key, &state_name);
+		MLR_INTERNAL_CODING_ERROR_IF(value_field_name == NULL);
+		acc_map_pair_t* pacc_field_to_acc_states = mapper_stats1_get_accs(pstate, pgroups, value_field_name,
+			pgroup_by_field_values_to_acc_fields);
+
+		for (lhmsve_t* pc = pacc_field_to_acc_states->pin->phead; pc != NULL; pc = pc->pnext) {
+			if (streq(pc->key, fake_acc_name_for_setups))
+				continue;
+			if (!streq(stats1_acc_state_name(pc->key), state_name))
+				continue;
+			stats1_acc_t* pstats1_acc = pc->pvvalue;
+			char* dump = mlr_strdup_or_die(pe->value);
+			if (!pstats1_acc->pmerge_dump_func(pstats1_acc->pvstate, dump)) {
+				fprintf(stderr, "%s %s: could not parse accumulator state in field \"%s\".\n",
+					MLR_GLOBALS.bargv0, mapper_stats1_setup.verb, pe->key);
+				exit(1);
+			}
+			free(dump);
+		}
+		free(value_field_name);
+	}
+}
+
+// ----------------------------------------------------------------
+// For percentiles there is one unique accumulator given (for example) five distinct
+// names p0,p25,p50,p75,p100.  The input accumulators are unique: only one
+// percentile-keeper. There are multiple output accumulators: each references the same
+// underlying percentile-keeper but with distinct parameters.  Hence the ->pin and ->pout maps.
+static acc_map_pair_t* mapper_stats1_get_accs(mapper_stats1_state_t* pstate, stats1_groups_t* pgroups,
+	char* value_field_name, lhmsv_t* pgroup_to_acc_field)
 {
-	// For percentiles there is one unique accumulator given (for example) five distinct
-	// names p0,p25,p50,p75,p100.  The input accumulators are unique: only one
-	// percentile-keeper. There are multiple output accumulators: each references the same
-	// underlying percentile-keeper but with distinct parameters.  Hence the ->pin and ->pout maps.
 	acc_map_pair_t* pacc_field_to_acc_states = lhmsv_get(pgroup_to_acc_field, value_field_name);
 	if (pacc_field_to_acc_states == NULL) {
 		pacc_field_to_acc_states = mlr_malloc_or_die(sizeof(acc_map_pair_t));
 		pacc_field_to_acc_states->pin  = lhmsv_alloc();
 		pacc_field_to_acc_states->pout = lhmsv_alloc();
-		lhmsv_put(pgroup_to_acc_field, value_field_name, pacc_field_to_acc_states, NO_FREE);
+		// The name may point into the record, which the map and the accumulators
+		// outlive, so they share a copy.
+		char* name_copy = mlr_strdup_or_die(value_field_name);
+		lhmsv_put(pgroup_to_acc_field, name_copy, pacc_field_to_acc_states, FREE_ENTRY_KEY);
+		make_stats1_accs(name_copy, pstate->paccumulator_names, pstate->allow_int_float,
+			pstate->do_interpolated_percentiles, pstate->percentile_sketch_k,
+			pacc_field_to_acc_states->pin, pacc_field_to_acc_states->pout);
+		lhmsv_put(pacc_field_to_acc_states->pin, fake_acc_name_for_setups, fake_acc_name_for_setups, NO_FREE);
 	}
+	return pacc_field_to_acc_states;
+}
+
+// ----------------------------------------------------------------
+static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_t* pstate,
+	stats1_groups_t* pgroups, char* value_field_name, char* value_field_sval, lhmsv_t* pgroup_to_acc_field)
+{
+	acc_map_pair_t* pacc_field_to_acc_states = mapper_stats1_get_accs(pstate, pgroups, value_field_name,
+		pgroup_to_acc_field);
 	lhmsv_t* acc_field_to_acc_state_in  = pacc_field_to_acc_states->pin;
 	lhmsv_t* acc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
 
-	// Look up presence of all accumulators at this level's hashmap.
-	char* presence = lhmsv_get(acc_field_to_acc_state_in, fake_acc_name_for_setups);
-	if (presence == NULL) {
-		make_stats1_accs(value_field_name, pstate->paccumulator_names, pstate->allow_int_float,
-			pstate->do_interpolated_percentiles, acc_field_to_acc_state_in, acc_field_to_acc_state_out);
-		lhmsv_put(acc_field_to_acc_state_in, fake_acc_name_for_setups, fake_acc_name_for_setups, NO_FREE);
-	}
-
 	if (value_field_sval == NULL) // Key not present
 		return;
 	if (*value_field_sval == 0) // Key present with null value
@@ -610,15 +1189,15 @@ static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_
 static sllv_t* mapper_stats1_emit_all_without_group_by_regexes(mapper_stats1_state_t* pstate) {
 	sllv_t* poutrecs = sllv_alloc();
 
-	for (lhmslve_t* pa = pstate->groups_without_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
-		slls_t* pgroup_by_field_values = pa->key;
+	group_table_t* ptable = pstate->pgroups->groups_without_group_by_regex;
+	for (int i = 0; i < ptable->num_entries; i++) {
+		group_table_entry_t* pa = &ptable->entries[i];
 		lrec_t* poutrec = lrec_unbacked_alloc();
 
 		// Add in a=s,b=t fields:
-		sllse_t* pb = pstate->pgroup_by_field_names->phead;
-		sllse_t* pc =         pgroup_by_field_values->phead;
-		for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-			lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+		int j = 0;
+		for (sllse_t* pb = pstate->pgroup_by_field_names->phead; pb != NULL; pb = pb->pnext, j++) {
+			lrec_put(poutrec, pb->value, pa->key_values[j], NO_FREE);
 		}
 
 		// Add in fields such as x_sum=#, y_count=#, etc.:
@@ -627,8 +1206,12 @@ static sllv_t* mapper_stats1_emit_all_without_group_by_regexes(mapper_stats1_sta
 		for (lhmsve_t* pd = pgroup_to_acc_field->phead; pd != NULL; pd = pd->pnext) {
 			char* value_field_name = pd->key;
 			acc_map_pair_t* pacc_field_to_acc_states = pd->pvvalue;
-			lhmsv_t* acc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
-			mapper_stats1_emit(pstate, poutrec, value_field_name, acc_field_to_acc_state_out);
+			if (pstate->do_dump_state) {
+				mapper_stats1_emit_dumps(pstate, poutrec, value_field_name, pacc_field_to_acc_states->pin);
+			} else {
+				lhmsv_t* acc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
+				mapper_stats1_emit(pstate, poutrec, value_field_name, acc_field_to_acc_state_out);
+			}
 		}
 		sllv_append(poutrecs, poutrec);
 	}
@@ -641,7 +1224,7 @@ static sllv_t* mapper_stats1_emit_all_with_group_by_regexes(mapper_stats1_state_
 	sllv_t* poutrecs = sllv_alloc();
 
 	// Two-level map: group-by field names -> group-by field values -> acc-field map
-	for (lhmslve_t* pa = pstate->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
+	for (lhmslve_t* pa = pstate->pgroups->groups_with_group_by_regex->phead; pa != NULL; pa = pa->pnext) {
 		slls_t* pgroup_by_field_names = pa->key;
 		lhmslv_t* pgroups_by_names = pa->pvvalue;
 
@@ -663,8 +1246,12 @@ static sllv_t* mapper_stats1_emit_all_with_group_by_regexes(mapper_stats1_state_
 			for (lhmsve_t* pe = pgroup_by_field_values_to_acc_field->phead; pe != NULL; pe = pe->pnext) {
 				char* value_field_name = pe->key;
 				acc_map_pair_t* pacc_field_to_acc_states = pe->pvvalue;
-				lhmsv_t* acc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
-				mapper_stats1_emit(pstate, poutrec, value_field_name, acc_field_to_acc_state_out);
+				if (pstate->do_dump_state) {
+					mapper_stats1_emit_dumps(pstate, poutrec, value_field_name, pacc_field_to_acc_states->pin);
+				} else {
+					lhmsv_t* acc_field_to_acc_state_out = pacc_field_to_acc_states->pout;
+					mapper_stats1_emit(pstate, poutrec, value_field_name, acc_field_to_acc_state_out);
+				}
 			}
 
 			sllv_append(poutrecs, poutrec);
@@ -691,3 +1278,20 @@ static lrec_t* mapper_stats1_emit(mapper_stats1_state_t* pstate, lrec_t* poutrec
 	}
 	return poutrec;
 }
+
+// ----------------------------------------------------------------
+// Adds in fields such as x_sum, x_percentiles, etc. with the accumulators'
+// dumped states. The input accumulators are the unique ones.
+static void mapper_stats1_emit_dumps(mapper_stats1_state_t* pstate, lrec_t* poutrec,
+	char* value_field_name, lhmsv_t* acc_field_to_acc_state_in)
+{
+	for (lhmsve_t* pe = acc_field_to_acc_state_in->phead; pe != NULL; pe = pe->pnext) {
+		char* stats1_acc_name = pe->key;
+		if (streq(stats1_acc_name, fake_acc_name_for_setups))
+			continue;
+		stats1_acc_t* pstats1_acc = pe->pvvalue;
+		pstats1_acc->pdump_func(pstats1_acc->pvstate, pstate->psb);
+		lrec_put(poutrec, mlr_paste_3_strings(value_field_name, "_", stats1_acc_state_name(stats1_acc_name)),
+			sb_finish(pstate->psb), FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
+	}
+}
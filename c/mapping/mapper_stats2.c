@@ -6,6 +6,7 @@
 #include "lib/mlr_globals.h"
 #include "lib/mlrmath.h"
 #include "lib/mlrstat.h"
+#include "lib/string_builder.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
 #include "lib/string_array.h"
@@ -15,6 +16,7 @@
 #include "containers/mixutil.h"
 #include "containers/dvector.h"
 #include "mapping/mappers.h"
+#include "mapping/acc_state.h"
 #include "cli/argparse.h"
 
 typedef enum _bivar_measure_t {
@@ -30,12 +32,18 @@ typedef void stats2_ingest_func_t(void* pvstate, double x, double y);
 typedef void   stats2_emit_func_t(void* pvstate, char* name1, char* name2, lrec_t* poutrec);
 typedef void    stats2_fit_func_t(void* pvstate, double x, double y, lrec_t* poutrec);
 typedef void   stats2_free_func_t(struct _stats2_acc_t* pstats2_acc);
+// For --dump-state and --merge-state; see acc_state.h. The merge modifies the
+// dump in place, and returns FALSE if it can't be parsed.
+typedef void   stats2_dump_func_t(void* pvstate, string_builder_t* psb);
+typedef int    stats2_merge_dump_func_t(void* pvstate, char* dump);
 
 typedef struct _stats2_acc_t {
 	void* pvstate;
 	stats2_ingest_func_t* pingest_func;
 	stats2_emit_func_t*   pemit_func;
 	stats2_fit_func_t*    pfit_func;
+	stats2_dump_func_t*   pdump_func;
+	stats2_merge_dump_func_t* pmerge_dump_func;
 	stats2_free_func_t*   pfree_func; // virtual destructor
 } stats2_acc_t;
 
@@ -49,6 +57,9 @@ typedef struct _mapper_stats2_state_t {
 	int       do_verbose;
 	int       do_iterative_stats;
 	int       do_hold_and_fit;
+	int       do_dump_state;
+	int       do_merge_state;
+	string_builder_t* psb;
 } mapper_stats2_state_t;
 
 typedef stats2_acc_t* stats2_alloc_func_t(char* value_field_name_1, char* value_field_name_2, char* stats2_acc_name, int do_verbose);
@@ -59,10 +70,13 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_name_pairs, slls_t* pgroup_by_field_names,
-	int do_verbose, int do_iterative_stats, int do_hold_and_fit);
+	int do_verbose, int do_iterative_stats, int do_hold_and_fit, int do_dump_state, int do_merge_state);
 static void      mapper_stats2_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_stats2_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static void      mapper_stats2_ingest(lrec_t* pinrec, context_t* pctx, mapper_stats2_state_t* pstate);
+static void      mapper_stats2_ingest_dumps(lrec_t* pinrec, mapper_stats2_state_t* pstate);
+static stats2_acc_t* mapper_stats2_get_acc(mapper_stats2_state_t* pstate, lhmsv_t* pacc_fields_to_acc_state,
+	char* value_field_name_1, char* value_field_name_2, char* stats2_acc_name);
 static sllv_t*   mapper_stats2_emit_all(mapper_stats2_state_t* pstate);
 static void      mapper_stats2_emit(mapper_stats2_state_t* pstate, lrec_t* pinrec,
 	char* value_field_name_1, char* value_field_name_2, lhmsv_t* pacc_fields_to_acc_state);
@@ -123,7 +137,15 @@ static void mapper_stats2_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "               the input data to compute new fit fields. All input records are\n");
 	fprintf(o, "               held in memory until end of input stream. Has effect only for\n");
 	fprintf(o, "               linreg-ols, linreg-pca, and logireg.\n");
-	fprintf(o, "Only one of -s or --fit may be used.\n");
+	fprintf(o, "--dump-state   Instead of statistics, output accumulator states: one record\n");
+	fprintf(o, "               per group, with fields such as x_y_corr. These may be saved,\n");
+	fprintf(o, "               e.g. one file per shard of a larger data set, for use with\n");
+	fprintf(o, "               --merge-state.\n");
+	fprintf(o, "--merge-state  Take as input the records output by --dump-state, from any\n");
+	fprintf(o, "               number of runs with the same -a, -f, and -g. Output is as if a\n");
+	fprintf(o, "               single run had seen all the original data. With --dump-state,\n");
+	fprintf(o, "               outputs the merged states instead.\n");
+	fprintf(o, "Only one of -s, --fit, or --dump-state/--merge-state may be used.\n");
 	fprintf(o, "Example: %s %s -a linreg-pca -f x,y\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a linreg-ols,r2 -f x,y -g size,shape\n", argv0, verb);
 	fprintf(o, "Example: %s %s -a corr -f x,y\n", argv0, verb);
@@ -139,6 +161,8 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 	int             do_iterative_stats    = FALSE;
 	int             do_hold_and_fit       = FALSE;
 	int             allow_int_float       = TRUE;
+	int             do_dump_state         = FALSE;
+	int             do_merge_state        = FALSE;
 
 	char* verb = argv[(*pargi)++];
 
@@ -149,6 +173,8 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 	ap_define_true_flag(pstate,         "-v",    &do_verbose);
 	ap_define_true_flag(pstate,         "-s",    &do_iterative_stats);
 	ap_define_true_flag(pstate,         "--fit", &do_hold_and_fit);
+	ap_define_true_flag(pstate,         "--dump-state",  &do_dump_state);
+	ap_define_true_flag(pstate,         "--merge-state", &do_merge_state);
 	// The -F isn't used for stats2: all arithmetic here is floating-point. Yet
 	// it is supported for step and stats1 for all applicable stats1/step
 	// accumulators, so we accept here as well for all applicable stats2
@@ -159,7 +185,7 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 		mapper_stats2_usage(stderr, argv[0], verb);
 		return NULL;
 	}
-	if (do_iterative_stats && do_hold_and_fit) {
+	if (do_iterative_stats + do_hold_and_fit + (do_dump_state || do_merge_state) > 1) {
 		mapper_stats2_usage(stderr, argv[0], verb);
 		return NULL;
 	}
@@ -173,13 +199,13 @@ static mapper_t* mapper_stats2_parse_cli(int* pargi, int argc, char** argv,
 	}
 
 	return mapper_stats2_alloc(pstate, paccumulator_names, pvalue_field_names, pgroup_by_field_names,
-		do_verbose, do_iterative_stats, do_hold_and_fit);
+		do_verbose, do_iterative_stats, do_hold_and_fit, do_dump_state, do_merge_state);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_name_pairs, slls_t* pgroup_by_field_names,
-	int do_verbose, int do_iterative_stats, int do_hold_and_fit)
+	int do_verbose, int do_iterative_stats, int do_hold_and_fit, int do_dump_state, int do_merge_state)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -193,6 +219,9 @@ static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 	pstate->do_verbose               = do_verbose;
 	pstate->do_iterative_stats       = do_iterative_stats;
 	pstate->do_hold_and_fit          = do_hold_and_fit;
+	pstate->do_dump_state            = do_dump_state;
+	pstate->do_merge_state           = do_merge_state;
+	pstate->psb                      = sb_alloc(1024);
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_stats2_process;
@@ -226,6 +255,7 @@ static void mapper_stats2_free(mapper_t* pmapper, context_t* _) {
 		sllv_free(plist);
 	}
 	lhmslv_free(pstate->record_groups);
+	sb_free(pstate->psb);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -268,6 +298,11 @@ static void mapper_stats2_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_stats2_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_stats2_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
+		if (pstate->do_merge_state) {
+			mapper_stats2_ingest_dumps(pinrec, pstate);
+			lrec_free(pinrec);
+			return NULL;
+		}
 		mapper_stats2_ingest(pinrec, pctx, pstate);
 		if (pstate->do_iterative_stats) {
 			// The input record is modified in this case, with new fields appended
@@ -340,16 +375,8 @@ static void mapper_stats2_ingest(lrec_t* pinrec, context_t* pctx, mapper_stats2_
 		sllse_t* pc = pstate->paccumulator_names->phead;
 		for ( ; pc != NULL; pc = pc->pnext) {
 			char* stats2_acc_name = pc->value;
-			stats2_acc_t* pstats2_acc = lhmsv_get(pacc_fields_to_acc_state, stats2_acc_name);
-			if (pstats2_acc == NULL) {
-				pstats2_acc = make_stats2(value_field_name_1, value_field_name_2, stats2_acc_name, pstate->do_verbose);
-				if (pstats2_acc == NULL) {
-					fprintf(stderr, "mlr stats2: accumulator \"%s\" not found.\n",
-						stats2_acc_name);
-					exit(1);
-				}
-				lhmsv_put(pacc_fields_to_acc_state, stats2_acc_name, pstats2_acc, NO_FREE);
-			}
+			stats2_acc_t* pstats2_acc = mapper_stats2_get_acc(pstate, pacc_fields_to_acc_state,
+				value_field_name_1, value_field_name_2, stats2_acc_name);
 			if (sval1 == NULL || sval2 == NULL)
 				continue;
 
@@ -366,6 +393,71 @@ static void mapper_stats2_ingest(lrec_t* pinrec, context_t* pctx, mapper_stats2_
 	slls_free(pgroup_by_field_values);
 }
 
+static stats2_acc_t* mapper_stats2_get_acc(mapper_stats2_state_t* pstate, lhmsv_t* pacc_fields_to_acc_state,
+	char* value_field_name_1, char* value_field_name_2, char* stats2_acc_name)
+{
+	stats2_acc_t* pstats2_acc = lhmsv_get(pacc_fields_to_acc_state, stats2_acc_name);
+	if (pstats2_acc == NULL) {
+		pstats2_acc = make_stats2(value_field_name_1, value_field_name_2, stats2_acc_name, pstate->do_verbose);
+		if (pstats2_acc == NULL) {
+			fprintf(stderr, "mlr stats2: accumulator \"%s\" not found.\n",
+				stats2_acc_name);
+			exit(1);
+		}
+		lhmsv_put(pacc_fields_to_acc_state, stats2_acc_name, pstats2_acc, NO_FREE);
+	}
+	return pstats2_acc;
+}
+
+// ----------------------------------------------------------------
+// For --merge-state. Each input record is as output by --dump-state: group-by
+// fields along with dumped states in fields such as x_y_corr.
+static void mapper_stats2_ingest_dumps(lrec_t* pinrec, mapper_stats2_state_t* pstate) {
+	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
+	if (pgroup_by_field_values == NULL) {
+		return;
+	}
+
+	lhms2v_t* pgroup_to_acc_field = lhmslv_get(pstate->acc_groups, pgroup_by_field_values);
+	if (pgroup_to_acc_field == NULL) {
+		pgroup_to_acc_field = lhms2v_alloc();
+		lhmslv_put(pstate->acc_groups, slls_copy(pgroup_by_field_values), pgroup_to_acc_field, FREE_ENTRY_KEY);
+	}
+
+	int n = pstate->pvalue_field_name_pairs->length;
+	for (int i = 0; i < n; i += 2) {
+		char* value_field_name_1 = pstate->pvalue_field_name_pairs->strings[i];
+		char* value_field_name_2 = pstate->pvalue_field_name_pairs->strings[i+1];
+
+		lhmsv_t* pacc_fields_to_acc_state = lhms2v_get(pgroup_to_acc_field, value_field_name_1, value_field_name_2);
+		if (pacc_fields_to_acc_state == NULL) {
+			pacc_fields_to_acc_state = lhmsv_alloc();
+			lhms2v_put(pgroup_to_acc_field, value_field_name_1, value_field_name_2, pacc_fields_to_acc_state, NO_FREE);
+		}
+
+		for (sllse_t* pc = pstate->paccumulator_names->phead; pc != NULL; pc = pc->pnext) {
+			char* stats2_acc_name = pc->value;
+			char* dump_field_name = mlr_paste_5_strings(value_field_name_1, "_", value_field_name_2, "_",
+				stats2_acc_name);
+			char* dump = lrec_get(pinrec, dump_field_name);
+			if (dump != NULL) {
+				stats2_acc_t* pstats2_acc = mapper_stats2_get_acc(pstate, pacc_fields_to_acc_state,
+					value_field_name_1, value_field_name_2, stats2_acc_name);
+				dump = mlr_strdup_or_die(dump);
+				if (!pstats2_acc->pmerge_dump_func(pstats2_acc->pvstate, dump)) {
+					fprintf(stderr, "%s %s: could not parse accumulator state in field \"%s\".\n",
+						MLR_GLOBALS.bargv0, mapper_stats2_setup.verb, dump_field_name);
+					exit(1);
+				}
+				free(dump);
+			}
+			free(dump_field_name);
+		}
+	}
+
+	slls_free(pgroup_by_field_values);
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_stats2_emit_all(mapper_stats2_state_t* pstate) {
 	sllv_t* poutrecs = sllv_alloc();
@@ -390,6 +482,18 @@ static sllv_t* mapper_stats2_emit_all(mapper_stats2_state_t* pstate) {
 			char*    value_field_name_2 = pd->key2;
 			lhmsv_t* pacc_fields_to_acc_state = pd->pvvalue;
 
+			if (pstate->do_dump_state) {
+				// Fields such as x_y_corr with the accumulators' dumped states
+				for (lhmsve_t* pe = pacc_fields_to_acc_state->phead; pe != NULL; pe = pe->pnext) {
+					stats2_acc_t* pstats2_acc = pe->pvvalue;
+					pstats2_acc->pdump_func(pstats2_acc->pvstate, pstate->psb);
+					lrec_put(poutrec,
+						mlr_paste_5_strings(value_field_name_1, "_", value_field_name_2, "_", pe->key),
+						sb_finish(pstate->psb), FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
+				}
+				continue;
+			}
+
 			mapper_stats2_emit(pstate, poutrec, value_field_name_1, value_field_name_2,
 				pacc_fields_to_acc_state);
 
@@ -560,6 +664,32 @@ static void stats2_linreg_ols_fit(void* pvstate, double x, double y, lrec_t* pou
 		lrec_put(poutrec, pstate->fit_output_field_name, sfit, FREE_ENTRY_VALUE);
 	}
 }
+static void stats2_linreg_ols_dump(void* pvstate, string_builder_t* psb) {
+	stats2_linreg_ols_state_t* pstate = pvstate;
+	acc_state_put_int(psb, pstate->count);
+	acc_state_put_float(psb, pstate->sumx);
+	acc_state_put_float(psb, pstate->sumy);
+	acc_state_put_float(psb, pstate->sumx2);
+	acc_state_put_float(psb, pstate->sumxy);
+}
+static int stats2_linreg_ols_merge_dump(void* pvstate, char* dump) {
+	stats2_linreg_ols_state_t* pstate = pvstate;
+	unsigned long long count;
+	double sumx, sumy, sumx2, sumxy;
+	if (!acc_state_get_count(&dump, &count) ||
+		!acc_state_get_float(&dump, &sumx) ||
+		!acc_state_get_float(&dump, &sumy) ||
+		!acc_state_get_float(&dump, &sumx2) ||
+		!acc_state_get_float(&dump, &sumxy) ||
+		!acc_state_at_end(&dump))
+		return FALSE;
+	pstate->count += count;
+	pstate->sumx  += sumx;
+	pstate->sumy  += sumy;
+	pstate->sumx2 += sumx2;
+	pstate->sumxy += sumxy;
+	return TRUE;
+}
 static void stats2_linreg_ols_free(stats2_acc_t* pstats2_acc) {
 	stats2_linreg_ols_state_t* pstate = pstats2_acc->pvstate;
 	free(pstate->m_output_field_name);
@@ -590,6 +720,8 @@ static stats2_acc_t* stats2_linreg_ols_alloc(char* value_field_name_1, char* val
 	pstats2_acc->pingest_func = stats2_linreg_ols_ingest;
 	pstats2_acc->pemit_func   = stats2_linreg_ols_emit;
 	pstats2_acc->pfit_func    = stats2_linreg_ols_fit;
+	pstats2_acc->pdump_func   = stats2_linreg_ols_dump;
+	pstats2_acc->pmerge_dump_func = stats2_linreg_ols_merge_dump;
 	pstats2_acc->pfree_func   = stats2_linreg_ols_free;
 	return pstats2_acc;
 }
@@ -632,6 +764,29 @@ static void stats2_logireg_emit(void* pvstate, char* name1, char* name2, lrec_t*
 	char* nval = mlr_alloc_string_from_ll(pstate->pxs->size);
 	lrec_put(poutrec, pstate->n_output_field_name, nval, FREE_ENTRY_VALUE);
 }
+// The number of points, then the points.
+static void stats2_logireg_dump(void* pvstate, string_builder_t* psb) {
+	stats2_logireg_state_t* pstate = pvstate;
+	acc_state_put_int(psb, pstate->pxs->size);
+	for (unsigned long long i = 0; i < pstate->pxs->size; i++) {
+		acc_state_put_float(psb, pstate->pxs->data[i]);
+		acc_state_put_float(psb, pstate->pys->data[i]);
+	}
+}
+static int stats2_logireg_merge_dump(void* pvstate, char* dump) {
+	stats2_logireg_state_t* pstate = pvstate;
+	unsigned long long n;
+	if (!acc_state_get_count(&dump, &n))
+		return FALSE;
+	for (unsigned long long i = 0; i < n; i++) {
+		double x, y;
+		if (!acc_state_get_float(&dump, &x) || !acc_state_get_float(&dump, &y))
+			return FALSE;
+		dvector_append(pstate->pxs, x);
+		dvector_append(pstate->pys, y);
+	}
+	return acc_state_at_end(&dump);
+}
 static void stats2_logireg_free(stats2_acc_t* pstats2_acc) {
 	stats2_logireg_state_t* pstate = pstats2_acc->pvstate;
 	free(pstate->m_output_field_name);
@@ -678,6 +833,8 @@ static stats2_acc_t* stats2_logireg_alloc(char* value_field_name_1, char* value_
 	pstats2_acc->pingest_func = stats2_logireg_ingest;
 	pstats2_acc->pemit_func   = stats2_logireg_emit;
 	pstats2_acc->pfit_func    = stats2_logireg_fit;
+	pstats2_acc->pdump_func   = stats2_logireg_dump;
+	pstats2_acc->pmerge_dump_func = stats2_logireg_merge_dump;
 	pstats2_acc->pfree_func   = stats2_logireg_free;
 	return pstats2_acc;
 }
@@ -723,6 +880,35 @@ static void stats2_r2_emit(void* pvstate, char* name1, char* name2, lrec_t* pout
 		lrec_put(poutrec, pstate->r2_output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats2_r2_dump(void* pvstate, string_builder_t* psb) {
+	stats2_r2_state_t* pstate = pvstate;
+	acc_state_put_int(psb, pstate->count);
+	acc_state_put_float(psb, pstate->sumx);
+	acc_state_put_float(psb, pstate->sumy);
+	acc_state_put_float(psb, pstate->sumx2);
+	acc_state_put_float(psb, pstate->sumxy);
+	acc_state_put_float(psb, pstate->sumy2);
+}
+static int stats2_r2_merge_dump(void* pvstate, char* dump) {
+	stats2_r2_state_t* pstate = pvstate;
+	unsigned long long count;
+	double sumx, sumy, sumx2, sumxy, sumy2;
+	if (!acc_state_get_count(&dump, &count) ||
+		!acc_state_get_float(&dump, &sumx) ||
+		!acc_state_get_float(&dump, &sumy) ||
+		!acc_state_get_float(&dump, &sumx2) ||
+		!acc_state_get_float(&dump, &sumxy) ||
+		!acc_state_get_float(&dump, &sumy2) ||
+		!acc_state_at_end(&dump))
+		return FALSE;
+	pstate->count += count;
+	pstate->sumx  += sumx;
+	pstate->sumy  += sumy;
+	pstate->sumx2 += sumx2;
+	pstate->sumxy += sumxy;
+	pstate->sumy2 += sumy2;
+	return TRUE;
+}
 static void stats2_r2_free(stats2_acc_t* pstats2_acc) {
 	stats2_r2_state_t* pstate = pstats2_acc->pvstate;
 	free(pstate->r2_output_field_name);
@@ -744,6 +930,8 @@ static stats2_acc_t* stats2_r2_alloc(char* value_field_name_1, char* value_field
 	pstats2_acc->pingest_func = stats2_r2_ingest;
 	pstats2_acc->pemit_func   = stats2_r2_emit;
 	pstats2_acc->pfit_func    = NULL;
+	pstats2_acc->pdump_func   = stats2_r2_dump;
+	pstats2_acc->pmerge_dump_func = stats2_r2_merge_dump;
 	pstats2_acc->pfree_func   = stats2_r2_free;
 
 	return pstats2_acc;
@@ -917,6 +1105,35 @@ static void linreg_pca_fit(void* pvstate, double x, double y, lrec_t* poutrec) {
 	}
 }
 
+static void stats2_corr_cov_dump(void* pvstate, string_builder_t* psb) {
+	stats2_corr_cov_state_t* pstate = pvstate;
+	acc_state_put_int(psb, pstate->count);
+	acc_state_put_float(psb, pstate->sumx);
+	acc_state_put_float(psb, pstate->sumy);
+	acc_state_put_float(psb, pstate->sumx2);
+	acc_state_put_float(psb, pstate->sumxy);
+	acc_state_put_float(psb, pstate->sumy2);
+}
+static int stats2_corr_cov_merge_dump(void* pvstate, char* dump) {
+	stats2_corr_cov_state_t* pstate = pvstate;
+	unsigned long long count;
+	double sumx, sumy, sumx2, sumxy, sumy2;
+	if (!acc_state_get_count(&dump, &count) ||
+		!acc_state_get_float(&dump, &sumx) ||
+		!acc_state_get_float(&dump, &sumy) ||
+		!acc_state_get_float(&dump, &sumx2) ||
+		!acc_state_get_float(&dump, &sumxy) ||
+		!acc_state_get_float(&dump, &sumy2) ||
+		!acc_state_at_end(&dump))
+		return FALSE;
+	pstate->count += count;
+	pstate->sumx  += sumx;
+	pstate->sumy  += sumy;
+	pstate->sumx2 += sumx2;
+	pstate->sumxy += sumxy;
+	pstate->sumy2 += sumy2;
+	return TRUE;
+}
 static void stats2_corr_cov_free(stats2_acc_t* pstats2_acc) {
 	stats2_corr_cov_state_t* pstate = pstats2_acc->pvstate;
 
@@ -991,6 +1208,8 @@ static stats2_acc_t* stats2_corr_cov_alloc(char* value_field_name_1, char* value
 		pstats2_acc->pfit_func = linreg_pca_fit;
 	else
 		pstats2_acc->pfit_func = NULL;
+	pstats2_acc->pdump_func = stats2_corr_cov_dump;
+	pstats2_acc->pmerge_dump_func = stats2_corr_cov_merge_dump;
 	pstats2_acc->pfree_func = stats2_corr_cov_free;
 
 	return pstats2_acc;
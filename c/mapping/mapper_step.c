@@ -7,10 +7,11 @@
 #include "containers/sllv.h"
 #include "containers/slls.h"
 #include "lib/string_array.h"
-#include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
 #include "lib/mvfuncs.h"
+#include "lib/mlrstat.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
@@ -34,8 +35,16 @@ typedef struct _step_t {
 	step_free_func_t*     pfree_func;
 } step_t;
 
+// For the moving-window steppers: the last so many records, or those within so
+// many seconds of the current one by the time field.
+typedef struct _step_window_spec_t {
+	int    num_records;     // Zero for a time window
+	char*  time_field_name; // NULL for a record window
+	double seconds;
+} step_window_spec_t;
+
 typedef step_t* step_alloc_func_t(char* input_field_name, int allow_int_float,
-	slls_t* pstring_alphas, slls_t* pewma_suffixes);
+	slls_t* pstring_alphas, slls_t* pewma_suffixes, step_window_spec_t* pwindow_spec);
 
 typedef struct _mapper_step_state_t {
 	ap_state_t*     pargp;
@@ -43,10 +52,12 @@ typedef struct _mapper_step_state_t {
 	string_array_t* pvalue_field_names;    // parameter
 	string_array_t* pvalue_field_values;   // scratch space used per-record
 	slls_t*         pgroup_by_field_names; // parameter
-	lhmslv_t*       groups;
+	group_key_t*    pgroup_key;
+	group_table_t*  groups;
 	int             allow_int_float;
 	slls_t*         pstring_alphas;
 	slls_t*         pewma_suffixes;
+	step_window_spec_t window_spec;
 } mapper_step_state_t;
 
 // Multilevel hashmap structure:
@@ -76,35 +87,61 @@ static void      mapper_step_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_step_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_step_alloc(ap_state_t* pargp, slls_t* pstepper_names, string_array_t* pvalue_field_names,
-	slls_t* pgroup_by_field_names, int allow_int_float, slls_t* pstring_alphas, slls_t* pewma_suffixes);
+	slls_t* pgroup_by_field_names, int allow_int_float, slls_t* pstring_alphas, slls_t* pewma_suffixes,
+	step_window_spec_t* pwindow_spec);
 static void      mapper_step_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_step_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
-static step_t* step_delta_alloc      (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2);
-static step_t* step_shift_alloc      (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2);
-static step_t* step_from_first_alloc (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2);
-static step_t* step_ratio_alloc      (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2);
-static step_t* step_rsum_alloc       (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2);
-static step_t* step_counter_alloc    (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2);
+static step_t* step_delta_alloc      (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3);
+static step_t* step_shift_alloc      (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3);
+static step_t* step_from_first_alloc (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3);
+static step_t* step_ratio_alloc      (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3);
+static step_t* step_rsum_alloc       (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3);
+static step_t* step_counter_alloc    (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3);
 static step_t* step_ewma_alloc       (char* input_field_name, int unused,
-	slls_t* pstring_alphas, slls_t* pewma_suffixes);
+	slls_t* pstring_alphas, slls_t* pewma_suffixes, step_window_spec_t* unused3);
+static step_t* step_msum_alloc       (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec);
+static step_t* step_mmean_alloc      (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec);
+static step_t* step_mmin_alloc       (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec);
+static step_t* step_mmax_alloc       (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec);
+static step_t* step_mstddev_alloc    (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec);
+static step_t* step_mcount_alloc     (char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec);
 
 static step_t* make_step(char* step_name, char* input_field_name, int allow_int_float,
-	slls_t* pstring_alphas, slls_t* pewma_suffixes);
+	slls_t* pstring_alphas, slls_t* pewma_suffixes, step_window_spec_t* pwindow_spec);
 
 typedef struct _step_lookup_t {
 	char* name;
 	step_alloc_func_t* palloc_func;
+	int   is_windowed;
 	char* desc;
 } step_lookup_t;
 static step_lookup_t step_lookup_table[] = {
-	{"delta",      step_delta_alloc,      "Compute differences in field(s) between successive records"},
-	{"shift",      step_shift_alloc,      "Include value(s) in field(s) from previous record, if any"},
-	{"from-first", step_from_first_alloc, "Compute differences in field(s) from first record"},
-	{"ratio",      step_ratio_alloc,      "Compute ratios in field(s) between successive records"},
-	{"rsum",       step_rsum_alloc,       "Compute running sums of field(s) between successive records"},
-	{"counter",    step_counter_alloc,    "Count instances of field(s) between successive records"},
-	{"ewma",       step_ewma_alloc,       "Exponentially weighted moving average over successive records"},
+	{"delta",      step_delta_alloc,      FALSE, "Compute differences in field(s) between successive records"},
+	{"shift",      step_shift_alloc,      FALSE, "Include value(s) in field(s) from previous record, if any"},
+	{"from-first", step_from_first_alloc, FALSE, "Compute differences in field(s) from first record"},
+	{"ratio",      step_ratio_alloc,      FALSE, "Compute ratios in field(s) between successive records"},
+	{"rsum",       step_rsum_alloc,       FALSE, "Compute running sums of field(s) between successive records"},
+	{"counter",    step_counter_alloc,    FALSE, "Count instances of field(s) between successive records"},
+	{"ewma",       step_ewma_alloc,       FALSE, "Exponentially weighted moving average over successive records"},
+	{"msum",       step_msum_alloc,       TRUE,  "Moving sum of field(s) over the window (see -w)"},
+	{"mmean",      step_mmean_alloc,      TRUE,  "Moving mean of field(s) over the window"},
+	{"mmin",       step_mmin_alloc,       TRUE,  "Moving minimum of field(s) over the window"},
+	{"mmax",       step_mmax_alloc,       TRUE,  "Moving maximum of field(s) over the window"},
+	{"mstddev",    step_mstddev_alloc,    TRUE,  "Moving sample standard deviation of field(s) over the window"},
+	{"mcount",     step_mcount_alloc,     TRUE,  "Count of values of field(s) in the window"},
 };
 static int step_lookup_table_length = sizeof(step_lookup_table) / sizeof(step_lookup_table[0]);
 
@@ -138,6 +175,14 @@ static void mapper_step_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "-o {a,b,c} Custom suffixes for EWMA output fields. If omitted, these default to\n");
 	fprintf(o, "           the -d values. If supplied, the number of -o values must be the same\n");
 	fprintf(o, "           as the number of -d values.\n");
+	fprintf(o, "-w {n}     Window for the moving steppers msum, mmean, etc.: the current record\n");
+	fprintf(o, "           and the n-1 before it, within its group, which have the field.\n");
+	fprintf(o, "-W {s} -t {name} Window for the moving steppers by time instead: records\n");
+	fprintf(o, "           whose time field {name} is less than s after the current\n");
+	fprintf(o, "           record's. Times are numbers, e.g. seconds since the epoch, and\n");
+	fprintf(o, "           should be nondecreasing within each group.\n");
+	fprintf(o, "Each moving stepper costs O(1) per record, amortized, with memory only for\n");
+	fprintf(o, "the values in the window.\n");
 	fprintf(o, "\n");
 	fprintf(o, "Examples:\n");
 	fprintf(o, "  %s %s -a rsum -f request_size\n", argv0, verb);
@@ -145,6 +190,8 @@ static void mapper_step_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "  %s %s -a ewma -d 0.1,0.9 -f x,y\n", argv0, verb);
 	fprintf(o, "  %s %s -a ewma -d 0.1,0.9 -o smooth,rough -f x,y\n", argv0, verb);
 	fprintf(o, "  %s %s -a ewma -d 0.1,0.9 -o smooth,rough -f x,y -g group_name\n", argv0, verb);
+	fprintf(o, "  %s %s -a mmean,mmax -w 10 -f latency -g hostname\n", argv0, verb);
+	fprintf(o, "  %s %s -a msum,mcount -W 3600 -t time -f bytes\n", argv0, verb);
 	fprintf(o, "\n");
 	fprintf(o, "Please see http://johnkerl.org/miller/doc/reference.html#filter or\n");
 	fprintf(o, "https://en.wikipedia.org/wiki/Moving_average#Exponential_moving_average\n");
@@ -160,6 +207,7 @@ static mapper_t* mapper_step_parse_cli(int* pargi, int argc, char** argv,
 	slls_t*         pstring_alphas        = slls_single_no_free(DEFAULT_STRING_ALPHA);
 	slls_t*         pewma_suffixes        = NULL;
 	int             allow_int_float       = TRUE;
+	step_window_spec_t window_spec        = { 0, NULL, 0.0 };
 
 	char* verb = argv[(*pargi)++];
 
@@ -170,6 +218,9 @@ static mapper_t* mapper_step_parse_cli(int* pargi, int argc, char** argv,
 	ap_define_string_list_flag(pstate,  "-d", &pstring_alphas);
 	ap_define_string_list_flag(pstate,  "-o", &pewma_suffixes);
 	ap_define_false_flag(pstate,        "-F", &allow_int_float);
+	ap_define_int_flag(pstate,          "-w", &window_spec.num_records);
+	ap_define_float_flag(pstate,        "-W", &window_spec.seconds);
+	ap_define_string_flag(pstate,       "-t", &window_spec.time_field_name);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_step_usage(stderr, argv[0], verb);
@@ -187,13 +238,40 @@ static mapper_t* mapper_step_parse_cli(int* pargi, int argc, char** argv,
 		}
 	}
 
+	// Exactly one kind of window, if any stepper needs one.
+	int have_record_window = window_spec.num_records != 0;
+	int have_time_window = window_spec.seconds != 0.0 || window_spec.time_field_name != NULL;
+	if (have_record_window && window_spec.num_records < 1) {
+		mapper_step_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (have_time_window && (window_spec.seconds <= 0.0 || window_spec.time_field_name == NULL)) {
+		mapper_step_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (have_record_window && have_time_window) {
+		mapper_step_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	for (sllse_t* pe = pstepper_names->phead; pe != NULL; pe = pe->pnext) {
+		for (int i = 0; i < step_lookup_table_length; i++) {
+			if (streq(pe->value, step_lookup_table[i].name) && step_lookup_table[i].is_windowed
+				&& !have_record_window && !have_time_window)
+			{
+				fprintf(stderr, "%s %s: stepper \"%s\" needs -w, or -W and -t.\n", MLR_GLOBALS.bargv0, verb, pe->value);
+				return NULL;
+			}
+		}
+	}
+
 	return mapper_step_alloc(pstate, pstepper_names, pvalue_field_names, pgroup_by_field_names,
-		allow_int_float, pstring_alphas, pewma_suffixes);
+		allow_int_float, pstring_alphas, pewma_suffixes, &window_spec);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_step_alloc(ap_state_t* pargp, slls_t* pstepper_names, string_array_t* pvalue_field_names,
-	slls_t* pgroup_by_field_names, int allow_int_float, slls_t* pstring_alphas, slls_t* pewma_suffixes)
+	slls_t* pgroup_by_field_names, int allow_int_float, slls_t* pstring_alphas, slls_t* pewma_suffixes,
+	step_window_spec_t* pwindow_spec)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -204,10 +282,12 @@ static mapper_t* mapper_step_alloc(ap_state_t* pargp, slls_t* pstepper_names, st
 	pstate->pvalue_field_names    = pvalue_field_names;
 	pstate->pvalue_field_values   = string_array_alloc(pvalue_field_names->length);
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
-	pstate->groups                = lhmslv_alloc();
+	pstate->pgroup_key            = group_key_alloc();
+	pstate->groups                = group_table_alloc(pgroup_by_field_names->length);
 	pstate->allow_int_float       = allow_int_float;
 	pstate->pstring_alphas        = pstring_alphas;
 	pstate->pewma_suffixes        = pewma_suffixes;
+	pstate->window_spec           = *pwindow_spec;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_step_process;
@@ -225,10 +305,10 @@ static void mapper_step_free(mapper_t* pmapper, context_t* _) {
 	slls_free(pstate->pstring_alphas);
 	slls_free(pstate->pewma_suffixes);
 
-	// lhmslv_free and lhmsv_free will free the hashmap keys; we need to free
+	// group_table_free and lhmsv_free will free the hashmap keys; we need to free
 	// the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
-		lhmsv_t* pgroup_to_acc_field = pa->pvvalue;
+	for (int i = 0; i < pstate->groups->num_entries; i++) {
+		lhmsv_t* pgroup_to_acc_field = pstate->groups->entries[i].pvvalue;
 		for (lhmsve_t* pb = pgroup_to_acc_field->phead; pb != NULL; pb = pb->pnext) {
 			lhmsv_t* pacc_field_to_acc_state = pb->pvvalue;
 			for (lhmsve_t* pc = pacc_field_to_acc_state->phead; pc != NULL; pc = pc->pnext) {
@@ -239,7 +319,8 @@ static void mapper_step_free(mapper_t* pmapper, context_t* _) {
 		}
 		lhmsv_free(pgroup_to_acc_field);
 	}
-	lhmslv_free(pstate->groups);
+	group_table_free(pstate->groups);
+	group_key_free(pstate->pgroup_key);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -253,19 +334,13 @@ static sllv_t* mapper_step_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 
 	// ["s", "t"]
 	mlr_reference_values_from_record_into_string_array(pinrec, pstate->pvalue_field_names, pstate->pvalue_field_values);
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-
-	if (pgroup_by_field_values == NULL) {
-		slls_free(pgroup_by_field_values);
+	if (!group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names))
 		return sllv_single(pinrec);
-	}
 
-	lhmsv_t* pgroup_to_acc_field = lhmslv_get(pstate->groups, pgroup_by_field_values);
-	if (pgroup_to_acc_field == NULL) {
-		pgroup_to_acc_field = lhmsv_alloc();
-		lhmslv_put(pstate->groups, slls_copy(pgroup_by_field_values), pgroup_to_acc_field, FREE_ENTRY_KEY);
-	}
-	slls_free(pgroup_by_field_values);
+	lhmsv_t** ppgroup_to_acc_field = (lhmsv_t**)group_table_get_or_add(pstate->groups, pstate->pgroup_key);
+	if (*ppgroup_to_acc_field == NULL)
+		*ppgroup_to_acc_field = lhmsv_alloc();
+	lhmsv_t* pgroup_to_acc_field = *ppgroup_to_acc_field;
 
 	// for x=1 and y=2
 	int n = pstate->pvalue_field_names->length;
@@ -293,7 +368,7 @@ static sllv_t* mapper_step_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 			step_t* pstep = lhmsv_get(pacc_field_to_acc_state, step_name);
 			if (pstep == NULL) {
 				pstep = make_step(step_name, value_field_name, pstate->allow_int_float,
-					pstate->pstring_alphas, pstate->pewma_suffixes);
+					pstate->pstring_alphas, pstate->pewma_suffixes, &pstate->window_spec);
 				if (pstep == NULL) {
 					fprintf(stderr, "mlr step: stepper \"%s\" not found.\n",
 						step_name);
@@ -336,12 +411,12 @@ static sllv_t* mapper_step_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 }
 
 static step_t* make_step(char* step_name, char* input_field_name, int allow_int_float,
-	slls_t* pstring_alphas, slls_t* pewma_suffixes)
+	slls_t* pstring_alphas, slls_t* pewma_suffixes, step_window_spec_t* pwindow_spec)
 {
 	for (int i = 0; i < step_lookup_table_length; i++)
 		if (streq(step_name, step_lookup_table[i].name))
 			return step_lookup_table[i].palloc_func(input_field_name, allow_int_float,
-				pstring_alphas, pewma_suffixes);
+				pstring_alphas, pewma_suffixes, pwindow_spec);
 	return NULL;
 }
 
@@ -372,7 +447,9 @@ static void step_delta_free(step_t* pstep) {
 	free(pstate);
 	free(pstep);
 }
-static step_t* step_delta_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2) {
+static step_t* step_delta_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3)
+{
 	step_t* pstep = mlr_malloc_or_die(sizeof(step_t));
 	step_delta_state_t* pstate = mlr_malloc_or_die(sizeof(step_delta_state_t));
 	pstate->prev = mv_absent();
@@ -409,7 +486,9 @@ static void step_shift_free(step_t* pstep) {
 	free(pstate);
 	free(pstep);
 }
-static step_t* step_shift_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2) {
+static step_t* step_shift_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3)
+{
 	step_t* pstep = mlr_malloc_or_die(sizeof(step_t));
 	step_shift_state_t* pstate = mlr_malloc_or_die(sizeof(step_shift_state_t));
 	pstate->prev = mlr_strdup_or_die("");
@@ -451,7 +530,9 @@ static void step_from_first_free(step_t* pstep) {
 	free(pstate);
 	free(pstep);
 }
-static step_t* step_from_first_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2) {
+static step_t* step_from_first_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3)
+{
 	step_t* pstep = mlr_malloc_or_die(sizeof(step_t));
 	step_from_first_state_t* pstate = mlr_malloc_or_die(sizeof(step_from_first_state_t));
 	pstate->first = mv_absent();
@@ -494,7 +575,9 @@ static void step_ratio_free(step_t* pstep) {
 	free(pstate);
 	free(pstep);
 }
-static step_t* step_ratio_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2) {
+static step_t* step_ratio_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3)
+{
 	step_t* pstep = mlr_malloc_or_die(sizeof(step_t));
 	step_ratio_state_t* pstate = mlr_malloc_or_die(sizeof(step_ratio_state_t));
 	pstate->prev          = -999.0;
@@ -532,7 +615,9 @@ static void step_rsum_free(step_t* pstep) {
 	free(pstate);
 	free(pstep);
 }
-static step_t* step_rsum_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2) {
+static step_t* step_rsum_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3)
+{
 	step_t* pstep = mlr_malloc_or_die(sizeof(step_t));
 	step_rsum_state_t* pstate = mlr_malloc_or_die(sizeof(step_rsum_state_t));
 	pstate->allow_int_float = allow_int_float;
@@ -569,7 +654,9 @@ static void step_counter_free(step_t* pstep) {
 	free(pstate);
 	free(pstep);
 }
-static step_t* step_counter_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2) {
+static step_t* step_counter_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* unused3)
+{
 	step_t* pstep = mlr_malloc_or_die(sizeof(step_t));
 	step_counter_state_t* pstate = mlr_malloc_or_die(sizeof(step_counter_state_t));
 	pstate->counter = allow_int_float ? mv_from_int(0LL) : mv_from_float(0.0);
@@ -632,7 +719,9 @@ static void step_ewma_free(step_t* pstep) {
 	free(pstep);
 }
 
-static step_t* step_ewma_alloc(char* input_field_name, int unused, slls_t* pstring_alphas, slls_t* pewma_suffixes) {
+static step_t* step_ewma_alloc(char* input_field_name, int unused, slls_t* pstring_alphas, slls_t* pewma_suffixes,
+	step_window_spec_t* unused3)
+{
 	step_t* pstep              = mlr_malloc_or_die(sizeof(step_t));
 
 	step_ewma_state_t* pstate  = mlr_malloc_or_die(sizeof(step_ewma_state_t));
@@ -664,3 +753,253 @@ static step_t* step_ewma_alloc(char* input_field_name, int unused, slls_t* pstri
 	pstep->pfree_func     = step_ewma_free;
 	return pstep;
 }
+
+// ----------------------------------------------------------------
+// Moving-window steppers. Values in the window are kept in a ring-buffer deque,
+// oldest first, and evicted from the front as the window moves past them.
+//
+// For sum, mean, stddev, and count every value is kept, along with running
+// sums which are updated by adding each value as it arrives and subtracting it
+// as it's evicted. Since floating-point subtraction doesn't exactly undo
+// addition, the sums are recomputed from the deque once as many values have
+// been evicted as are in it: still O(1) per record, amortized, and with no
+// drift accumulating over long streams.
+//
+// For min and max the deque is monotonic: a value is dropped as soon as a
+// later one is at least as extreme, since it can no longer be the window's
+// extreme. Then the front of the deque is always the extreme, and each value is
+// pushed and popped at most once.
+
+typedef enum _window_do_which_t {
+	DO_MSUM,
+	DO_MMEAN,
+	DO_MMIN,
+	DO_MMAX,
+	DO_MSTDDEV,
+	DO_MCOUNT,
+} window_do_which_t;
+
+typedef struct _window_entry_t {
+	mv_t   value;
+	double time;
+	unsigned long long sequence;
+} window_entry_t;
+
+typedef struct _step_window_state_t {
+	window_do_which_t  do_which;
+	step_window_spec_t window_spec;
+	int                allow_int_float;
+	char*              output_field_name;
+
+	window_entry_t*    entries; // Ring buffer
+	int                capacity;
+	int                head;
+	int                length;
+	unsigned long long next_sequence;
+
+	mv_t               sum;
+	double             fsum;
+	double             fsum2;
+	unsigned long long num_evicted_since_resum;
+} step_window_state_t;
+
+static inline window_entry_t* window_entry(step_window_state_t* pstate, int i) {
+	return &pstate->entries[(pstate->head + i) & (pstate->capacity - 1)];
+}
+
+static void window_push_back(step_window_state_t* pstate, mv_t* pvalue, double time) {
+	if (pstate->length == pstate->capacity) {
+		int new_capacity = 2 * pstate->capacity;
+		window_entry_t* new_entries = mlr_malloc_or_die(new_capacity * sizeof(window_entry_t));
+		for (int i = 0; i < pstate->length; i++)
+			new_entries[i] = *window_entry(pstate, i);
+		free(pstate->entries);
+		pstate->entries  = new_entries;
+		pstate->capacity = new_capacity;
+		pstate->head     = 0;
+	}
+	window_entry_t* pe = window_entry(pstate, pstate->length);
+	pe->value    = *pvalue;
+	pe->time     = time;
+	pe->sequence = pstate->next_sequence;
+	pstate->length++;
+}
+
+static inline double window_double(mv_t* pvalue) {
+	return pvalue->type == MT_INT ? (double)pvalue->u.intv : pvalue->u.fltv;
+}
+
+static void window_resum(step_window_state_t* pstate) {
+	pstate->sum   = pstate->allow_int_float ? mv_from_int(0LL) : mv_from_float(0.0);
+	pstate->fsum  = 0.0;
+	pstate->fsum2 = 0.0;
+	for (int i = 0; i < pstate->length; i++) {
+		mv_t* pvalue = &window_entry(pstate, i)->value;
+		double d = window_double(pvalue);
+		pstate->sum = x_xx_plus_func(&pstate->sum, pvalue);
+		pstate->fsum  += d;
+		pstate->fsum2 += d * d;
+	}
+	pstate->num_evicted_since_resum = 0LL;
+}
+
+// Drops entries which the current record's window no longer covers.
+static void window_evict(step_window_state_t* pstate, double time) {
+	int keep_sums = pstate->do_which != DO_MMIN && pstate->do_which != DO_MMAX;
+	int num_evicted = 0;
+	while (pstate->length > 0) {
+		window_entry_t* pe = window_entry(pstate, 0);
+		if (pstate->window_spec.time_field_name != NULL) {
+			if (pe->time > time - pstate->window_spec.seconds)
+				break;
+		} else {
+			if (pe->sequence + pstate->window_spec.num_records >= pstate->next_sequence)
+				break;
+		}
+		if (keep_sums) {
+			double d = window_double(&pe->value);
+			pstate->sum = x_xx_minus_func(&pstate->sum, &pe->value);
+			pstate->fsum  -= d;
+			pstate->fsum2 -= d * d;
+		}
+		pstate->head = (pstate->head + 1) & (pstate->capacity - 1);
+		pstate->length--;
+		num_evicted++;
+	}
+	if (keep_sums && num_evicted > 0) {
+		pstate->num_evicted_since_resum += num_evicted;
+		if (pstate->num_evicted_since_resum >= pstate->length)
+			window_resum(pstate);
+	}
+}
+
+static void step_window_nprocess(void* pvstate, mv_t* pnumv, lrec_t* prec) {
+	step_window_state_t* pstate = pvstate;
+
+	double time = 0.0;
+	if (pstate->window_spec.time_field_name != NULL) {
+		char* stime = lrec_get(prec, pstate->window_spec.time_field_name);
+		if (stime == NULL || *stime == 0) {
+			fprintf(stderr, "%s step: time field \"%s\" not found or empty.\n",
+				MLR_GLOBALS.bargv0, pstate->window_spec.time_field_name);
+			exit(1);
+		}
+		time = mlr_double_from_string_or_die(stime);
+	}
+
+	switch (pstate->do_which) {
+	case DO_MMIN:
+		while (pstate->length > 0 && !mv_i_nn_lt(&window_entry(pstate, pstate->length - 1)->value, pnumv))
+			pstate->length--;
+		window_push_back(pstate, pnumv, time);
+		break;
+	case DO_MMAX:
+		while (pstate->length > 0 && !mv_i_nn_gt(&window_entry(pstate, pstate->length - 1)->value, pnumv))
+			pstate->length--;
+		window_push_back(pstate, pnumv, time);
+		break;
+	default:
+		window_push_back(pstate, pnumv, time);
+		double d = window_double(pnumv);
+		pstate->sum = x_xx_plus_func(&pstate->sum, pnumv);
+		pstate->fsum  += d;
+		pstate->fsum2 += d * d;
+		break;
+	}
+	pstate->next_sequence++;
+	window_evict(pstate, time);
+
+	char* output = NULL;
+	switch (pstate->do_which) {
+	case DO_MSUM:
+		output = mv_alloc_format_val(&pstate->sum);
+		break;
+	case DO_MMEAN:
+		output = mlr_alloc_string_from_double(pstate->fsum / pstate->length, MLR_GLOBALS.ofmt);
+		break;
+	case DO_MMIN:
+	case DO_MMAX:
+		output = mv_alloc_format_val(&window_entry(pstate, 0)->value);
+		break;
+	case DO_MSTDDEV:
+		if (pstate->length < 2) {
+			lrec_put(prec, pstate->output_field_name, "", NO_FREE);
+			return;
+		}
+		output = mlr_alloc_string_from_double(sqrt(mlr_get_var(pstate->length, pstate->fsum, pstate->fsum2)),
+			MLR_GLOBALS.ofmt);
+		break;
+	case DO_MCOUNT:
+		output = pstate->allow_int_float
+			? mlr_alloc_string_from_ll(pstate->length)
+			: mlr_alloc_string_from_double(pstate->length, MLR_GLOBALS.ofmt);
+		break;
+	}
+	lrec_put(prec, pstate->output_field_name, output, FREE_ENTRY_VALUE);
+}
+static void step_window_zprocess(void* pvstate, lrec_t* prec) {
+	step_window_state_t* pstate = pvstate;
+	lrec_put(prec, pstate->output_field_name, "", NO_FREE);
+}
+static void step_window_free(step_t* pstep) {
+	step_window_state_t* pstate = pstep->pvstate;
+	free(pstate->entries);
+	free(pstate->output_field_name);
+	free(pstate);
+	free(pstep);
+}
+static step_t* step_window_alloc(char* input_field_name, int allow_int_float, step_window_spec_t* pwindow_spec,
+	window_do_which_t do_which, char* suffix)
+{
+	step_t* pstep = mlr_malloc_or_die(sizeof(step_t));
+	step_window_state_t* pstate = mlr_malloc_or_die(sizeof(step_window_state_t));
+	pstate->do_which          = do_which;
+	pstate->window_spec       = *pwindow_spec;
+	pstate->allow_int_float   = allow_int_float;
+	pstate->output_field_name = mlr_paste_2_strings(input_field_name, suffix);
+	pstate->capacity          = 16; // Power of two
+	pstate->entries           = mlr_malloc_or_die(pstate->capacity * sizeof(window_entry_t));
+	pstate->head              = 0;
+	pstate->length            = 0;
+	pstate->next_sequence     = 0LL;
+	window_resum(pstate);
+
+	pstep->pvstate        = (void*)pstate;
+	pstep->pdprocess_func = NULL;
+	pstep->pnprocess_func = step_window_nprocess;
+	pstep->psprocess_func = NULL;
+	pstep->pzprocess_func = step_window_zprocess;
+	pstep->pfree_func     = step_window_free;
+	return pstep;
+}
+
+static step_t* step_msum_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec)
+{
+	return step_window_alloc(input_field_name, allow_int_float, pwindow_spec, DO_MSUM, "_msum");
+}
+static step_t* step_mmean_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec)
+{
+	return step_window_alloc(input_field_name, allow_int_float, pwindow_spec, DO_MMEAN, "_mmean");
+}
+static step_t* step_mmin_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec)
+{
+	return step_window_alloc(input_field_name, allow_int_float, pwindow_spec, DO_MMIN, "_mmin");
+}
+static step_t* step_mmax_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec)
+{
+	return step_window_alloc(input_field_name, allow_int_float, pwindow_spec, DO_MMAX, "_mmax");
+}
+static step_t* step_mstddev_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec)
+{
+	return step_window_alloc(input_field_name, allow_int_float, pwindow_spec, DO_MSTDDEV, "_mstddev");
+}
+static step_t* step_mcount_alloc(char* input_field_name, int allow_int_float, slls_t* unused1, slls_t* unused2,
+	step_window_spec_t* pwindow_spec)
+{
+	return step_window_alloc(input_field_name, allow_int_float, pwindow_spec, DO_MCOUNT, "_mcount");
+}
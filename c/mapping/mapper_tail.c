@@ -5,7 +5,7 @@
 #include "lib/mlrutil.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
-#include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
 #include "mapping/mappers.h"
@@ -15,7 +15,8 @@ typedef struct _mapper_tail_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
 	unsigned long long tail_count;
-	lhmslv_t* precord_lists_by_group;
+	group_key_t* pgroup_key;
+	group_table_t* precord_lists_by_group;
 } mapper_tail_state_t;
 
 static void      mapper_tail_usage(FILE* o, char* argv0, char* verb);
@@ -70,7 +71,8 @@ static mapper_t* mapper_tail_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 	pstate->pargp                  = pargp;
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
 	pstate->tail_count             = tail_count;
-	pstate->precord_lists_by_group = lhmslv_alloc();
+	pstate->pgroup_key             = group_key_alloc();
+	pstate->precord_lists_by_group = group_table_alloc(pgroup_by_field_names->length);
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_tail_process;
@@ -83,14 +85,15 @@ static void mapper_tail_free(mapper_t* pmapper, context_t* _) {
 	mapper_tail_state_t* pstate = pmapper->pvstate;
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
-	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->precord_lists_by_group->phead; pa != NULL; pa = pa->pnext) {
-		sllv_t* precord_list_for_group = pa->pvvalue;
+	// group_table_free will free the keys; we need to free the void-star values.
+	for (int i = 0; i < pstate->precord_lists_by_group->num_entries; i++) {
+		sllv_t* precord_list_for_group = pstate->precord_lists_by_group->entries[i].pvvalue;
 		// outrecs were freed by caller of mapper_tail_process. Here, just free
 		// the sllv container itself.
 		sllv_free(precord_list_for_group);
 	}
-	lhmslv_free(pstate->precord_lists_by_group);
+	group_table_free(pstate->precord_lists_by_group);
+	group_key_free(pstate->pgroup_key);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -100,16 +103,12 @@ static void mapper_tail_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_tail_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_tail_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			sllv_t* precord_list_for_group = lhmslv_get(pstate->precord_lists_by_group, pgroup_by_field_values);
-			if (precord_list_for_group == NULL) {
-				precord_list_for_group = sllv_alloc();
-				lhmslv_put(pstate->precord_lists_by_group, slls_copy(pgroup_by_field_values),
-					precord_list_for_group, FREE_ENTRY_KEY);
-			}
-			slls_free(pgroup_by_field_values);
+		if (group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
+			sllv_t** pprecord_list_for_group = (sllv_t**)group_table_get_or_add(pstate->precord_lists_by_group,
+				pstate->pgroup_key);
+			if (*pprecord_list_for_group == NULL)
+				*pprecord_list_for_group = sllv_alloc();
+			sllv_t* precord_list_for_group = *pprecord_list_for_group;
 			if (precord_list_for_group->length >= pstate->tail_count) {
 				lrec_t* porec = sllv_pop(precord_list_for_group);
 				lrec_free(porec);
@@ -123,8 +122,8 @@ static sllv_t* mapper_tail_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 	else {
 		sllv_t* poutrecs = sllv_alloc();
 
-		for (lhmslve_t* pa = pstate->precord_lists_by_group->phead; pa != NULL; pa = pa->pnext) {
-			sllv_t* precord_list_for_group = pa->pvvalue;
+		for (int i = 0; i < pstate->precord_lists_by_group->num_entries; i++) {
+			sllv_t* precord_list_for_group = pstate->precord_lists_by_group->entries[i].pvvalue;
 			sllv_transfer(poutrecs, precord_list_for_group);
 		}
 		sllv_append(poutrecs, NULL);
@@ -7,7 +7,7 @@
 #include "lib/mlr_globals.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
-#include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/lhmsv.h"
 #include "containers/top_keeper.h"
 #include "containers/mixutil.h"
@@ -27,7 +27,8 @@ typedef struct _mapper_top_state_t {
 	int show_full_records;
 	int allow_int_float;
 	maybe_sign_flipper_t* pmaybe_sign_flipper;
-	lhmslv_t* groups;
+	group_key_t* pgroup_key;
+	group_table_t* groups;
 	char* output_field_name;
 } mapper_top_state_t;
 
@@ -121,7 +122,8 @@ static mapper_t* mapper_top_alloc(ap_state_t* pargp, slls_t* pvalue_field_names,
 	pstate->allow_int_float       = allow_int_float;
 	pstate->top_count             = top_count;
 	pstate->pmaybe_sign_flipper   = do_max ? x_x_upos_func : x_x_uneg_func;
-	pstate->groups                = lhmslv_alloc();
+	pstate->pgroup_key            = group_key_alloc();
+	pstate->groups                = group_table_alloc(pgroup_by_field_names->length);
 	pstate->output_field_name     = output_field_name;
 
 	pmapper->pvstate       = pstate;
@@ -137,8 +139,8 @@ static void mapper_top_free(mapper_t* pmapper, context_t* _) {
 	slls_free(pstate->pgroup_by_field_names);
 
 	// Free the hashmap pvvalues; the lhm free methods will free the hashmap keys.
-	for (lhmslve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
-		lhmsv_t* pgroup = pa->pvvalue;
+	for (int i = 0; i < pstate->groups->num_entries; i++) {
+		lhmsv_t* pgroup = pstate->groups->entries[i].pvvalue;
 		for (lhmsve_t* pb = pgroup->phead; pb != NULL; pb = pb->pnext) {
 			top_keeper_t* ptop_keeper_for_group = pb->pvvalue;
 			top_keeper_free(ptop_keeper_for_group);
@@ -146,7 +148,8 @@ static void mapper_top_free(mapper_t* pmapper, context_t* _) {
 		lhmsv_free(pgroup);
 	}
 
-	lhmslv_free(pstate->groups);
+	group_table_free(pstate->groups);
+	group_key_free(pstate->pgroup_key);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -168,28 +171,22 @@ static sllv_t* mapper_top_process(lrec_t* pinrec, context_t* pctx, void* pvstate
 static void mapper_top_ingest(lrec_t* pinrec, mapper_top_state_t* pstate) {
 	// ["s", "t"]
 	slls_t* pvalue_field_values    = mlr_reference_selected_values_from_record(pinrec, pstate->pvalue_field_names);
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
 
 	// Heterogeneous-data case -- not all sought fields were present in record
-	if (pvalue_field_values == NULL || pgroup_by_field_values == NULL) {
-		slls_free(pvalue_field_values);
-		slls_free(pgroup_by_field_values);
+	if (pvalue_field_values == NULL) {
 		lrec_free(pinrec);
 		return;
 	}
-	if (pgroup_by_field_values->length != pstate->pgroup_by_field_names->length) {
+	if (!group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
 		slls_free(pvalue_field_values);
-		slls_free(pgroup_by_field_values);
 		lrec_free(pinrec);
 		return;
 	}
 
-	lhmsv_t* group_to_acc_field = lhmslv_get(pstate->groups, pgroup_by_field_values);
-	if (group_to_acc_field == NULL) {
-		group_to_acc_field = lhmsv_alloc();
-		lhmslv_put(pstate->groups, slls_copy(pgroup_by_field_values), group_to_acc_field, FREE_ENTRY_KEY);
-	}
-	slls_free(pgroup_by_field_values);
+	lhmsv_t** ppgroup_to_acc_field = (lhmsv_t**)group_table_get_or_add(pstate->groups, pstate->pgroup_key);
+	if (*ppgroup_to_acc_field == NULL)
+		*ppgroup_to_acc_field = lhmsv_alloc();
+	lhmsv_t* group_to_acc_field = *ppgroup_to_acc_field;
 
 	sllse_t* pa = pstate->pvalue_field_names->phead;
 	sllse_t* pb =         pvalue_field_values->phead;
@@ -233,7 +230,8 @@ static void mapper_top_ingest(lrec_t* pinrec, mapper_top_state_t* pstate) {
 static sllv_t* mapper_top_emit(mapper_top_state_t* pstate, context_t* pctx) {
 	sllv_t* poutrecs = sllv_alloc();
 
-	for (lhmslve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
+	for (int j = 0; j < pstate->groups->num_entries; j++) {
+		group_table_entry_t* pa = &pstate->groups->entries[j];
 
 		// Above we required that there was only one value field in the
 		// show-full-records case. That's for two reasons: (1) here, we print
@@ -244,6 +242,7 @@ static sllv_t* mapper_top_emit(mapper_top_state_t* pstate, context_t* pctx) {
 			lhmsv_t* group_to_acc_field = pa->pvvalue;
 			for (lhmsve_t* pd = group_to_acc_field->phead; pd != NULL; pd = pd->pnext) {
 				top_keeper_t* ptop_keeper_for_group = pd->pvvalue;
+				top_keeper_sort(ptop_keeper_for_group);
 				for (int i = 0;  i < ptop_keeper_for_group->size; i++) {
 					sllv_append(poutrecs, ptop_keeper_for_group->top_precords[i]);
 					ptop_keeper_for_group->top_precords[i] = NULL;
@@ -252,19 +251,20 @@ static sllv_t* mapper_top_emit(mapper_top_state_t* pstate, context_t* pctx) {
 		}
 
 		else {
-			slls_t* pgroup_by_field_values = pa->key;
+			lhmsv_t* group_to_acc_field = pa->pvvalue;
+			for (lhmsve_t* pd = group_to_acc_field->phead; pd != NULL; pd = pd->pnext)
+				top_keeper_sort(pd->pvvalue);
+
 			for (int i = 0; i < pstate->top_count; i++) {
 				lrec_t* poutrec = lrec_unbacked_alloc();
 
 				// Add in a=s,b=t fields:
-				sllse_t* pb = pstate->pgroup_by_field_names->phead;
-				sllse_t* pc =         pgroup_by_field_values->phead;
-				for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-					lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+				int k = 0;
+				for (sllse_t* pb = pstate->pgroup_by_field_names->phead; pb != NULL; pb = pb->pnext, k++) {
+					lrec_put(poutrec, pb->value, pa->key_values[k], NO_FREE);
 				}
 
 				// Add in fields such as x_top_1=#
-				lhmsv_t* group_to_acc_field = pa->pvvalue;
 				// for "x", "y"
 				for (lhmsve_t* pd = group_to_acc_field->phead; pd != NULL; pd = pd->pnext) {
 					char* value_field_name = pd->key;
@@ -3,16 +3,23 @@
 #include <string.h>
 #include <math.h>
 #include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
 #include "containers/sllv.h"
 #include "containers/lhmsll.h"
-#include "containers/lhmslv.h"
+#include "containers/group_table.h"
 #include "containers/lhmsv.h"
 #include "containers/lhmsll.h"
 #include "containers/mixutil.h"
+#include "containers/hyperloglog.h"
+#include "containers/fingerprint_table.h"
+#include "lib/string_builder.h"
 #include "mapping/mappers.h"
+#include "mapping/acc_state.h"
 #include "cli/argparse.h"
 
 #define DEFAULT_OUTPUT_FIELD_NAME "count"
+#define STATE_FIELD_NAME_SUFFIX "_hll"
+#define REGISTER_DIGITS "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz._"
 
 typedef struct _mapper_uniq_state_t {
 	ap_state_t* pargp;
@@ -21,9 +28,27 @@ typedef struct _mapper_uniq_state_t {
 	int       show_num_distinct_only;
 	lhmsll_t* puniqified_record_counts; // lrec_sprintf -> counts
 	lhmsv_t*  puniqified_records; // lrec_sprintf -> records
-	lhmslv_t* pcounts_by_group;
+	group_key_t*   pgroup_key;
+	group_table_t* pcounts_by_group;
 	lhmsv_t*  pcounts_unlashed; // string field name -> string field value -> long long count
 	char* output_field_name;
+
+	// For distinct counts by group, and for approximate distinct counts.
+	slls_t*        pcount_group_by_field_names; // Empty for a single group
+	group_key_t*   pcount_group_key;
+	group_key_t*   pvalue_key;
+	group_table_t* pdistincts_by_group; // Values are group_table_t*, or with --approx, hyperloglog_t*
+	int            approx_precision;    // 0 for exact counts
+	char**         record_strings;      // Field names and values for uniq -a
+	int            record_strings_capacity;
+	int            do_dump_state;
+	int            do_merge_state;
+	char*          state_field_name;
+	string_builder_t* psb;
+
+	// For --fingerprint: distinct records or group-by values, by hash only.
+	int                  do_fingerprint;
+	fingerprint_table_t* pfingerprints; // With uniq -a -c, values are the first records
 } mapper_uniq_state_t;
 
 // ----------------------------------------------------------------
@@ -58,12 +83,21 @@ static mapper_t* mapper_uniq_alloc(
 	int show_counts,
 	int show_num_distinct_only,
 	char* output_field_name,
-	int uniqify_entire_records);
+	int uniqify_entire_records,
+	slls_t* pcount_group_by_field_names,
+	int approx_precision,
+	int do_dump_state,
+	int do_merge_state,
+	int do_fingerprint);
 
 static void mapper_uniq_free(
 	mapper_t* pmapper,
 	context_t* _);
 
+static mapper_field_usage_t mapper_count_distinct_field_usage(
+	mapper_t* pmapper,
+	hss_t* pfield_names);
+
 static sllv_t* mapper_uniq_process_uniqify_entire_records(
 	lrec_t* pinrec,
 	context_t* pctx,
@@ -79,6 +113,16 @@ static sllv_t* mapper_uniq_process_uniqify_entire_records_show_num_distinct_only
 	context_t* pctx,
 	void* pvstate);
 
+static sllv_t* mapper_uniq_process_fingerprint_entire_records(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
+static sllv_t* mapper_uniq_process_fingerprint_entire_records_show_counts(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
 static sllv_t* mapper_uniq_process_unlashed(
 	lrec_t* pinrec,
 	context_t* pctx,
@@ -89,6 +133,11 @@ static sllv_t* mapper_uniq_process_num_distinct_only(
 	context_t* pctx,
 	void* pvstate);
 
+static sllv_t* mapper_uniq_process_num_distinct_by_group(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
 static sllv_t* mapper_uniq_process_with_counts(
 	lrec_t* pinrec,
 	context_t* pctx,
@@ -99,12 +148,18 @@ static sllv_t* mapper_uniq_process_no_counts(
 	context_t* pctx,
 	void* pvstate);
 
+static sllv_t* mapper_uniq_process_fingerprint_no_counts(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
 // ----------------------------------------------------------------
 mapper_setup_t mapper_count_distinct_setup = {
 	.verb = "count-distinct",
 	.pusage_func = mapper_count_distinct_usage,
 	.pparse_func = mapper_count_distinct_parse_cli,
 	.ignores_input = FALSE,
+	.pfield_usage_func = mapper_count_distinct_field_usage,
 };
 
 mapper_setup_t mapper_uniq_setup = {
@@ -134,6 +189,30 @@ static void mapper_count_distinct_usage(
 	fprintf(o, "              and b field values. With -f a,b and with -u, computes counts\n");
 	fprintf(o, "              for distinct a field values and counts for distinct b field\n");
 	fprintf(o, "              values separately.\n");
+	fprintf(o, "-g {d,e,f}    With -n: show the number of distinct values separately for each\n");
+	fprintf(o, "              distinct combination of these group-by fields' values.\n");
+	fprintf(o, "--approx      Like -n, but estimate the number of distinct values using a\n");
+	fprintf(o, "              HyperLogLog sketch, in a fixed amount of memory per group rather\n");
+	fprintf(o, "              than memory for each distinct value. The relative standard error\n");
+	fprintf(o, "              is 1.04/sqrt(2^p): 0.81%% with the default p=%d, using 16KB per\n",
+		HYPERLOGLOG_DEFAULT_PRECISION);
+	fprintf(o, "              group; small groups use less.\n");
+	fprintf(o, "--approx-precision {p} As --approx, with 2^p registers, for p from %d to %d.\n",
+		HYPERLOGLOG_MIN_PRECISION, HYPERLOGLOG_MAX_PRECISION);
+	fprintf(o, "--dump-state  With --approx: instead of counts, output sketches, one record per\n");
+	fprintf(o, "              group with field {name}%s. These may be saved, e.g. one file\n",
+		STATE_FIELD_NAME_SUFFIX);
+	fprintf(o, "              per shard of a larger data set, for use with --merge-state.\n");
+	fprintf(o, "--merge-state With --approx: take as input the records output by --dump-state,\n");
+	fprintf(o, "              from any number of runs with the same -g, -o, and precision.\n");
+	fprintf(o, "              Output is as if a single run had seen all the original data.\n");
+	fprintf(o, "              With --dump-state, outputs the merged sketches instead.\n");
+	fprintf(o, "--fingerprint With -n: count distinct values exactly, but keeping only a 128-bit\n");
+	fprintf(o, "              hash of each rather than the values themselves. Two distinct\n");
+	fprintf(o, "              values are miscounted as one only if their hashes collide,\n");
+	fprintf(o, "              which is vanishingly unlikely.\n");
+	fprintf(o, "Example: %s %s -f user --approx -g day\n", argv0, verb);
+	fprintf(o, "         estimates the number of distinct users on each day.\n");
 }
 
 // ----------------------------------------------------------------
@@ -145,24 +224,37 @@ static mapper_t* mapper_count_distinct_parse_cli(
 	cli_writer_opts_t* __)
 {
 	slls_t* pfield_names = NULL;
+	slls_t* pgroup_by_field_names = NULL;
 	int     show_num_distinct_only = FALSE;
 	char*   output_field_name = DEFAULT_OUTPUT_FIELD_NAME;
 	int     do_lashed = TRUE;
+	int     approx_precision = 0;
+	int     do_dump_state = FALSE;
+	int     do_merge_state = FALSE;
+	int     do_fingerprint = FALSE;
 
 	char* verb = argv[(*pargi)++];
 
 	ap_state_t* pstate = ap_alloc();
 	ap_define_string_list_flag(pstate, "-f", &pfield_names);
+	ap_define_string_list_flag(pstate, "-g", &pgroup_by_field_names);
 	ap_define_true_flag(pstate,        "-n", &show_num_distinct_only);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
 	ap_define_false_flag(pstate,       "-u", &do_lashed);
+	ap_define_int_value_flag(pstate,   "--approx", HYPERLOGLOG_DEFAULT_PRECISION, &approx_precision);
+	ap_define_int_flag(pstate,         "--approx-precision", &approx_precision);
+	ap_define_true_flag(pstate,        "--dump-state", &do_dump_state);
+	ap_define_true_flag(pstate,        "--merge-state", &do_merge_state);
+	ap_define_true_flag(pstate,        "--fingerprint", &do_fingerprint);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_count_distinct_usage(stderr, argv[0], verb);
 		return NULL;
 	}
 
-	if (pfield_names == NULL) {
+	if (approx_precision != 0)
+		show_num_distinct_only = TRUE;
+	if (pfield_names == NULL && !do_merge_state) {
 		mapper_count_distinct_usage(stderr, argv[0], verb);
 		return NULL;
 	}
@@ -170,9 +262,30 @@ static mapper_t* mapper_count_distinct_parse_cli(
 		mapper_count_distinct_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (pgroup_by_field_names != NULL && !show_num_distinct_only) {
+		mapper_count_distinct_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (approx_precision != 0
+		&& (approx_precision < HYPERLOGLOG_MIN_PRECISION || approx_precision > HYPERLOGLOG_MAX_PRECISION))
+	{
+		mapper_count_distinct_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if ((do_dump_state || do_merge_state) && approx_precision == 0) {
+		mapper_count_distinct_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (do_fingerprint && (!show_num_distinct_only || approx_precision != 0)) {
+		mapper_count_distinct_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (pfield_names == NULL)
+		pfield_names = slls_alloc();
 
 	return mapper_uniq_alloc(pstate, pfield_names, do_lashed, TRUE, show_num_distinct_only,
-		output_field_name, FALSE);
+		output_field_name, FALSE, pgroup_by_field_names, approx_precision, do_dump_state, do_merge_state,
+		do_fingerprint);
 }
 
 // ----------------------------------------------------------------
@@ -194,6 +307,15 @@ static void mapper_uniq_usage(
 	fprintf(o, "              With -c, produces unique records, with repeat counts for each.\n");
 	fprintf(o, "              With -n, produces only one record which is the unique-record count.\n");
 	fprintf(o, "              With neither -c nor -n, produces unique records.\n");
+	fprintf(o, "--approx      Like -n, but estimate the number of distinct values (or with -a,\n");
+	fprintf(o, "              records) in fixed memory: see %s count-distinct --help.\n", argv0);
+	fprintf(o, "--approx-precision {p} As --approx, with 2^p registers, for p from %d to %d.\n",
+		HYPERLOGLOG_MIN_PRECISION, HYPERLOGLOG_MAX_PRECISION);
+	fprintf(o, "--fingerprint Tell records (with -a) or values apart by a 128-bit hash of\n");
+	fprintf(o, "              them, keeping only that hash for each distinct one seen rather\n");
+	fprintf(o, "              than a copy. Two distinct ones are taken as the same only if\n");
+	fprintf(o, "              their hashes collide, which is vanishingly unlikely. Records are\n");
+	fprintf(o, "              still kept for -a -c, and values for -g -c, for output.\n");
 }
 
 static mapper_t* mapper_uniq_parse_cli(
@@ -209,6 +331,8 @@ static mapper_t* mapper_uniq_parse_cli(
 	char*   output_field_name = DEFAULT_OUTPUT_FIELD_NAME;
 	int     do_lashed = TRUE;
 	int     uniqify_entire_records = FALSE;
+	int     approx_precision = 0;
+	int     do_fingerprint = FALSE;
 
 	char* verb = argv[(*pargi)++];
 
@@ -219,12 +343,23 @@ static mapper_t* mapper_uniq_parse_cli(
 	ap_define_true_flag(pstate,        "-n", &show_num_distinct_only);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
 	ap_define_true_flag(pstate,        "-a", &uniqify_entire_records);
+	ap_define_int_value_flag(pstate,   "--approx", HYPERLOGLOG_DEFAULT_PRECISION, &approx_precision);
+	ap_define_int_flag(pstate,         "--approx-precision", &approx_precision);
+	ap_define_true_flag(pstate,        "--fingerprint", &do_fingerprint);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_uniq_usage(stderr, argv[0], verb);
 		return NULL;
 	}
 
+	if (approx_precision != 0) {
+		show_num_distinct_only = TRUE;
+		if (approx_precision < HYPERLOGLOG_MIN_PRECISION || approx_precision > HYPERLOGLOG_MAX_PRECISION) {
+			mapper_uniq_usage(stderr, argv[0], verb);
+			return NULL;
+		}
+	}
+
 	if (uniqify_entire_records) {
 		if (pgroup_by_field_names != NULL) {
 			mapper_uniq_usage(stderr, argv[0], verb);
@@ -242,7 +377,7 @@ static mapper_t* mapper_uniq_parse_cli(
 	}
 
 	return mapper_uniq_alloc(pstate, pgroup_by_field_names, do_lashed, show_counts, show_num_distinct_only,
-		output_field_name, uniqify_entire_records);
+		output_field_name, uniqify_entire_records, NULL, approx_precision, FALSE, FALSE, do_fingerprint);
 }
 
 // ----------------------------------------------------------------
@@ -253,7 +388,12 @@ static mapper_t* mapper_uniq_alloc(
 	int show_counts,
 	int show_num_distinct_only,
 	char* output_field_name,
-	int uniqify_entire_records)
+	int uniqify_entire_records,
+	slls_t* pcount_group_by_field_names,
+	int approx_precision,
+	int do_dump_state,
+	int do_merge_state,
+	int do_fingerprint)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -265,12 +405,35 @@ static mapper_t* mapper_uniq_alloc(
 	pstate->show_num_distinct_only   = show_num_distinct_only;
 	pstate->puniqified_record_counts = lhmsll_alloc();
 	pstate->puniqified_records       = lhmsv_alloc();
-	pstate->pcounts_by_group         = lhmslv_alloc();
+	pstate->pgroup_key               = group_key_alloc();
+	pstate->pcounts_by_group         = group_table_alloc(pgroup_by_field_names == NULL ? 0 : pgroup_by_field_names->length);
 	pstate->pcounts_unlashed         = lhmsv_alloc();
 	pstate->output_field_name        = output_field_name;
 
+	pstate->pcount_group_by_field_names = pcount_group_by_field_names == NULL ? slls_alloc()
+		: pcount_group_by_field_names;
+	pstate->pcount_group_key         = group_key_alloc();
+	pstate->pvalue_key               = group_key_alloc();
+	pstate->pdistincts_by_group      = group_table_alloc(pstate->pcount_group_by_field_names->length);
+	pstate->approx_precision         = approx_precision;
+	pstate->record_strings           = NULL;
+	pstate->record_strings_capacity  = 0;
+	pstate->do_dump_state            = do_dump_state;
+	pstate->do_merge_state           = do_merge_state;
+	pstate->state_field_name         = mlr_paste_2_strings(output_field_name, STATE_FIELD_NAME_SUFFIX);
+	pstate->psb                      = sb_alloc(1024);
+	pstate->do_fingerprint           = do_fingerprint;
+	pstate->pfingerprints            = fingerprint_table_alloc();
+
 	pmapper->pvstate = pstate;
-	if (uniqify_entire_records) {
+	if (show_num_distinct_only && (approx_precision != 0 || pcount_group_by_field_names != NULL || do_fingerprint)) {
+		pmapper->pprocess_func = mapper_uniq_process_num_distinct_by_group;
+	} else if (uniqify_entire_records && do_fingerprint) {
+		if (show_counts)
+			pmapper->pprocess_func = mapper_uniq_process_fingerprint_entire_records_show_counts;
+		else
+			pmapper->pprocess_func = mapper_uniq_process_fingerprint_entire_records;
+	} else if (uniqify_entire_records) {
 		if (show_counts)
 			pmapper->pprocess_func = mapper_uniq_process_uniqify_entire_records_show_counts;
 		else if (show_num_distinct_only)
@@ -283,6 +446,8 @@ static mapper_t* mapper_uniq_alloc(
 		pmapper->pprocess_func = mapper_uniq_process_num_distinct_only;
 	else if (show_counts)
 		pmapper->pprocess_func = mapper_uniq_process_with_counts;
+	else if (do_fingerprint)
+		pmapper->pprocess_func = mapper_uniq_process_fingerprint_no_counts;
 	else
 		pmapper->pprocess_func = mapper_uniq_process_no_counts;
 	pmapper->pfree_func = mapper_uniq_free;
@@ -309,13 +474,12 @@ static void mapper_uniq_free(
 	lhmsv_free(pstate->puniqified_records);
 	pstate->puniqified_records = NULL;
 
-	// lhmslv_free will free the keys: we only need to free the void-star values.
-	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
-		unsigned long long* pcount = pa->pvvalue;
-		free(pcount);
-	}
-	lhmslv_free(pstate->pcounts_by_group);
+	// group_table_free will free the keys: we only need to free the void-star values.
+	for (int i = 0; i < pstate->pcounts_by_group->num_entries; i++)
+		free(pstate->pcounts_by_group->entries[i].pvvalue);
+	group_table_free(pstate->pcounts_by_group);
 	pstate->pcounts_by_group = NULL;
+	group_key_free(pstate->pgroup_key);
 
 	for (lhmsve_t* pb = pstate->pcounts_unlashed->phead; pb != NULL; pb = pb->pnext) {
 		lhmsll_t* pmap = pb->pvvalue;
@@ -324,6 +488,25 @@ static void mapper_uniq_free(
 	lhmsv_free(pstate->pcounts_unlashed);
 	pstate->pcounts_unlashed = NULL;
 
+	for (int i = 0; i < pstate->pdistincts_by_group->num_entries; i++) {
+		if (pstate->approx_precision != 0)
+			hyperloglog_free(pstate->pdistincts_by_group->entries[i].pvvalue);
+		else if (pstate->do_fingerprint)
+			fingerprint_table_free(pstate->pdistincts_by_group->entries[i].pvvalue);
+		else
+			group_table_free(pstate->pdistincts_by_group->entries[i].pvvalue);
+	}
+	group_table_free(pstate->pdistincts_by_group);
+	group_key_free(pstate->pcount_group_key);
+	group_key_free(pstate->pvalue_key);
+	slls_free(pstate->pcount_group_by_field_names);
+	free(pstate->record_strings);
+	free(pstate->state_field_name);
+	sb_free(pstate->psb);
+	for (int i = 0; i < pstate->pfingerprints->num_entries; i++)
+		lrec_free(pstate->pfingerprints->entries[i].pvvalue);
+	fingerprint_table_free(pstate->pfingerprints);
+
 	pstate->pgroup_by_field_names = NULL;
 	pstate->pcounts_by_group = NULL;
 
@@ -332,6 +515,25 @@ static void mapper_uniq_free(
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+// Counts for count-distinct depend only on the values of the named fields (or,
+// with --merge-state, on the dumped states).
+static mapper_field_usage_t mapper_count_distinct_field_usage(
+	mapper_t* pmapper,
+	hss_t* pfield_names)
+{
+	mapper_uniq_state_t* pstate = pmapper->pvstate;
+	if (pstate->pgroup_by_field_names == NULL) // distinct whole records
+		return MAPPER_USES_ALL_FIELDS;
+	for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	for (sllse_t* pe = pstate->pcount_group_by_field_names->phead; pe != NULL; pe = pe->pnext)
+		hss_add(pfield_names, pe->value);
+	if (pstate->do_merge_state)
+		hss_add(pfield_names, pstate->state_field_name);
+	return MAPPER_USES_NAMED_FIELDS_ONLY;
+}
+
 // ----------------------------------------------------------------
 // Print each unique record only once (on first occurrence).
 static sllv_t* mapper_uniq_process_uniqify_entire_records(
@@ -471,18 +673,15 @@ static sllv_t* mapper_uniq_process_num_distinct_only(
 {
 	mapper_uniq_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
-			if (pcount == NULL) {
-				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
-				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+		if (group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
+			unsigned long long** ppcount = (unsigned long long**)group_table_get_or_add(pstate->pcounts_by_group,
+				pstate->pgroup_key);
+			if (*ppcount == NULL) {
+				*ppcount = mlr_malloc_or_die(sizeof(unsigned long long));
+				**ppcount = 1LL;
 			} else {
-				(*pcount)++;
+				(**ppcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
@@ -491,7 +690,7 @@ static sllv_t* mapper_uniq_process_num_distinct_only(
 		sllv_t* poutrecs = sllv_alloc();
 
 		lrec_t* poutrec = lrec_unbacked_alloc();
-		int count = pstate->pcounts_by_group->num_occupied;
+		int count = group_table_size(pstate->pcounts_by_group);
 		lrec_put(poutrec, "count", mlr_alloc_string_from_int(count), FREE_ENTRY_VALUE);
 		sllv_append(poutrecs, poutrec);
 
@@ -507,33 +706,28 @@ static sllv_t* mapper_uniq_process_with_counts(
 {
 	mapper_uniq_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
-			if (pcount == NULL) {
-				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
-				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+		if (group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
+			unsigned long long** ppcount = (unsigned long long**)group_table_get_or_add(pstate->pcounts_by_group,
+				pstate->pgroup_key);
+			if (*ppcount == NULL) {
+				*ppcount = mlr_malloc_or_die(sizeof(unsigned long long));
+				**ppcount = 1LL;
 			} else {
-				(*pcount)++;
+				(**ppcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
 	} else {
 		sllv_t* poutrecs = sllv_alloc();
 
-		for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
+		for (int i = 0; i < pstate->pcounts_by_group->num_entries; i++) {
+			group_table_entry_t* pa = &pstate->pcounts_by_group->entries[i];
 			lrec_t* poutrec = lrec_unbacked_alloc();
 
-			slls_t* pgroup_by_field_values = pa->key;
-
-			sllse_t* pb = pstate->pgroup_by_field_names->phead;
-			sllse_t* pc =         pgroup_by_field_values->phead;
-			for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-				lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+			int j = 0;
+			for (sllse_t* pb = pstate->pgroup_by_field_names->phead; pb != NULL; pb = pb->pnext, j++) {
+				lrec_put(poutrec, pb->value, pa->key_values[j], NO_FREE);
 			}
 
 			if (pstate->show_counts) {
@@ -558,35 +752,298 @@ static sllv_t* mapper_uniq_process_no_counts(
 		return sllv_single(NULL);
 	}
 
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-		pstate->pgroup_by_field_names);
-	if (pgroup_by_field_values == NULL) {
+	if (!group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
 		lrec_free(pinrec);
 		return NULL;
 	}
 
-	unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
-	if (pcount == NULL) {
-		pcount = mlr_malloc_or_die(sizeof(unsigned long long));
-		*pcount = 1LL;
-		slls_t* pcopy = slls_copy(pgroup_by_field_values);
-		lhmslv_put(pstate->pcounts_by_group, pcopy, pcount, FREE_ENTRY_KEY);
+	group_table_t* pcounts_by_group = pstate->pcounts_by_group;
+	unsigned long long** ppcount = (unsigned long long**)group_table_get_or_add(pcounts_by_group,
+		pstate->pgroup_key);
+	if (*ppcount == NULL) {
+		*ppcount = mlr_malloc_or_die(sizeof(unsigned long long));
+		**ppcount = 1LL;
 
+		// The new group's values, as copied into the table.
+		char** key_values = pcounts_by_group->entries[pcounts_by_group->num_entries - 1].key_values;
 		lrec_t* poutrec = lrec_unbacked_alloc();
 
-		sllse_t* pb = pstate->pgroup_by_field_names->phead;
-		sllse_t* pc = pcopy->phead;
-		for ( ; pb != NULL && pc != NULL; pb = pb->pnext, pc = pc->pnext) {
-			lrec_put(poutrec, pb->value, pc->value, NO_FREE);
+		int j = 0;
+		for (sllse_t* pb = pstate->pgroup_by_field_names->phead; pb != NULL; pb = pb->pnext, j++) {
+			lrec_put(poutrec, pb->value, key_values[j], NO_FREE);
 		}
 
 		lrec_free(pinrec);
-		slls_free(pgroup_by_field_values);
 		return sllv_single(poutrec);
 	} else {
-		(*pcount)++;
+		(**ppcount)++;
+		lrec_free(pinrec);
+		return NULL;
+	}
+}
+
+// ----------------------------------------------------------------
+// Numbers of distinct values (or with uniq -a, records) for each group, exactly
+// or with --approx by HyperLogLog. Without count-distinct -g there is a single
+// group with no group-by fields.
+
+// For uniq -a: the record's field names and values, in order, as one key.
+static void mapper_uniq_key_from_entire_record(mapper_uniq_state_t* pstate, lrec_t* pinrec) {
+	int num_strings = 2 * pinrec->field_count;
+	if (num_strings > pstate->record_strings_capacity) {
+		pstate->record_strings_capacity = num_strings;
+		pstate->record_strings = mlr_realloc_or_die(pstate->record_strings, num_strings * sizeof(char*));
+	}
+	int i = 0;
+	for (lrece_t* pe = pinrec->phead; pe != NULL; pe = pe->pnext) {
+		pstate->record_strings[i++] = pe->key;
+		pstate->record_strings[i++] = pe->value;
+	}
+	group_key_from_array(pstate->pvalue_key, pstate->record_strings, num_strings);
+}
+
+static void* mapper_uniq_alloc_distincts(mapper_uniq_state_t* pstate) {
+	if (pstate->approx_precision != 0)
+		return hyperloglog_alloc(pstate->approx_precision);
+	else if (pstate->do_fingerprint)
+		return fingerprint_table_alloc();
+	else
+		return group_table_alloc(pstate->pgroup_by_field_names == NULL ? 0 : pstate->pgroup_by_field_names->length);
+}
+
+// Sketches are dumped as the precision, then either "sparse" followed by the
+// number of nonzero registers and each one's index times 64 plus its value,
+// or "dense" followed by a string with one character per register.
+static char* mapper_uniq_dump_sketch(mapper_uniq_state_t* pstate, hyperloglog_t* phll) {
+	string_builder_t* psb = pstate->psb;
+	acc_state_put_int(psb, phll->precision);
+	if (phll->registers == NULL) {
+		acc_state_put_string(psb, "sparse");
+		acc_state_put_int(psb, phll->num_sparse);
+		for (int i = 0; i < phll->num_sparse; i++)
+			acc_state_put_int(psb, (long long)(phll->sparse[i] >> 8) * 64 + (phll->sparse[i] & 0xff));
+	} else {
+		acc_state_put_string(psb, "dense");
+		sb_append_char(psb, ACC_STATE_SEPARATOR);
+		sb_append_char(psb, 's');
+		for (int i = 0; i < phll->num_registers; i++)
+			sb_append_char(psb, REGISTER_DIGITS[phll->registers[i]]);
+	}
+	return sb_finish(psb);
+}
+
+static int mapper_uniq_merge_dumped_sketch(hyperloglog_t* phll, char* dump) {
+	long long precision;
+	char* format;
+	if (!acc_state_get_int(&dump, &precision) || precision != phll->precision)
+		return FALSE;
+	if (!acc_state_get_string(&dump, &format))
+		return FALSE;
+	int max_value = hyperloglog_max_register_value(phll);
+	if (streq(format, "sparse")) {
+		unsigned long long num_sparse;
+		if (!acc_state_get_count(&dump, &num_sparse))
+			return FALSE;
+		for (unsigned long long i = 0; i < num_sparse; i++) {
+			long long entry;
+			if (!acc_state_get_int(&dump, &entry))
+				return FALSE;
+			long long index = entry / 64;
+			int value = entry % 64;
+			if (entry < 0 || index >= phll->num_registers || value > max_value)
+				return FALSE;
+			hyperloglog_update_register(phll, index, value);
+		}
+	} else if (streq(format, "dense")) {
+		char* registers;
+		if (!acc_state_get_string(&dump, &registers) || strlen(registers) != phll->num_registers)
+			return FALSE;
+		for (int i = 0; i < phll->num_registers; i++) {
+			char* pdigit = strchr(REGISTER_DIGITS, registers[i]);
+			if (pdigit == NULL || pdigit - REGISTER_DIGITS > max_value)
+				return FALSE;
+			hyperloglog_update_register(phll, i, pdigit - REGISTER_DIGITS);
+		}
+	} else {
+		return FALSE;
+	}
+	return acc_state_at_end(&dump);
+}
+
+static sllv_t* mapper_uniq_emit_num_distinct_by_group(mapper_uniq_state_t* pstate) {
+	sllv_t* poutrecs = sllv_alloc();
+	group_table_t* pdistincts_by_group = pstate->pdistincts_by_group;
+
+	for (int i = 0; i < pdistincts_by_group->num_entries; i++) {
+		group_table_entry_t* pa = &pdistincts_by_group->entries[i];
+		lrec_t* poutrec = lrec_unbacked_alloc();
+		int j = 0;
+		for (sllse_t* pb = pstate->pcount_group_by_field_names->phead; pb != NULL; pb = pb->pnext, j++)
+			lrec_put(poutrec, pb->value, pa->key_values[j], NO_FREE);
+
+		if (pstate->do_dump_state) {
+			lrec_put(poutrec, pstate->state_field_name, mapper_uniq_dump_sketch(pstate, pa->pvvalue),
+				FREE_ENTRY_VALUE);
+		} else {
+			long long count = (pstate->approx_precision != 0) ? llround(hyperloglog_estimate(pa->pvvalue))
+				: pstate->do_fingerprint ? fingerprint_table_size(pa->pvvalue)
+				: group_table_size(pa->pvvalue);
+			lrec_put(poutrec, pstate->output_field_name, mlr_alloc_string_from_ll(count), FREE_ENTRY_VALUE);
+		}
+		sllv_append(poutrecs, poutrec);
+	}
+
+	// As for exact counts, there is a count of zero for empty input.
+	if (pdistincts_by_group->num_entries == 0 && pstate->pcount_group_by_field_names->length == 0
+		&& !pstate->do_dump_state)
+	{
+		lrec_t* poutrec = lrec_unbacked_alloc();
+		lrec_put(poutrec, pstate->output_field_name, "0", NO_FREE);
+		sllv_append(poutrecs, poutrec);
+	}
+
+	sllv_append(poutrecs, NULL);
+	return poutrecs;
+}
+
+static sllv_t* mapper_uniq_process_num_distinct_by_group(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec == NULL)
+		return mapper_uniq_emit_num_distinct_by_group(pstate);
+
+	if (!group_key_from_record(pstate->pcount_group_key, pinrec, pstate->pcount_group_by_field_names)) {
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	if (pstate->do_merge_state) {
+		char* dump = lrec_get(pinrec, pstate->state_field_name);
+		if (dump != NULL) {
+			void** ppdistincts = group_table_get_or_add(pstate->pdistincts_by_group, pstate->pcount_group_key);
+			if (*ppdistincts == NULL)
+				*ppdistincts = mapper_uniq_alloc_distincts(pstate);
+			dump = mlr_strdup_or_die(dump);
+			if (!mapper_uniq_merge_dumped_sketch(*ppdistincts, dump)) {
+				fprintf(stderr, "%s %s: could not parse sketch in field \"%s\".\n",
+					MLR_GLOBALS.bargv0, "count-distinct", pstate->state_field_name);
+				exit(1);
+			}
+			free(dump);
+		}
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	if (pstate->pgroup_by_field_names == NULL) {
+		mapper_uniq_key_from_entire_record(pstate, pinrec);
+	} else if (!group_key_from_record(pstate->pvalue_key, pinrec, pstate->pgroup_by_field_names)) {
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	void** ppdistincts = group_table_get_or_add(pstate->pdistincts_by_group, pstate->pcount_group_key);
+	if (*ppdistincts == NULL)
+		*ppdistincts = mapper_uniq_alloc_distincts(pstate);
+	if (pstate->approx_precision != 0)
+		hyperloglog_add_hash(*ppdistincts, pstate->pvalue_key->hash);
+	else if (pstate->do_fingerprint)
+		(void)fingerprint_table_get_or_add(*ppdistincts, fingerprint_from_group_key(pstate->pvalue_key));
+	else
+		(void)group_table_get_or_add(*ppdistincts, pstate->pvalue_key);
+
+	lrec_free(pinrec);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+// With --fingerprint: records and group-by values are looked up by a 128-bit
+// hash computed in place from the record's fields, without formatting them as
+// a string, and only the hash is kept.
+
+// Print each unique record only once (on first occurrence).
+static sllv_t* mapper_uniq_process_fingerprint_entire_records(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec == NULL)
+		return sllv_single(NULL);
+
+	mapper_uniq_key_from_entire_record(pstate, pinrec);
+	fingerprint_table_entry_t* pe = fingerprint_table_get_or_add(pstate->pfingerprints,
+		fingerprint_from_group_key(pstate->pvalue_key));
+	if (pe->count++ == 0LL) {
+		return sllv_single(pinrec);
+	} else {
 		lrec_free(pinrec);
-		slls_free(pgroup_by_field_values);
 		return NULL;
 	}
 }
+
+// Print each unique record only once, with uniqueness counts. The first
+// instance of each is kept for output at end of stream.
+static sllv_t* mapper_uniq_process_fingerprint_entire_records_show_counts(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		mapper_uniq_key_from_entire_record(pstate, pinrec);
+		fingerprint_table_entry_t* pe = fingerprint_table_get_or_add(pstate->pfingerprints,
+			fingerprint_from_group_key(pstate->pvalue_key));
+		if (pe->count++ == 0LL)
+			pe->pvvalue = pinrec;
+		else
+			lrec_free(pinrec);
+		return NULL;
+	} else {
+		sllv_t* poutrecs = sllv_alloc();
+		for (int i = 0; i < pstate->pfingerprints->num_entries; i++) {
+			fingerprint_table_entry_t* pe = &pstate->pfingerprints->entries[i];
+			lrec_t* prec = pe->pvvalue;
+			lrec_prepend(prec, pstate->output_field_name, mlr_alloc_string_from_ull(pe->count), FREE_ENTRY_VALUE);
+			sllv_append(poutrecs, prec);
+			pe->pvvalue = NULL; // transfer ownership to poutrecs
+		}
+		sllv_append(poutrecs, NULL);
+		return poutrecs;
+	}
+}
+
+// Print each distinct combination of group-by values on first occurrence.
+static sllv_t* mapper_uniq_process_fingerprint_no_counts(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec == NULL) {
+		return sllv_single(NULL);
+	}
+
+	if (!group_key_from_record(pstate->pgroup_key, pinrec, pstate->pgroup_by_field_names)) {
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	fingerprint_table_entry_t* pe = fingerprint_table_get_or_add(pstate->pfingerprints,
+		fingerprint_from_group_key(pstate->pgroup_key));
+	if (pe->count++ != 0LL) {
+		lrec_free(pinrec);
+		return NULL;
+	}
+
+	lrec_t* poutrec = lrec_unbacked_alloc();
+	int j = 0;
+	for (sllse_t* pb = pstate->pgroup_by_field_names->phead; pb != NULL; pb = pb->pnext, j++) {
+		lrec_put(poutrec, pb->value, mlr_strdup_or_die(pstate->pgroup_key->values[j]), FREE_ENTRY_VALUE);
+	}
+	lrec_free(pinrec);
+	return sllv_single(poutrec);
+}
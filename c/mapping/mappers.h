@@ -40,6 +40,7 @@ extern mapper_setup_t mapper_sec2gmtdate_setup;
 extern mapper_setup_t mapper_seqgen_setup;
 extern mapper_setup_t mapper_shuffle_setup;
 extern mapper_setup_t mapper_sort_setup;
+extern mapper_setup_t mapper_split_setup;
 extern mapper_setup_t mapper_stats1_setup;
 extern mapper_setup_t mapper_stats2_setup;
 extern mapper_setup_t mapper_step_setup;
@@ -10,8 +10,10 @@
 #include "containers/lhmss.h"
 #include "containers/lhmsll.h"
 #include "containers/percentile_keeper.h"
+#include "containers/percentile_sketch.h"
 #include "lib/mvfuncs.h"
 #include "mapping/stats1_accumulators.h"
+#include "mapping/acc_state.h"
 
 // ----------------------------------------------------------------
 void make_stats1_accs(
@@ -19,6 +21,7 @@ void make_stats1_accs(
 	slls_t*  paccumulator_names,          // input
 	int      allow_int_float,             // input
 	int      do_interpolated_percentiles, // input
+	int      percentile_sketch_k,         // input: 0 for exact percentiles
 	lhmsv_t* acc_field_to_acc_state_in,   // output
 	lhmsv_t* acc_field_to_acc_state_out)  // output
 {
@@ -34,7 +37,7 @@ void make_stats1_accs(
 		if (is_percentile_acc_name(stats1_acc_name)) {
 			if (ppercentile_acc == NULL) {
 				ppercentile_acc = stats1_percentile_alloc(value_field_name, stats1_acc_name, allow_int_float,
-					do_interpolated_percentiles);
+					do_interpolated_percentiles, percentile_sketch_k);
 				if (ppercentile_acc == NULL) {
 					fprintf(stderr, "%s stats1: accumulator \"%s\" not found.\n",
 						MLR_GLOBALS.bargv0, stats1_acc_name);
@@ -86,6 +89,52 @@ int is_percentile_acc_name(char* stats1_acc_name) {
 	return TRUE;
 }
 
+char* stats1_acc_state_name(char* stats1_acc_name) {
+	return is_percentile_acc_name(stats1_acc_name) ? "percentiles" : stats1_acc_name;
+}
+
+// ----------------------------------------------------------------
+// For mode and antimode. Values new to this map are appended in the other map's
+// order, so first-found still wins ties.
+static void stats1_merge_counts_for_value(lhmsll_t* pcounts_for_value, lhmsll_t* pother_counts_for_value) {
+	for (lhmslle_t* pf = pother_counts_for_value->phead; pf != NULL; pf = pf->pnext) {
+		lhmslle_t* pe = lhmsll_get_entry(pcounts_for_value, pf->key);
+		if (pe == NULL) {
+			lhmsll_put(pcounts_for_value, mlr_strdup_or_die(pf->key), pf->value, FREE_ENTRY_KEY);
+		} else {
+			pe->value += pf->value;
+		}
+	}
+}
+
+// The number of distinct values, then value-count pairs.
+static void stats1_dump_counts_for_value(lhmsll_t* pcounts_for_value, string_builder_t* psb) {
+	acc_state_put_int(psb, pcounts_for_value->num_occupied);
+	for (lhmslle_t* pe = pcounts_for_value->phead; pe != NULL; pe = pe->pnext) {
+		acc_state_put_string(psb, pe->key);
+		acc_state_put_int(psb, pe->value);
+	}
+}
+
+static int stats1_merge_dump_counts_for_value(lhmsll_t* pcounts_for_value, char* dump) {
+	unsigned long long n;
+	if (!acc_state_get_count(&dump, &n))
+		return FALSE;
+	for (unsigned long long i = 0; i < n; i++) {
+		char* value;
+		long long count;
+		if (!acc_state_get_string(&dump, &value) || !acc_state_get_int(&dump, &count))
+			return FALSE;
+		lhmslle_t* pe = lhmsll_get_entry(pcounts_for_value, value);
+		if (pe == NULL) {
+			lhmsll_put(pcounts_for_value, mlr_strdup_or_die(value), count, FREE_ENTRY_KEY);
+		} else {
+			pe->value += count;
+		}
+	}
+	return acc_state_at_end(&dump);
+}
+
 // ----------------------------------------------------------------
 typedef struct _stats1_count_state_t {
 	mv_t counter;
@@ -107,6 +156,23 @@ static void stats1_count_emit(void* pvstate, char* value_field_name, char* stats
 		lrec_put(poutrec, pstate->output_field_name, mv_alloc_format_val(&pstate->counter),
 			FREE_ENTRY_VALUE);
 }
+static void stats1_count_merge(void* pvstate, void* pvother_state) {
+	stats1_count_state_t* pstate = pvstate;
+	stats1_count_state_t* pother = pvother_state;
+	pstate->counter = x_xx_plus_func(&pstate->counter, &pother->counter);
+}
+static void stats1_count_dump(void* pvstate, string_builder_t* psb) {
+	stats1_count_state_t* pstate = pvstate;
+	acc_state_put_mv(psb, &pstate->counter);
+}
+static int stats1_count_merge_dump(void* pvstate, char* dump) {
+	stats1_count_state_t* pstate = pvstate;
+	mv_t counter;
+	if (!acc_state_get_mv(&dump, &counter) || !mv_is_numeric(&counter) || !acc_state_at_end(&dump))
+		return FALSE;
+	pstate->counter = x_xx_plus_func(&pstate->counter, &counter);
+	return TRUE;
+}
 static void stats1_count_free(stats1_acc_t* pstats1_acc) {
 	stats1_count_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -127,6 +193,9 @@ stats1_acc_t* stats1_count_alloc(char* value_field_name, char* stats1_acc_name,
 	pstats1_acc->pningest_func   = NULL;
 	pstats1_acc->psingest_func   = stats1_count_singest;
 	pstats1_acc->pemit_func      = stats1_count_emit;
+	pstats1_acc->pmerge_func     = stats1_count_merge;
+	pstats1_acc->pdump_func      = stats1_count_dump;
+	pstats1_acc->pmerge_dump_func = stats1_count_merge_dump;
 	pstats1_acc->pfree_func      = stats1_count_free;
 	return pstats1_acc;
 }
@@ -164,6 +233,19 @@ static void stats1_mode_emit(void* pvstate, char* value_field_name, char* stats1
 	else
 		lrec_put(poutrec, pstate->output_field_name, max_key, NO_FREE);
 }
+static void stats1_mode_merge(void* pvstate, void* pvother_state) {
+	stats1_mode_state_t* pstate = pvstate;
+	stats1_mode_state_t* pother = pvother_state;
+	stats1_merge_counts_for_value(pstate->pcounts_for_value, pother->pcounts_for_value);
+}
+static void stats1_mode_dump(void* pvstate, string_builder_t* psb) {
+	stats1_mode_state_t* pstate = pvstate;
+	stats1_dump_counts_for_value(pstate->pcounts_for_value, psb);
+}
+static int stats1_mode_merge_dump(void* pvstate, char* dump) {
+	stats1_mode_state_t* pstate = pvstate;
+	return stats1_merge_dump_counts_for_value(pstate->pcounts_for_value, dump);
+}
 static void stats1_mode_free(stats1_acc_t* pstats1_acc) {
 	stats1_mode_state_t* pstate = pstats1_acc->pvstate;
 	lhmsll_free(pstate->pcounts_for_value);
@@ -184,6 +266,9 @@ stats1_acc_t* stats1_mode_alloc(char* value_field_name, char* stats1_acc_name, i
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = stats1_mode_singest;
 	pstats1_acc->pemit_func     = stats1_mode_emit;
+	pstats1_acc->pmerge_func    = stats1_mode_merge;
+	pstats1_acc->pdump_func     = stats1_mode_dump;
+	pstats1_acc->pmerge_dump_func = stats1_mode_merge_dump;
 	pstats1_acc->pfree_func     = stats1_mode_free;
 	return pstats1_acc;
 }
@@ -223,6 +308,19 @@ static void stats1_antimode_emit(void* pvstate, char* value_field_name, char* st
 	else
 		lrec_put(poutrec, pstate->output_field_name, min_key, NO_FREE);
 }
+static void stats1_antimode_merge(void* pvstate, void* pvother_state) {
+	stats1_antimode_state_t* pstate = pvstate;
+	stats1_antimode_state_t* pother = pvother_state;
+	stats1_merge_counts_for_value(pstate->pcounts_for_value, pother->pcounts_for_value);
+}
+static void stats1_antimode_dump(void* pvstate, string_builder_t* psb) {
+	stats1_antimode_state_t* pstate = pvstate;
+	stats1_dump_counts_for_value(pstate->pcounts_for_value, psb);
+}
+static int stats1_antimode_merge_dump(void* pvstate, char* dump) {
+	stats1_antimode_state_t* pstate = pvstate;
+	return stats1_merge_dump_counts_for_value(pstate->pcounts_for_value, dump);
+}
 static void stats1_antimode_free(stats1_acc_t* pstats1_acc) {
 	stats1_antimode_state_t* pstate = pstats1_acc->pvstate;
 	lhmsll_free(pstate->pcounts_for_value);
@@ -243,6 +341,9 @@ stats1_acc_t* stats1_antimode_alloc(char* value_field_name, char* stats1_acc_nam
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = stats1_antimode_singest;
 	pstats1_acc->pemit_func     = stats1_antimode_emit;
+	pstats1_acc->pmerge_func    = stats1_antimode_merge;
+	pstats1_acc->pdump_func     = stats1_antimode_dump;
+	pstats1_acc->pmerge_dump_func = stats1_antimode_merge_dump;
 	pstats1_acc->pfree_func     = stats1_antimode_free;
 	return pstats1_acc;
 }
@@ -266,6 +367,23 @@ static void stats1_sum_emit(void* pvstate, char* value_field_name, char* stats1_
 		lrec_put(poutrec, pstate->output_field_name, mv_alloc_format_val(&pstate->sum),
 			FREE_ENTRY_VALUE);
 }
+static void stats1_sum_merge(void* pvstate, void* pvother_state) {
+	stats1_sum_state_t* pstate = pvstate;
+	stats1_sum_state_t* pother = pvother_state;
+	pstate->sum = x_xx_plus_func(&pstate->sum, &pother->sum);
+}
+static void stats1_sum_dump(void* pvstate, string_builder_t* psb) {
+	stats1_sum_state_t* pstate = pvstate;
+	acc_state_put_mv(psb, &pstate->sum);
+}
+static int stats1_sum_merge_dump(void* pvstate, char* dump) {
+	stats1_sum_state_t* pstate = pvstate;
+	mv_t sum;
+	if (!acc_state_get_mv(&dump, &sum) || !mv_is_numeric(&sum) || !acc_state_at_end(&dump))
+		return FALSE;
+	pstate->sum = x_xx_plus_func(&pstate->sum, &sum);
+	return TRUE;
+}
 static void stats1_sum_free(stats1_acc_t* pstats1_acc) {
 	stats1_sum_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -286,6 +404,9 @@ stats1_acc_t* stats1_sum_alloc(char* value_field_name, char* stats1_acc_name, in
 	pstats1_acc->pningest_func = stats1_sum_ningest;
 	pstats1_acc->psingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_sum_emit;
+	pstats1_acc->pmerge_func   = stats1_sum_merge;
+	pstats1_acc->pdump_func    = stats1_sum_dump;
+	pstats1_acc->pmerge_dump_func = stats1_sum_merge_dump;
 	pstats1_acc->pfree_func    = stats1_sum_free;
 	return pstats1_acc;
 }
@@ -317,6 +438,27 @@ static void stats1_mean_emit(void* pvstate, char* value_field_name, char* stats1
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_mean_merge(void* pvstate, void* pvother_state) {
+	stats1_mean_state_t* pstate = pvstate;
+	stats1_mean_state_t* pother = pvother_state;
+	pstate->sum   += pother->sum;
+	pstate->count += pother->count;
+}
+static void stats1_mean_dump(void* pvstate, string_builder_t* psb) {
+	stats1_mean_state_t* pstate = pvstate;
+	acc_state_put_float(psb, pstate->sum);
+	acc_state_put_int(psb, pstate->count);
+}
+static int stats1_mean_merge_dump(void* pvstate, char* dump) {
+	stats1_mean_state_t* pstate = pvstate;
+	double sum;
+	unsigned long long count;
+	if (!acc_state_get_float(&dump, &sum) || !acc_state_get_count(&dump, &count) || !acc_state_at_end(&dump))
+		return FALSE;
+	pstate->sum   += sum;
+	pstate->count += count;
+	return TRUE;
+}
 static void stats1_mean_free(stats1_acc_t* pstats1_acc) {
 	stats1_mean_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -337,6 +479,9 @@ stats1_acc_t* stats1_mean_alloc(char* value_field_name, char* stats1_acc_name, i
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = NULL;
 	pstats1_acc->pemit_func     = stats1_mean_emit;
+	pstats1_acc->pmerge_func    = stats1_mean_merge;
+	pstats1_acc->pdump_func     = stats1_mean_dump;
+	pstats1_acc->pmerge_dump_func = stats1_mean_merge_dump;
 	pstats1_acc->pfree_func     = stats1_mean_free;
 	return pstats1_acc;
 }
@@ -376,6 +521,33 @@ static void stats1_stddev_var_meaneb_emit(void* pvstate, char* value_field_name,
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_stddev_var_meaneb_merge(void* pvstate, void* pvother_state) {
+	stats1_stddev_var_meaneb_state_t* pstate = pvstate;
+	stats1_stddev_var_meaneb_state_t* pother = pvother_state;
+	pstate->count += pother->count;
+	pstate->sumx  += pother->sumx;
+	pstate->sumx2 += pother->sumx2;
+}
+static void stats1_stddev_var_meaneb_dump(void* pvstate, string_builder_t* psb) {
+	stats1_stddev_var_meaneb_state_t* pstate = pvstate;
+	acc_state_put_int(psb, pstate->count);
+	acc_state_put_float(psb, pstate->sumx);
+	acc_state_put_float(psb, pstate->sumx2);
+}
+static int stats1_stddev_var_meaneb_merge_dump(void* pvstate, char* dump) {
+	stats1_stddev_var_meaneb_state_t* pstate = pvstate;
+	unsigned long long count;
+	double sumx, sumx2;
+	if (!acc_state_get_count(&dump, &count) ||
+		!acc_state_get_float(&dump, &sumx) ||
+		!acc_state_get_float(&dump, &sumx2) ||
+		!acc_state_at_end(&dump))
+		return FALSE;
+	pstate->count += count;
+	pstate->sumx  += sumx;
+	pstate->sumx2 += sumx2;
+	return TRUE;
+}
 static void stats1_stddev_var_meaneb_free(stats1_acc_t* pstats1_acc) {
 	stats1_stddev_var_meaneb_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -397,6 +569,9 @@ stats1_acc_t* stats1_stddev_var_meaneb_alloc(char* value_field_name, char* stats
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_stddev_var_meaneb_emit;
+	pstats1_acc->pmerge_func   = stats1_stddev_var_meaneb_merge;
+	pstats1_acc->pdump_func    = stats1_stddev_var_meaneb_dump;
+	pstats1_acc->pmerge_dump_func = stats1_stddev_var_meaneb_merge_dump;
 	pstats1_acc->pfree_func    = stats1_stddev_var_meaneb_free;
 	return pstats1_acc;
 }
@@ -448,6 +623,37 @@ static void stats1_skewness_emit(void* pvstate, char* value_field_name, char* st
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_skewness_merge(void* pvstate, void* pvother_state) {
+	stats1_skewness_state_t* pstate = pvstate;
+	stats1_skewness_state_t* pother = pvother_state;
+	pstate->count += pother->count;
+	pstate->sumx  += pother->sumx;
+	pstate->sumx2 += pother->sumx2;
+	pstate->sumx3 += pother->sumx3;
+}
+static void stats1_skewness_dump(void* pvstate, string_builder_t* psb) {
+	stats1_skewness_state_t* pstate = pvstate;
+	acc_state_put_int(psb, pstate->count);
+	acc_state_put_float(psb, pstate->sumx);
+	acc_state_put_float(psb, pstate->sumx2);
+	acc_state_put_float(psb, pstate->sumx3);
+}
+static int stats1_skewness_merge_dump(void* pvstate, char* dump) {
+	stats1_skewness_state_t* pstate = pvstate;
+	unsigned long long count;
+	double sumx, sumx2, sumx3;
+	if (!acc_state_get_count(&dump, &count) ||
+		!acc_state_get_float(&dump, &sumx) ||
+		!acc_state_get_float(&dump, &sumx2) ||
+		!acc_state_get_float(&dump, &sumx3) ||
+		!acc_state_at_end(&dump))
+		return FALSE;
+	pstate->count += count;
+	pstate->sumx  += sumx;
+	pstate->sumx2 += sumx2;
+	pstate->sumx3 += sumx3;
+	return TRUE;
+}
 static void stats1_skewness_free(stats1_acc_t* pstats1_acc) {
 	stats1_skewness_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -471,6 +677,9 @@ stats1_acc_t* stats1_skewness_alloc(char* value_field_name, char* stats1_acc_nam
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_skewness_emit;
+	pstats1_acc->pmerge_func   = stats1_skewness_merge;
+	pstats1_acc->pdump_func    = stats1_skewness_dump;
+	pstats1_acc->pmerge_dump_func = stats1_skewness_merge_dump;
 	pstats1_acc->pfree_func    = stats1_skewness_free;
 	return pstats1_acc;
 }
@@ -509,6 +718,41 @@ static void stats1_kurtosis_emit(void* pvstate, char* value_field_name, char* st
 			lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
 	}
 }
+static void stats1_kurtosis_merge(void* pvstate, void* pvother_state) {
+	stats1_kurtosis_state_t* pstate = pvstate;
+	stats1_kurtosis_state_t* pother = pvother_state;
+	pstate->count += pother->count;
+	pstate->sumx  += pother->sumx;
+	pstate->sumx2 += pother->sumx2;
+	pstate->sumx3 += pother->sumx3;
+	pstate->sumx4 += pother->sumx4;
+}
+static void stats1_kurtosis_dump(void* pvstate, string_builder_t* psb) {
+	stats1_kurtosis_state_t* pstate = pvstate;
+	acc_state_put_int(psb, pstate->count);
+	acc_state_put_float(psb, pstate->sumx);
+	acc_state_put_float(psb, pstate->sumx2);
+	acc_state_put_float(psb, pstate->sumx3);
+	acc_state_put_float(psb, pstate->sumx4);
+}
+static int stats1_kurtosis_merge_dump(void* pvstate, char* dump) {
+	stats1_kurtosis_state_t* pstate = pvstate;
+	unsigned long long count;
+	double sumx, sumx2, sumx3, sumx4;
+	if (!acc_state_get_count(&dump, &count) ||
+		!acc_state_get_float(&dump, &sumx) ||
+		!acc_state_get_float(&dump, &sumx2) ||
+		!acc_state_get_float(&dump, &sumx3) ||
+		!acc_state_get_float(&dump, &sumx4) ||
+		!acc_state_at_end(&dump))
+		return FALSE;
+	pstate->count += count;
+	pstate->sumx  += sumx;
+	pstate->sumx2 += sumx2;
+	pstate->sumx3 += sumx3;
+	pstate->sumx4 += sumx4;
+	return TRUE;
+}
 static void stats1_kurtosis_free(stats1_acc_t* pstats1_acc) {
 	stats1_kurtosis_state_t* pstate = pstats1_acc->pvstate;
 	free(pstate->output_field_name);
@@ -524,6 +768,7 @@ stats1_acc_t* stats1_kurtosis_alloc(char* value_field_name, char* stats1_acc_nam
 	pstate->sumx               = 0.0;
 	pstate->sumx2              = 0.0;
 	pstate->sumx3              = 0.0;
+	pstate->sumx4              = 0.0;
 	pstate->output_field_name  = mlr_paste_3_strings(value_field_name, "_", stats1_acc_name);
 
 	pstats1_acc->pvstate       = (void*)pstate;
@@ -531,6 +776,9 @@ stats1_acc_t* stats1_kurtosis_alloc(char* value_field_name, char* stats1_acc_nam
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = NULL;
 	pstats1_acc->pemit_func    = stats1_kurtosis_emit;
+	pstats1_acc->pmerge_func   = stats1_kurtosis_merge;
+	pstats1_acc->pdump_func    = stats1_kurtosis_dump;
+	pstats1_acc->pmerge_dump_func = stats1_kurtosis_merge_dump;
 	pstats1_acc->pfree_func    = stats1_kurtosis_free;
 	return pstats1_acc;
 }
@@ -561,6 +809,26 @@ static void stats1_min_emit(void* pvstate, char* value_field_name, char* stats1_
 				FREE_ENTRY_VALUE);
 	}
 }
+// The min function frees whichever argument it doesn't return, so the other
+// accumulator mustn't free its value again.
+static void stats1_min_merge(void* pvstate, void* pvother_state) {
+	stats1_min_state_t* pstate = pvstate;
+	stats1_min_state_t* pother = pvother_state;
+	pstate->min = x_xx_min_func(&pstate->min, &pother->min);
+	pother->min = mv_absent();
+}
+static void stats1_min_dump(void* pvstate, string_builder_t* psb) {
+	stats1_min_state_t* pstate = pvstate;
+	acc_state_put_mv(psb, &pstate->min);
+}
+static int stats1_min_merge_dump(void* pvstate, char* dump) {
+	stats1_min_state_t* pstate = pvstate;
+	mv_t min;
+	if (!acc_state_get_mv(&dump, &min) || !acc_state_at_end(&dump))
+		return FALSE;
+	pstate->min = x_xx_min_func(&pstate->min, &min);
+	return TRUE;
+}
 static void stats1_min_free(stats1_acc_t* pstats1_acc) {
 	stats1_min_state_t* pstate = pstats1_acc->pvstate;
 	mv_free(&pstate->min);
@@ -581,6 +849,9 @@ stats1_acc_t* stats1_min_alloc(char* value_field_name, char* stats1_acc_name, in
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = stats1_min_singest;
 	pstats1_acc->pemit_func    = stats1_min_emit;
+	pstats1_acc->pmerge_func   = stats1_min_merge;
+	pstats1_acc->pdump_func    = stats1_min_dump;
+	pstats1_acc->pmerge_dump_func = stats1_min_merge_dump;
 	pstats1_acc->pfree_func    = stats1_min_free;
 	return pstats1_acc;
 }
@@ -611,6 +882,26 @@ static void stats1_max_emit(void* pvstate, char* value_field_name, char* stats1_
 				FREE_ENTRY_VALUE);
 	}
 }
+// The max function frees whichever argument it doesn't return, so the other
+// accumulator mustn't free its value again.
+static void stats1_max_merge(void* pvstate, void* pvother_state) {
+	stats1_max_state_t* pstate = pvstate;
+	stats1_max_state_t* pother = pvother_state;
+	pstate->max = x_xx_max_func(&pstate->max, &pother->max);
+	pother->max = mv_absent();
+}
+static void stats1_max_dump(void* pvstate, string_builder_t* psb) {
+	stats1_max_state_t* pstate = pvstate;
+	acc_state_put_mv(psb, &pstate->max);
+}
+static int stats1_max_merge_dump(void* pvstate, char* dump) {
+	stats1_max_state_t* pstate = pvstate;
+	mv_t max;
+	if (!acc_state_get_mv(&dump, &max) || !acc_state_at_end(&dump))
+		return FALSE;
+	pstate->max = x_xx_max_func(&pstate->max, &max);
+	return TRUE;
+}
 static void stats1_max_free(stats1_acc_t* pstats1_acc) {
 	stats1_max_state_t* pstate = pstats1_acc->pvstate;
 	mv_free(&pstate->max);
@@ -631,22 +922,36 @@ stats1_acc_t* stats1_max_alloc(char* value_field_name, char* stats1_acc_name, in
 	pstats1_acc->pningest_func = NULL;
 	pstats1_acc->psingest_func = stats1_max_singest;
 	pstats1_acc->pemit_func    = stats1_max_emit;
+	pstats1_acc->pmerge_func   = stats1_max_merge;
+	pstats1_acc->pdump_func    = stats1_max_dump;
+	pstats1_acc->pmerge_dump_func = stats1_max_merge_dump;
 	pstats1_acc->pfree_func    = stats1_max_free;
 	return pstats1_acc;
 }
 
 // ----------------------------------------------------------------
+// With --approx, a percentile_sketch is used in place of the percentile_keeper.
 typedef struct _stats1_percentile_state_t {
 	percentile_keeper_t* ppercentile_keeper;
+	percentile_sketch_t* ppercentile_sketch;
 	lhmss_t* poutput_field_names;
 	int reference_count;
 	percentile_keeper_emitter_t* ppercentile_keeper_emitter;
+	percentile_sketch_emitter_t* ppercentile_sketch_emitter;
 } stats1_percentile_state_t;
 static void stats1_percentile_singest(void* pvstate, char* sval) {
 	stats1_percentile_state_t* pstate = pvstate;
 	mv_t val = mv_copy_type_infer_string_or_float_or_int(sval);
 	percentile_keeper_ingest(pstate->ppercentile_keeper, val);
 }
+static void stats1_percentile_sketch_singest(void* pvstate, char* sval) {
+	stats1_percentile_state_t* pstate = pvstate;
+	mv_t val = mv_scan_number_or_die(sval);
+	if (val.type == MT_INT)
+		percentile_sketch_ingest(pstate->ppercentile_sketch, (double)val.u.intv, TRUE);
+	else
+		percentile_sketch_ingest(pstate->ppercentile_sketch, val.u.fltv, FALSE);
+}
 
 static void stats1_percentile_emit(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec) {
 	stats1_percentile_state_t* pstate = pvstate;
@@ -658,7 +963,9 @@ static void stats1_percentile_emit(void* pvstate, char* value_field_name, char*
 		// TODO: do the sscanf once at alloc time and store the double in the state struct for a minor perf gain.
 		(void)sscanf(stats1_acc_name, "p%lf", &p); // Assuming this was range-checked earlier on to be in [0,100].
 	}
-	mv_t v = pstate->ppercentile_keeper_emitter(pstate->ppercentile_keeper, p);
+	mv_t v = (pstate->ppercentile_sketch != NULL)
+		? pstate->ppercentile_sketch_emitter(pstate->ppercentile_sketch, p)
+		: pstate->ppercentile_keeper_emitter(pstate->ppercentile_keeper, p);
 	char* s = mv_alloc_format_val(&v);
 	// For this type, one accumulator tracks many stats1_names, but a single value_field_name.
 	char* output_field_name = lhmss_get(pstate->poutput_field_names, stats1_acc_name);
@@ -670,34 +977,149 @@ static void stats1_percentile_emit(void* pvstate, char* value_field_name, char*
 	lrec_put(poutrec, mlr_strdup_or_die(output_field_name), s, FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
 }
 
+static void stats1_percentile_merge(void* pvstate, void* pvother_state) {
+	stats1_percentile_state_t* pstate = pvstate;
+	stats1_percentile_state_t* pother = pvother_state;
+	percentile_keeper_merge(pstate->ppercentile_keeper, pother->ppercentile_keeper);
+}
+// The number of values, then the values.
+static void stats1_percentile_dump(void* pvstate, string_builder_t* psb) {
+	stats1_percentile_state_t* pstate = pvstate;
+	percentile_keeper_t* ppercentile_keeper = pstate->ppercentile_keeper;
+	acc_state_put_int(psb, ppercentile_keeper->size);
+	for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
+		mv_t val = percentile_keeper_get(ppercentile_keeper, i);
+		acc_state_put_mv(psb, &val);
+	}
+}
+static int stats1_percentile_merge_dump(void* pvstate, char* dump) {
+	stats1_percentile_state_t* pstate = pvstate;
+	unsigned long long n;
+	if (!acc_state_get_count(&dump, &n))
+		return FALSE;
+	for (unsigned long long i = 0; i < n; i++) {
+		mv_t val;
+		if (!acc_state_get_mv(&dump, &val) || val.type == MT_ABSENT)
+			return FALSE;
+		percentile_keeper_ingest(pstate->ppercentile_keeper, val);
+	}
+	return acc_state_at_end(&dump);
+}
+static void stats1_percentile_sketch_merge(void* pvstate, void* pvother_state) {
+	stats1_percentile_state_t* pstate = pvstate;
+	stats1_percentile_state_t* pother = pvother_state;
+	percentile_sketch_merge(pstate->ppercentile_sketch, pother->ppercentile_sketch);
+}
+// A marker, so that exact and approximate states aren't mixed up; then k, the
+// count, the all-ints flag, the min and max; then the number of levels, and for
+// each level its number of values followed by the values.
+static void stats1_percentile_sketch_dump(void* pvstate, string_builder_t* psb) {
+	stats1_percentile_state_t* pstate = pvstate;
+	percentile_sketch_t* psketch = pstate->ppercentile_sketch;
+	acc_state_put_string(psb, "sketch");
+	acc_state_put_int(psb, psketch->k);
+	acc_state_put_int(psb, psketch->n);
+	acc_state_put_int(psb, psketch->all_ints);
+	acc_state_put_float(psb, psketch->min);
+	acc_state_put_float(psb, psketch->max);
+	acc_state_put_int(psb, psketch->num_levels);
+	for (int h = 0; h < psketch->num_levels; h++) {
+		acc_state_put_int(psb, psketch->levels[h].size);
+		for (int i = 0; i < psketch->levels[h].size; i++)
+			acc_state_put_float(psb, psketch->levels[h].values[i]);
+	}
+}
+static int stats1_percentile_sketch_merge_dump(void* pvstate, char* dump) {
+	stats1_percentile_state_t* pstate = pvstate;
+	char* marker;
+	long long k, all_ints;
+	unsigned long long n, num_levels;
+	double min, max;
+	if (!acc_state_get_string(&dump, &marker) || !streq(marker, "sketch"))
+		return FALSE;
+	if (!acc_state_get_int(&dump, &k) || !acc_state_get_count(&dump, &n) || !acc_state_get_int(&dump, &all_ints))
+		return FALSE;
+	if (!acc_state_get_float(&dump, &min) || !acc_state_get_float(&dump, &max))
+		return FALSE;
+	if (!acc_state_get_count(&dump, &num_levels) || num_levels > 64)
+		return FALSE;
+	if (k < PERCENTILE_SKETCH_MIN_K)
+		return FALSE;
+
+	percentile_sketch_t* pother = percentile_sketch_alloc(k);
+	int ok = TRUE;
+	for (int h = 0; ok && h < num_levels; h++) {
+		unsigned long long size;
+		if (!acc_state_get_count(&dump, &size)) {
+			ok = FALSE;
+			break;
+		}
+		for (unsigned long long i = 0; i < size; i++) {
+			double value;
+			if (!acc_state_get_float(&dump, &value)) {
+				ok = FALSE;
+				break;
+			}
+			percentile_sketch_restore(pother, h, value);
+		}
+	}
+	if (ok && acc_state_at_end(&dump) && pother->n == n) {
+		pother->all_ints = all_ints;
+		pother->min = min;
+		pother->max = max;
+		percentile_sketch_merge(pstate->ppercentile_sketch, pother);
+	} else {
+		ok = FALSE;
+	}
+	percentile_sketch_free(pother);
+	return ok;
+}
 static void stats1_percentile_free(stats1_acc_t* pstats1_acc) {
 	stats1_percentile_state_t* pstate = pstats1_acc->pvstate;
 	pstate->reference_count--;
 	if (pstate->reference_count == 0) {
 		percentile_keeper_free(pstate->ppercentile_keeper);
+		percentile_sketch_free(pstate->ppercentile_sketch);
 		lhmss_free(pstate->poutput_field_names);
 		free(pstate);
 		free(pstats1_acc);
 	}
 }
 stats1_acc_t* stats1_percentile_alloc(char* value_field_name, char* stats1_acc_name, int allow_int_float,
-	int do_interpolated_percentiles)
+	int do_interpolated_percentiles, int percentile_sketch_k)
 {
 	stats1_acc_t* pstats1_acc   = mlr_malloc_or_die(sizeof(stats1_acc_t));
 	stats1_percentile_state_t* pstate = mlr_malloc_or_die(sizeof(stats1_percentile_state_t));
-	pstate->ppercentile_keeper  = percentile_keeper_alloc();
+	pstate->ppercentile_keeper  = NULL;
+	pstate->ppercentile_sketch  = NULL;
 	pstate->poutput_field_names = lhmss_alloc();
 	pstate->reference_count     = 1;
 	pstate->ppercentile_keeper_emitter = (do_interpolated_percentiles)
 		? percentile_keeper_emit_linearly_interpolated
 		: percentile_keeper_emit_non_interpolated;
+	pstate->ppercentile_sketch_emitter = (do_interpolated_percentiles)
+		? percentile_sketch_emit_linearly_interpolated
+		: percentile_sketch_emit_non_interpolated;
 
 	pstats1_acc->pvstate        = (void*)pstate;
 	pstats1_acc->pdingest_func  = NULL;
 	pstats1_acc->pningest_func  = NULL;
 	pstats1_acc->psingest_func  = stats1_percentile_singest;
 	pstats1_acc->pemit_func     = stats1_percentile_emit;
+	pstats1_acc->pmerge_func    = stats1_percentile_merge;
+	pstats1_acc->pdump_func     = stats1_percentile_dump;
+	pstats1_acc->pmerge_dump_func = stats1_percentile_merge_dump;
 	pstats1_acc->pfree_func     = stats1_percentile_free;
+
+	if (percentile_sketch_k > 0) {
+		pstate->ppercentile_sketch        = percentile_sketch_alloc(percentile_sketch_k);
+		pstats1_acc->psingest_func        = stats1_percentile_sketch_singest;
+		pstats1_acc->pmerge_func          = stats1_percentile_sketch_merge;
+		pstats1_acc->pdump_func           = stats1_percentile_sketch_dump;
+		pstats1_acc->pmerge_dump_func     = stats1_percentile_sketch_merge_dump;
+	} else {
+		pstate->ppercentile_keeper        = percentile_keeper_alloc();
+	}
 	return pstats1_acc;
 }
 void stats1_percentile_reuse(stats1_acc_t* pstats1_acc) {
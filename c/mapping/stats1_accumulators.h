@@ -4,6 +4,7 @@
 #include "containers/lrec.h"
 #include "containers/slls.h"
 #include "containers/lhmsv.h"
+#include "lib/string_builder.h"
 
 // ----------------------------------------------------------------
 // These are used by mlr stats1 as well as mlr merge-fields.
@@ -31,14 +32,30 @@ typedef void stats1_singest_func_t(void* pvstate, char*  val);
 // after the accumulator is freed.
 typedef void stats1_emit_func_t(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec);
 typedef void stats1_free_func_t(struct _stats1_acc_t* pstats1_acc);
+// Folds another accumulator of the same type into this one, leaving this one as
+// if it had also ingested, after its own data, everything the other one did.
+// This is for combining partial aggregates, e.g. from stats1 -j. The other
+// accumulator's data may be moved rather than copied; it must still be freed
+// but is otherwise no longer usable.
+typedef void stats1_merge_func_t(void* pvstate, void* pvother_state);
+// For stats1 --dump-state: appends the accumulator's state, encoded as described
+// in acc_state.h, to the string builder.
+typedef void stats1_dump_func_t(void* pvstate, string_builder_t* psb);
+// For stats1 --merge-state: folds in a state dumped by an accumulator of the same
+// type, just as the merge function would. The dump is modified in place. Returns
+// FALSE if it can't be parsed.
+typedef int stats1_merge_dump_func_t(void* pvstate, char* dump);
 
 typedef struct _stats1_acc_t {
 	void* pvstate;
-	stats1_dingest_func_t* pdingest_func;
-	stats1_ningest_func_t* pningest_func;
-	stats1_singest_func_t* psingest_func;
-	stats1_emit_func_t*    pemit_func;
-	stats1_free_func_t*    pfree_func; // virtual destructor
+	stats1_dingest_func_t*    pdingest_func;
+	stats1_ningest_func_t*    pningest_func;
+	stats1_singest_func_t*    psingest_func;
+	stats1_emit_func_t*       pemit_func;
+	stats1_merge_func_t*      pmerge_func;
+	stats1_dump_func_t*       pdump_func;
+	stats1_merge_dump_func_t* pmerge_dump_func;
+	stats1_free_func_t*       pfree_func; // virtual destructor
 } stats1_acc_t;
 
 typedef stats1_acc_t* stats1_alloc_func_t(char* value_field_name, char* stats1_acc_name, int allow_int_float,
@@ -59,7 +76,9 @@ stats1_acc_t* stats1_skewness_alloc          (char* value_field_name, char* stat
 stats1_acc_t* stats1_kurtosis_alloc          (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_min_alloc               (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_max_alloc               (char* value_field_name, char* stats1_acc_name, int aif, int dip);
-stats1_acc_t* stats1_percentile_alloc        (char* value_field_name, char* stats1_acc_name, int aif, int dip);
+// With positive percentile_sketch_k, uses an approximate percentile_sketch with that k.
+stats1_acc_t* stats1_percentile_alloc        (char* value_field_name, char* stats1_acc_name, int aif, int dip,
+	int percentile_sketch_k);
 void          stats1_percentile_reuse        (stats1_acc_t* pstats1_acc);
 
 
@@ -72,6 +91,7 @@ void make_stats1_accs(
 	slls_t*  paccumulator_names,
 	int      allow_int_float,
 	int      do_interpolated_percentiles,
+	int      percentile_sketch_k,
 	lhmsv_t* acc_field_to_acc_state_in,
 	lhmsv_t* acc_field_to_acc_state_out);
 
@@ -83,6 +103,10 @@ stats1_acc_t* make_stats1_acc(
 
 int is_percentile_acc_name(char* stats1_acc_name);
 
+// Dumped states are keyed by value-field name and this: the accumulator name,
+// except that all percentiles share one state named "percentiles".
+char* stats1_acc_state_name(char* stats1_acc_name);
+
 // ----------------------------------------------------------------
 // Lookups for all but percentiles, which are a special case.
 typedef struct _stats1_acc_lookup_t {
@@ -11,6 +11,7 @@
 #include "input/lrec_readers.h"
 #include "mapping/mappers.h"
 #include "output/lrec_writers.h"
+#include "output/output_handle_pool.h"
 #include "stream/stream.h"
 
 int main(int argc, char** argv) {
@@ -34,5 +35,7 @@ int main(int argc, char** argv) {
 	mapper_chain_free(pmapper_list, &ctx);
 	cli_opts_free(popts);
 
+	output_handle_pool_print_stats(stderr);
+
 	return ok ? 0 : 1;
 }
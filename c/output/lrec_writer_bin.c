@@ -0,0 +1,159 @@
+// ================================================================
+// Writer for Miller's binary record format; see lib/bin_format.h.
+//
+// Values are appended to per-column buffers as records arrive, and the records
+// freed. A batch is written out when a record with other field names arrives,
+// when it's full, and at end of stream. So unlike the text writers, output
+// comes a batch at a time rather than a record at a time.
+// ================================================================
+
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "lib/bin_format.h"
+#include "containers/mixutil.h"
+#include "output/lrec_writers.h"
+#include "output/output_buffer.h"
+
+typedef struct _lrec_writer_bin_state_t {
+	int               wrote_stream_header;
+	slls_t*           pkeys;       // Field names of the current batch; NULL if it's empty
+	int               num_records; // In the current batch
+	size_t            body_length; // Of the current batch, so far
+	output_buffer_t*  pob;         // For the stream and batch headers, and the field names
+	output_buffer_t** pcolumns;    // Values of the current batch
+	int               num_columns_allocated;
+	FILE*             output_stream; // The last one written to
+} lrec_writer_bin_state_t;
+
+static void lrec_writer_bin_free(lrec_writer_t* pwriter, context_t* pctx);
+static void lrec_writer_bin_process(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx);
+static void flush_batch(lrec_writer_bin_state_t* pstate, FILE* output_stream);
+static void start_batch(lrec_writer_bin_state_t* pstate, lrec_t* prec);
+static void append_length(output_buffer_t* pob, size_t length, uint32_t flags);
+
+// ----------------------------------------------------------------
+lrec_writer_t* lrec_writer_bin_alloc() {
+	lrec_writer_t* plrec_writer = mlr_malloc_or_die(sizeof(lrec_writer_t));
+
+	lrec_writer_bin_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_writer_bin_state_t));
+	pstate->wrote_stream_header   = FALSE;
+	pstate->pkeys                 = NULL;
+	pstate->num_records           = 0;
+	pstate->body_length           = 0;
+	pstate->pob                   = ob_alloc(OUTPUT_BUFFER_DEFAULT_SIZE);
+	pstate->pcolumns              = NULL;
+	pstate->num_columns_allocated = 0;
+	pstate->output_stream         = NULL;
+
+	plrec_writer->pvstate       = pstate;
+	plrec_writer->pprocess_func = lrec_writer_bin_process;
+	plrec_writer->pfree_func    = lrec_writer_bin_free;
+
+	return plrec_writer;
+}
+
+// Writers for DSL emit/tee/print to standard output are freed without an
+// end-of-stream call, so a pending batch is written out here.
+static void lrec_writer_bin_free(lrec_writer_t* pwriter, context_t* pctx) {
+	lrec_writer_bin_state_t* pstate = pwriter->pvstate;
+	if (pstate->num_records > 0 && pstate->output_stream != NULL)
+		flush_batch(pstate, pstate->output_stream);
+	slls_free(pstate->pkeys);
+	ob_free(pstate->pob);
+	for (int j = 0; j < pstate->num_columns_allocated; j++)
+		ob_free(pstate->pcolumns[j]);
+	free(pstate->pcolumns);
+	free(pstate);
+	free(pwriter);
+}
+
+// ----------------------------------------------------------------
+static void lrec_writer_bin_process(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx) {
+	lrec_writer_bin_state_t* pstate = pvstate;
+	pstate->output_stream = output_stream;
+
+	if (prec == NULL) { // End of record stream
+		flush_batch(pstate, output_stream);
+		return;
+	}
+
+	if (pstate->pkeys != NULL && !lrec_keys_equal_list(prec, pstate->pkeys))
+		flush_batch(pstate, output_stream);
+	if (pstate->pkeys == NULL)
+		start_batch(pstate, prec);
+
+	int j = 0;
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
+		output_buffer_t* pob = pstate->pcolumns[j];
+		size_t length = strlen(pe->value);
+		append_length(pob, length, (pe->quote_flags & FIELD_QUOTED_ON_INPUT) ? BIN_FORMAT_QUOTED_BIT : 0);
+		ob_append_bytes(pob, pe->value, length + 1);
+		pstate->body_length += 4 + length + 1;
+	}
+	pstate->num_records++;
+	lrec_free(prec); // end of baton-pass
+
+	if (pstate->num_records >= BIN_FORMAT_MAX_BATCH_RECORDS || pstate->body_length >= BIN_FORMAT_MAX_BATCH_BYTES)
+		flush_batch(pstate, output_stream);
+}
+
+// ----------------------------------------------------------------
+static void start_batch(lrec_writer_bin_state_t* pstate, lrec_t* prec) {
+	pstate->pkeys = mlr_copy_keys_from_record(prec);
+	int num_fields = pstate->pkeys->length;
+	if (num_fields > pstate->num_columns_allocated) {
+		pstate->pcolumns = mlr_realloc_or_die(pstate->pcolumns, num_fields * sizeof(output_buffer_t*));
+		for (int j = pstate->num_columns_allocated; j < num_fields; j++)
+			pstate->pcolumns[j] = ob_alloc(OUTPUT_BUFFER_DEFAULT_SIZE);
+		pstate->num_columns_allocated = num_fields;
+	}
+	for (sllse_t* pk = pstate->pkeys->phead; pk != NULL; pk = pk->pnext)
+		pstate->body_length += 4 + strlen(pk->value) + 1;
+}
+
+static void flush_batch(lrec_writer_bin_state_t* pstate, FILE* output_stream) {
+	if (pstate->num_records == 0)
+		return;
+	output_buffer_t* pob = pstate->pob;
+
+	if (!pstate->wrote_stream_header) {
+		char header[BIN_FORMAT_MAGIC_LENGTH + 4];
+		memcpy(header, BIN_FORMAT_MAGIC, BIN_FORMAT_MAGIC_LENGTH);
+		bin_format_put_u32(&header[BIN_FORMAT_MAGIC_LENGTH], BIN_FORMAT_VERSION);
+		ob_append_bytes(pob, header, sizeof(header));
+		pstate->wrote_stream_header = TRUE;
+	}
+
+	char header[BIN_FORMAT_BATCH_HEADER_SIZE];
+	bin_format_put_u32(&header[0], pstate->num_records);
+	bin_format_put_u32(&header[4], pstate->pkeys->length);
+	bin_format_put_u64(&header[8], pstate->body_length);
+	ob_append_bytes(pob, header, sizeof(header));
+
+	for (sllse_t* pk = pstate->pkeys->phead; pk != NULL; pk = pk->pnext) {
+		size_t length = strlen(pk->value);
+		append_length(pob, length, 0);
+		ob_append_bytes(pob, pk->value, length + 1);
+	}
+	ob_flush_to_stream(pob, output_stream);
+
+	for (int j = 0; j < pstate->pkeys->length; j++)
+		ob_flush_to_stream(pstate->pcolumns[j], output_stream);
+
+	slls_free(pstate->pkeys);
+	pstate->pkeys = NULL;
+	pstate->num_records = 0;
+	pstate->body_length = 0;
+}
+
+static void append_length(output_buffer_t* pob, size_t length, uint32_t flags) {
+	if (length > BIN_FORMAT_MAX_LENGTH) {
+		fprintf(stderr, "%s: field of length %llu is too long for binary output.\n",
+			MLR_GLOBALS.bargv0, (unsigned long long)length);
+		exit(1);
+	}
+	char buf[4];
+	bin_format_put_u32(buf, length | flags);
+	ob_append_bytes(pob, buf, 4);
+}
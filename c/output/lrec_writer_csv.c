@@ -4,15 +4,18 @@
 #include "lib/mlr_globals.h"
 #include "containers/mixutil.h"
 #include "output/lrec_writers.h"
-
-typedef void       quoted_output_func_t(FILE* fp,char*s,char*ors,char*ofs, int orslen,int ofslen, char quote_flags);
-static  void      quote_all_output_func(FILE* fp,char*s,char*ors,char*ofs, int orslen,int ofslen, char quote_flags);
-static  void     quote_none_output_func(FILE* fp,char*s,char*ors,char*ofs, int orslen,int ofslen, char quote_flags);
-static  void  quote_minimal_output_func(FILE* fp,char*s,char*ors,char*ofs, int orslen,int ofslen, char quote_flags);
-static  void  quote_minimal_auto_output_func(FILE* fp,char*s,char*ors,char*ofs, int orslen,int ofslen, char qf);
-static  void  quote_numeric_output_func(FILE* fp,char*s,char*ors,char*ofs, int orslen,int ofslen, char quote_flags);
-static  void quote_original_output_func(FILE* fp,char*s,char*ors,char*ofs, int orslen,int ofslen, char quote_flags);
-static void quote_string(FILE* fp, char* string);
+#include "output/output_buffer.h"
+
+struct _lrec_writer_csv_state_t;
+typedef void quoted_output_func_t(output_buffer_t* pob, char* s, struct _lrec_writer_csv_state_t* pstate,
+	char quote_flags);
+static quoted_output_func_t quote_all_output_func;
+static quoted_output_func_t quote_none_output_func;
+static quoted_output_func_t quote_minimal_output_func;
+static quoted_output_func_t quote_numeric_output_func;
+static quoted_output_func_t quote_original_output_func;
+static void quote_string(output_buffer_t* pob, char* string);
+static void quote_string_from(output_buffer_t* pob, char* string, char* p);
 
 typedef struct _lrec_writer_csv_state_t {
 	int   onr;
@@ -24,6 +27,14 @@ typedef struct _lrec_writer_csv_state_t {
 	long long num_header_lines_output;
 	slls_t* plast_header_output;
 	int headerless_csv_output;
+	output_buffer_t* pob;
+
+	// For minimal quoting: the line terminator to check field contents against
+	// (with --ors auto, a field containing LF needs quoting whether the output
+	// is LF or CRLF), and which bytes can start something needing quotes.
+	char* quote_ors;
+	int   quote_orslen;
+	char  quote_triggers[256];
 } lrec_writer_csv_state_t;
 
 // ----------------------------------------------------------------
@@ -43,6 +54,7 @@ lrec_writer_t* lrec_writer_csv_alloc(char* ors, char* ofs, quoting_t oquoting, i
 	pstate->orslen = strlen(pstate->ors);
 	pstate->ofslen = strlen(pstate->ofs);
 	pstate->headerless_csv_output = headerless_csv_output;
+	pstate->pob    = ob_alloc(OUTPUT_BUFFER_DEFAULT_SIZE);
 
 	switch(oquoting) {
 	case QUOTE_ALL:      pstate->pquoted_output_func = quote_all_output_func;      break;
@@ -54,15 +66,24 @@ lrec_writer_t* lrec_writer_csv_alloc(char* ors, char* ofs, quoting_t oquoting, i
 		MLR_INTERNAL_CODING_ERROR();
 	}
 
+	pstate->quote_ors    = streq(ors, "auto") ? "\n" : ors;
+	pstate->quote_orslen = strlen(pstate->quote_ors);
+	if (pstate->quote_orslen == 0 || pstate->ofslen == 0) {
+		// Every position matches an empty separator.
+		memset(pstate->quote_triggers, TRUE, sizeof(pstate->quote_triggers));
+	} else {
+		memset(pstate->quote_triggers, FALSE, sizeof(pstate->quote_triggers));
+		pstate->quote_triggers[(unsigned char)'"'] = TRUE;
+		pstate->quote_triggers[(unsigned char)pstate->quote_ors[0]] = TRUE;
+		pstate->quote_triggers[(unsigned char)pstate->ofs[0]] = TRUE;
+	}
+
 	pstate->num_header_lines_output = 0LL;
 	pstate->plast_header_output     = NULL;
 
 	plrec_writer->pvstate = (void*)pstate;
 	if (streq(ors, "auto")) {
 		plrec_writer->pprocess_func = lrec_writer_csv_process_auto_ors;
-		if (oquoting == QUOTE_MINIMAL) {
-			pstate->pquoted_output_func = quote_minimal_auto_output_func;
-		}
 	} else {
 		plrec_writer->pprocess_func = lrec_writer_csv_process_nonauto_ors;
 	}
@@ -74,6 +95,7 @@ lrec_writer_t* lrec_writer_csv_alloc(char* ors, char* ofs, quoting_t oquoting, i
 static void lrec_writer_csv_free(lrec_writer_t* pwriter, context_t* pctx) {
 	lrec_writer_csv_state_t* pstate = pwriter->pvstate;
 	slls_free(pstate->plast_header_output);
+	ob_free(pstate->pob);
 	free(pstate);
 	free(pwriter);
 }
@@ -92,7 +114,9 @@ static void lrec_writer_csv_process(void* pvstate, FILE* output_stream, lrec_t*
 	if (prec == NULL)
 		return;
 	lrec_writer_csv_state_t* pstate = pvstate;
+	output_buffer_t* pob = pstate->pob;
 	char *ofs = pstate->ofs;
+	int ofslen = pstate->ofslen;
 	int orslen = strlen(ors);
 
 	if (pstate->plast_header_output != NULL) {
@@ -100,7 +124,7 @@ static void lrec_writer_csv_process(void* pvstate, FILE* output_stream, lrec_t*
 			slls_free(pstate->plast_header_output);
 			pstate->plast_header_output = NULL;
 			if (pstate->num_header_lines_output > 0LL)
-				fputs(ors, output_stream);
+				ob_append_bytes(pob, ors, orslen);
 		}
 	}
 
@@ -109,12 +133,11 @@ static void lrec_writer_csv_process(void* pvstate, FILE* output_stream, lrec_t*
 		if (!pstate->headerless_csv_output) {
 			for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
 				if (nf > 0)
-					fputs(ofs, output_stream);
-				pstate->pquoted_output_func(output_stream, pe->key, pstate->ors, pstate->ofs,
-					orslen, pstate->ofslen, 0);
+					ob_append_bytes(pob, ofs, ofslen);
+				pstate->pquoted_output_func(pob, pe->key, pstate, 0);
 				nf++;
 			}
-			fputs(ors, output_stream);
+			ob_append_bytes(pob, ors, orslen);
 		}
 		pstate->plast_header_output = mlr_copy_keys_from_record(prec);
 		pstate->num_header_lines_output++;
@@ -123,12 +146,12 @@ static void lrec_writer_csv_process(void* pvstate, FILE* output_stream, lrec_t*
 	int nf = 0;
 	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
 		if (nf > 0)
-			fputs(ofs, output_stream);
-		pstate->pquoted_output_func(output_stream, pe->value, pstate->ors, pstate->ofs,
-			orslen, pstate->ofslen, pe->quote_flags);
+			ob_append_bytes(pob, ofs, ofslen);
+		pstate->pquoted_output_func(pob, pe->value, pstate, pe->quote_flags);
 		nf++;
 	}
-	fputs(ors, output_stream);
+	ob_append_bytes(pob, ors, orslen);
+	ob_flush_to_stream(pob, output_stream);
 	pstate->onr++;
 
 	// See ../README.md for memory-management conventions
@@ -136,89 +159,81 @@ static void lrec_writer_csv_process(void* pvstate, FILE* output_stream, lrec_t*
 }
 
 // ----------------------------------------------------------------
-static void quote_all_output_func(FILE* fp, char* string, char* ors, char* ofs, int orslen, int ofslen,
+static void quote_all_output_func(output_buffer_t* pob, char* string, lrec_writer_csv_state_t* pstate,
 	char quote_flags)
 {
-	quote_string(fp, string);
+	quote_string(pob, string);
 }
 
-static void quote_none_output_func(FILE* fp, char* string, char* ors, char* ofs, int orslen, int ofslen,
+static void quote_none_output_func(output_buffer_t* pob, char* string, lrec_writer_csv_state_t* pstate,
 	char quote_flags)
 {
-	fputs(string, fp);
-}
-
-static void quote_minimal_output_func(FILE* fp, char* string, char* ors, char* ofs, int orslen, int ofslen,
-	char quote_flags)
-{
-	int output_quotes = FALSE;
-	for (char* p = string; *p; p++) {
-		if (streqn(p, ors, orslen) || streqn(p, ofs, ofslen)) {
-			output_quotes = TRUE;
-			break;
-		}
-		if (*p == '"') {
-			output_quotes = TRUE;
-			break;
-		}
-	}
-	if (output_quotes) {
-		quote_string(fp, string);
-	} else {
-		fputs(string, fp);
-	}
+	ob_append_string(pob, string);
 }
 
-static void quote_minimal_auto_output_func(FILE* fp, char* string, char* _, char* ofs, int __, int ofslen,
+// One pass over the field: bytes which can't start a double quote, OFS, or
+// ORS are skipped with a table lookup. If the end is reached, the length is
+// known and the field is copied as-is; otherwise quoting starts from where the
+// scan stopped, without rescanning the prefix.
+static void quote_minimal_output_func(output_buffer_t* pob, char* string, lrec_writer_csv_state_t* pstate,
 	char quote_flags)
 {
-	int output_quotes = FALSE;
-	for (char* p = string; *p; p++) {
-		if (streqn(p, "\n", 1) || streqn(p, "\r\n", 2) || streqn(p, ofs, ofslen)) {
-			output_quotes = TRUE;
-			break;
-		}
-		if (*p == '"') {
-			output_quotes = TRUE;
-			break;
+	char* p = string;
+	for ( ; *p; p++) {
+		if (pstate->quote_triggers[(unsigned char)*p]) {
+			if (*p == '"'
+				|| streqn(p, pstate->quote_ors, pstate->quote_orslen)
+				|| streqn(p, pstate->ofs, pstate->ofslen))
+			{
+				break;
+			}
 		}
 	}
-	if (output_quotes) {
-		quote_string(fp, string);
+	if (*p == 0) {
+		ob_append_bytes(pob, string, p - string);
 	} else {
-		fputs(string, fp);
+		quote_string_from(pob, string, p);
 	}
 }
 
-static void quote_numeric_output_func(FILE* fp, char* string, char* ors, char* ofs, int orslen, int ofslen,
+static void quote_numeric_output_func(output_buffer_t* pob, char* string, lrec_writer_csv_state_t* pstate,
 	char quote_flags)
 {
 	double temp;
 	if (mlr_try_float_from_string(string, &temp)) {
-		quote_string(fp, string);
+		quote_string(pob, string);
 	} else {
-		fputs(string, fp);
+		ob_append_string(pob, string);
 	}
 }
 
-static void quote_original_output_func(FILE* fp, char* string, char* ors, char* ofs, int orslen, int ofslen,
+static void quote_original_output_func(output_buffer_t* pob, char* string, lrec_writer_csv_state_t* pstate,
 	char quote_flags)
 {
 	if (quote_flags & FIELD_QUOTED_ON_INPUT) {
-		quote_string(fp, string);
+		quote_string(pob, string);
 	} else {
-		fputs(string, fp);
+		ob_append_string(pob, string);
 	}
 }
 
 // ----------------------------------------------------------------
-static void quote_string(FILE* fp, char* string) {
-	fputc('"', fp);
-	for (char* p = string; *p; p++) {
-		if (*p == '"')
-			fputs("\"\"", fp);
-		else
-			fputc(*p, fp);
+static void quote_string(output_buffer_t* pob, char* string) {
+	quote_string_from(pob, string, string);
+}
+
+// The caller has already checked that string up to p has no double quotes.
+static void quote_string_from(output_buffer_t* pob, char* string, char* p) {
+	ob_append_char(pob, '"');
+	ob_append_bytes(pob, string, p - string);
+	char* q = p;
+	for ( ; *p; p++) {
+		if (*p == '"') {
+			// Copy through the double quote, then start the next run at it, so it's doubled.
+			ob_append_bytes(pob, q, p - q + 1);
+			q = p;
+		}
 	}
-	fputc('"', fp);
+	ob_append_bytes(pob, q, p - q);
+	ob_append_char(pob, '"');
 }
@@ -1,11 +1,16 @@
 #include <stdlib.h>
 #include "lib/mlrutil.h"
 #include "output/lrec_writers.h"
+#include "output/output_buffer.h"
 
 typedef struct _lrec_writer_dkvp_state_t {
 	char* ors;
 	char* ofs;
+	int   ofslen;
 	char* ops;
+	int   opslen;
+	int   single_char_separators;
+	output_buffer_t* pob;
 } lrec_writer_dkvp_state_t;
 
 static void lrec_writer_dkvp_free(lrec_writer_t* pwriter, context_t* pctx);
@@ -21,6 +26,10 @@ lrec_writer_t* lrec_writer_dkvp_alloc(char* ors, char* ofs, char* ops) {
 	pstate->ors = ors;
 	pstate->ofs = ofs;
 	pstate->ops = ops;
+	pstate->ofslen = strlen(ofs);
+	pstate->opslen = strlen(ops);
+	pstate->single_char_separators = pstate->ofslen == 1 && pstate->opslen == 1;
+	pstate->pob = ob_alloc(OUTPUT_BUFFER_DEFAULT_SIZE);
 
 	plrec_writer->pvstate = (void*)pstate;
 	plrec_writer->pprocess_func = streq(ors, "auto")
@@ -32,7 +41,9 @@ lrec_writer_t* lrec_writer_dkvp_alloc(char* ors, char* ofs, char* ops) {
 }
 
 static void lrec_writer_dkvp_free(lrec_writer_t* pwriter, context_t* pctx) {
-	free(pwriter->pvstate);
+	lrec_writer_dkvp_state_t* pstate = pwriter->pvstate;
+	ob_free(pstate->pob);
+	free(pstate);
 	free(pwriter);
 }
 
@@ -50,19 +61,33 @@ static void lrec_writer_dkvp_process(void* pvstate, FILE* output_stream, lrec_t*
 	if (prec == NULL)
 		return;
 	lrec_writer_dkvp_state_t* pstate = pvstate;
-	char* ofs = pstate->ofs;
-	char* ops = pstate->ops;
+	output_buffer_t* pob = pstate->pob;
 
-	int nf = 0;
-	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
-		if (nf > 0)
-			fputs(ofs, output_stream);
-		fputs(pe->key, output_stream);
-		fputs(ops, output_stream);
-		fputs(pe->value, output_stream);
-		nf++;
+	if (prec->poriginal_line != NULL && pstate->single_char_separators
+		&& prec->original_ifs == pstate->ofs[0] && prec->original_ips == pstate->ops[0])
+	{
+		// Unchanged since it was read with these separators: put back the ones
+		// the reader replaced with null terminators, and write out the line.
+		// The record is freed just below, so its fields needn't stay terminated.
+		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
+			if (pe != prec->phead)
+				pe->key[-1] = prec->original_ifs;
+			pe->value[-1] = prec->original_ips;
+		}
+		ob_append_bytes(pob, prec->poriginal_line, prec->original_line_length);
+	} else {
+		int nf = 0;
+		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
+			if (nf > 0)
+				ob_append_bytes(pob, pstate->ofs, pstate->ofslen);
+			ob_append_string(pob, pe->key);
+			ob_append_bytes(pob, pstate->ops, pstate->opslen);
+			ob_append_string(pob, pe->value);
+			nf++;
+		}
 	}
-	fputs(ors, output_stream);
+	ob_append_string(pob, ors);
+	ob_flush_to_stream(pob, output_stream);
 	lrec_free(prec); // end of baton-pass
 }
 
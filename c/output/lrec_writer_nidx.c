@@ -1,10 +1,13 @@
 #include <stdlib.h>
 #include "lib/mlrutil.h"
 #include "output/lrec_writers.h"
+#include "output/output_buffer.h"
 
 typedef struct _lrec_writer_nidx_state_t {
 	char* ors;
 	char* ofs;
+	int   ofslen;
+	output_buffer_t* pob;
 } lrec_writer_nidx_state_t;
 
 static void lrec_writer_nidx_free(lrec_writer_t* pwriter, context_t* pctx);
@@ -19,6 +22,8 @@ lrec_writer_t* lrec_writer_nidx_alloc(char* ors, char* ofs) {
 	lrec_writer_nidx_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_writer_nidx_state_t));
 	pstate->ors = ors;
 	pstate->ofs = ofs;
+	pstate->ofslen = strlen(ofs);
+	pstate->pob = ob_alloc(OUTPUT_BUFFER_DEFAULT_SIZE);
 
 	plrec_writer->pvstate       = (void*)pstate;
 	plrec_writer->pprocess_func = streq(ors, "auto")
@@ -30,7 +35,9 @@ lrec_writer_t* lrec_writer_nidx_alloc(char* ors, char* ofs) {
 }
 
 static void lrec_writer_nidx_free(lrec_writer_t* pwriter, context_t* pctx) {
-	free(pwriter->pvstate);
+	lrec_writer_nidx_state_t* pstate = pwriter->pvstate;
+	ob_free(pstate->pob);
+	free(pstate);
 	free(pwriter);
 }
 
@@ -48,15 +55,16 @@ static void lrec_writer_nidx_process(void* pvstate, FILE* output_stream, lrec_t*
 	if (prec == NULL)
 		return;
 	lrec_writer_nidx_state_t* pstate = pvstate;
-	char* ofs = pstate->ofs;
+	output_buffer_t* pob = pstate->pob;
 
 	int nf = 0;
 	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
 		if (nf > 0)
-			fputs(ofs, output_stream);
-		fputs(pe->value, output_stream);
+			ob_append_bytes(pob, pstate->ofs, pstate->ofslen);
+		ob_append_string(pob, pe->value);
 		nf++;
 	}
-	fputs(ors, output_stream);
+	ob_append_string(pob, ors);
+	ob_flush_to_stream(pob, output_stream);
 	lrec_free(prec); // end of baton-pass
 }
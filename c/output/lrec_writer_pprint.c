@@ -6,6 +6,17 @@
 #include "containers/mixutil.h"
 #include "output/lrec_writers.h"
 
+// ----------------------------------------------------------------
+// By default, records are held until the end of each block of same-schema
+// records (or end of stream), since column widths depend on all of them.
+//
+// With a nonzero lookahead, column widths are instead computed from the first
+// lookahead records of each block; those are printed, and subsequent records
+// are printed as they arrive, in constant memory. If a later value is too wide
+// for its column then either it's truncated to fit, or (the default) a new
+// block is started, with its own header, at that record.
+// ----------------------------------------------------------------
+
 typedef struct _lrec_writer_pprint_state_t {
 	sllv_t*    precords;
 	slls_t*    pprev_keys;
@@ -14,35 +25,73 @@ typedef struct _lrec_writer_pprint_state_t {
 	char*      ors;
 	char       ofs;
 	int        barred;
+
+	// For streaming mode
+	long long  lookahead;
+	int        truncate;
+	int*       pstreaming_widths; // Non-null when streaming the current block
+	int        num_streaming_widths;
 } lrec_writer_pprint_state_t;
 
 static void lrec_writer_pprint_free(lrec_writer_t* pwriter, context_t* pctx);
 static void lrec_writer_pprint_process(void* pvstate, FILE* output_stream, lrec_t* prec, char* ors);
+static void lrec_writer_pprint_process_streaming(void* pvstate, FILE* output_stream, lrec_t* prec, char* ors);
 static void lrec_writer_pprint_process_auto_ors(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx);
 static void lrec_writer_pprint_process_nonauto_ors(void* pvstate, FILE* output_stream, lrec_t* prec, context_t* pctx);
+static void lrec_writer_pprint_process_streaming_auto_ors(void* pvstate, FILE* output_stream, lrec_t* prec,
+	context_t* pctx);
+static void lrec_writer_pprint_process_streaming_nonauto_ors(void* pvstate, FILE* output_stream, lrec_t* prec,
+	context_t* pctx);
+static void end_streaming_block(lrec_writer_pprint_state_t* pstate, FILE* output_stream, char* ors);
+static void start_streaming_block(lrec_writer_pprint_state_t* pstate, FILE* output_stream, char* ors);
+static int  record_fits_widths(lrec_writer_pprint_state_t* pstate, lrec_t* prec);
+
+static int* compute_max_widths(sllv_t* precords);
 static void print_and_free_record_list(sllv_t* precords, FILE* output_stream, char* ors, char ofs,
 	int right_align);
 static void print_and_free_record_list_barred(sllv_t* precords, FILE* output_stream, char* ors, char ofs,
 	int right_align);
+static void print_header(lrec_t* prec, int* max_widths, FILE* output_stream, char* ors, char ofs,
+	int right_align);
+static void print_data_row(lrec_t* prec, int* max_widths, int truncate, FILE* output_stream, char* ors, char ofs,
+	int right_align);
+static void print_barred_separator(int num_fields, int* max_widths, FILE* output_stream, char* ors);
+static void print_barred_header(lrec_t* prec, int* max_widths, FILE* output_stream, char* ors, char ofs,
+	int right_align);
+static void print_barred_data_row(lrec_t* prec, int* max_widths, int truncate, FILE* output_stream, char* ors,
+	char ofs, int right_align);
+static void print_padded(char* value, int width, int truncate, FILE* output_stream, char ofs, int right_align);
 
 // ----------------------------------------------------------------
-lrec_writer_t* lrec_writer_pprint_alloc(char* ors, char ofs, int right_align, int barred) {
+lrec_writer_t* lrec_writer_pprint_alloc(char* ors, char ofs, int right_align, int barred,
+	long long lookahead, int truncate)
+{
 	lrec_writer_t* plrec_writer = mlr_malloc_or_die(sizeof(lrec_writer_t));
 
 	lrec_writer_pprint_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_writer_pprint_state_t));
-	pstate->precords           = sllv_alloc();
-	pstate->pprev_keys         = NULL;
-	pstate->ors                = ors;
-	pstate->ofs                = ofs;
-	pstate->right_align        = right_align;
-	pstate->barred             = barred;
-	pstate->num_blocks_written = 0LL;
-
-	plrec_writer->pvstate       = pstate;
-	plrec_writer->pprocess_func = streq(ors, "auto")
-		? lrec_writer_pprint_process_auto_ors
-		: lrec_writer_pprint_process_nonauto_ors;
-	plrec_writer->pfree_func    = lrec_writer_pprint_free;
+	pstate->precords             = sllv_alloc();
+	pstate->pprev_keys           = NULL;
+	pstate->ors                  = ors;
+	pstate->ofs                  = ofs;
+	pstate->right_align          = right_align;
+	pstate->barred               = barred;
+	pstate->num_blocks_written   = 0LL;
+	pstate->lookahead            = lookahead;
+	pstate->truncate             = truncate;
+	pstate->pstreaming_widths    = NULL;
+	pstate->num_streaming_widths = 0;
+
+	plrec_writer->pvstate = pstate;
+	if (lookahead > 0LL) {
+		plrec_writer->pprocess_func = streq(ors, "auto")
+			? lrec_writer_pprint_process_streaming_auto_ors
+			: lrec_writer_pprint_process_streaming_nonauto_ors;
+	} else {
+		plrec_writer->pprocess_func = streq(ors, "auto")
+			? lrec_writer_pprint_process_auto_ors
+			: lrec_writer_pprint_process_nonauto_ors;
+	}
+	plrec_writer->pfree_func = lrec_writer_pprint_free;
 
 	return plrec_writer;
 }
@@ -57,6 +106,7 @@ static void lrec_writer_pprint_free(lrec_writer_t* pwriter, context_t* pctx) {
 		slls_free(pstate->pprev_keys);
 		pstate->pprev_keys = NULL;
 	}
+	free(pstate->pstreaming_widths);
 	free(pstate);
 	free(pwriter);
 }
@@ -109,13 +159,127 @@ static void lrec_writer_pprint_process(void* pvstate, FILE* output_stream, lrec_
 }
 
 // ----------------------------------------------------------------
-static void print_and_free_record_list(sllv_t* precords, FILE* output_stream, char* ors, char ofs,
-	int right_align)
+static void lrec_writer_pprint_process_streaming_auto_ors(void* pvstate, FILE* output_stream, lrec_t* prec,
+	context_t* pctx)
 {
-	if (precords->length == 0) {
-		sllv_free(precords);
+	lrec_writer_pprint_process_streaming(pvstate, output_stream, prec, pctx->auto_line_term);
+}
+
+static void lrec_writer_pprint_process_streaming_nonauto_ors(void* pvstate, FILE* output_stream, lrec_t* prec,
+	context_t* pctx)
+{
+	lrec_writer_pprint_state_t* pstate = pvstate;
+	lrec_writer_pprint_process_streaming(pvstate, output_stream, prec, pstate->ors);
+}
+
+static void lrec_writer_pprint_process_streaming(void* pvstate, FILE* output_stream, lrec_t* prec, char* ors) {
+	lrec_writer_pprint_state_t* pstate = pvstate;
+
+	if (prec == NULL) {
+		end_streaming_block(pstate, output_stream, ors);
 		return;
 	}
+
+	if (pstate->pprev_keys != NULL && !lrec_keys_equal_list(prec, pstate->pprev_keys)) {
+		end_streaming_block(pstate, output_stream, ors);
+	} else if (pstate->pstreaming_widths != NULL && !pstate->truncate && !record_fits_widths(pstate, prec)) {
+		// Same schema, but a value is too wide: start over with a new header. The
+		// keys are the same so there's no need to recopy them.
+		slls_t* pkeys = pstate->pprev_keys;
+		pstate->pprev_keys = NULL;
+		end_streaming_block(pstate, output_stream, ors);
+		pstate->pprev_keys = pkeys;
+	}
+
+	if (pstate->pprev_keys == NULL)
+		pstate->pprev_keys = mlr_copy_keys_from_record(prec);
+
+	if (pstate->pstreaming_widths == NULL) {
+		sllv_append(pstate->precords, prec);
+		if (pstate->precords->length >= pstate->lookahead)
+			start_streaming_block(pstate, output_stream, ors);
+	} else {
+		if (pstate->barred) {
+			print_barred_data_row(prec, pstate->pstreaming_widths, pstate->truncate, output_stream, ors,
+				pstate->ofs, pstate->right_align);
+		} else {
+			print_data_row(prec, pstate->pstreaming_widths, pstate->truncate, output_stream, ors,
+				pstate->ofs, pstate->right_align);
+		}
+		lrec_free(prec); // end of baton-pass
+	}
+}
+
+// Computes column widths from the lookahead records, prints them with header,
+// and switches to printing subsequent records as they arrive.
+static void start_streaming_block(lrec_writer_pprint_state_t* pstate, FILE* output_stream, char* ors) {
+	lrec_t* prec1 = pstate->precords->phead->pvvalue;
+	pstate->pstreaming_widths = compute_max_widths(pstate->precords);
+	pstate->num_streaming_widths = prec1->field_count;
+
+	if (pstate->num_blocks_written > 0LL) // separate blocks with empty line
+		fputs(ors, output_stream);
+	pstate->num_blocks_written++;
+
+	if (pstate->barred) {
+		print_barred_separator(prec1->field_count, pstate->pstreaming_widths, output_stream, ors);
+		print_barred_header(prec1, pstate->pstreaming_widths, output_stream, ors, pstate->ofs,
+			pstate->right_align);
+		print_barred_separator(prec1->field_count, pstate->pstreaming_widths, output_stream, ors);
+	} else {
+		print_header(prec1, pstate->pstreaming_widths, output_stream, ors, pstate->ofs, pstate->right_align);
+	}
+
+	while (pstate->precords->phead != NULL) {
+		lrec_t* prec = sllv_pop(pstate->precords);
+		if (pstate->barred) {
+			print_barred_data_row(prec, pstate->pstreaming_widths, FALSE, output_stream, ors, pstate->ofs,
+				pstate->right_align);
+		} else {
+			print_data_row(prec, pstate->pstreaming_widths, FALSE, output_stream, ors, pstate->ofs,
+				pstate->right_align);
+		}
+		lrec_free(prec); // end of baton-pass
+	}
+}
+
+static void end_streaming_block(lrec_writer_pprint_state_t* pstate, FILE* output_stream, char* ors) {
+	if (pstate->pstreaming_widths == NULL) {
+		// Block ended within the lookahead window
+		if (pstate->precords->length > 0)
+			start_streaming_block(pstate, output_stream, ors);
+	}
+	if (pstate->pstreaming_widths != NULL) {
+		if (pstate->barred)
+			print_barred_separator(pstate->num_streaming_widths, pstate->pstreaming_widths, output_stream, ors);
+		free(pstate->pstreaming_widths);
+		pstate->pstreaming_widths = NULL;
+		pstate->num_streaming_widths = 0;
+	}
+	if (pstate->pprev_keys != NULL) {
+		slls_free(pstate->pprev_keys);
+		pstate->pprev_keys = NULL;
+	}
+}
+
+// The last column isn't padded in non-barred left-aligned output, so its width
+// doesn't matter there.
+static int record_fits_widths(lrec_writer_pprint_state_t* pstate, lrec_t* prec) {
+	int j = 0;
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
+		if (pe->pnext == NULL && !pstate->barred && !pstate->right_align)
+			break;
+		char* value = pe->value;
+		if (*value == 0) // empty string
+			value = "-";
+		if (strlen_for_utf8_display(value) > pstate->pstreaming_widths[j])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+static int* compute_max_widths(sllv_t* precords) {
 	lrec_t* prec1 = precords->phead->pvvalue;
 
 	int* max_widths = mlr_malloc_or_die(sizeof(int) * prec1->field_count);
@@ -132,63 +296,26 @@ static void print_and_free_record_list(sllv_t* precords, FILE* output_stream, ch
 				max_widths[j] = width;
 		}
 	}
+	return max_widths;
+}
+
+// ----------------------------------------------------------------
+static void print_and_free_record_list(sllv_t* precords, FILE* output_stream, char* ors, char ofs,
+	int right_align)
+{
+	if (precords->length == 0) {
+		sllv_free(precords);
+		return;
+	}
+
+	int* max_widths = compute_max_widths(precords);
 
 	int onr = 0;
 	for (sllve_t* pnode = precords->phead; pnode != NULL; pnode = pnode->pnext, onr++) {
 		lrec_t* prec = pnode->pvvalue;
-
-		if (onr == 0) {
-			j = 0;
-			for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-				if (j > 0) {
-					fputc(ofs, output_stream);
-				}
-				if (!right_align) {
-					if (pe->pnext == NULL) {
-						fprintf(output_stream, "%s", pe->key);
-					} else {
-						// "%-*s" fprintf format isn't correct for non-ASCII UTF-8
-						fprintf(output_stream, "%s", pe->key);
-						int d = max_widths[j] - strlen_for_utf8_display(pe->key);
-						for (int i = 0; i < d; i++)
-							fputc(ofs, output_stream);
-					}
-				} else {
-					int d = max_widths[j] - strlen_for_utf8_display(pe->key);
-					for (int i = 0; i < d; i++)
-						fputc(ofs, output_stream);
-					fprintf(output_stream, "%s", pe->key);
-				}
-			}
-			fputs(ors, output_stream);
-		}
-
-		j = 0;
-		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-			if (j > 0) {
-				fputc(ofs, output_stream);
-			}
-			char* value = pe->value;
-			if (*value == 0) // empty string
-				value = "-";
-			if (!right_align) {
-				if (pe->pnext == NULL) {
-					fprintf(output_stream, "%s", value);
-				} else {
-					fprintf(output_stream, "%s", value);
-					int d = max_widths[j] - strlen_for_utf8_display(value);
-					for (int i = 0; i < d; i++)
-						fputc(ofs, output_stream);
-				}
-			} else {
-				int d = max_widths[j] - strlen_for_utf8_display(value);
-				for (int i = 0; i < d; i++)
-					fputc(ofs, output_stream);
-				fprintf(output_stream, "%s", value);
-			}
-		}
-		fputs(ors, output_stream);
-
+		if (onr == 0)
+			print_header(prec, max_widths, output_stream, ors, ofs, right_align);
+		print_data_row(prec, max_widths, FALSE, output_stream, ors, ofs, right_align);
 		lrec_free(prec); // end of baton-pass
 	}
 
@@ -204,135 +331,150 @@ static void print_and_free_record_list_barred(sllv_t* precords, FILE* output_str
 		sllv_free(precords);
 		return;
 	}
-	lrec_t* prec1 = precords->phead->pvvalue;
 
-	int* max_widths = mlr_malloc_or_die(sizeof(int) * prec1->field_count);
-	int j = 0;
-	for (lrece_t* pe = prec1->phead; pe != NULL; pe = pe->pnext, j++) {
-		max_widths[j] = strlen_for_utf8_display(pe->key);
-	}
-	for (sllve_t* pnode = precords->phead; pnode != NULL; pnode = pnode->pnext) {
-		lrec_t* prec = pnode->pvvalue;
-		j = 0;
-		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-			int width = strlen_for_utf8_display(pe->value);
-			if (width > max_widths[j])
-				max_widths[j] = width;
-		}
-	}
+	int* max_widths = compute_max_widths(precords);
 
 	int onr = 0;
 	for (sllve_t* pnode = precords->phead; pnode != NULL; pnode = pnode->pnext, onr++) {
 		lrec_t* prec = pnode->pvvalue;
 
 		if (onr == 0) {
+			print_barred_separator(prec->field_count, max_widths, output_stream, ors);
+			print_barred_header(prec, max_widths, output_stream, ors, ofs, right_align);
+			print_barred_separator(prec->field_count, max_widths, output_stream, ors);
+		}
 
-			j = 0;
-			fputc('+', output_stream);
-			fputc('-', output_stream);
-			for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-				if (j > 0) {
-					fputc('-', output_stream);
-				}
-				int d = max_widths[j];
-				for (int i = 0; i < d; i++)
-					fputc('-', output_stream);
-				fputc('-', output_stream);
-				fputc('+', output_stream);
-			}
-			fputs(ors, output_stream);
+		print_barred_data_row(prec, max_widths, FALSE, output_stream, ors, ofs, right_align);
 
-			j = 0;
-			fputc('|', output_stream);
-			fputc(ofs, output_stream);
-			for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-				if (j > 0) {
-					fputc(ofs, output_stream);
-				}
-				if (!right_align) {
-					// "%-*s" fprintf format isn't correct for non-ASCII UTF-8
-					fprintf(output_stream, "%s", pe->key);
-					int d = max_widths[j] - strlen_for_utf8_display(pe->key);
-					for (int i = 0; i < d; i++)
-						fputc(ofs, output_stream);
-					fputc(ofs, output_stream);
-					fputc('|', output_stream);
-				} else {
-					int d = max_widths[j] - strlen_for_utf8_display(pe->key);
-					for (int i = 0; i < d; i++)
-						fputc(ofs, output_stream);
-					fprintf(output_stream, "%s", pe->key);
-					fputc(ofs, output_stream);
-					fputc('|', output_stream);
-				}
-			}
-			fputs(ors, output_stream);
+		if (pnode->pnext == NULL)
+			print_barred_separator(prec->field_count, max_widths, output_stream, ors);
 
-			j = 0;
-			fputc('+', output_stream);
-			fputc('-', output_stream);
-			for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-				if (j > 0) {
-					fputc('-', output_stream);
-				}
-				int d = max_widths[j];
-				for (int i = 0; i < d; i++)
-					fputc('-', output_stream);
-				fputc('-', output_stream);
-				fputc('+', output_stream);
-			}
-			fputs(ors, output_stream);
+		lrec_free(prec); // end of baton-pass
+	}
 
+	free(max_widths);
+	sllv_free(precords);
+}
+
+// ----------------------------------------------------------------
+static void print_header(lrec_t* prec, int* max_widths, FILE* output_stream, char* ors, char ofs,
+	int right_align)
+{
+	int j = 0;
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
+		if (j > 0) {
+			fputc(ofs, output_stream);
+		}
+		if (!right_align && pe->pnext == NULL) {
+			fprintf(output_stream, "%s", pe->key);
+		} else {
+			print_padded(pe->key, max_widths[j], FALSE, output_stream, ofs, right_align);
 		}
+	}
+	fputs(ors, output_stream);
+}
 
-		j = 0;
-		fputc('|', output_stream);
-		fputc(ofs, output_stream);
-		for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-			if (j > 0) {
-				fputc(ofs, output_stream);
-			}
-			char* value = pe->value;
-			if (*value == 0) // empty string
-				value = "-";
-			if (!right_align) {
-				fprintf(output_stream, "%s", value);
-				int d = max_widths[j] - strlen_for_utf8_display(value);
-				for (int i = 0; i < d; i++)
-					fputc(ofs, output_stream);
-				fputc(ofs, output_stream);
-				fputc('|', output_stream);
-			} else {
-				int d = max_widths[j] - strlen_for_utf8_display(value);
-				for (int i = 0; i < d; i++)
-					fputc(ofs, output_stream);
-				fprintf(output_stream, "%s", value);
-				fputc(ofs, output_stream);
-				fputc('|', output_stream);
-			}
+static void print_data_row(lrec_t* prec, int* max_widths, int truncate, FILE* output_stream, char* ors, char ofs,
+	int right_align)
+{
+	int j = 0;
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
+		if (j > 0) {
+			fputc(ofs, output_stream);
 		}
-		fputs(ors, output_stream);
+		char* value = pe->value;
+		if (*value == 0) // empty string
+			value = "-";
+		if (!right_align && pe->pnext == NULL) {
+			fprintf(output_stream, "%s", value);
+		} else {
+			print_padded(value, max_widths[j], truncate, output_stream, ofs, right_align);
+		}
+	}
+	fputs(ors, output_stream);
+}
 
-		if (pnode->pnext == NULL) {
-			j = 0;
-			fputc('+', output_stream);
+// ----------------------------------------------------------------
+static void print_barred_separator(int num_fields, int* max_widths, FILE* output_stream, char* ors) {
+	fputc('+', output_stream);
+	fputc('-', output_stream);
+	for (int j = 0; j < num_fields; j++) {
+		if (j > 0) {
 			fputc('-', output_stream);
-			for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
-				if (j > 0) {
-					fputc('-', output_stream);
-				}
-				int d = max_widths[j];
-				for (int i = 0; i < d; i++)
-					fputc('-', output_stream);
-				fputc('-', output_stream);
-				fputc('+', output_stream);
-			}
-			fputs(ors, output_stream);
 		}
+		int d = max_widths[j];
+		for (int i = 0; i < d; i++)
+			fputc('-', output_stream);
+		fputc('-', output_stream);
+		fputc('+', output_stream);
+	}
+	fputs(ors, output_stream);
+}
 
-		lrec_free(prec); // end of baton-pass
+static void print_barred_header(lrec_t* prec, int* max_widths, FILE* output_stream, char* ors, char ofs,
+	int right_align)
+{
+	int j = 0;
+	fputc('|', output_stream);
+	fputc(ofs, output_stream);
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
+		if (j > 0) {
+			fputc(ofs, output_stream);
+		}
+		print_padded(pe->key, max_widths[j], FALSE, output_stream, ofs, right_align);
+		fputc(ofs, output_stream);
+		fputc('|', output_stream);
 	}
+	fputs(ors, output_stream);
+}
 
-	free(max_widths);
-	sllv_free(precords);
+static void print_barred_data_row(lrec_t* prec, int* max_widths, int truncate, FILE* output_stream, char* ors,
+	char ofs, int right_align)
+{
+	int j = 0;
+	fputc('|', output_stream);
+	fputc(ofs, output_stream);
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext, j++) {
+		if (j > 0) {
+			fputc(ofs, output_stream);
+		}
+		char* value = pe->value;
+		if (*value == 0) // empty string
+			value = "-";
+		print_padded(value, max_widths[j], truncate, output_stream, ofs, right_align);
+		fputc(ofs, output_stream);
+		fputc('|', output_stream);
+	}
+	fputs(ors, output_stream);
+}
+
+// ----------------------------------------------------------------
+// "%-*s" fprintf format isn't correct for non-ASCII UTF-8, so we pad by hand.
+// With truncate, values wider than the column are cut to fit, at a UTF-8
+// character boundary.
+static void print_padded(char* value, int width, int truncate, FILE* output_stream, char ofs, int right_align) {
+	int value_width = strlen_for_utf8_display(value);
+	if (truncate && value_width > width) {
+		int nchars = 0;
+		char* p = value;
+		for ( ; *p; p++) {
+			if ((*p & 0xc0) != 0x80) {
+				if (nchars == width)
+					break;
+				nchars++;
+			}
+		}
+		fwrite(value, 1, p - value, output_stream);
+		return;
+	}
+	int d = width - value_width;
+	if (!right_align) {
+		fputs(value, output_stream);
+		for (int i = 0; i < d; i++)
+			fputc(ofs, output_stream);
+	} else {
+		for (int i = 0; i < d; i++)
+			fputc(ofs, output_stream);
+		fputs(value, output_stream);
+	}
 }
@@ -34,9 +34,12 @@ lrec_writer_t*  lrec_writer_alloc(cli_writer_opts_t* popts) {
 			return NULL;
 		} else {
 			return lrec_writer_pprint_alloc(popts->ors, popts->ofs[0], popts->right_align_pprint,
-				popts->pprint_barred);
+				popts->pprint_barred, popts->pprint_lookahead, popts->pprint_truncate);
 		}
 
+	} else if (streq(popts->ofile_fmt, "bin")) {
+		return lrec_writer_bin_alloc();
+
 	} else {
 		return NULL;
 	}
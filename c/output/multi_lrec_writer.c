@@ -5,9 +5,16 @@
 
 // ----------------------------------------------------------------
 multi_lrec_writer_t* multi_lrec_writer_alloc(cli_writer_opts_t* pwriter_opts) {
+	return multi_lrec_writer_alloc_in_pool(pwriter_opts, NULL);
+}
+
+multi_lrec_writer_t* multi_lrec_writer_alloc_in_pool(cli_writer_opts_t* pwriter_opts,
+	output_handle_pool_t* phandle_pool)
+{
 	multi_lrec_writer_t* pmlw = mlr_malloc_or_die(sizeof(multi_lrec_writer_t));
-	pmlw->pnames_to_lrec_writers_and_fps = lhmsv_alloc();
+	pmlw->pnames_to_lrec_writers_and_handles = lhmsv_alloc();
 	pmlw->pwriter_opts = pwriter_opts;
+	pmlw->phandle_pool = phandle_pool;
 	return pmlw;
 }
 
@@ -16,74 +23,44 @@ void multi_lrec_writer_free(multi_lrec_writer_t* pmlw, context_t* pctx) {
 	if (pmlw == NULL)
 		return;
 
-	for (lhmsve_t* pe = pmlw->pnames_to_lrec_writers_and_fps->phead; pe != NULL; pe = pe->pnext) {
-		lrec_writer_and_fp_t* pstate = pe->pvvalue;
+	for (lhmsve_t* pe = pmlw->pnames_to_lrec_writers_and_handles->phead; pe != NULL; pe = pe->pnext) {
+		lrec_writer_and_handle_t* pstate = pe->pvvalue;
 		pstate->plrec_writer->pfree_func(pstate->plrec_writer, pctx);
-		free(pstate->filename_or_command);
+		output_handle_free(pstate->phandle);
 		free(pstate);
 	}
 
-	lhmsv_free(pmlw->pnames_to_lrec_writers_and_fps);
+	lhmsv_free(pmlw->pnames_to_lrec_writers_and_handles);
 	free(pmlw);
 }
 
 // ----------------------------------------------------------------
+// The lrec-writer keeps its own state (e.g. whether the CSV header has been
+// written) across eviction and reopen of its output handle, so output resumes
+// where it left off.
 void multi_lrec_writer_output_srec(multi_lrec_writer_t* pmlw, lrec_t* poutrec, char* filename_or_command,
 	file_output_mode_t file_output_mode, int flush_every_record, context_t* pctx)
 {
-	lrec_writer_and_fp_t* pstate = lhmsv_get(pmlw->pnames_to_lrec_writers_and_fps, filename_or_command);
+	lrec_writer_and_handle_t* pstate = lhmsv_get(pmlw->pnames_to_lrec_writers_and_handles, filename_or_command);
 	if (pstate == NULL) {
-		pstate = mlr_malloc_or_die(sizeof(lrec_writer_and_fp_t));
+		pstate = mlr_malloc_or_die(sizeof(lrec_writer_and_handle_t));
 		pstate->plrec_writer = lrec_writer_alloc(pmlw->pwriter_opts);
 		MLR_INTERNAL_CODING_ERROR_IF(pstate->plrec_writer == NULL);
-		pstate->filename_or_command = mlr_strdup_or_die(filename_or_command);
-		char* mode_string = get_mode_string(file_output_mode);
-		char* mode_desc = get_mode_desc(file_output_mode);
-		if (file_output_mode == MODE_PIPE) {
-			pstate->is_popen = TRUE;
-			pstate->output_stream = popen(filename_or_command, mode_string);
-			if (pstate->output_stream == NULL) {
-				perror("popen");
-				fprintf(stderr, "%s: failed popen for %s on \"%s\".\n",
-					MLR_GLOBALS.bargv0, mode_desc, filename_or_command);
-				exit(1);
-			}
-		} else {
-			pstate->is_popen = FALSE;
-			pstate->output_stream = fopen(filename_or_command, mode_string);
-			if (pstate->output_stream == NULL) {
-				perror("fopen");
-				fprintf(stderr, "%s: failed fopen for %s on \"%s\".\n",
-					MLR_GLOBALS.bargv0, mode_desc, filename_or_command);
-				exit(1);
-			}
-		}
-
-		lhmsv_put(pmlw->pnames_to_lrec_writers_and_fps, mlr_strdup_or_die(filename_or_command), pstate, FREE_ENTRY_KEY);
+		pstate->phandle = pmlw->phandle_pool == NULL
+			? output_handle_alloc(filename_or_command, file_output_mode)
+			: output_handle_alloc_in_pool(pmlw->phandle_pool, filename_or_command, file_output_mode);
+		lhmsv_put(pmlw->pnames_to_lrec_writers_and_handles, mlr_strdup_or_die(filename_or_command), pstate,
+			FREE_ENTRY_KEY);
 	}
 
-	pstate->plrec_writer->pprocess_func(pstate->plrec_writer->pvstate, pstate->output_stream, poutrec, pctx);
+	FILE* output_stream = output_handle_get_stream(pstate->phandle);
+	pstate->plrec_writer->pprocess_func(pstate->plrec_writer->pvstate, output_stream, poutrec, pctx);
 
 	if (poutrec != NULL) {
 		if (flush_every_record)
-			fflush(pstate->output_stream);
+			output_handle_flush_record(pstate->phandle);
 	} else {
-		if (pstate->is_popen) {
-			// Sadly, pclose returns an error even on well-formed commands. For example, if the popened
-			// command was "grep nonesuch" and the string "nonesuch" was not encountered, grep returns
-			// non-zero and popen flags it as an error. We cannot differentiate these from genuine
-			// failure cases so the best choice is to simply call pclose and ignore error codes.
-			// If a piped-to command does fail then it should have some output to stderr which the
-			// user can take advantage of.
-			(void)pclose(pstate->output_stream);
-		} else {
-			if (fclose(pstate->output_stream) != 0) {
-				perror("fclose");
-				fprintf(stderr, "%s: fclose error on \"%s\".\n", MLR_GLOBALS.bargv0, filename_or_command);
-				exit(1);
-			}
-		}
-		pstate->output_stream = NULL;
+		output_handle_close(pstate->phandle);
 	}
 }
 
@@ -100,25 +77,18 @@ void multi_lrec_writer_output_list(multi_lrec_writer_t* pmlw, sllv_t* poutrecs,
 	}
 }
 
+// ----------------------------------------------------------------
+// Outputs are finished and closed in the order they were first written to.
+// Files which were evicted from the handle pool are reopened for the writers'
+// end-of-stream output (e.g. pprint's buffered records, or JSON list-wrap
+// closing brackets).
 void multi_lrec_writer_drain(multi_lrec_writer_t* pmlw, context_t* pctx) {
-	for (lhmsve_t* pe = pmlw->pnames_to_lrec_writers_and_fps->phead; pe != NULL; pe = pe->pnext) {
-		lrec_writer_and_fp_t* pstate = pe->pvvalue;
-		pstate->plrec_writer->pprocess_func(pstate->plrec_writer->pvstate, pstate->output_stream, NULL, pctx);
-		fflush(pstate->output_stream);
-		if (pstate->is_popen) {
-			// Sadly, pclose returns an error even on well-formed commands. For example, if the popened
-			// command was "grep nonesuch" and the string "nonesuch" was not encountered, grep returns
-			// non-zero and popen flags it as an error. We cannot differentiate these from genuine
-			// failure cases so the best choice is to simply call pclose and ignore error codes.
-			// If a piped-to command does fail then it should have some output to stderr which the
-			// user can take advantage of.
-			(void)pclose(pstate->output_stream);
-		} else {
-			if (fclose(pstate->output_stream) != 0) {
-				perror("fclose");
-				fprintf(stderr, "%s: fclose error on \"%s\".\n", MLR_GLOBALS.bargv0, pstate->filename_or_command);
-				exit(1);
-			}
-		}
+	for (lhmsve_t* pe = pmlw->pnames_to_lrec_writers_and_handles->phead; pe != NULL; pe = pe->pnext) {
+		lrec_writer_and_handle_t* pstate = pe->pvvalue;
+		if (pstate->phandle->is_popen && pstate->phandle->output_stream == NULL)
+			continue; // Already ended
+		FILE* output_stream = output_handle_get_stream(pstate->phandle);
+		pstate->plrec_writer->pprocess_func(pstate->plrec_writer->pvstate, output_stream, NULL, pctx);
+		output_handle_close(pstate->phandle);
 	}
 }
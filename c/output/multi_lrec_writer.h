@@ -7,24 +7,28 @@
 #include "containers/sllv.h"
 #include "output/lrec_writers.h"
 #include "output/file_output_mode.h"
+#include "output/output_handle_pool.h"
 #include "lib/context.h"
 
 // ----------------------------------------------------------------
 // This is the value struct for the hashmap:
-typedef struct _lrec_writer_and_fp_t {
-	lrec_writer_t* plrec_writer;
-	char* filename_or_command;
-	FILE* output_stream;
-	int is_popen;
-} lrec_writer_and_fp_t;
+typedef struct _lrec_writer_and_handle_t {
+	lrec_writer_t*   plrec_writer;
+	output_handle_t* phandle;
+} lrec_writer_and_handle_t;
 
 typedef struct _multi_lrec_writer_t {
-	lhmsv_t* pnames_to_lrec_writers_and_fps;
+	lhmsv_t* pnames_to_lrec_writers_and_handles;
 	cli_writer_opts_t* pwriter_opts;
+	output_handle_pool_t* phandle_pool;
 } multi_lrec_writer_t;
 
 // ----------------------------------------------------------------
+// Output handles are allocated in the default pool.
 multi_lrec_writer_t* multi_lrec_writer_alloc(cli_writer_opts_t* pwriter_opts);
+// Output handles are allocated in the given pool, which the caller owns.
+multi_lrec_writer_t* multi_lrec_writer_alloc_in_pool(cli_writer_opts_t* pwriter_opts,
+	output_handle_pool_t* phandle_pool);
 
 void multi_lrec_writer_free(multi_lrec_writer_t* pmlw, context_t* pctx);
 
@@ -4,16 +4,12 @@
 #include <stdio.h>
 #include "containers/lhmsv.h"
 #include "output/file_output_mode.h"
+#include "output/output_handle_pool.h"
 
 // ----------------------------------------------------------------
-// This is the value struct for the hashmap:
-typedef struct _fp_and_flag_t {
-	FILE* output_stream;
-	int is_popen;
-} fp_and_flag_t;
-
+// The hashmap values are output_handle_t*.
 typedef struct _multi_out_t {
-	lhmsv_t* pnames_to_fps;
+	lhmsv_t* pnames_to_handles;
 } multi_out_t;
 
 // ----------------------------------------------------------------
@@ -23,6 +19,11 @@ void  multi_out_close(multi_out_t* pmo);
 
 void  multi_out_free(multi_out_t* pmo);
 
+// The returned stream is valid until the next multi_out_get or multi_lrec_writer
+// output call, either of which may evict it from the output-handle pool.
 FILE* multi_out_get(multi_out_t* pmo, char* filename_or_command, file_output_mode_t file_output_mode);
 
+// For flush-every-record semantics. See output_handle_flush_record.
+void  multi_out_flush_record(multi_out_t* pmo, char* filename_or_command);
+
 #endif // MULTI_OUT_H
@@ -0,0 +1,40 @@
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "output/output_buffer.h"
+
+// ----------------------------------------------------------------
+output_buffer_t* ob_alloc(size_t alloc_length) {
+	output_buffer_t* pob = mlr_malloc_or_die(sizeof(output_buffer_t));
+	if (alloc_length < 1)
+		alloc_length = OUTPUT_BUFFER_DEFAULT_SIZE;
+	pob->buffer       = mlr_malloc_or_die(alloc_length);
+	pob->used_length  = 0;
+	pob->alloc_length = alloc_length;
+	return pob;
+}
+
+void ob_free(output_buffer_t* pob) {
+	if (pob == NULL)
+		return;
+	free(pob->buffer);
+	free(pob);
+}
+
+// ----------------------------------------------------------------
+// Doubling, so that a record wider than any seen so far costs one realloc and
+// the buffer then stays at that size.
+void _ob_enlarge(output_buffer_t* pob, size_t min_alloc_length) {
+	size_t new_alloc_length = pob->alloc_length * 2;
+	while (new_alloc_length < min_alloc_length)
+		new_alloc_length *= 2;
+	pob->buffer = mlr_realloc_or_die(pob->buffer, new_alloc_length);
+	pob->alloc_length = new_alloc_length;
+}
+
+// ----------------------------------------------------------------
+void ob_flush_to_stream(output_buffer_t* pob, FILE* output_stream) {
+	if (pob->used_length > 0) {
+		fwrite(pob->buffer, 1, pob->used_length, output_stream);
+		pob->used_length = 0;
+	}
+}
@@ -0,0 +1,56 @@
+// ================================================================
+// Per-writer buffer in which a whole output record is assembled before being
+// handed to stdio with a single fwrite.
+//
+// Record writers emit many short strings per record: keys, values, and
+// separators. Writing each with fputs/fputc costs a stdio lock and bounds
+// check apiece. Appending to this buffer is a length check and a memcpy.
+//
+// The buffer is emptied into the writer's FILE* at the end of each record,
+// rather than accumulating several records and writing around stdio, since
+// the same stream is shared with other output such as DSL print/emit/tee to
+// stdout, and record order relative to that output must be kept. Syscall
+// batching is then stdio's job: redirected files have large buffers (see
+// output_handle_pool.h) as does stdout when it isn't a terminal.
+// ================================================================
+
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <stdio.h>
+#include <string.h>
+
+#define OUTPUT_BUFFER_DEFAULT_SIZE (16 * 1024)
+
+typedef struct _output_buffer_t {
+	char*  buffer;
+	size_t used_length;
+	size_t alloc_length;
+} output_buffer_t;
+
+output_buffer_t* ob_alloc(size_t alloc_length);
+void ob_free(output_buffer_t* pob);
+void _ob_enlarge(output_buffer_t* pob, size_t min_alloc_length); // private method
+
+// Writes the buffered bytes to the stream with one fwrite and empties the buffer.
+void ob_flush_to_stream(output_buffer_t* pob, FILE* output_stream);
+
+// ----------------------------------------------------------------
+static inline void ob_append_char(output_buffer_t* pob, char c) {
+	if (pob->used_length >= pob->alloc_length)
+		_ob_enlarge(pob, pob->used_length + 1);
+	pob->buffer[pob->used_length++] = c;
+}
+
+static inline void ob_append_bytes(output_buffer_t* pob, char* s, size_t length) {
+	if (pob->used_length + length > pob->alloc_length)
+		_ob_enlarge(pob, pob->used_length + length);
+	memcpy(&pob->buffer[pob->used_length], s, length);
+	pob->used_length += length;
+}
+
+static inline void ob_append_string(output_buffer_t* pob, char* s) {
+	ob_append_bytes(pob, s, strlen(s));
+}
+
+#endif // OUTPUT_BUFFER_H
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "output/output_handle_pool.h"
+
+#define MIN_MAX_OPEN_FILES     4
+#define DEFAULT_MAX_OPEN_FILES 512
+
+// ----------------------------------------------------------------
+static output_handle_pool_t DEFAULT_POOL = {
+	.max_open_files = 0,
+	.phead          = NULL,
+	.ptail          = NULL,
+	.num_open_files = 0,
+	.num_opens      = 0LL,
+	.num_reopens    = 0LL,
+	.num_evictions  = 0LL,
+	.num_flushes    = 0LL,
+	.max_num_open   = 0,
+};
+static int print_stats = FALSE;
+
+static void pool_unlink(output_handle_pool_t* ppool, output_handle_t* phandle);
+static void pool_push_head(output_handle_pool_t* ppool, output_handle_t* phandle);
+static void output_handle_open(output_handle_t* phandle);
+
+// ----------------------------------------------------------------
+output_handle_pool_t* output_handle_pool_alloc(int max_open_files) {
+	output_handle_pool_t* ppool = mlr_malloc_or_die(sizeof(output_handle_pool_t));
+	ppool->max_open_files = max_open_files < MIN_MAX_OPEN_FILES ? MIN_MAX_OPEN_FILES : max_open_files;
+	ppool->phead          = NULL;
+	ppool->ptail          = NULL;
+	ppool->num_open_files = 0;
+	ppool->num_opens      = 0LL;
+	ppool->num_reopens    = 0LL;
+	ppool->num_evictions  = 0LL;
+	ppool->num_flushes    = 0LL;
+	ppool->max_num_open   = 0;
+	return ppool;
+}
+
+void output_handle_pool_free(output_handle_pool_t* ppool) {
+	if (ppool == NULL)
+		return;
+	MLR_INTERNAL_CODING_ERROR_IF(ppool->num_open_files != 0);
+	DEFAULT_POOL.num_opens     += ppool->num_opens;
+	DEFAULT_POOL.num_reopens   += ppool->num_reopens;
+	DEFAULT_POOL.num_evictions += ppool->num_evictions;
+	DEFAULT_POOL.num_flushes   += ppool->num_flushes;
+	free(ppool);
+}
+
+// ----------------------------------------------------------------
+void output_handle_pool_set_max_open_files(int max_open_files) {
+	DEFAULT_POOL.max_open_files = max_open_files;
+}
+
+void output_handle_pool_set_print_stats(int do_print_stats) {
+	print_stats = do_print_stats;
+}
+
+void output_handle_pool_print_stats(FILE* o) {
+	if (!print_stats)
+		return;
+	fprintf(o, "%s: output handles: opens=%lld reopens=%lld evictions=%lld flushes=%lld max_open=%d limit=%d\n",
+		MLR_GLOBALS.bargv0, DEFAULT_POOL.num_opens, DEFAULT_POOL.num_reopens, DEFAULT_POOL.num_evictions,
+		DEFAULT_POOL.num_flushes, DEFAULT_POOL.max_num_open, output_handle_pool_get_max_open_files());
+}
+
+// Unless overridden on the command line, use half the soft file-descriptor
+// limit, leaving the rest for input files, pipes, and whatever else.
+int output_handle_pool_get_max_open_files() {
+	if (DEFAULT_POOL.max_open_files <= 0) {
+		struct rlimit rl;
+		if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur == RLIM_INFINITY) {
+			DEFAULT_POOL.max_open_files = DEFAULT_MAX_OPEN_FILES;
+		} else {
+			DEFAULT_POOL.max_open_files = rl.rlim_cur / 2;
+		}
+		if (DEFAULT_POOL.max_open_files < MIN_MAX_OPEN_FILES)
+			DEFAULT_POOL.max_open_files = MIN_MAX_OPEN_FILES;
+	}
+	return DEFAULT_POOL.max_open_files;
+}
+
+// ----------------------------------------------------------------
+output_handle_t* output_handle_alloc(char* filename_or_command, file_output_mode_t file_output_mode) {
+	return output_handle_alloc_in_pool(&DEFAULT_POOL, filename_or_command, file_output_mode);
+}
+
+output_handle_t* output_handle_alloc_in_pool(output_handle_pool_t* ppool, char* filename_or_command,
+	file_output_mode_t file_output_mode)
+{
+	output_handle_t* phandle = mlr_malloc_or_die(sizeof(output_handle_t));
+	phandle->filename_or_command = mlr_strdup_or_die(filename_or_command);
+	phandle->file_output_mode    = file_output_mode;
+	phandle->is_popen            = file_output_mode == MODE_PIPE;
+	phandle->was_opened          = FALSE;
+	phandle->output_stream       = NULL;
+	phandle->pbuffer             = NULL;
+	phandle->ppool               = ppool;
+	phandle->pprev               = NULL;
+	phandle->pnext               = NULL;
+	return phandle;
+}
+
+void output_handle_free(output_handle_t* phandle) {
+	if (phandle == NULL)
+		return;
+	output_handle_close(phandle);
+	free(phandle->filename_or_command);
+	free(phandle);
+}
+
+// ----------------------------------------------------------------
+FILE* output_handle_get_stream(output_handle_t* phandle) {
+	if (phandle->output_stream == NULL) {
+		output_handle_open(phandle);
+	} else if (!phandle->is_popen && phandle->ppool->phead != phandle) {
+		pool_unlink(phandle->ppool, phandle);
+		pool_push_head(phandle->ppool, phandle);
+	}
+	return phandle->output_stream;
+}
+
+void output_handle_flush_record(output_handle_t* phandle) {
+	if (phandle->is_popen && phandle->output_stream != NULL) {
+		fflush(phandle->output_stream);
+		phandle->ppool->num_flushes++;
+	}
+}
+
+// ----------------------------------------------------------------
+static void output_handle_open(output_handle_t* phandle) {
+	output_handle_pool_t* ppool = phandle->ppool;
+	if (phandle->is_popen) {
+		// Pipes aren't reopened after close: that would start the command over again.
+		MLR_INTERNAL_CODING_ERROR_IF(phandle->was_opened);
+		phandle->output_stream = popen(phandle->filename_or_command, get_mode_string(MODE_PIPE));
+		if (phandle->output_stream == NULL) {
+			perror("popen");
+			fprintf(stderr, "%s: failed popen for %s on \"%s\".\n",
+				MLR_GLOBALS.bargv0, get_mode_desc(MODE_PIPE), phandle->filename_or_command);
+			exit(1);
+		}
+		phandle->was_opened = TRUE;
+		ppool->num_opens++;
+		return;
+	}
+
+	int max_open_files = ppool == &DEFAULT_POOL ? output_handle_pool_get_max_open_files() : ppool->max_open_files;
+	while (ppool->num_open_files >= max_open_files && ppool->ptail != NULL) {
+		output_handle_close(ppool->ptail);
+		ppool->num_evictions++;
+	}
+
+	// The first open truncates, for tee > etc. After eviction, append to what we
+	// already wrote.
+	file_output_mode_t mode = phandle->was_opened ? MODE_APPEND : phandle->file_output_mode;
+	phandle->output_stream = fopen(phandle->filename_or_command, get_mode_string(mode));
+	if (phandle->output_stream == NULL) {
+		perror("fopen");
+		fprintf(stderr, "%s: failed fopen for %s on \"%s\".\n",
+			MLR_GLOBALS.bargv0, get_mode_desc(mode), phandle->filename_or_command);
+		exit(1);
+	}
+	phandle->pbuffer = mlr_malloc_or_die(OUTPUT_HANDLE_BUFFER_SIZE);
+	setvbuf(phandle->output_stream, phandle->pbuffer, _IOFBF, OUTPUT_HANDLE_BUFFER_SIZE);
+
+	if (phandle->was_opened)
+		ppool->num_reopens++;
+	else
+		ppool->num_opens++;
+	phandle->was_opened = TRUE;
+
+	pool_push_head(ppool, phandle);
+	ppool->num_open_files++;
+	if (ppool->num_open_files > ppool->max_num_open)
+		ppool->max_num_open = ppool->num_open_files;
+}
+
+// ----------------------------------------------------------------
+void output_handle_close(output_handle_t* phandle) {
+	if (phandle->output_stream == NULL)
+		return;
+
+	if (phandle->is_popen) {
+		// Sadly, pclose returns an error even on well-formed commands. For example, if the popened
+		// command was "grep nonesuch" and the string "nonesuch" was not encountered, grep returns
+		// non-zero and popen flags it as an error. We cannot differentiate these from genuine
+		// failure cases so the best choice is to simply call pclose and ignore error codes.
+		// If a piped-to command does fail then it should have some output to stderr which the
+		// user can take advantage of.
+		(void)pclose(phandle->output_stream);
+	} else {
+		if (fclose(phandle->output_stream) != 0) {
+			perror("fclose");
+			fprintf(stderr, "%s: fclose error on \"%s\".\n", MLR_GLOBALS.bargv0, phandle->filename_or_command);
+			exit(1);
+		}
+		phandle->ppool->num_flushes++;
+		free(phandle->pbuffer);
+		phandle->pbuffer = NULL;
+		pool_unlink(phandle->ppool, phandle);
+		phandle->ppool->num_open_files--;
+	}
+	phandle->output_stream = NULL;
+}
+
+// ----------------------------------------------------------------
+static void pool_unlink(output_handle_pool_t* ppool, output_handle_t* phandle) {
+	if (phandle->pprev == NULL)
+		ppool->phead = phandle->pnext;
+	else
+		phandle->pprev->pnext = phandle->pnext;
+	if (phandle->pnext == NULL)
+		ppool->ptail = phandle->pprev;
+	else
+		phandle->pnext->pprev = phandle->pprev;
+	phandle->pprev = NULL;
+	phandle->pnext = NULL;
+}
+
+static void pool_push_head(output_handle_pool_t* ppool, output_handle_t* phandle) {
+	phandle->pprev = NULL;
+	phandle->pnext = ppool->phead;
+	if (ppool->phead != NULL)
+		ppool->phead->pprev = phandle;
+	ppool->phead = phandle;
+	if (ppool->ptail == NULL)
+		ppool->ptail = phandle;
+}
@@ -0,0 +1,101 @@
+// ================================================================
+// Bounded pool of output handles for redirected DSL output: tee > ..., emit > ...,
+// print > ..., dump > ..., and their >> and | variants.
+//
+// Each distinct redirect target has an output_handle_t. Its stream is opened on
+// first use. Open file handles are kept on a least-recently-used list, and when
+// opening one more would exceed the pool's limit, the least-recently-used file
+// is closed. It is transparently reopened, in append mode, the next time it's
+// written to. This keeps Miller within its file-descriptor limit no matter how
+// many distinct filenames a put expression produces. Pipes are never evicted
+// since closing a pipe ends the command on the other side of it.
+//
+// DSL redirects share a process-wide default pool. Other users, such as the
+// split verb's writer threads, may allocate their own pools: pools are not
+// thread-safe, so each thread must use only its own.
+//
+// File handles get large stdio buffers, and are flushed only when their buffers
+// fill, on eviction, and on close, so that many small record writes become few
+// write syscalls. Pipes are flushed after each record (unless put/filter
+// --no-fflush is used) so that downstream commands see output as it's produced.
+// ================================================================
+
+#ifndef OUTPUT_HANDLE_POOL_H
+#define OUTPUT_HANDLE_POOL_H
+
+#include <stdio.h>
+#include "output/file_output_mode.h"
+
+#define OUTPUT_HANDLE_BUFFER_SIZE (64 * 1024)
+
+struct _output_handle_pool_t;
+
+typedef struct _output_handle_t {
+	char*              filename_or_command;
+	file_output_mode_t file_output_mode;
+	int                is_popen;
+	int                was_opened;
+	FILE*              output_stream; // NULL when not currently open
+	char*              pbuffer;
+	struct _output_handle_pool_t* ppool;
+	// Links in the pool's LRU list of open file handles
+	struct _output_handle_t* pprev;
+	struct _output_handle_t* pnext;
+} output_handle_t;
+
+typedef struct _output_handle_pool_t {
+	int max_open_files;
+
+	// LRU list of open file handles: most recently used at head.
+	output_handle_t* phead;
+	output_handle_t* ptail;
+	int num_open_files;
+
+	long long num_opens;
+	long long num_reopens;
+	long long num_evictions;
+	long long num_flushes;
+	int       max_num_open;
+} output_handle_pool_t;
+
+// ----------------------------------------------------------------
+// Allocates in the default pool.
+output_handle_t* output_handle_alloc(char* filename_or_command, file_output_mode_t file_output_mode);
+output_handle_t* output_handle_alloc_in_pool(output_handle_pool_t* ppool, char* filename_or_command,
+	file_output_mode_t file_output_mode);
+
+// Closes the handle if it's open.
+void output_handle_free(output_handle_t* phandle);
+
+// Returns the handle's stream, (re)opening it if necessary and marking it as
+// most recently used. The return value is only valid until the next call to
+// this function for any handle, since that call may evict this one.
+FILE* output_handle_get_stream(output_handle_t* phandle);
+
+// For flush-every-record semantics: flushes pipes; leaves files to their buffers.
+void output_handle_flush_record(output_handle_t* phandle);
+
+// Closes the stream if it's open. A subsequent get reopens in append mode.
+void output_handle_close(output_handle_t* phandle);
+
+// ----------------------------------------------------------------
+// The pool's handles must all have been freed before the pool is. Its counts
+// are added to the default pool's, for stats printing.
+output_handle_pool_t* output_handle_pool_alloc(int max_open_files);
+void output_handle_pool_free(output_handle_pool_t* ppool);
+
+// ----------------------------------------------------------------
+// Process-wide settings, from the main command line.
+
+// Zero means use a default derived from the file-descriptor limit.
+void output_handle_pool_set_max_open_files(int max_open_files);
+void output_handle_pool_set_print_stats(int print_stats);
+
+// The default pool's limit, which other pools' limits should be carved out of.
+int output_handle_pool_get_max_open_files();
+
+// Prints open/reopen/evict/flush counts to the given stream, if stats printing
+// was requested.
+void output_handle_pool_print_stats(FILE* o);
+
+#endif // OUTPUT_HANDLE_POOL_H
@@ -3,10 +3,12 @@
 #include <string.h>
 
 #include "lib/mlrutil.h"
+#include "lib/mlr_arch.h"
 #include "lib/mlr_globals.h"
 #include "containers/lrec.h"
 #include "containers/sllv.h"
 #include "input/lrec_readers.h"
+#include "input/parallel_file_reader.h"
 #include "mapping/mappers.h"
 #include "output/lrec_writers.h"
 
@@ -16,6 +18,9 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 static int do_file_chained(char* filename, context_t* pctx,
 	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
 	cli_opts_t* popts);
+static int can_read_files_in_parallel(cli_opts_t* popts);
+static int do_files_parallel_chained(parallel_file_reader_t* preader, context_t* pctx,
+	sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream, cli_opts_t* popts);
 
 static sllv_t* chain_map(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head);
 
@@ -120,6 +125,7 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 
 	lrec_reader_t* plrec_reader = lrec_reader_alloc_or_die(&popts->reader_opts);
 	lrec_writer_t* plrec_writer = lrec_writer_alloc_or_die(&popts->writer_opts);
+	parallel_file_reader_t* pparallel_reader = NULL;
 
 	MLR_INTERNAL_CODING_ERROR_IF(pmapper_list->length < 1); // Should not have been allowed by the CLI parser.
 
@@ -133,6 +139,11 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 		pctx->fnr = 0;
 		ok = do_file_chained("-", pctx, plrec_reader, pmapper_list, plrec_writer,
 			output_stream, popts) && ok;
+	} else if (can_read_files_in_parallel(popts)) {
+		pparallel_reader = parallel_file_reader_alloc(&popts->reader_opts, popts->filenames,
+			popts->read_threads, popts->read_threads_ordered, pctx);
+		ok = do_files_parallel_chained(pparallel_reader, pctx, pmapper_list, plrec_writer,
+			output_stream, popts) && ok;
 	} else {
 		// Read from each file name in turn
 		for (sllse_t* pe = popts->filenames->phead; pe != NULL; pe = pe->pnext) {
@@ -155,6 +166,7 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 	plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, NULL, pctx);
 
 	plrec_reader->pfree_func(plrec_reader);
+	parallel_file_reader_free(pparallel_reader);
 	plrec_writer->pfree_func(plrec_writer, pctx);
 
 	return ok;
@@ -173,14 +185,14 @@ static int do_file_chained(char* filename, context_t* pctx,
 	// Start-of-file hook, e.g. expecting CSV headers on input.
 	plrec_reader->psof_func(plrec_reader->pvstate, pvhandle);
 
-	while (1) {
+	// A mapper which will pass on no more records, whatever its input, sets
+	// force_eof: e.g. mlr head, once it has its records. Reading stops right
+	// away, rather than after one more record, which for slow input such as a
+	// pipe may be a long time coming; the mappers get end of stream as usual.
+	while (pctx->force_eof == FALSE) {
 		lrec_t* pinrec = plrec_reader->pprocess_func(plrec_reader->pvstate, pvhandle, pctx);
 		if (pinrec == NULL)
 			break;
-		if (pctx->force_eof == TRUE) { // e.g. mlr head
-			lrec_free(pinrec);
-			break;
-		}
 		pctx->nr++;
 		pctx->fnr++;
 
@@ -193,6 +205,37 @@ static int do_file_chained(char* filename, context_t* pctx,
 	return 1;
 }
 
+// ----------------------------------------------------------------
+// With pass-comments the readers write comment lines straight to standard
+// output, which only makes sense when reading in order on the main thread.
+static int can_read_files_in_parallel(cli_opts_t* popts) {
+	return MLR_ARCH_THREADS_ENABLED
+		&& popts->read_threads > 1
+		&& popts->filenames->length > 1
+		&& popts->reader_opts.comment_handling != PASS_COMMENTS;
+}
+
+static int do_files_parallel_chained(parallel_file_reader_t* preader, context_t* pctx,
+	sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream, cli_opts_t* popts)
+{
+	progress_indicator_t* pindicator = popts->nr_progress_mod == 0LL
+		? null_progress_indicator
+		: stderr_progress_indicator;
+
+	while (pctx->force_eof == FALSE) { // e.g. mlr head
+		// Sets FILENAME, FILENUM, and FNR for the record.
+		lrec_t* pinrec = parallel_file_reader_next(preader, pctx);
+		if (pinrec == NULL)
+			break;
+		pctx->nr++;
+
+		pindicator(pctx, popts->nr_progress_mod);
+
+		drive_lrec(pinrec, pctx, pmapper_list->phead, plrec_writer, output_stream);
+	}
+	return 1;
+}
+
 // ----------------------------------------------------------------
 static void drive_lrec(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, lrec_writer_t* plrec_writer,
 	FILE* output_stream)
@@ -72,7 +72,7 @@ static char* test_lrec_unbacked_api() {
 static char* test_lrec_dkvp_api() {
 	char* line = mlr_strdup_or_die("w=2,x=3,y=4,z=5");
 
-	lrec_t* prec = lrec_parse_stdio_dkvp_single_sep(line, ',', '=', FALSE);
+	lrec_t* prec = lrec_parse_stdio_dkvp_single_sep(line, ',', '=', FALSE, NULL);
 	mu_assert_lf(prec->field_count == 4);
 
 	mu_assert_lf(streq(lrec_get(prec, "w"), "2"));
@@ -15,7 +15,12 @@
 #include "containers/lhms2v.h"
 #include "containers/lhmslv.h"
 #include "containers/lhmsmv.h"
+#include "containers/group_table.h"
+#include "containers/fingerprint_table.h"
+#include "containers/heavy_hitters.h"
+#include "containers/hyperloglog.h"
 #include "containers/percentile_keeper.h"
+#include "containers/percentile_sketch.h"
 #include "containers/top_keeper.h"
 #include "containers/dheap.h"
 #include "lib/mvfuncs.h"
@@ -627,6 +632,246 @@ static char* test_lhmslv() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+static char* test_group_table() {
+	slls_t* aw = slls_alloc(); slls_append_no_free(aw, "a"); slls_append_no_free(aw, "w");
+	slls_t* ax = slls_alloc(); slls_append_no_free(ax, "a"); slls_append_no_free(ax, "x");
+	slls_t* abx = slls_alloc(); slls_append_no_free(abx, "ab"); slls_append_no_free(abx, "x");
+	slls_t* abx2 = slls_alloc(); slls_append_no_free(abx2, "a"); slls_append_no_free(abx2, "bx");
+	group_key_t* pkey = group_key_alloc();
+
+	group_table_t* ptable = group_table_alloc(2);
+	mu_assert_lf(group_table_size(ptable) == 0);
+	group_key_from_list(pkey, aw); mu_assert_lf(group_table_get(ptable, pkey) == NULL);
+	mu_assert_lf(group_table_check(ptable));
+
+	group_key_from_list(pkey, ax);  group_table_put(ptable, pkey, "3");
+	group_key_from_list(pkey, abx); group_table_put(ptable, pkey, "5");
+	mu_assert_lf(group_table_size(ptable) == 2);
+	group_key_from_list(pkey, aw);   mu_assert_lf(group_table_get(ptable, pkey) == NULL);
+	group_key_from_list(pkey, ax);   mu_assert_lf(streq(group_table_get(ptable, pkey), "3"));
+	group_key_from_list(pkey, abx);  mu_assert_lf(streq(group_table_get(ptable, pkey), "5"));
+	group_key_from_list(pkey, abx2); mu_assert_lf(group_table_get(ptable, pkey) == NULL);
+	mu_assert_lf(group_table_check(ptable));
+
+	group_key_from_list(pkey, ax); group_table_put(ptable, pkey, "4");
+	mu_assert_lf(group_table_size(ptable) == 2);
+	mu_assert_lf(streq(group_table_get(ptable, pkey), "4"));
+
+	// Keys are copied, and iteration is in insertion order.
+	mu_assert_lf(ptable->entries[0].key_values[0] != ax->phead->value);
+	mu_assert_lf(streq(ptable->entries[0].key_values[0], "a"));
+	mu_assert_lf(streq(ptable->entries[0].key_values[1], "x"));
+	mu_assert_lf(streq(ptable->entries[1].key_values[0], "ab"));
+	mu_assert_lf(streq(ptable->entries[1].key_values[1], "x"));
+	group_table_free(ptable);
+
+	// Enough keys to force rehashing, with values long enough to need more than one arena block.
+	ptable = group_table_alloc(2);
+	char buf1[32], buf2[2048];
+	memset(buf2, 'y', sizeof(buf2) - 1);
+	buf2[sizeof(buf2) - 1] = 0;
+	char* values[2] = { buf1, buf2 };
+	int n = 10000;
+	for (int i = 0; i < n; i++) {
+		snprintf(buf1, sizeof(buf1), "%d", i);
+		group_key_from_array(pkey, values, 2);
+		void** ppvalue = group_table_get_or_add(ptable, pkey);
+		mu_assert_lf(*ppvalue == NULL);
+		*ppvalue = (void*)(long)(i + 1);
+	}
+	mu_assert_lf(group_table_size(ptable) == n);
+	mu_assert_lf(group_table_check(ptable));
+	for (int i = 0; i < n; i++) {
+		snprintf(buf1, sizeof(buf1), "%d", i);
+		group_key_from_array(pkey, values, 2);
+		mu_assert_lf(group_table_get(ptable, pkey) == (void*)(long)(i + 1));
+		mu_assert_lf(streq(ptable->entries[i].key_values[0], buf1));
+		mu_assert_lf(streq(ptable->entries[i].key_values[1], buf2));
+	}
+	group_table_free(ptable);
+
+	// No group-by fields: one group.
+	ptable = group_table_alloc(0);
+	slls_t* pempty = slls_alloc();
+	group_key_from_list(pkey, pempty); group_table_put(ptable, pkey, "1");
+	group_key_from_list(pkey, pempty); mu_assert_lf(streq(group_table_get(ptable, pkey), "1"));
+	mu_assert_lf(group_table_size(ptable) == 1);
+	group_table_free(ptable);
+
+	group_key_free(pkey);
+	slls_free(aw);
+	slls_free(ax);
+	slls_free(abx);
+	slls_free(abx2);
+	slls_free(pempty);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_fingerprint_table() {
+	group_key_t* pkey = group_key_alloc();
+	char* ab_c[] = { "ab", "c" };
+	char* a_bc[] = { "a", "bc" };
+	char* abc[]  = { "abc" };
+
+	// Values are delimited, as for group_table.
+	fingerprint_table_t* ptable = fingerprint_table_alloc();
+	group_key_from_array(pkey, ab_c, 2); fingerprint_t fp_ab_c = fingerprint_from_group_key(pkey);
+	group_key_from_array(pkey, a_bc, 2); fingerprint_t fp_a_bc = fingerprint_from_group_key(pkey);
+	group_key_from_array(pkey, abc, 1);  fingerprint_t fp_abc  = fingerprint_from_group_key(pkey);
+	mu_assert_lf(fp_ab_c.lo != fp_a_bc.lo && fp_ab_c.lo != fp_abc.lo && fp_a_bc.lo != fp_abc.lo);
+	mu_assert_lf(fp_ab_c.hi != fp_ab_c.lo);
+
+	mu_assert_lf(fingerprint_table_get(ptable, fp_ab_c) == NULL);
+	fingerprint_table_entry_t* pe = fingerprint_table_get_or_add(ptable, fp_ab_c);
+	mu_assert_lf(pe->count == 0LL && pe->pvvalue == NULL);
+	pe->count++;
+	pe = fingerprint_table_get_or_add(ptable, fp_a_bc);
+	mu_assert_lf(pe->count == 0LL);
+	pe->count++;
+	pe = fingerprint_table_get_or_add(ptable, fp_ab_c);
+	mu_assert_lf(pe->count == 1LL);
+	pe->count++;
+	mu_assert_lf(fingerprint_table_size(ptable) == 2);
+	mu_assert_lf(fingerprint_table_get(ptable, fp_abc) == NULL);
+	mu_assert_lf(ptable->entries[0].count == 2LL);
+	mu_assert_lf(ptable->entries[1].count == 1LL);
+	mu_assert_lf(fingerprint_table_check(ptable));
+	fingerprint_table_free(ptable);
+
+	// Enough keys to force rehashing.
+	ptable = fingerprint_table_alloc();
+	char buf[32];
+	char* values[] = { buf };
+	int n = 100000;
+	for (int rep = 0; rep < 2; rep++) {
+		for (int i = 0; i < n; i++) {
+			snprintf(buf, sizeof(buf), "%d", i);
+			group_key_from_array(pkey, values, 1);
+			pe = fingerprint_table_get_or_add(ptable, fingerprint_from_group_key(pkey));
+			mu_assert_lf(pe->count == rep);
+			pe->count++;
+		}
+	}
+	mu_assert_lf(fingerprint_table_size(ptable) == n);
+	mu_assert_lf(fingerprint_table_check(ptable));
+	for (int i = 0; i < n; i++)
+		mu_assert_lf(ptable->entries[i].count == 2LL);
+	fingerprint_table_free(ptable);
+
+	group_key_free(pkey);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_heavy_hitters() {
+	group_key_t* pkey = group_key_alloc();
+	char buf[32];
+	char* values[] = { buf };
+
+	// With enough counters, counts are exact.
+	heavy_hitters_t* phh = heavy_hitters_alloc(1, 10);
+	for (int i = 0; i < 10; i++) {
+		for (int j = 0; j <= i; j++) {
+			snprintf(buf, sizeof(buf), "%d", j);
+			group_key_from_array(pkey, values, 1);
+			heavy_hitters_ingest(phh, pkey);
+		}
+	}
+	mu_assert_lf(heavy_hitters_check(phh));
+	heavy_hitter_t** sorted = heavy_hitters_sorted(phh);
+	for (int i = 0; i < 10; i++) {
+		snprintf(buf, sizeof(buf), "%d", i);
+		mu_assert_lf(streq(sorted[i]->key_values[0], buf));
+		mu_assert_lf(sorted[i]->count == 10 - i);
+		mu_assert_lf(sorted[i]->error == 0LL);
+	}
+	free(sorted);
+	heavy_hitters_free(phh);
+
+	// With few counters, frequent values are still found among many rare ones,
+	// with counts over by at most n/m.
+	int m = 20;
+	phh = heavy_hitters_alloc(1, m);
+	int n = 0;
+	for (int i = 0; i < 20000; i++) {
+		if (i % 4 == 0)
+			snprintf(buf, sizeof(buf), "hot");
+		else if (i % 10 == 1)
+			snprintf(buf, sizeof(buf), "warm");
+		else
+			snprintf(buf, sizeof(buf), "cold%d", i);
+		group_key_from_array(pkey, values, 1);
+		heavy_hitters_ingest(phh, pkey);
+		n++;
+		if (i % 997 == 0)
+			mu_assert_lf(heavy_hitters_check(phh));
+	}
+	mu_assert_lf(heavy_hitters_check(phh));
+	mu_assert_lf(phh->num_counters == m);
+	sorted = heavy_hitters_sorted(phh);
+	mu_assert_lf(streq(sorted[0]->key_values[0], "hot"));
+	mu_assert_lf(sorted[0]->count >= 5000 && sorted[0]->count <= 5000 + n / m);
+	mu_assert_lf(sorted[0]->count - sorted[0]->error <= 5000);
+	mu_assert_lf(streq(sorted[1]->key_values[0], "warm"));
+	mu_assert_lf(sorted[1]->count >= 2000 && sorted[1]->count <= 2000 + n / m);
+	free(sorted);
+	heavy_hitters_free(phh);
+
+	group_key_free(pkey);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_hyperloglog() {
+	group_key_t* pkey = group_key_alloc();
+	char buf[32];
+
+	// Small counts are exact or nearly so, in sparse form.
+	hyperloglog_t* phll = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	mu_assert_lf(hyperloglog_estimate(phll) == 0.0);
+	for (int rep = 0; rep < 3; rep++) {
+		for (int i = 0; i < 100; i++) {
+			snprintf(buf, sizeof(buf), "%d", i);
+			char* values[] = { buf };
+			group_key_from_array(pkey, values, 1);
+			hyperloglog_add_hash(phll, pkey->hash);
+		}
+	}
+	mu_assert_lf(phll->registers == NULL);
+	mu_assert_lf(llround(hyperloglog_estimate(phll)) >= 99 && llround(hyperloglog_estimate(phll)) <= 101);
+
+	// Large counts, built in two halves which overlap by 10000, are within a few
+	// standard errors once merged.
+	hyperloglog_t* pfirst  = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	hyperloglog_t* psecond = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	int n = 200000;
+	for (int i = 0; i < n; i++) {
+		snprintf(buf, sizeof(buf), "%d", i);
+		char* values[] = { buf };
+		group_key_from_array(pkey, values, 1);
+		if (i < n/2 + 5000)
+			hyperloglog_add_hash(pfirst, pkey->hash);
+		if (i >= n/2 - 5000)
+			hyperloglog_add_hash(psecond, pkey->hash);
+	}
+	mu_assert_lf(pfirst->registers != NULL);
+	hyperloglog_merge(pfirst, psecond);
+	double estimate = hyperloglog_estimate(pfirst);
+	mu_assert_lf(fabs(estimate - n) < 0.03 * n);
+
+	// Sparse into dense.
+	hyperloglog_merge(phll, pfirst);
+	mu_assert_lf(hyperloglog_estimate(phll) == estimate);
+
+	hyperloglog_free(phll);
+	hyperloglog_free(pfirst);
+	hyperloglog_free(psecond);
+	group_key_free(pkey);
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_lhmsmv() {
 	printf("\n");
@@ -733,6 +978,91 @@ static char* test_percentile_keeper() {
 
 	percentile_keeper_free(ppercentile_keeper);
 
+	// Selection over int-only storage, in any order of ranks, then after a
+	// switch to mixed storage. The values are 0 to n-1 so a value is its own rank.
+	int n = 10007;
+	ppercentile_keeper = percentile_keeper_alloc();
+	for (int i = 0; i < n; i++)
+		percentile_keeper_ingest(ppercentile_keeper, mv_from_int((long long)i * 7919LL % n));
+	mu_assert_lf(ppercentile_keeper->type == PERCENTILE_KEEPER_INTS);
+	int ps[] = { 50, 10, 90, 25, 75, 0, 100, 50, 99, 1 };
+	for (int i = 0; i < sizeof(ps)/sizeof(ps[0]); i++) {
+		q = percentile_keeper_emit_non_interpolated(ppercentile_keeper, ps[i]);
+		mu_assert_lf(q.type == MT_INT);
+		mu_assert_lf(q.u.intv == (ps[i] == 100 ? n - 1 : ps[i] * n / 100));
+	}
+	q = percentile_keeper_emit_linearly_interpolated(ppercentile_keeper, 50.0);
+	mu_assert_lf(q.type == MT_FLOAT && q.u.fltv == (n - 1) / 2.0);
+
+	percentile_keeper_ingest(ppercentile_keeper, mv_from_float(-0.5));
+	mu_assert_lf(ppercentile_keeper->type == PERCENTILE_KEEPER_MIXED);
+	q = percentile_keeper_emit_non_interpolated(ppercentile_keeper, 0.0);
+	mu_assert_lf(q.type == MT_FLOAT && q.u.fltv == -0.5);
+	q = percentile_keeper_emit_non_interpolated(ppercentile_keeper, 50.0);
+	mu_assert_lf(q.type == MT_INT && q.u.intv == (n + 1) / 2 - 1);
+	q = percentile_keeper_emit_non_interpolated(ppercentile_keeper, 100.0);
+	mu_assert_lf(q.type == MT_INT && q.u.intv == n - 1);
+	percentile_keeper_free(ppercentile_keeper);
+
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_percentile_sketch() {
+	mv_t q;
+
+	// Below k values, the same as percentile_keeper.
+	percentile_sketch_t* psketch = percentile_sketch_alloc(PERCENTILE_SKETCH_DEFAULT_K);
+	for (int i = 5; i >= 1; i--)
+		percentile_sketch_ingest(psketch, i, TRUE);
+	q = percentile_sketch_emit_non_interpolated(psketch, 10.0);
+	mu_assert_lf(q.type == MT_INT && q.u.intv == 1LL);
+	q = percentile_sketch_emit_non_interpolated(psketch, 50.0);
+	mu_assert_lf(q.type == MT_INT && q.u.intv == 3LL);
+	q = percentile_sketch_emit_non_interpolated(psketch, 100.0);
+	mu_assert_lf(q.type == MT_INT && q.u.intv == 5LL);
+	q = percentile_sketch_emit_linearly_interpolated(psketch, 25.0);
+	mu_assert_lf(q.type == MT_FLOAT && q.u.fltv == 2.0);
+	q = percentile_sketch_emit_linearly_interpolated(psketch, 30.0);
+	mu_assert_lf(q.type == MT_FLOAT && q.u.fltv > 2.19 && q.u.fltv < 2.21);
+	percentile_sketch_ingest(psketch, 2.5, FALSE);
+	q = percentile_sketch_emit_non_interpolated(psketch, 50.0);
+	mu_assert_lf(q.type == MT_FLOAT && q.u.fltv == 3.0);
+	percentile_sketch_free(psketch);
+
+	// Beyond k values: bounded memory, with ranks off by less than 2% of n.
+	// The values are 0 to n-1 so a value is its own rank.
+	int n = 100000;
+	psketch = percentile_sketch_alloc(PERCENTILE_SKETCH_DEFAULT_K);
+	percentile_sketch_t* pfirst  = percentile_sketch_alloc(PERCENTILE_SKETCH_DEFAULT_K);
+	percentile_sketch_t* psecond = percentile_sketch_alloc(PERCENTILE_SKETCH_DEFAULT_K);
+	for (int i = 0; i < n; i++) {
+		long long value = (long long)i * 7919LL % n;
+		percentile_sketch_ingest(psketch, value, TRUE);
+		percentile_sketch_ingest(i < n/3 ? pfirst : psecond, value, TRUE);
+	}
+	percentile_sketch_merge(pfirst, psecond);
+	mu_assert_lf(psketch->n == n);
+	mu_assert_lf(pfirst->n == n);
+	mu_assert_lf(percentile_sketch_retained(psketch) < 10 * PERCENTILE_SKETCH_DEFAULT_K);
+	mu_assert_lf(percentile_sketch_retained(pfirst) < 10 * PERCENTILE_SKETCH_DEFAULT_K);
+
+	for (int p = 0; p <= 100; p += 5) {
+		percentile_sketch_t* psketches[] = { psketch, pfirst };
+		for (int j = 0; j < 2; j++) {
+			q = percentile_sketch_emit_non_interpolated(psketches[j], p);
+			mu_assert_lf(q.type == MT_INT);
+			long long wanted = p == 100 ? n - 1 : p * n / 100;
+			mu_assert_lf(llabs(q.u.intv - wanted) < n / 50);
+			if (p == 0 || p == 100)
+				mu_assert_lf(q.u.intv == wanted);
+		}
+	}
+
+	percentile_sketch_free(psketch);
+	percentile_sketch_free(pfirst);
+	percentile_sketch_free(psecond);
+
 	return NULL;
 }
 
@@ -788,6 +1118,35 @@ static char* test_top_keeper() {
 	mu_assert_lf(ptop_keeper->top_values[2].u.fltv == 5.0);
 
 	top_keeper_free(ptop_keeper);
+
+	// Past the threshold, as a heap: the same values as the sorted array would
+	// keep, in the same order once sorted.
+	capacity = 3 * TOP_KEEPER_HEAP_THRESHOLD;
+	ptop_keeper = top_keeper_alloc(capacity);
+	top_keeper_t* parray_keeper = top_keeper_alloc(TOP_KEEPER_HEAP_THRESHOLD);
+	mu_assert_lf(ptop_keeper->is_heap);
+	for (int i = 0; i < 10 * capacity; i++) {
+		// Distinct values, scrambled, with an int/float mix.
+		long long v = (i * 7919LL) % (10 * capacity);
+		mv_t value = (i % 2) ? mv_from_int(v) : mv_from_float(v + 0.5);
+		top_keeper_add(ptop_keeper, value, NULL);
+		top_keeper_add(parray_keeper, value, NULL);
+		if (i == capacity / 2) {
+			// Sorting part way through is allowed.
+			top_keeper_sort(ptop_keeper);
+			mu_assert_lf(!ptop_keeper->is_heap);
+		}
+	}
+	top_keeper_sort(ptop_keeper);
+	top_keeper_sort(parray_keeper);
+	mu_assert_lf(ptop_keeper->size == capacity);
+	for (int i = 1; i < capacity; i++)
+		mu_assert_lf(mv_i_nn_gt(&ptop_keeper->top_values[i-1], &ptop_keeper->top_values[i]));
+	for (int i = 0; i < parray_keeper->size; i++)
+		mu_assert_lf(mv_i_nn_eq(&ptop_keeper->top_values[i], &parray_keeper->top_values[i]));
+	top_keeper_free(ptop_keeper);
+	top_keeper_free(parray_keeper);
+
 	return NULL;
 }
 
@@ -874,8 +1233,13 @@ static char * run_all_tests() {
 	mu_run_test(test_lhmsv);
 	mu_run_test(test_lhms2v);
 	mu_run_test(test_lhmslv);
+	mu_run_test(test_group_table);
+	mu_run_test(test_fingerprint_table);
+	mu_run_test(test_heavy_hitters);
+	mu_run_test(test_hyperloglog);
 	mu_run_test(test_lhmsmv);
 	mu_run_test(test_percentile_keeper);
+	mu_run_test(test_percentile_sketch);
 	mu_run_test(test_top_keeper);
 	mu_run_test(test_dheap);
 	return 0;
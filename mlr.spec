@@ -8,6 +8,7 @@ Source: https://github.com/johnkerl/miller/releases/download/v%{version}/%{name}
 URL: http://johnkerl.org/miller/doc
 Buildroot: %{_tmppath}/%{name}-%{version}-root
 BuildRequires: flex >= 2.5.35
+BuildRequires: zlib-devel
 
 %description
 Miller (mlr) allows name-indexed data such as CSV and JSON files to be